@@ -14,6 +14,15 @@
 #include "bt_compiler.h"
 #include "bt_debug.h"
 #include "bt_gc.h"
+#include "bt_userdata.h"
+#include "bt_profiler.h"
+#include "bt_coroutine.h"
+#include "bt_channel.h"
+#include "bt_image.h"
+#include "bt_module_cache.h"
+
+static void coroutine_finalizer(bt_Context* ctx, bt_Userdata* userdata);
+static void coroutine_tracer(bt_Context* ctx, bt_Userdata* userdata);
 
 void bt_open(bt_Context** context, bt_Handlers* handlers)
 {
@@ -23,6 +32,8 @@ void bt_open(bt_Context** context, bt_Handlers* handlers)
 	ctx->alloc = handlers->alloc;
 	ctx->free = handlers->free;
 	ctx->realloc = handlers->realloc;
+	ctx->alloc_page = handlers->alloc_page;
+	ctx->free_page = handlers->free_page;
 	ctx->on_error = handlers->on_error;
 
 	ctx->write = handlers->write;
@@ -32,10 +43,11 @@ void bt_open(bt_Context** context, bt_Handlers* handlers)
 	ctx->free_source = handlers->free_source;
 
 	bt_make_gc(ctx);
+	bt_pool_init(ctx);
 
-	for (uint32_t i = 0; i < BT_STRINGTABLE_SIZE; i++) {
-		bt_buffer_empty(&ctx->string_table[i]);
-	}
+	ctx->string_table.entries = NULL;
+	ctx->string_table.capacity = 0;
+	ctx->string_table.count = 0;
 
 	ctx->n_allocated = 0;
 	ctx->next = 0;
@@ -44,6 +56,11 @@ void bt_open(bt_Context** context, bt_Handlers* handlers)
 	ctx->troot_top = 0;
 
 	ctx->current_thread = 0;
+	ctx->idle_runners = 0;
+
+	ctx->profiler = NULL;
+	ctx->module_cache = NULL;
+	ctx->profiling = BT_FALSE;
 
 	ctx->types.null = bt_make_primitive_type(ctx, "null", bt_type_satisfier_same);
 	ctx->types.any = bt_make_primitive_type(ctx, "any", bt_type_satisfier_any);
@@ -74,6 +91,14 @@ void bt_open(bt_Context** context, bt_Handlers* handlers)
 	bt_register_type(ctx, BT_VALUE_OBJECT(bt_make_string_hashed(ctx, "array")), ctx->types.array);
 	bt_register_type(ctx, BT_VALUE_OBJECT(bt_make_string_hashed(ctx, "Type")), ctx->types.type);
 
+	ctx->types.coroutine = bt_make_userdata_type(ctx, "Coroutine");
+	bt_userdata_type_set_finalizer(ctx->types.coroutine, coroutine_finalizer);
+	bt_userdata_type_set_tracer(ctx->types.coroutine, coroutine_tracer);
+	bt_register_type(ctx, BT_VALUE_OBJECT(bt_make_string_hashed(ctx, "Coroutine")), ctx->types.coroutine);
+
+	ctx->types.channel = bt_make_channel_type(ctx);
+	bt_register_type(ctx, BT_VALUE_OBJECT(bt_make_string_hashed(ctx, "Channel")), ctx->types.channel);
+
 	ctx->meta_names.add = bt_make_string_hashed_len(ctx, "@add", 4);
 	ctx->meta_names.sub = bt_make_string_hashed_len(ctx, "@sub", 4);
 	ctx->meta_names.mul = bt_make_string_hashed_len(ctx, "@mul", 4);
@@ -89,6 +114,22 @@ void bt_open(bt_Context** context, bt_Handlers* handlers)
 	ctx->compiler_options.allow_method_hoisting = BT_TRUE;
 	ctx->compiler_options.predict_hash_slots = BT_TRUE;
 	ctx->compiler_options.typed_array_subscript = BT_TRUE;
+	ctx->compiler_options.fuse_instructions = BT_TRUE;
+	ctx->compiler_options.direct_native_calls = BT_TRUE;
+	ctx->compiler_options.optimize_bytecode = BT_TRUE;
+
+#ifdef BOLT_OP_HISTOGRAM
+	memset(ctx->op_counts, 0, sizeof(ctx->op_counts));
+	memset(ctx->op_pairs, 0, sizeof(ctx->op_pairs));
+#endif
+
+#ifdef BOLT_IC_STATS
+	memset(ctx->ic_sites, 0, sizeof(ctx->ic_sites));
+	ctx->ic_site_count = 0;
+#endif
+
+	ctx->images = NULL;
+	ctx->image_count = 0;
 
 	ctx->module_paths = NULL;
 	bt_append_module_path(ctx, "%s.bolt");
@@ -124,9 +165,26 @@ static void bt_write(bt_Context* ctx, const char* msg)
 #ifdef BOLT_ALLOW_MALLOC
 #ifndef __APPLE__
 #include <malloc.h>
-#else
+#endif
 #include <stdlib.h>
+
+static void* bt_alloc_page(size_t size)
+{
+#ifdef _MSC_VER
+	return _aligned_malloc(size, size);
+#else
+	return aligned_alloc(size, size);
+#endif
+}
+
+static void bt_free_page(void* page, size_t size)
+{
+#ifdef _MSC_VER
+	_aligned_free(page);
+#else
+	free(page);
 #endif
+}
 #endif
 
 #ifdef BOLT_ALLOW_FOPEN
@@ -167,6 +225,8 @@ bt_Handlers bt_default_handlers()
 	result.alloc = malloc;
 	result.realloc = realloc;
 	result.free = free;
+	result.alloc_page = bt_alloc_page;
+	result.free_page = bt_free_page;
 #endif
 
 
@@ -194,6 +254,8 @@ void bt_close(bt_Context* context)
 	context->types.array = 0;
 	context->types.table = 0;
 	context->types.type = 0;
+	context->types.coroutine = 0;
+	context->types.channel = 0;
 	
 	context->meta_names.add = 0;
 	context->meta_names.div = 0;
@@ -212,14 +274,28 @@ void bt_close(bt_Context* context)
 	context->current_thread = 0;
 	context->native_references = 0;
 
-	for (uint32_t i = 0; i < BT_STRINGTABLE_SIZE; i++) {
-		bt_buffer_destroy(context, &context->string_table[i]);
-		bt_buffer_empty(&context->string_table[i]);
+	bt_profiler_destroy(context);
+	bt_module_cache_destroy(context);
+
+	while (context->idle_runners) {
+		bt_Thread* runner = context->idle_runners;
+		context->idle_runners = runner->outer;
+		bt_destroy_thread(context, runner);
 	}
 
+	bt_gc_free(context, context->string_table.entries, context->string_table.capacity * sizeof(bt_StringTableEntry));
+	context->string_table.entries = NULL;
+	context->string_table.capacity = 0;
+	context->string_table.count = 0;
+
 	while (bt_collect(&context->gc, 0));
 
 	bt_free(context, context->root);
+	bt_pool_destroy(context);
+
+	bt_gc_free(context, (void*)context->images, context->image_count * sizeof(bt_Image*));
+	context->images = NULL;
+	context->image_count = 0;
 
 	bt_Path* path = context->module_paths;
 	while (path) {
@@ -269,6 +345,13 @@ bt_Module* bt_compile_module(bt_Context* context, const char* source, const char
 	bt_close_parser(&parser);
 	bt_close_tokenizer(&tok);
 
+	if (result && mod_name) {
+		// named so tools like the profiler can refer to it, bt_find_module renames it after the import path
+		bt_push_root(context, (bt_Object*)result);
+		result->name = bt_make_string(context, mod_name);
+		bt_pop_root(context);
+	}
+
 	return result;
 }
 
@@ -343,6 +426,10 @@ void bt_register_prelude(bt_Context* context, bt_Value name, bt_Type* type, bt_V
 void bt_register_module(bt_Context* context, bt_Value name, bt_Module* module)
 {
 	bt_table_set(context, context->loaded_modules, name, BT_VALUE_OBJECT(module));
+	// native modules have no other name, keep the registered one for tools like the profiler
+	if (!module->name && BT_IS_OBJECT(name) && BT_OBJECT_GET_TYPE(BT_AS_OBJECT(name)) == BT_OBJECT_TYPE_STRING) {
+		module->name = (bt_String*)BT_AS_OBJECT(name);
+	}
 }
 
 void bt_append_module_path(bt_Context* context, const char* spec)
@@ -395,7 +482,25 @@ bt_Module* bt_find_module(bt_Context* context, bt_Value name, bt_bool suppress_e
 	bt_push_root(context, BT_AS_OBJECT(name));
 	// TODO: resolve module name with path
 	bt_Value normalized_path = bt_normalize_path(context, name);
+	bt_push_root(context, BT_AS_OBJECT(normalized_path));
 	bt_Module* mod = (bt_Module*)BT_AS_OBJECT(bt_table_get(context->loaded_modules, normalized_path));
+	if (mod == 0 && context->image_count) {
+		// modules from attached images are already compiled and don't touch the file system
+		bt_Module* new_mod = bt_image_load_module(context, (bt_String*)BT_AS_OBJECT(normalized_path));
+		if (new_mod) {
+			bt_push_root(context, (bt_Object*)new_mod);
+			new_mod->name = (bt_String*)BT_AS_OBJECT(normalized_path);
+			new_mod->path = new_mod->name;
+			bt_bool success = bt_execute(context, (bt_Callable*)new_mod);
+			if (success) bt_register_module(context, normalized_path, new_mod);
+
+			bt_pop_root(context);
+			bt_pop_root(context);
+			bt_pop_root(context);
+			return success ? new_mod : NULL;
+		}
+	}
+
 	if (mod == 0) {
 		bt_String* to_load = (bt_String*)BT_AS_OBJECT(name);
 
@@ -411,6 +516,7 @@ bt_Module* bt_find_module(bt_Context* context, bt_Value name, bt_bool suppress_e
 			if (path_len >= BT_MODULE_PATH_SIZE) {
 				if (!suppress_errors) bt_runtime_error(context->current_thread, "Path buffer overrun when loading module!", NULL);
 				bt_pop_root(context);
+				bt_pop_root(context);
 				return NULL;
 			}
 
@@ -424,33 +530,50 @@ bt_Module* bt_find_module(bt_Context* context, bt_Value name, bt_bool suppress_e
 		if (code == 0) {
 			if(context->current_thread && !suppress_errors) bt_runtime_error(context->current_thread, "Cannot find module file", NULL);
 			bt_pop_root(context);
+			bt_pop_root(context);
 			return NULL;
 		}
 
 
-		bt_Module* new_mod = bt_compile_module(context, code, path_buf);
+		// unchanged sources are loaded from the module cache when one is set, see bt_module_cache.h
+		bt_Module* new_mod = bt_module_cache_load(context, (bt_String*)BT_AS_OBJECT(normalized_path), code);
+		if (!new_mod) {
+			new_mod = bt_compile_module(context, code, path_buf);
+			if (new_mod && context->module_cache) {
+				bt_push_root(context, (bt_Object*)new_mod);
+				bt_module_cache_store(context, new_mod, (bt_String*)BT_AS_OBJECT(normalized_path), code);
+				bt_pop_root(context);
+			}
+		}
 		context->free_source(context, code);
 
 		if (new_mod) {
+			bt_push_root(context, (bt_Object*)new_mod);
 			new_mod->name = (bt_String*)BT_AS_OBJECT(normalized_path);
 			new_mod->path = bt_make_string_len(context, path_buf, path_len);
 			if (bt_execute(context, (bt_Callable*)new_mod)) {
 				bt_register_module(context, normalized_path, new_mod);
 
+				bt_pop_root(context);
+				bt_pop_root(context);
 				bt_pop_root(context);
 				return new_mod;
 			}
 			else {
+				bt_pop_root(context);
+				bt_pop_root(context);
 				bt_pop_root(context);
 				return NULL;
 			}
 		}
 		else {
+			bt_pop_root(context);
 			bt_pop_root(context);
 			return NULL;
 		}
 	}
 
+	bt_pop_root(context);
 	bt_pop_root(context);
 	return mod;
 }
@@ -464,6 +587,11 @@ bt_Thread* bt_make_thread(bt_Context* context)
 	result->context = context;
 	result->should_report = BT_TRUE;
 	result->last_error = 0;
+	result->outer = 0;
+	result->coroutine = 0;
+	result->yield_value = BT_VALUE_NULL;
+	result->reentry = 0;
+	result->yielding = BT_FALSE;
 
 	result->native_stack[result->native_depth].return_loc = 0;
 	result->native_stack[result->native_depth].argc = 0;
@@ -478,7 +606,11 @@ void bt_destroy_thread(bt_Context* context, bt_Thread* thread)
 	bt_gc_free(context, thread, sizeof(bt_Thread));
 }
 
-static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_Op* ip, bt_Value* constants, int8_t return_loc);
+static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_Op* ip, bt_Value* constants, int8_t return_loc, uint32_t base_depth);
+
+// Profiler hooks, entered after a frame is pushed and exited before it's popped. Costs a single branch while not profiling
+#define PROFILE_ENTER(ctx, callable) if ((ctx)->profiling) bt_profiler_enter((ctx), thread, (bt_Callable*)(callable))
+#define PROFILE_EXIT(ctx) if ((ctx)->profiling) bt_profiler_exit((ctx), thread)
 
 bt_bool bt_execute(bt_Context* context, bt_Callable* callable)
 {
@@ -497,7 +629,9 @@ bt_bool bt_execute_on_thread(bt_Context* context, bt_Thread* thread, bt_Callable
 bt_bool bt_execute_with_args(bt_Context* context, bt_Thread* thread, bt_Callable* callable, bt_Value* args, uint8_t argc)
 {
 	bt_Thread* old_thread = context->current_thread;
+	bt_Thread* old_outer = thread->outer;
 
+	if (thread != old_thread) thread->outer = old_thread;
 	context->current_thread = thread;
 
 	bt_push(thread, BT_VALUE_OBJECT(callable));
@@ -509,10 +643,12 @@ bt_bool bt_execute_with_args(bt_Context* context, bt_Thread* thread, bt_Callable
 	int32_t result = setjmp(&thread->error_loc[0]);
 	if (result == 0) bt_call(thread, argc);
 	else {
+		thread->outer = old_outer;
 		context->current_thread = old_thread;
 		return BT_FALSE;
 	}
 
+	thread->outer = old_outer;
 	context->current_thread = old_thread;
 	return BT_TRUE;
 }
@@ -592,19 +728,25 @@ void bt_call(bt_Thread* thread, uint8_t argc)
 	thread->top += BT_STACKFRAME_GET_SIZE(*frame) + 2;
 	bt_Object* obj = BT_AS_OBJECT(thread->stack[thread->top - 1]);
 
+	// coroutines can only yield from the outermost call, natives calling back into bolt nest this
+	thread->reentry++;
+
 	switch (BT_OBJECT_GET_TYPE(obj)) {
 	case BT_OBJECT_TYPE_FN: {
 		bt_Fn* callable = (bt_Fn*)obj;
 		thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, callable->stack_size, 0);
-		call(thread->context, thread, callable->module, callable->instructions.elements, callable->constants.elements, -1);
+		PROFILE_ENTER(thread->context, obj);
+		call(thread->context, thread, callable->module, callable->instructions.elements, callable->constants.elements, -1, thread->depth);
 	} break;
 	case BT_OBJECT_TYPE_CLOSURE: {
 		bt_Fn* callable = ((bt_Closure*)obj)->fn;
 		thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, callable->stack_size, 0);
-		call(thread->context, thread, callable->module, callable->instructions.elements, callable->constants.elements, -1);
+		PROFILE_ENTER(thread->context, obj);
+		call(thread->context, thread, callable->module, callable->instructions.elements, callable->constants.elements, -1, thread->depth);
 	} break;
 	case BT_OBJECT_TYPE_NATIVE_FN: {
 		thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, 0, 0);
+		PROFILE_ENTER(thread->context, obj);
 
 		thread->native_stack[thread->native_depth].return_loc = -2;
 		thread->native_stack[thread->native_depth].argc = argc;
@@ -617,16 +759,233 @@ void bt_call(bt_Thread* thread, uint8_t argc)
 	case BT_OBJECT_TYPE_MODULE: {
 		bt_Module* mod = (bt_Module*)obj;
 		thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, mod->stack_size, 0);
+		PROFILE_ENTER(thread->context, obj);
 
-		call(thread->context, thread, mod, mod->instructions.elements, mod->constants.elements, -1);
+		call(thread->context, thread, mod, mod->instructions.elements, mod->constants.elements, -1, thread->depth);
 	} break;
 	default: bt_runtime_error(thread, "Unsupported callable type.", NULL);
 	}
 
+	thread->reentry--;
+	// the frames a yield leaves behind are picked up by bt_resume
+	if (thread->yielding) return;
+
+	PROFILE_EXIT(thread->context);
 	thread->depth--;
 	thread->top = old_top;
 }
 
+#define SNAPSHOT_SIZE(stack_size, depth) \
+	((stack_size) * sizeof(bt_Value) + (depth) * (sizeof(bt_StackFrame) + sizeof(bt_ScriptFrame)))
+#define SNAPSHOT_VALUES(co) ((bt_Value*)(co)->snapshot)
+#define SNAPSHOT_FRAMES(co) ((bt_StackFrame*)((co)->snapshot + (co)->stack_size * sizeof(bt_Value)))
+#define SNAPSHOT_SCRIPT_FRAMES(co) ((bt_ScriptFrame*)((co)->snapshot + (co)->stack_size * sizeof(bt_Value) + (co)->depth * sizeof(bt_StackFrame)))
+
+static void coroutine_finalizer(bt_Context* ctx, bt_Userdata* userdata)
+{
+	bt_Coroutine* co = bt_userdata_get(userdata);
+	if (co->snapshot) bt_gc_free(ctx, co->snapshot, co->capacity);
+	co->snapshot = NULL;
+	co->capacity = 0;
+}
+
+static void coroutine_tracer(bt_Context* ctx, bt_Userdata* userdata)
+{
+	bt_Coroutine* co = bt_userdata_get(userdata);
+	bt_grey_obj(ctx, (bt_Object*)co->entry);
+	if (co->status != BT_COROUTINE_SUSPENDED) return;
+
+	bt_Value* values = SNAPSHOT_VALUES(co);
+	for (uint32_t i = 0; i < co->stack_size; ++i) {
+		if (BT_IS_OBJECT(values[i])) bt_grey_obj(ctx, BT_AS_OBJECT(values[i]));
+	}
+
+	bt_StackFrame* frames = SNAPSHOT_FRAMES(co);
+	for (uint32_t i = 0; i < co->depth; ++i) {
+		bt_grey_obj(ctx, (bt_Object*)BT_STACKFRAME_GET_CALLABLE(frames[i]));
+	}
+}
+
+bt_Userdata* bt_make_coroutine(bt_Context* ctx, bt_Callable* callable)
+{
+	bt_Coroutine co;
+	memset(&co, 0, sizeof(bt_Coroutine));
+	co.entry = callable;
+	co.status = BT_COROUTINE_READY;
+
+	return bt_make_userdata(ctx, ctx->types.coroutine, &co, sizeof(bt_Coroutine));
+}
+
+bt_Coroutine* bt_coroutine_get(bt_Userdata* coroutine)
+{
+	return bt_userdata_get(coroutine);
+}
+
+bt_CoroutineStatus bt_coroutine_status(bt_Userdata* coroutine)
+{
+	return bt_coroutine_get(coroutine)->status;
+}
+
+static bt_Op resume_trampoline[] = { BT_MAKE_OP_ABC(BT_OP_END, 0, 0, 0) };
+
+static void save_resume_point(bt_Thread* thread, bt_Op* ip, bt_Value* constants, bt_Module* module, int8_t return_loc, uint8_t resume_loc)
+{
+	bt_Coroutine* co = thread->coroutine;
+	co->ip = ip;
+	co->constants = constants;
+	co->module = module;
+	co->return_loc = return_loc;
+	co->resume_loc = resume_loc;
+}
+
+static void save_snapshot(bt_Context* ctx, bt_Thread* thread, bt_Coroutine* co)
+{
+	uint32_t stack_size = thread->top + BT_STACKFRAME_GET_SIZE(thread->callstack[thread->depth - 1]);
+	uint32_t size = (uint32_t)SNAPSHOT_SIZE(stack_size, thread->depth);
+
+	// never shrinks, a coroutine tends to yield from the same few places every time
+	if (size > co->capacity) {
+		if (co->snapshot) bt_gc_free(ctx, co->snapshot, co->capacity);
+		co->snapshot = bt_gc_alloc(ctx, size);
+		co->capacity = size;
+	}
+
+	co->stack_size = stack_size;
+	co->depth = thread->depth;
+	co->top = thread->top;
+
+	memcpy(SNAPSHOT_VALUES(co), thread->stack, stack_size * sizeof(bt_Value));
+	memcpy(SNAPSHOT_FRAMES(co), thread->callstack, co->depth * sizeof(bt_StackFrame));
+	memcpy(SNAPSHOT_SCRIPT_FRAMES(co), thread->script_stack, co->depth * sizeof(bt_ScriptFrame));
+
+	// the coroutine may already have been traced this cycle
+	if (ctx->gc.phase == BT_GC_PHASE_MARK) {
+		for (uint32_t i = 0; i < stack_size; ++i) BT_GC_BARRIER(ctx, thread->stack[i]);
+		for (uint32_t i = 0; i < co->depth; ++i) bt_grey_obj(ctx, (bt_Object*)BT_STACKFRAME_GET_CALLABLE(thread->callstack[i]));
+	}
+}
+
+static void restore_snapshot(bt_Thread* thread, bt_Coroutine* co)
+{
+	memcpy(thread->stack, SNAPSHOT_VALUES(co), co->stack_size * sizeof(bt_Value));
+	memcpy(thread->callstack, SNAPSHOT_FRAMES(co), co->depth * sizeof(bt_StackFrame));
+	memcpy(thread->script_stack, SNAPSHOT_SCRIPT_FRAMES(co), co->depth * sizeof(bt_ScriptFrame));
+	thread->depth = co->depth;
+	thread->top = co->top;
+}
+
+static bt_Thread* acquire_runner(bt_Context* ctx)
+{
+	bt_Thread* runner = ctx->idle_runners;
+	if (runner) ctx->idle_runners = runner->outer;
+	else runner = bt_make_thread(ctx);
+	return runner;
+}
+
+static void release_runner(bt_Context* ctx, bt_Thread* runner)
+{
+	runner->depth = 1;
+	runner->top = 0;
+	runner->native_depth = 0;
+	runner->reentry = 0;
+	runner->callstack[0] = BT_MAKE_STACKFRAME(0, 0, 0);
+	runner->coroutine = NULL;
+	runner->yielding = BT_FALSE;
+	runner->yield_value = BT_VALUE_NULL;
+	runner->last_error = NULL;
+
+	runner->outer = ctx->idle_runners;
+	ctx->idle_runners = runner;
+}
+
+bt_bool bt_resume(bt_Context* ctx, bt_Userdata* coroutine, bt_Value value, bt_Value* result)
+{
+	bt_Coroutine* co = bt_coroutine_get(coroutine);
+	if (co->status != BT_COROUTINE_READY && co->status != BT_COROUTINE_SUSPENDED) return BT_FALSE;
+
+	bt_Thread* outer = ctx->current_thread;
+	bt_Thread* thread = acquire_runner(ctx);
+	thread->outer = outer;
+	thread->coroutine = co;
+	thread->should_report = outer ? outer->should_report : BT_TRUE;
+	ctx->current_thread = thread;
+
+	bt_bool first_run = co->status == BT_COROUTINE_READY;
+	co->status = BT_COROUTINE_RUNNING;
+
+	bt_bool success = BT_TRUE;
+	if (setjmp(&thread->error_loc[0]) == 0) {
+		if (first_run) {
+			bt_push(thread, BT_VALUE_OBJECT(co->entry));
+			bt_call(thread, 0);
+		}
+		else {
+			restore_snapshot(thread, co);
+			thread->stack[thread->top + co->resume_loc] = value;
+			thread->reentry = 1;
+
+			// the innermost frame is pushed like the caller of a bolt function, and resumed by running an END on top of it
+			bt_ScriptFrame* frame = thread->script_stack + thread->depth;
+			frame->ip = co->ip;
+			frame->constants = co->constants;
+			frame->upv = BT_CLOSURE_UPVALS(BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]));
+			frame->module = co->module;
+			frame->top = thread->top;
+			frame->return_loc = co->return_loc;
+			frame->is_iter = BT_FALSE;
+			thread->callstack[thread->depth] = thread->callstack[thread->depth - 1];
+			thread->depth++;
+
+			call(ctx, thread, co->module, resume_trampoline, co->constants, -1, 2);
+
+			if (!thread->yielding) {
+				PROFILE_EXIT(ctx);
+				thread->depth--;
+				thread->top = 0;
+			}
+		}
+
+		if (thread->yielding) {
+			save_snapshot(ctx, thread, co);
+			co->status = BT_COROUTINE_SUSPENDED;
+			if (result) *result = thread->yield_value;
+
+			while (thread->depth > 1) {
+				PROFILE_EXIT(ctx);
+				thread->depth--;
+			}
+		}
+		else {
+			co->status = BT_COROUTINE_DONE;
+			if (result) *result = bt_pop(thread);
+			coroutine_finalizer(ctx, coroutine);
+		}
+	}
+	else {
+		co->status = BT_COROUTINE_FAILED;
+		coroutine_finalizer(ctx, coroutine);
+		success = BT_FALSE;
+	}
+
+	ctx->current_thread = outer;
+	release_runner(ctx, thread);
+	return success;
+}
+
+void bt_yield(bt_Thread* thread, bt_Value value)
+{
+	if (!thread->coroutine) {
+		bt_runtime_error(thread, "Can't yield outside of a coroutine!", NULL);
+	}
+
+	if (thread->reentry != 1 || thread->native_depth != 1) {
+		bt_runtime_error(thread, "Can't yield from a function called by native code!", NULL);
+	}
+
+	thread->yielding = BT_TRUE;
+	thread->yield_value = value;
+}
+
 const char* bt_get_debug_source(bt_Callable* callable)
 {
 	switch (BT_OBJECT_GET_TYPE(callable)) {
@@ -708,16 +1067,46 @@ uint32_t bt_get_debug_index(bt_Callable* callable, bt_Op* ip)
 	return 0;
 }
 
+/** Place `entry` in the first free slot along its probe sequence */
+static void string_table_place(bt_StringTable* table, bt_StringTableEntry entry)
+{
+	uint32_t mask = table->capacity - 1;
+	uint32_t slot = (uint32_t)entry.hash & mask;
+	while (table->entries[slot].string) slot = (slot + 1) & mask;
+	table->entries[slot] = entry;
+}
+
+static void string_table_grow(bt_Context* ctx, bt_StringTable* table)
+{
+	bt_StringTableEntry* old_entries = table->entries;
+	uint32_t old_capacity = table->capacity;
+
+	table->capacity = old_capacity ? old_capacity * 2 : BT_STRINGTABLE_SIZE;
+	table->entries = bt_gc_alloc(ctx, table->capacity * sizeof(bt_StringTableEntry));
+	memset(table->entries, 0, table->capacity * sizeof(bt_StringTableEntry));
+
+	for (uint32_t i = 0; i < old_capacity; ++i) {
+		if (old_entries[i].string) string_table_place(table, old_entries[i]);
+	}
+
+	if (old_entries) bt_gc_free(ctx, old_entries, old_capacity * sizeof(bt_StringTableEntry));
+}
+
 bt_String* bt_get_or_make_interned(bt_Context* ctx, const char* str, uint32_t len)
 {
+	bt_StringTable* table = &ctx->string_table;
+	if ((table->count + 1) * 2 > table->capacity) string_table_grow(ctx, table);
+
 	uint64_t hash = bt_hash_str(str, len);
-	uint64_t bucket_idx = hash % BT_STRINGTABLE_SIZE;
+	uint32_t mask = table->capacity - 1;
+	uint32_t slot = (uint32_t)hash & mask;
 
-	bt_StringTableBucket* bucket = ctx->string_table + bucket_idx;
+	for (bt_StringTableEntry* entry = table->entries + slot; entry->string; entry = table->entries + slot) {
+		if (entry->hash == hash && entry->string->len == len && memcmp(BT_STRING_STR(entry->string), str, len) == 0) {
+			return entry->string;
+		}
 
-	for (uint32_t i = 0; i < bucket->length; ++i) {
-		bt_StringTableEntry* entry = bucket->elements + i;
-		if (entry->hash == hash) return entry->string;
+		slot = (slot + 1) & mask;
 	}
 
 	bt_StringTableEntry new_entry;
@@ -728,26 +1117,98 @@ bt_String* bt_get_or_make_interned(bt_Context* ctx, const char* str, uint32_t le
 	new_entry.string->len = len;
 	new_entry.string->hash = hash;
 	new_entry.string->interned = 1;
-	bt_buffer_push(ctx, bucket, new_entry);
+
+	// The allocation may have kicked off a gc step that swept the table, so don't reuse the probed slot
+	string_table_place(table, new_entry);
+	table->count++;
 
 	return new_entry.string;
 }
 
 void bt_remove_interned(bt_Context* ctx, bt_String* str)
 {
-	uint64_t bucket_idx = str->hash % BT_STRINGTABLE_SIZE;
+	bt_StringTable* table = &ctx->string_table;
+	if (table->count == 0) return;
+
+	uint32_t mask = table->capacity - 1;
+	uint32_t hole = (uint32_t)str->hash & mask;
+	while (table->entries[hole].string != str) {
+		if (table->entries[hole].string == NULL) return;
+		hole = (hole + 1) & mask;
+	}
 
-	bt_StringTableBucket* bucket = ctx->string_table + bucket_idx;
-	for (uint32_t i = 0; i < bucket->length; ++i) {
-		bt_StringTableEntry* entry = bucket->elements + i;
-		if (entry->hash == str->hash) {
-			bucket->elements[i] = bucket->elements[bucket->length - 1];
-			bucket->length--;
-			return;
+	// Shift the rest of the cluster back over the hole so no probe sequence is broken
+	uint32_t next = hole;
+	for (;;) {
+		next = (next + 1) & mask;
+		if (table->entries[next].string == NULL) break;
+
+		uint32_t home = (uint32_t)table->entries[next].hash & mask;
+		bt_bool in_between = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+		if (!in_between) {
+			table->entries[hole] = table->entries[next];
+			hole = next;
+		}
+	}
+
+	table->entries[hole].string = NULL;
+	table->count--;
+}
+
+void bt_sweep_interned(bt_Context* ctx)
+{
+	bt_StringTable* table = &ctx->string_table;
+	if (table->count == 0) return;
+
+	for (uint32_t i = 0; i < table->capacity; ++i) {
+		bt_StringTableEntry* entry = table->entries + i;
+		if (entry->string && !BT_OBJECT_GET_MARK((bt_Object*)entry->string)) {
+			entry->string = NULL;
+			table->count--;
+		}
+	}
+
+	// Re-place survivors cluster by cluster, starting after a known empty slot so every cluster is walked front to back
+	uint32_t mask = table->capacity - 1;
+	uint32_t start = 0;
+	while (table->entries[start].string) start++;
+
+	for (uint32_t i = 1; i <= table->capacity; ++i) {
+		uint32_t slot = (start + i) & mask;
+		bt_StringTableEntry entry = table->entries[slot];
+		if (entry.string) {
+			table->entries[slot].string = NULL;
+			string_table_place(table, entry);
 		}
 	}
 }
 
+bt_StringTableStats bt_get_string_table_stats(bt_Context* ctx)
+{
+	bt_StringTable* table = &ctx->string_table;
+
+	bt_StringTableStats stats;
+	stats.entries = table->count;
+	stats.capacity = table->capacity;
+	stats.max_probe = 0;
+	stats.avg_probe = 0;
+
+	uint64_t total_probe = 0;
+	uint32_t mask = table->capacity - 1;
+	for (uint32_t i = 0; i < table->capacity; ++i) {
+		bt_StringTableEntry* entry = table->entries + i;
+		if (!entry->string) continue;
+
+		uint32_t probe = ((i - (uint32_t)entry->hash) & mask) + 1;
+		total_probe += probe;
+		if (probe > stats.max_probe) stats.max_probe = probe;
+	}
+
+	if (table->count) stats.avg_probe = (double)total_probe / table->count;
+
+	return stats;
+}
+
 #define XSTR(x) #x
 #define ARITH_MF(name)                                                                               \
 if (BT_IS_OBJECT(lhs)) {																			 \
@@ -789,6 +1250,33 @@ static BT_NO_INLINE void bt_add(bt_Thread* thread, bt_Value* __restrict result,
 	bt_runtime_error(thread, "Unable to add values", ip);
 }
 
+// Typed array subscripts, the bounds and element type are checked here so the common case doesn't leave the interpreter loop
+static BT_FORCE_INLINE void bt_load_elem(bt_Thread* thread, bt_Value* __restrict result, bt_Userdata* arr, bt_number index, bt_Op* ip)
+{
+	uint64_t idx = (uint64_t)index;
+	if (idx >= BT_TYPED_ARRAY(arr)->length) bt_runtime_error(thread, "Array index out of bounds!", ip);
+
+	void* data = BT_TYPED_ARRAY_DATA(arr);
+	switch (arr->type->as.userdata.elements) {
+	case BT_ELEMENTS_F32: *result = BT_VALUE_NUMBER(((float*)data)[idx]); break;
+	case BT_ELEMENTS_F64: *result = BT_VALUE_NUMBER(((double*)data)[idx]); break;
+	default: *result = BT_VALUE_NUMBER(((int32_t*)data)[idx]); break;
+	}
+}
+
+static BT_FORCE_INLINE void bt_store_elem(bt_Thread* thread, bt_Userdata* arr, bt_number index, bt_number value, bt_Op* ip)
+{
+	uint64_t idx = (uint64_t)index;
+	if (idx >= BT_TYPED_ARRAY(arr)->length) bt_runtime_error(thread, "Array index out of bounds!", ip);
+
+	void* data = BT_TYPED_ARRAY_DATA(arr);
+	switch (arr->type->as.userdata.elements) {
+	case BT_ELEMENTS_F32: ((float*)data)[idx] = (float)value; break;
+	case BT_ELEMENTS_F64: ((double*)data)[idx] = value; break;
+	default: ((int32_t*)data)[idx] = bt_number_to_int32(value); break;
+	}
+}
+
 static BT_FORCE_INLINE void bt_neg(bt_Thread* thread, bt_Value* __restrict result, bt_Value rhs, bt_Op* ip)
 {
 	if (BT_IS_NUMBER(rhs)) {
@@ -872,13 +1360,223 @@ static BT_NO_INLINE void bt_mfneq(bt_Thread* thread, bt_Value* __restrict result
 	bt_runtime_error(thread, "Cannot neq non-number value!", ip);
 }
 
-static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_Op* ip, bt_Value* constants, int8_t return_loc)
+// Inline caches for table fields accessed by constant key, kept in the IDX_EXT following the op.
+// Tables don't carry a shape id, so a remembered slot is validated directly instead: it has to be in bounds
+// and hold the exact key, which is always the same interned string for a given site.
+// LOAD_IDX_K/STORE_IDX_K pack up to 4 slots of 6 bits into a and ubc, most recently learned first, 0 being empty.
+// The slow paths of accelerated LOAD_IDX/STORE_IDX retry their predicted slot, and keep one learned slot in a.
+#define BT_IC_BITS 6
+#define BT_IC_MASK ((1u << BT_IC_BITS) - 1)
+#define BT_IC_WAYS_MASK 0xFFFFFFu
+#define BT_IC_WAYS(ext) (BT_GET_A(ext) | ((uint32_t)BT_GET_UBC(ext) << 8))
+
+#ifdef BOLT_IC_STATS
+#include <stdio.h>
+
+static void bt_ic_record(bt_Thread* thread, bt_Op* ext, bt_bool hit)
+{
+	bt_Context* ctx = thread->context;
+	uint32_t slot = (uint32_t)(((uintptr_t)ext / sizeof(bt_Op)) * 2654435761u) % BT_IC_STATS_SITES;
+
+	for (uint32_t probe = 0; probe < BT_IC_STATS_SITES; ++probe) {
+		bt_InlineCacheSite* site = ctx->ic_sites + slot;
+		if (site->site == ext) {
+			if (hit) site->hits++; else site->misses++;
+			return;
+		}
+
+		if (site->site == NULL) {
+			site->site = ext;
+			site->hits = hit ? 1 : 0;
+			site->misses = hit ? 0 : 1;
+			ctx->ic_site_count++;
+
+			bt_Callable* callable = BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]);
+			bt_Module* module = BT_OBJECT_GET_TYPE(callable) == BT_OBJECT_TYPE_MODULE ? (bt_Module*)callable : bt_get_owning_module(callable);
+			bt_DebugLocBuffer* loc_buffer = bt_get_debug_locs(callable);
+			uint16_t line = 0;
+			if (loc_buffer) {
+				bt_TokenBuffer* tokens = bt_get_debug_tokens(callable);
+				line = tokens->elements[loc_buffer->elements[bt_get_debug_index(callable, ext - 1)]]->line;
+			}
+
+			const char* module_name = "<unknown>";
+			if (module && module->path) module_name = BT_STRING_STR(module->path);
+			else if (module && module->name) module_name = BT_STRING_STR(module->name);
+
+			snprintf(site->location, sizeof(site->location), "%s:%u", module_name, line);
+			return;
+		}
+
+		slot = (slot + 1) % BT_IC_STATS_SITES;
+	}
+}
+
+#define IC_RECORD(thread, ext, hit) bt_ic_record(thread, ext, hit);
+#else
+#define IC_RECORD(thread, ext, hit)
+#endif
+
+static BT_FORCE_INLINE bt_TablePair* bt_ic_probe(bt_Table* tbl, bt_Value key, uint32_t slot)
+{
+	bt_TablePair* pair = BT_TABLE_PAIRS(tbl) + slot;
+	return (slot < tbl->length && pair->key == key) ? pair : NULL;
+}
+
+static BT_FORCE_INLINE bt_TablePair* bt_ic_probe_ways(bt_Object* obj, bt_Value key, uint32_t ways)
+{
+	if (BT_OBJECT_GET_TYPE(obj) != BT_OBJECT_TYPE_TABLE) return NULL;
+
+	for (; ways; ways >>= BT_IC_BITS) {
+		bt_TablePair* pair = bt_ic_probe((bt_Table*)obj, key, (ways & BT_IC_MASK) - 1);
+		if (pair) return pair;
+	}
+
+	return NULL;
+}
+
+static void bt_ic_learn(bt_Op* ext, int32_t slot)
+{
+	if ((uint32_t)slot >= BT_IC_MASK) return;
+
+	uint32_t ways = ((BT_IC_WAYS(*ext) << BT_IC_BITS) | (uint32_t)(slot + 1)) & BT_IC_WAYS_MASK;
+	*ext = BT_MAKE_OP_AUBC(BT_OP_IDX_EXT, ways & 0xFF, ways >> 8);
+}
+
+// Shared by both cache kinds, on a miss the key is looked up once and the found slot handed to `learn`
+static BT_NO_INLINE bt_Value bt_ic_load_miss(bt_Thread* thread, bt_Object* obj, bt_Value key, bt_Op* ext, bt_bool single)
+{
+	IC_RECORD(thread, ext, BT_FALSE);
+
+	if (BT_OBJECT_GET_TYPE(obj) != BT_OBJECT_TYPE_TABLE) return bt_get(thread->context, obj, key);
+
+	bt_Table* tbl = (bt_Table*)obj;
+	int32_t found = bt_table_get_idx(tbl, key);
+	if (found == -1) return tbl->prototype ? bt_table_get(tbl->prototype, key) : BT_VALUE_NULL;
+
+	if (single) { if (found <= UINT8_MAX - 1) *ext = BT_MAKE_OP_AIBC(BT_OP_IDX_EXT, found + 1, BT_GET_IBC(*ext)); }
+	else bt_ic_learn(ext, found);
+
+	return BT_TABLE_PAIRS(tbl)[found].value;
+}
+
+static BT_NO_INLINE void bt_ic_store_miss(bt_Thread* thread, bt_Object* obj, bt_Value key, bt_Value value, bt_Op* ext, bt_bool single)
+{
+	IC_RECORD(thread, ext, BT_FALSE);
+
+	if (BT_OBJECT_GET_TYPE(obj) != BT_OBJECT_TYPE_TABLE) {
+		bt_set(thread->context, obj, key, value);
+		return;
+	}
+
+	bt_Table* tbl = (bt_Table*)obj;
+	int32_t found = bt_table_get_idx(tbl, key);
+	if (found == -1) {
+		// new keys are appended
+		bt_table_set(thread->context, tbl, key, value);
+		found = (int32_t)tbl->length - 1;
+	}
+	else {
+		BT_TABLE_PAIRS(tbl)[found].value = value;
+		BT_GC_BARRIER(thread->context, value);
+	}
+
+	if (single) { if (found <= UINT8_MAX - 1) *ext = BT_MAKE_OP_AIBC(BT_OP_IDX_EXT, found + 1, BT_GET_IBC(*ext)); }
+	else bt_ic_learn(ext, found);
+}
+
+static BT_FORCE_INLINE bt_Value bt_ic_load(bt_Thread* thread, bt_Object* obj, bt_Value key, bt_Op* ext)
+{
+	bt_TablePair* pair = bt_ic_probe_ways(obj, key, BT_IC_WAYS(*ext));
+	if (pair) {
+		IC_RECORD(thread, ext, BT_TRUE);
+		return pair->value;
+	}
+
+	return bt_ic_load_miss(thread, obj, key, ext, BT_FALSE);
+}
+
+static BT_FORCE_INLINE void bt_ic_store(bt_Thread* thread, bt_Object* obj, bt_Value key, bt_Value value, bt_Op* ext)
+{
+	bt_TablePair* pair = bt_ic_probe_ways(obj, key, BT_IC_WAYS(*ext));
+	if (pair) {
+		IC_RECORD(thread, ext, BT_TRUE);
+		pair->value = value;
+		BT_GC_BARRIER(thread->context, value);
+		return;
+	}
+
+	bt_ic_store_miss(thread, obj, key, value, ext, BT_FALSE);
+}
+
+// Values marked slow by a cast most often still have the layout the slot was predicted from
+static BT_FORCE_INLINE bt_TablePair* bt_ic_probe_slow(bt_Object* obj, bt_Value key, uint32_t predicted, bt_Op* ext)
+{
+	if (BT_OBJECT_GET_TYPE(obj) != BT_OBJECT_TYPE_TABLE) return NULL;
+
+	bt_TablePair* pair = bt_ic_probe((bt_Table*)obj, key, predicted);
+	if (!pair && BT_GET_A(*ext)) pair = bt_ic_probe((bt_Table*)obj, key, BT_GET_A(*ext) - 1);
+	return pair;
+}
+
+static BT_FORCE_INLINE bt_Value bt_ic_load_slow(bt_Thread* thread, bt_Object* obj, bt_Value key, uint32_t predicted, bt_Op* ext)
+{
+	bt_TablePair* pair = bt_ic_probe_slow(obj, key, predicted, ext);
+	if (pair) {
+		IC_RECORD(thread, ext, BT_TRUE);
+		return pair->value;
+	}
+
+	return bt_ic_load_miss(thread, obj, key, ext, BT_TRUE);
+}
+
+static BT_FORCE_INLINE void bt_ic_store_slow(bt_Thread* thread, bt_Object* obj, bt_Value key, bt_Value value, uint32_t predicted, bt_Op* ext)
+{
+	bt_TablePair* pair = bt_ic_probe_slow(obj, key, predicted, ext);
+	if (pair) {
+		IC_RECORD(thread, ext, BT_TRUE);
+		pair->value = value;
+		BT_GC_BARRIER(thread->context, value);
+		return;
+	}
+
+	bt_ic_store_miss(thread, obj, key, value, ext, BT_TRUE);
+}
+
+// Calls a native made with `bt_make_native_direct` on the unboxed values in `args`, the compiler checked their types
+static BT_FORCE_INLINE bt_Value bt_call_direct(bt_NativeFn* native, bt_Value* args)
+{
+	switch (native->direct_kind) {
+	case BT_DIRECT_NUM_0: return BT_VALUE_NUMBER(native->direct.num_0());
+	case BT_DIRECT_NUM_1: return BT_VALUE_NUMBER(native->direct.num_1(BT_AS_NUMBER(args[0])));
+	case BT_DIRECT_NUM_2: return BT_VALUE_NUMBER(native->direct.num_2(BT_AS_NUMBER(args[0]), BT_AS_NUMBER(args[1])));
+	case BT_DIRECT_NUM_3: return BT_VALUE_NUMBER(native->direct.num_3(BT_AS_NUMBER(args[0]), BT_AS_NUMBER(args[1]), BT_AS_NUMBER(args[2])));
+	case BT_DIRECT_USERDATA: return BT_VALUE_NUMBER(native->direct.userdata(BT_USERDATA_VALUE((bt_Userdata*)BT_AS_OBJECT(args[0]))));
+	case BT_DIRECT_USERDATA_NUM: native->direct.userdata_num(BT_USERDATA_VALUE((bt_Userdata*)BT_AS_OBJECT(args[0])), BT_AS_NUMBER(args[1])); break;
+	default: BT_ASSUME(0);
+	}
+
+	return BT_VALUE_NULL;
+}
+
+static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_Op* ip, bt_Value* constants, int8_t return_loc, uint32_t base_depth)
 {
 	bt_Value* stack = thread->stack + thread->top;
 	BT_PREFETCH_READ_MODERATE((const char*)stack);
 	bt_Value* upv = BT_CLOSURE_UPVALS(BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]));
 	bt_Object* obj, * obj2;
+	bt_Fn* fn;
+	bt_ScriptFrame* frame;
 
+	// bolt->bolt calls push a bt_ScriptFrame and continue in this loop, we only leave it once the frame at `base_depth` returns
+
+#ifdef BOLT_OP_HISTOGRAM
+	uint8_t last_op = BT_OP_END;
+#define RECORD_OP(next) \
+	context->op_counts[next]++; context->op_pairs[last_op][next]++; last_op = (uint8_t)(next);
+#else
+#define RECORD_OP(next)
+#endif
 
 #ifndef BOLT_USE_INLINE_THREADING
 	register bt_Op op;
@@ -887,21 +1585,71 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 #define CASE(x) case BT_OP_##x
 #define DISPATCH \
 	op = *ip++; \
+	RECORD_OP(BT_GET_OPCODE(op)) \
 	switch(BT_GET_OPCODE(op))
+#define ENTER continue;
+#define RESUMED_OP (ip[-1])
+#define EXT_OP (ip[0])
+#define CURRENT_IP (ip - 1)
 #else
 #define RETURN return;
 #define CASE(x) lbl_##x
 #define X(op) case BT_OP_##op: goto lbl_##op;
 #define op (*ip)
 #define NEXT                          \
-	switch (BT_GET_OPCODE(*(++ip))) { \
-		BT_OPS_X                      \
+	{                                 \
+		++ip;                         \
+		RECORD_OP(BT_GET_OPCODE(*ip)) \
+		switch (BT_GET_OPCODE(*ip)) { \
+			BT_OPS_X                  \
+		}                             \
 	}
 #define DISPATCH                      \
+	RECORD_OP(BT_GET_OPCODE(op))      \
 	switch (BT_GET_OPCODE(op)) {	  \
 		BT_OPS_X                      \
 	}
+#define ENTER { DISPATCH }
+#define RESUMED_OP (*ip)
+#define EXT_OP (ip[1])
+#define CURRENT_IP (ip)
 #endif
+
+// Saves the caller's state and switches to `callee`, whose stack must already start at thread->top.
+// `op` can't be read after this, as ip now points into the callee
+#define ENTER_SCRIPT_FN(callee, callee_fn, old_top, ret_loc, iter)                        \
+	frame = thread->script_stack + thread->depth;                                          \
+	frame->ip = ip; frame->constants = constants; frame->upv = upv; frame->module = module; \
+	frame->top = (old_top); frame->return_loc = return_loc; frame->is_iter = (iter);      \
+	thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(callee, (callee_fn)->stack_size, 0); \
+	PROFILE_ENTER(context, callee);                                                        \
+	return_loc = (ret_loc);                                                                \
+	module = (callee_fn)->module;                                                          \
+	constants = (callee_fn)->constants.elements;                                           \
+	upv = BT_CLOSURE_UPVALS(callee);                                                       \
+	stack = thread->stack + thread->top;                                                   \
+	ip = (callee_fn)->instructions.elements;                                               \
+	ENTER
+
+// Replaces the current frame with `callee`, moving its arguments down to the start of the frame
+#define TAIL_SCRIPT_FN(callee, callee_fn, args, argc)                                    \
+	for (uint8_t i = 0; i < (argc); ++i) stack[i] = (args)[i];                            \
+	PROFILE_EXIT(context);                                                                \
+	thread->callstack[thread->depth - 1] = BT_MAKE_STACKFRAME(callee, (callee_fn)->stack_size, 0); \
+	PROFILE_ENTER(context, callee);                                                       \
+	module = (callee_fn)->module;                                                         \
+	constants = (callee_fn)->constants.elements;                                          \
+	upv = BT_CLOSURE_UPVALS(callee);                                                      \
+	ip = (callee_fn)->instructions.elements;                                              \
+	ENTER
+
+// A native called from here yielded the coroutine running on this thread, save where to continue and unwind to bt_resume.
+// `ip` is kept the way ENTER_SCRIPT_FN keeps it, as the frame is resumed the same way a returning callee resumes its caller
+#define CHECK_YIELD()                                                              \
+	if (thread->yielding) {                                                        \
+		save_resume_point(thread, ip, constants, module, return_loc, BT_GET_A(op)); \
+		RETURN;                                                                    \
+	}
 #ifndef BOLT_USE_INLINE_THREADING
 	for (;;) 
 #endif 
@@ -916,7 +1664,7 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 		CASE(MOVE): stack[BT_GET_A(op)] = stack[BT_GET_B(op)]; NEXT;
 			
 		CASE(LOADUP):  BT_ASSUME(upv); stack[BT_GET_A(op)] = upv[BT_GET_B(op)]; NEXT;
-		CASE(STOREUP): BT_ASSUME(upv); upv[BT_GET_A(op)] = stack[BT_GET_B(op)]; NEXT;
+		CASE(STOREUP): BT_ASSUME(upv); upv[BT_GET_A(op)] = stack[BT_GET_B(op)]; BT_GC_BARRIER(context, upv[BT_GET_A(op)]); NEXT;
 
 		CASE(NEG):
 			if(BT_IS_ACCELERATED(op)) stack[BT_GET_A(op)] = BT_VALUE_NUMBER(-BT_AS_NUMBER(stack[BT_GET_B(op)]));
@@ -982,8 +1730,8 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 					ip++; // skip the ext op
 				}
 				else {
-					obj2 = (bt_Object*)(uintptr_t)BT_GET_A(op); // save this, as we modify op
-					stack[(uint8_t)obj2] = bt_get(context, obj, constants[BT_GET_IBC(*(++ip))]);
+					stack[BT_GET_A(op)] = bt_ic_load_slow(thread, obj, constants[BT_GET_IBC(EXT_OP)], BT_GET_C(op), &EXT_OP);
+					ip++; // skip the ext op
 				}
 			} else stack[BT_GET_A(op)] = bt_get(context, obj, stack[BT_GET_C(op)]); 
 		NEXT;
@@ -994,11 +1742,12 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 			if (BT_IS_ACCELERATED(op))	{
 				if (BT_IS_FAST(stack[BT_GET_A(op)])) {
 					(BT_TABLE_PAIRS(obj) + BT_GET_B(op))->value = stack[BT_GET_C(op)];
+					BT_GC_BARRIER(context, stack[BT_GET_C(op)]);
 					ip++; // skip the ext op
 				}
 				else {
-					obj2 = (bt_Object*)(intptr_t)BT_GET_C(op); // save this, as we modify op
-					bt_set(context, obj, constants[BT_GET_IBC(*(++ip))], stack[(uint8_t)obj2]);
+					bt_ic_store_slow(thread, obj, constants[BT_GET_IBC(EXT_OP)], stack[BT_GET_C(op)], BT_GET_B(op), &EXT_OP);
+					ip++; // skip the ext op
 				}
 			}
 			else bt_set(context, obj, stack[BT_GET_B(op)], stack[BT_GET_C(op)]); 
@@ -1035,8 +1784,12 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 			stack[BT_GET_A(op)] = BT_VALUE_OBJECT(obj2);
 		NEXT;
 
-		CASE(LOAD_IDX_K): stack[BT_GET_A(op)] = bt_get(context, BT_AS_OBJECT(stack[BT_GET_B(op)]), constants[BT_GET_C(op)]); NEXT;
-		CASE(STORE_IDX_K): bt_set(context, BT_AS_OBJECT(stack[BT_GET_A(op)]), constants[BT_GET_B(op)], stack[BT_GET_C(op)]); NEXT;
+		CASE(LOAD_IDX_K): stack[BT_GET_A(op)] = bt_ic_load(thread, BT_AS_OBJECT(stack[BT_GET_B(op)]), constants[BT_GET_C(op)], &EXT_OP); ip++; NEXT;
+		CASE(STORE_IDX_K): bt_ic_store(thread, BT_AS_OBJECT(stack[BT_GET_A(op)]), constants[BT_GET_B(op)], stack[BT_GET_C(op)], &EXT_OP); ip++; NEXT;
+		CASE(LOAD_VALUE_F): stack[BT_GET_A(op)] = bt_userdata_load_value_member(context, (bt_Userdata*)BT_AS_OBJECT(stack[BT_GET_B(op)]), (uint32_t)BT_AS_NUMBER(constants[BT_GET_C(op)])); NEXT;
+		CASE(STORE_VALUE_F): bt_userdata_store_value_member(context, (bt_Userdata*)BT_AS_OBJECT(stack[BT_GET_A(op)]), (uint32_t)BT_AS_NUMBER(constants[BT_GET_B(op)]), stack[BT_GET_C(op)]); NEXT;
+		CASE(LOAD_ELEM_F): bt_load_elem(thread, stack + BT_GET_A(op), (bt_Userdata*)BT_AS_OBJECT(stack[BT_GET_B(op)]), BT_AS_NUMBER(stack[BT_GET_C(op)]), ip); NEXT;
+		CASE(STORE_ELEM_F): bt_store_elem(thread, (bt_Userdata*)BT_AS_OBJECT(stack[BT_GET_A(op)]), BT_AS_NUMBER(stack[BT_GET_B(op)]), BT_AS_NUMBER(stack[BT_GET_C(op)]), ip); NEXT;
 
 		CASE(LOAD_PROTO): stack[BT_GET_A(op)] = bt_table_get(((bt_Table*)BT_AS_OBJECT(stack[BT_GET_B(op)]))->prototype, constants[BT_GET_C(op)]); NEXT;
 
@@ -1073,17 +1826,16 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 
 			switch (BT_OBJECT_GET_TYPE(obj)) {
 			case BT_OBJECT_TYPE_FN:
-				thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, ((bt_Fn*)obj)->stack_size, 0);
-				call(context, thread, ((bt_Fn*)obj)->module, ((bt_Fn*)obj)->instructions.elements, ((bt_Fn*)obj)->constants.elements, BT_GET_A(op) - (BT_GET_B(op) + 1));
-			break;
+				fn = (bt_Fn*)obj;
+				ENTER_SCRIPT_FN(obj, fn, (uint32_t)(uint64_t)obj2, BT_GET_A(op) - (BT_GET_B(op) + 1), BT_FALSE);
 			case BT_OBJECT_TYPE_CLOSURE:
 				switch (BT_OBJECT_GET_TYPE(((bt_Closure*)obj)->fn)) {
 				case BT_OBJECT_TYPE_FN:
-					thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, ((bt_Closure*)obj)->fn->stack_size, 0);
-					call(context, thread, ((bt_Closure*)obj)->fn->module, ((bt_Closure*)obj)->fn->instructions.elements, ((bt_Closure*)obj)->fn->constants.elements, BT_GET_A(op) - (BT_GET_B(op) + 1));
-					break;
+					fn = ((bt_Closure*)obj)->fn;
+					ENTER_SCRIPT_FN(obj, fn, (uint32_t)(uint64_t)obj2, BT_GET_A(op) - (BT_GET_B(op) + 1), BT_FALSE);
 				case BT_OBJECT_TYPE_NATIVE_FN:
 					thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, 0, 0);
+					PROFILE_ENTER(context, obj);
 
 					thread->native_stack[thread->native_depth].return_loc = BT_GET_A(op) - (BT_GET_B(op) + 1);
 					thread->native_stack[thread->native_depth].argc = BT_GET_C(op);
@@ -1097,6 +1849,7 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 			break;
 			case BT_OBJECT_TYPE_NATIVE_FN:
 				thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, 0, 0);
+				PROFILE_ENTER(context, obj);
 
 				thread->native_stack[thread->native_depth].return_loc = BT_GET_A(op) - (BT_GET_B(op) + 1);
 				thread->native_stack[thread->native_depth].argc = BT_GET_C(op);
@@ -1108,8 +1861,10 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 			default: bt_runtime_error(thread, "Unsupported callable type.", ip);
 			}
 
+			PROFILE_EXIT(context);
 			thread->depth--;
 			thread->top = (uint32_t)(uint64_t)obj2;
+			CHECK_YIELD();
 		NEXT;
 
 		CASE(REC_CALL):
@@ -1117,38 +1872,101 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 				bt_runtime_error(thread, "Stack overflow!", ip);
 			}
 
-		obj2 = (bt_Object*)(uint64_t)thread->top;
+			obj2 = (bt_Object*)(uint64_t)thread->top;
 
-		obj = (bt_Object*)BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]);
+			obj = (bt_Object*)BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]);
 
-		thread->top += BT_GET_B(op);
+			thread->top += BT_GET_B(op);
 
-		switch (BT_OBJECT_GET_TYPE(obj)) {
-		case BT_OBJECT_TYPE_FN:
-			thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, ((bt_Fn*)obj)->stack_size, 0);
-			call(context, thread, ((bt_Fn*)obj)->module, ((bt_Fn*)obj)->instructions.elements, ((bt_Fn*)obj)->constants.elements, BT_GET_A(op) - (BT_GET_B(op)));
-			break;
-		case BT_OBJECT_TYPE_CLOSURE:
-			switch (BT_OBJECT_GET_TYPE(((bt_Closure*)obj)->fn)) {
+			switch (BT_OBJECT_GET_TYPE(obj)) {
 			case BT_OBJECT_TYPE_FN:
-				thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, ((bt_Closure*)obj)->fn->stack_size, 0);
-				call(context, thread, ((bt_Closure*)obj)->fn->module, ((bt_Closure*)obj)->fn->instructions.elements, ((bt_Closure*)obj)->fn->constants.elements, BT_GET_A(op) - (BT_GET_B(op)));
+				fn = (bt_Fn*)obj;
+				ENTER_SCRIPT_FN(obj, fn, (uint32_t)(uint64_t)obj2, BT_GET_A(op) - BT_GET_B(op), BT_FALSE);
+			case BT_OBJECT_TYPE_CLOSURE:
+				switch (BT_OBJECT_GET_TYPE(((bt_Closure*)obj)->fn)) {
+				case BT_OBJECT_TYPE_FN:
+					fn = ((bt_Closure*)obj)->fn;
+					ENTER_SCRIPT_FN(obj, fn, (uint32_t)(uint64_t)obj2, BT_GET_A(op) - BT_GET_B(op), BT_FALSE);
+				default: bt_runtime_error(thread, "Closure contained unsupported callable type.", ip);
+				}
 				break;
-			default: bt_runtime_error(thread, "Closure contained unsupported callable type.", ip);
+			default: bt_runtime_error(thread, "Unsupported callable type.", ip);
+			}
+		NEXT;
+
+		// Tail calls into bolt functions reuse the current frame, anything else is a regular call followed by the RETURN the compiler emits after it
+		CASE(TAILCALL):
+			obj = BT_AS_OBJECT(stack[BT_GET_B(op)]);
+			switch (BT_OBJECT_GET_TYPE(obj)) {
+			case BT_OBJECT_TYPE_FN:
+				fn = (bt_Fn*)obj;
+				obj2 = (bt_Object*)(stack + BT_GET_B(op) + 1);
+				TAIL_SCRIPT_FN(obj, fn, (bt_Value*)obj2, BT_GET_C(op));
+			case BT_OBJECT_TYPE_CLOSURE:
+				if (BT_OBJECT_GET_TYPE(((bt_Closure*)obj)->fn) == BT_OBJECT_TYPE_FN) {
+					fn = ((bt_Closure*)obj)->fn;
+					obj2 = (bt_Object*)(stack + BT_GET_B(op) + 1);
+					TAIL_SCRIPT_FN(obj, fn, (bt_Value*)obj2, BT_GET_C(op));
+				}
+			default: break;
+			}
+			goto lbl_tailcall_fallback;
+
+		CASE(REC_TAILCALL):
+			obj = (bt_Object*)BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]);
+			fn = BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_CLOSURE ? ((bt_Closure*)obj)->fn : (bt_Fn*)obj;
+			obj2 = (bt_Object*)(stack + BT_GET_B(op));
+			TAIL_SCRIPT_FN(obj, fn, (bt_Value*)obj2, BT_GET_C(op) + 1);
+
+		lbl_tailcall_fallback:
+			if (thread->depth >= BT_CALLSTACK_SIZE) {
+				bt_runtime_error(thread, "Stack overflow!", ip);
 			}
-			break;
-		default: bt_runtime_error(thread, "Unsupported callable type.", ip);
-		}
 
-		thread->depth--;
-		thread->top = (uint32_t)(uint64_t)obj2;
+			obj2 = (bt_Object*)(uint64_t)thread->top;
+			thread->top += BT_GET_B(op) + 1;
+
+			thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, 0, 0);
+			PROFILE_ENTER(context, obj);
+
+			thread->native_stack[thread->native_depth].return_loc = BT_GET_A(op) - (BT_GET_B(op) + 1);
+			thread->native_stack[thread->native_depth].argc = BT_GET_C(op);
+			thread->native_depth++;
+
+			if (BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_NATIVE_FN) ((bt_NativeFn*)obj)->fn(context, thread);
+			else if (BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_CLOSURE && BT_OBJECT_GET_TYPE(((bt_Closure*)obj)->fn) == BT_OBJECT_TYPE_NATIVE_FN) ((bt_NativeFn*)((bt_Closure*)obj)->fn)->fn(context, thread);
+			else bt_runtime_error(thread, "Unsupported callable type.", ip);
+			thread->native_depth--;
+
+			PROFILE_EXIT(context);
+			thread->depth--;
+			thread->top = (uint32_t)(uint64_t)obj2;
+			CHECK_YIELD();
 		NEXT;
 
-		CASE(JMP): ip += BT_GET_IBC(op); NEXT;
+		CASE(JMP):
+			// loops always close with a backwards jump, which is where the sampling profiler gets a chance to look at long-running frames
+			if (context->profiling && BT_GET_IBC(op) < 0) bt_profiler_tick(context, thread, CURRENT_IP);
+			ip += BT_GET_IBC(op);
+		NEXT;
 		CASE(JMPF): if (stack[BT_GET_A(op)] == BT_VALUE_FALSE) ip += BT_GET_IBC(op); NEXT;
 
 		CASE(RETURN): stack[return_loc] = stack[BT_GET_A(op)];
-		CASE(END): RETURN;
+		CASE(END):
+			if (thread->depth == base_depth) RETURN;
+
+			PROFILE_EXIT(context);
+			frame = thread->script_stack + --thread->depth;
+			ip = frame->ip;
+			constants = frame->constants;
+			upv = frame->upv;
+			module = frame->module;
+			return_loc = frame->return_loc;
+			thread->top = frame->top;
+			stack = thread->stack + thread->top;
+
+			if (frame->is_iter && stack[BT_GET_A(RESUMED_OP)] == BT_VALUE_NULL) { ip += BT_GET_IBC(RESUMED_OP); }
+		NEXT;
 
 		CASE(NUMFOR):
 			stack[BT_GET_A(op)] = BT_VALUE_NUMBER(BT_AS_NUMBER(stack[BT_GET_A(op)]) + BT_AS_NUMBER(stack[BT_GET_A(op) + 1]));
@@ -1163,26 +1981,90 @@ static void call(bt_Context* context, bt_Thread* thread, bt_Module* module, bt_O
 			obj = BT_AS_OBJECT(stack[BT_GET_A(op) + 1]);
 			thread->top += BT_GET_A(op) + 2;
 			if (BT_OBJECT_GET_TYPE(((bt_Closure*)obj)->fn) == BT_OBJECT_TYPE_FN) {
-				thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, ((bt_Closure*)obj)->fn->stack_size, 0);
-				call(context, thread, ((bt_Closure*)obj)->fn->module, ((bt_Closure*)obj)->fn->instructions.elements, ((bt_Closure*)obj)->fn->constants.elements, -2);
+				if (thread->depth >= BT_CALLSTACK_SIZE) {
+					bt_runtime_error(thread, "Stack overflow!", ip);
+				}
+
+				fn = ((bt_Closure*)obj)->fn;
+				ENTER_SCRIPT_FN(obj, fn, thread->top - (BT_GET_A(op) + 2), -2, BT_TRUE);
 			}
 			else {
 				thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, 0, 0);
+				PROFILE_ENTER(context, obj);
 				thread->native_stack[thread->native_depth].return_loc = -2;
 				thread->native_depth++;
+				// there's no way to resume halfway through an iteration, so iterators can't yield
+				thread->reentry++;
 				((bt_NativeFn*)((bt_Closure*)obj)->fn)->fn(context, thread);
+				thread->reentry--;
 				thread->native_depth--;
 			}
 
+			PROFILE_EXIT(context);
 			thread->depth--;
 			thread->top -= BT_GET_A(op) + 2;
 			if (stack[BT_GET_A(op)] == BT_VALUE_NULL) { ip += BT_GET_IBC(op); }
 		NEXT;
 
+		// Fused compare-and-branch, falls through to the op after the trailing IDX_EXT or jumps by its offset
+		CASE(LT_JMPF):
+			if (BT_AS_NUMBER(stack[BT_GET_A(op)]) < BT_AS_NUMBER(stack[BT_GET_B(op)])) ip++;
+			else ip += 1 + BT_GET_IBC(EXT_OP);
+		NEXT;
+
+		CASE(LTE_JMPF):
+			if (BT_AS_NUMBER(stack[BT_GET_A(op)]) <= BT_AS_NUMBER(stack[BT_GET_B(op)])) ip++;
+			else ip += 1 + BT_GET_IBC(EXT_OP);
+		NEXT;
+
+		CASE(EQ_JMPF):
+			if (BT_AS_NUMBER(stack[BT_GET_A(op)]) == BT_AS_NUMBER(stack[BT_GET_B(op)])) ip++;
+			else ip += 1 + BT_GET_IBC(EXT_OP);
+		NEXT;
+
+		CASE(NEQ_JMPF):
+			if (BT_AS_NUMBER(stack[BT_GET_A(op)]) != BT_AS_NUMBER(stack[BT_GET_B(op)])) ip++;
+			else ip += 1 + BT_GET_IBC(EXT_OP);
+		NEXT;
+
+		CASE(ADD_I): stack[BT_GET_A(op)] = BT_VALUE_NUMBER(BT_AS_NUMBER(stack[BT_GET_B(op)]) + (int8_t)BT_GET_C(op)); NEXT;
+
 		CASE(LOAD_SUB_F): stack[BT_GET_A(op)] = bt_array_get(context, (bt_Array*)BT_AS_OBJECT(stack[BT_GET_B(op)]), (uint64_t)BT_AS_NUMBER(stack[BT_GET_C(op)])); NEXT;
 		CASE(STORE_SUB_F): bt_array_set(context, (bt_Array*)BT_AS_OBJECT(stack[BT_GET_A(op)]), (uint64_t)BT_AS_NUMBER(stack[BT_GET_B(op)]), stack[BT_GET_C(op)]); NEXT;
+		CASE(CONCAT): stack[BT_GET_A(op)] = BT_VALUE_OBJECT(bt_string_concat_many(context, stack + BT_GET_B(op), BT_GET_C(op))); NEXT;
 		CASE(APPEND_F): bt_array_push(context, (bt_Array*)BT_AS_OBJECT(stack[BT_GET_A(op)]), stack[BT_GET_B(op)]); NEXT;
 
+		CASE(CALL_DIRECT):
+			obj = BT_AS_OBJECT(stack[BT_GET_B(op)]);
+			if (BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_NATIVE_FN && ((bt_NativeFn*)obj)->direct_kind != BT_DIRECT_NONE &&
+				bt_direct_arity(((bt_NativeFn*)obj)->direct_kind) == BT_GET_C(op) &&
+				bt_direct_takes_userdata(((bt_NativeFn*)obj)->direct_kind) == (BT_IS_ACCELERATED(op) != 0)) {
+				if (context->profiling) {
+					if (thread->depth >= BT_CALLSTACK_SIZE) {
+						bt_runtime_error(thread, "Stack overflow!", ip);
+					}
+
+					// push a frame like a regular native call does, so the profiler sees and attributes the callee
+					thread->callstack[thread->depth++] = BT_MAKE_STACKFRAME(obj, 0, 0);
+					PROFILE_ENTER(context, obj);
+					stack[BT_GET_A(op)] = bt_call_direct((bt_NativeFn*)obj, stack + BT_GET_B(op) + 1);
+					PROFILE_EXIT(context);
+					thread->depth--;
+					NEXT;
+				}
+
+				stack[BT_GET_A(op)] = bt_call_direct((bt_NativeFn*)obj, stack + BT_GET_B(op) + 1);
+				NEXT;
+			}
+
+			// the callee isn't what the module was compiled against (e.g. it was deserialized into a different
+			// host), so its arguments may not fit, turn this into a plain call for good and run it as one
+#ifndef BOLT_USE_INLINE_THREADING
+			ip--;
+#endif
+			*ip = BT_MAKE_OP_ABC(BT_OP_CALL, BT_GET_A(op), BT_GET_B(op), BT_GET_C(op));
+			ENTER
+
 		CASE(IDX_EXT):;
 #ifndef BOLT_USE_INLINE_THREADING
 #ifdef BT_DEBUG
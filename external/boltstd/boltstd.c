@@ -8,6 +8,8 @@
 #include "boltstd_io.h"
 #include "boltstd_tables.h"
 #include "boltstd_regex.h"
+#include "boltstd_coroutine.h"
+#include "boltstd_channel.h"
 
 void boltstd_open_all(bt_Context* context)
 {
@@ -19,4 +21,6 @@ void boltstd_open_all(bt_Context* context)
 	boltstd_open_strings(context);
 	boltstd_open_io(context);
 	boltstd_open_regex(context);
+	boltstd_open_coroutine(context);
+	boltstd_open_channel(context);
 }
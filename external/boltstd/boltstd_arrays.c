@@ -1,8 +1,8 @@
 #include "boltstd_arrays.h"
 
 #include "../bt_embedding.h"
+#include "../bt_userdata.h"
 
-#include <stdlib.h>
 #include <memory.h>
 
 static void bt_arr_length(bt_Context* ctx, bt_Thread* thread)
@@ -48,11 +48,10 @@ static bt_Type* bt_arr_push_type(bt_Context* ctx, bt_Type** args, uint8_t argc)
 	return sig;
 }
 
-static bt_Value bt_arr_each_iter_fn;
-
 static void bt_arr_each(bt_Context* ctx, bt_Thread* thread)
 {
-	bt_push(thread, bt_arr_each_iter_fn);
+	// looked up per call, every context has its own iterator
+	bt_push(thread, bt_table_get(ctx->types.array->prototype_values, BT_VALUE_CSTRING(ctx, "$_each_iter")));
 	bt_push(thread, bt_arg(thread, 0));
 	bt_push(thread, BT_VALUE_NUMBER(0));
 
@@ -254,38 +253,170 @@ static void bt_arr_slice(bt_Context* ctx, bt_Thread* thread)
 	bt_pop_root(ctx);
 }
 
-typedef struct bt_SortCtx
-{
-	bt_Context* context;
+// Sorts keep all of their state on the call, so comparers are free to sort other arrays, or the same one, themselves
+typedef struct bt_SortCtx bt_SortCtx;
+typedef bt_bool (*bt_SortLess)(bt_SortCtx* sort, bt_Value a, bt_Value b);
+
+struct bt_SortCtx {
+	bt_SortLess less;
 	bt_Thread* thread;
 	bt_Value comp_fn;
-	bt_bool in_use;
-} bt_SortCtx;
+	const bt_Value* keys;
+};
+
+// runs below this length are insertion sorted
+#define BT_SORT_SMALL 8
+
+static bt_bool bt_sort_less_nums(bt_SortCtx* sort, bt_Value a, bt_Value b)
+{
+	return BT_AS_NUMBER(a) < BT_AS_NUMBER(b);
+}
+
+static bt_bool bt_sort_less_call(bt_SortCtx* sort, bt_Value a, bt_Value b)
+{
+	bt_push(sort->thread, sort->comp_fn);
+	bt_push(sort->thread, a);
+	bt_push(sort->thread, b);
+	bt_call(sort->thread, 2);
+
+	return bt_pop(sort->thread) == BT_VALUE_TRUE;
+}
+
+// sort_by orders element indices by the keys extracted up front
+static bt_bool bt_sort_less_key_nums(bt_SortCtx* sort, bt_Value a, bt_Value b)
+{
+	return BT_AS_NUMBER(sort->keys[(uint32_t)BT_AS_NUMBER(a)]) < BT_AS_NUMBER(sort->keys[(uint32_t)BT_AS_NUMBER(b)]);
+}
+
+static bt_bool bt_sort_less_key_strings(bt_SortCtx* sort, bt_Value a, bt_Value b)
+{
+	bt_String* as = (bt_String*)BT_AS_OBJECT(sort->keys[(uint32_t)BT_AS_NUMBER(a)]);
+	bt_String* bs = (bt_String*)BT_AS_OBJECT(sort->keys[(uint32_t)BT_AS_NUMBER(b)]);
+
+	uint32_t len = as->len < bs->len ? as->len : bs->len;
+	int cmp = memcmp(BT_STRING_STR(as), BT_STRING_STR(bs), len);
+	return cmp < 0 || (cmp == 0 && as->len < bs->len);
+}
+
+static void bt_sort_insertion(bt_SortCtx* sort, bt_Value* items, uint32_t length)
+{
+	for (uint32_t i = 1; i < length; ++i) {
+		bt_Value item = items[i];
+		uint32_t j = i;
+		for (; j > 0 && sort->less(sort, item, items[j - 1]); --j) items[j] = items[j - 1];
+		items[j] = item;
+	}
+}
+
+static void bt_sort_sift(bt_SortCtx* sort, bt_Value* items, uint32_t root, uint32_t length)
+{
+	for (;;) {
+		uint32_t child = root * 2 + 1;
+		if (child >= length) return;
+		if (child + 1 < length && sort->less(sort, items[child], items[child + 1])) child++;
+		if (!sort->less(sort, items[root], items[child])) return;
+
+		bt_Value temp = items[root]; items[root] = items[child]; items[child] = temp;
+		root = child;
+	}
+}
+
+static void bt_sort_heap(bt_SortCtx* sort, bt_Value* items, uint32_t length)
+{
+	for (uint32_t i = length / 2; i > 0; --i) bt_sort_sift(sort, items, i - 1, length);
 
-static bt_SortCtx sort_context;
+	for (uint32_t end = length - 1; end > 0; --end) {
+		bt_Value temp = items[0]; items[0] = items[end]; items[end] = temp;
+		bt_sort_sift(sort, items, 0, end);
+	}
+}
 
-static int bt_sort_comp(const void* in_a, const void* in_b)
+// Unstable introsort: median of three quicksort, falling back to heapsort when partitions keep coming out lopsided
+static void bt_sort_intro(bt_SortCtx* sort, bt_Value* items, uint32_t length, uint32_t depth)
 {
-	bt_Value a = *(bt_Value*)in_a;
-	bt_Value b = *(bt_Value*)in_b;
+	while (length > BT_SORT_SMALL) {
+		if (depth-- == 0) {
+			bt_sort_heap(sort, items, length);
+			return;
+		}
+
+		uint32_t mid = length / 2, last = length - 1;
+		if (sort->less(sort, items[mid], items[0])) { bt_Value t = items[mid]; items[mid] = items[0]; items[0] = t; }
+		if (sort->less(sort, items[last], items[mid])) {
+			bt_Value t = items[last]; items[last] = items[mid]; items[mid] = t;
+			if (sort->less(sort, items[mid], items[0])) { t = items[mid]; items[mid] = items[0]; items[0] = t; }
+		}
 
-	bt_push(sort_context.thread, sort_context.comp_fn);
-	bt_push(sort_context.thread, a);
-	bt_push(sort_context.thread, b);
-	bt_call(sort_context.thread, 2);
+		bt_Value pivot = items[mid];
+		uint32_t lo = 0, hi = last;
+		for (;;) {
+			// bounded, a comparer that isn't a strict weak ordering mustn't walk off the ends
+			while (lo < last && sort->less(sort, items[lo], pivot)) lo++;
+			while (hi > 0 && sort->less(sort, pivot, items[hi])) hi--;
+			if (lo >= hi) break;
 
-	bt_Value result = bt_pop(sort_context.thread);
-	if (result == BT_VALUE_TRUE) return -1;
+			bt_Value t = items[lo]; items[lo] = items[hi]; items[hi] = t;
+			lo++; hi--;
+		}
+
+		// recurse into the smaller side so the native stack stays logarithmic
+		uint32_t split = hi + 1;
+		if (split < length - split) {
+			bt_sort_intro(sort, items, split, depth);
+			items += split;
+			length -= split;
+		}
+		else {
+			bt_sort_intro(sort, items + split, length - split, depth);
+			length = split;
+		}
+	}
 
-	return 1;
+	bt_sort_insertion(sort, items, length);
 }
 
-static int bt_sort_comp_nums(const void* in_a, const void* in_b)
+// Stable merge sort, `scratch` holds at least `length` values
+static void bt_sort_merge(bt_SortCtx* sort, bt_Value* items, bt_Value* scratch, uint32_t length)
 {
-	bt_number a = BT_AS_NUMBER(*(bt_Value*)in_a);
-	bt_number b = BT_AS_NUMBER(*(bt_Value*)in_b);
+	if (length <= BT_SORT_SMALL) {
+		bt_sort_insertion(sort, items, length);
+		return;
+	}
+
+	uint32_t mid = length / 2;
+	bt_sort_merge(sort, items, scratch, mid);
+	bt_sort_merge(sort, items + mid, scratch, length - mid);
+
+	// already in order, common for nearly sorted input
+	if (!sort->less(sort, items[mid], items[mid - 1])) return;
 
-	return (a > b) - (a < b);
+	memcpy(scratch, items, mid * sizeof(bt_Value));
+
+	uint32_t left = 0, right = mid, out = 0;
+	while (left < mid && right < length) {
+		// ties take from the left run to stay stable
+		if (sort->less(sort, items[right], scratch[left])) items[out++] = items[right++];
+		else items[out++] = scratch[left++];
+	}
+
+	while (left < mid) items[out++] = scratch[left++];
+}
+
+static uint32_t bt_sort_depth(uint32_t length)
+{
+	uint32_t depth = 0;
+	while (length >>= 1) depth++;
+	return depth * 2;
+}
+
+// Makes a rooted array holding a copy of `length` values from `items`
+static bt_Array* bt_sort_copy(bt_Context* ctx, const bt_Value* items, uint32_t length)
+{
+	bt_Array* result = bt_make_array(ctx, length);
+	if (length) memcpy(result->items, items, length * sizeof(bt_Value));
+	result->length = length;
+	bt_push_root(ctx, (bt_Object*)result);
+	return result;
 }
 
 static bt_Type* bt_arr_sort_type(bt_Context* ctx, bt_Type** args, uint8_t argc)
@@ -319,32 +450,477 @@ static bt_Type* bt_arr_sort_type(bt_Context* ctx, bt_Type** args, uint8_t argc)
 	return bt_make_signature_type(ctx, arg, args, argc);
 }
 
+// Comparers are slow calls back into the vm, so they're sorted with a merge sort, which needs the fewest comparisons and is stable.
+// Only `sort_stable` promises stability though, `sort` is free to switch to an in-place algorithm
 static void bt_arr_sort(bt_Context* ctx, bt_Thread* thread)
 {
 	bt_Array* arg = (bt_Array*)bt_object(bt_arg(thread, 0));
 	bt_Value sorter = bt_argc(thread) == 2 ? bt_arg(thread, 1) : BT_VALUE_NULL;
+	uint32_t length = arg->length;
+
+	bt_SortCtx sort;
+	sort.thread = thread;
+	sort.comp_fn = sorter;
+	sort.keys = NULL;
 
-	// only allowed for number fast case
+	// only allowed for number fast case, numbers that compare equal can't be told apart so stability doesn't matter
 	if (sorter == BT_VALUE_NULL) {
-		qsort(arg->items, arg->length, sizeof(bt_Value), bt_sort_comp_nums);
+		sort.less = bt_sort_less_nums;
+		bt_sort_intro(&sort, arg->items, length, bt_sort_depth(length));
+		bt_return(thread, BT_VALUE_OBJECT(arg));
+		return;
 	}
-	else {
-		if (sort_context.in_use == BT_TRUE) {
-			bt_runtime_error(thread, "Cannot nest sorts!", NULL);
-		}
 
-		sort_context.in_use = BT_TRUE;
-		sort_context.comp_fn = sorter;
-		sort_context.context = ctx;
-		sort_context.thread = thread;
-		qsort(arg->items, arg->length, sizeof(bt_Value), bt_sort_comp);
-		
-		sort_context.in_use = BT_FALSE;
+	// the comparer can see and modify the array, so sort a private copy and write it back once done
+	sort.less = bt_sort_less_call;
+	bt_Array* items = bt_sort_copy(ctx, arg->items, length);
+	bt_Array* scratch = bt_sort_copy(ctx, arg->items, length / 2);
+	bt_sort_merge(&sort, items->items, scratch->items, length);
+	bt_pop_root(ctx);
+	bt_pop_root(ctx);
+
+	if (arg->length != length) bt_runtime_error(thread, "Array was resized while being sorted", NULL);
+	memcpy(arg->items, items->items, length * sizeof(bt_Value));
+
+	bt_return(thread, BT_VALUE_OBJECT(arg));
+}
+
+static bt_Type* bt_arr_sort_by_type(bt_Context* ctx, bt_Type** args, uint8_t argc)
+{
+	if (argc != 2) return NULL;
+	bt_Type* arg = bt_type_dealias(args[0]);
+	bt_Type* key_fn = bt_type_dealias(args[1]);
+
+	if (arg->category != BT_TYPE_CATEGORY_ARRAY) return NULL;
+	if (key_fn->category != BT_TYPE_CATEGORY_SIGNATURE) return NULL;
+	if (key_fn->as.fn.args.length != 1) return NULL;
+	if (!key_fn->as.fn.args.elements[0]->satisfier(key_fn->as.fn.args.elements[0], arg->as.array.inner)) return NULL;
+
+	bt_Type* key = bt_type_dealias(key_fn->as.fn.return_type);
+	if (key != ctx->types.number && key != ctx->types.string) return NULL;
+
+	return bt_make_signature_type(ctx, arg, args, argc);
+}
+
+// Calls `key_fn` once per element and sorts on the results natively, stable
+static void bt_arr_sort_by(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Array* arg = (bt_Array*)bt_object(bt_arg(thread, 0));
+	bt_Value key_fn = bt_arg(thread, 1);
+	uint32_t length = arg->length;
+
+	bt_Array* keys = bt_make_array(ctx, length);
+	bt_push_root(ctx, (bt_Object*)keys);
+
+	for (uint32_t i = 0; i < length; ++i) {
+		bt_push(thread, key_fn);
+		bt_push(thread, arg->items[i]);
+		bt_call(thread, 1);
+		bt_array_push(ctx, keys, bt_pop(thread));
 	}
 
+	if (arg->length != length) {
+		bt_pop_root(ctx);
+		bt_runtime_error(thread, "Array was resized while being sorted", NULL);
+	}
+
+	// no more calls into the vm from here on, the keys are known to all be numbers or all be strings
+	bt_Array* order = bt_make_array(ctx, length);
+	bt_push_root(ctx, (bt_Object*)order);
+	for (uint32_t i = 0; i < length; ++i) bt_array_push(ctx, order, BT_VALUE_NUMBER(i));
+
+	bt_Array* scratch = bt_sort_copy(ctx, order->items, length / 2);
+
+	bt_SortCtx sort;
+	sort.less = length && BT_IS_NUMBER(keys->items[0]) ? bt_sort_less_key_nums : bt_sort_less_key_strings;
+	sort.thread = thread;
+	sort.comp_fn = BT_VALUE_NULL;
+	sort.keys = keys->items;
+	bt_sort_merge(&sort, order->items, scratch->items, length);
+	bt_pop_root(ctx);
+
+	bt_Array* items = bt_sort_copy(ctx, arg->items, length);
+	for (uint32_t i = 0; i < length; ++i) arg->items[i] = items->items[(uint32_t)BT_AS_NUMBER(order->items[i])];
+
+	bt_pop_root(ctx);
+	bt_pop_root(ctx);
+	bt_pop_root(ctx);
+
 	bt_return(thread, BT_VALUE_OBJECT(arg));
 }
 
+// Typed arrays hold packed numbers instead of boxed values. The bulk operations below are plain loops over non-aliasing pointers,
+// written so the compiler can vectorize them for whatever instruction set it targets
+#define BT_TA_LANES 8
+
+#define BT_TA_DISPATCH(kind, ...)                                       \
+	switch (kind) {                                                     \
+	case BT_ELEMENTS_F32: { typedef float T; __VA_ARGS__ } break;       \
+	case BT_ELEMENTS_F64: { typedef double T; __VA_ARGS__ } break;      \
+	case BT_ELEMENTS_I32: { typedef int32_t T; __VA_ARGS__ } break;     \
+	default: break;                                                     \
+	}
+
+// Like BT_TA_DISPATCH, with `A` as a type wide enough to hold intermediate results of the element type `T`.
+// Integer math is carried out in `A` and saturated back into range, so it never overflows
+#define BT_TA_DISPATCH_WIDE(kind, ...)                                                 \
+	switch (kind) {                                                                    \
+	case BT_ELEMENTS_F32: { typedef float T; typedef float A; __VA_ARGS__ } break;     \
+	case BT_ELEMENTS_F64: { typedef double T; typedef double A; __VA_ARGS__ } break;   \
+	case BT_ELEMENTS_I32: { typedef int32_t T; typedef int64_t A; __VA_ARGS__ } break; \
+	default: break;                                                                    \
+	}
+
+// Like BT_TA_DISPATCH, with `A` as the accumulator type for reductions over `T`
+#define BT_TA_DISPATCH_ACC(kind, ...)                                                  \
+	switch (kind) {                                                                    \
+	case BT_ELEMENTS_F32: { typedef float T; typedef double A; __VA_ARGS__ } break;    \
+	case BT_ELEMENTS_F64: { typedef double T; typedef double A; __VA_ARGS__ } break;   \
+	case BT_ELEMENTS_I32: { typedef int32_t T; typedef int64_t A; __VA_ARGS__ } break; \
+	default: break;                                                                    \
+	}
+
+// the only integer element type is int32, this folds away at compile time
+#define BT_TA_IS_INT(T) ((T)0.5 == 0)
+
+// Converts the number `v` to the element type `T`, int32 elements saturate like every other store into them
+#define BT_TA_FROM_NUMBER(T, v) (BT_TA_IS_INT(T) ? (T)bt_number_to_int32(v) : (T)(v))
+
+// Narrows `v`, a result computed in the wide type of BT_TA_DISPATCH_WIDE, back to the element type `T`
+#define BT_TA_NARROW(T, v) (BT_TA_IS_INT(T) ? (T)bt_ta_saturate((int64_t)(v)) : (T)(v))
+
+static BT_FORCE_INLINE int32_t bt_ta_saturate(int64_t value)
+{
+	return value < INT32_MIN ? INT32_MIN : value > INT32_MAX ? INT32_MAX : (int32_t)value;
+}
+
+static bt_Userdata* bt_ta_arg(bt_Thread* thread, uint8_t idx)
+{
+	return (bt_Userdata*)bt_object(bt_arg(thread, idx));
+}
+
+static bt_ElementType bt_ta_kind(bt_Userdata* arr)
+{
+	return arr->type->as.userdata.elements;
+}
+
+// Returns the typed array operand at `idx` or NULL if it's a scalar, erroring if its length doesn't match `length`
+static bt_Userdata* bt_ta_operand(bt_Thread* thread, uint8_t idx, uint32_t length)
+{
+	bt_Value arg = bt_arg(thread, idx);
+	if (BT_IS_NUMBER(arg)) return NULL;
+
+	bt_Userdata* result = (bt_Userdata*)bt_object(arg);
+	if (BT_TYPED_ARRAY(result)->length != length) bt_runtime_error(thread, "Typed array lengths don't match", NULL);
+	return result;
+}
+
+static void bt_ta_make(bt_Context* ctx, bt_Thread* thread, bt_Type* type)
+{
+	bt_Value arg = bt_arg(thread, 0);
+	if (BT_IS_NUMBER(arg)) {
+		double length = bt_get_number(arg);
+		if (length < 0 || length > UINT32_MAX) bt_runtime_error(thread, "Invalid typed array length", NULL);
+		bt_return(thread, BT_VALUE_OBJECT(bt_make_typed_array(ctx, type, (uint32_t)length)));
+		return;
+	}
+
+	bt_Array* source = (bt_Array*)bt_object(arg);
+	bt_Userdata* result = bt_make_typed_array(ctx, type, source->length);
+	void* data = BT_TYPED_ARRAY_DATA(result);
+
+	BT_TA_DISPATCH(type->as.userdata.elements,
+		T* out = data;
+		for (uint32_t i = 0; i < source->length; ++i) out[i] = BT_TA_FROM_NUMBER(T, bt_get_number(source->items[i]));
+	)
+
+	bt_return(thread, BT_VALUE_OBJECT(result));
+}
+
+// the element types are kept on the array prototype, like the each iterator, so every context finds its own
+static bt_Type* bt_ta_type(bt_Context* ctx, const char* key)
+{
+	return (bt_Type*)bt_object(bt_table_get(ctx->types.array->prototype_values, BT_VALUE_CSTRING(ctx, key)));
+}
+
+static void bt_ta_float32(bt_Context* ctx, bt_Thread* thread) { bt_ta_make(ctx, thread, bt_ta_type(ctx, "$_float32")); }
+static void bt_ta_float64(bt_Context* ctx, bt_Thread* thread) { bt_ta_make(ctx, thread, bt_ta_type(ctx, "$_float64")); }
+static void bt_ta_int32(bt_Context* ctx, bt_Thread* thread) { bt_ta_make(ctx, thread, bt_ta_type(ctx, "$_int32")); }
+
+static double bt_ta_length(void* data)
+{
+	return ((bt_TypedArray*)data)->length;
+}
+
+static void bt_ta_to_array(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+
+	bt_Array* result = bt_make_array(ctx, length);
+	bt_push_root(ctx, (bt_Object*)result);
+
+	for (uint32_t i = 0; i < length; ++i) bt_array_push(ctx, result, bt_typed_array_get(ctx, arr, i));
+
+	bt_return(thread, BT_VALUE_OBJECT(result));
+	bt_pop_root(ctx);
+}
+
+static void bt_ta_fill(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+	bt_number value = bt_get_number(bt_arg(thread, 1));
+
+	BT_TA_DISPATCH(bt_ta_kind(arr),
+		T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);
+		T v = BT_TA_FROM_NUMBER(T, value);
+		for (uint32_t i = 0; i < length; ++i) a[i] = v;
+	)
+}
+
+// a[i] = a[i] op b, where b is either a scalar or an array of the same type and length
+#define BT_TA_BINARY(name, op)                                                          \
+static void name(bt_Context* ctx, bt_Thread* thread)                                    \
+{                                                                                       \
+	bt_Userdata* arr = bt_ta_arg(thread, 0);                                            \
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;                                      \
+	bt_Userdata* other = bt_ta_operand(thread, 1, length);                              \
+	bt_number scalar = other ? 0 : bt_get_number(bt_arg(thread, 1));                   \
+                                                                                        \
+	BT_TA_DISPATCH_WIDE(bt_ta_kind(arr),                                                \
+		T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);                                    \
+		if (other == arr) {                                                             \
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, (A)a[i] op a[i]); \
+		} else if (other) {                                                             \
+			const T* BT_RESTRICT b = BT_TYPED_ARRAY_DATA(other);                        \
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, (A)a[i] op b[i]); \
+		} else {                                                                        \
+			A b = BT_TA_FROM_NUMBER(T, scalar);                                         \
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, a[i] op b);    \
+		}                                                                               \
+	)                                                                                   \
+}
+
+BT_TA_BINARY(bt_ta_add, +)
+BT_TA_BINARY(bt_ta_mul, *)
+
+// a[i] = a[i] * b + c, where b and c are each either a scalar or an array of the same type and length
+static void bt_ta_fma(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+	bt_Userdata* b_arr = bt_ta_operand(thread, 1, length);
+	bt_Userdata* c_arr = bt_ta_operand(thread, 2, length);
+	bt_number b_scalar = b_arr ? 0 : bt_get_number(bt_arg(thread, 1));
+	bt_number c_scalar = c_arr ? 0 : bt_get_number(bt_arg(thread, 2));
+
+	// aliased operands can't take the restrict paths, copy them out first
+	// the product of two int32 elements plus a third always fits the wide type
+	if (b_arr == arr || c_arr == arr || (b_arr && b_arr == c_arr)) {
+		BT_TA_DISPATCH_WIDE(bt_ta_kind(arr),
+			T* a = BT_TYPED_ARRAY_DATA(arr);
+			const T* b = b_arr ? BT_TYPED_ARRAY_DATA(b_arr) : NULL;
+			const T* c = c_arr ? BT_TYPED_ARRAY_DATA(c_arr) : NULL;
+			A b_value = BT_TA_FROM_NUMBER(T, b_scalar), c_value = BT_TA_FROM_NUMBER(T, c_scalar);
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, (A)a[i] * (b ? b[i] : b_value) + (c ? c[i] : c_value));
+		)
+		return;
+	}
+
+	BT_TA_DISPATCH_WIDE(bt_ta_kind(arr),
+		T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);
+		if (b_arr && c_arr) {
+			const T* BT_RESTRICT b = BT_TYPED_ARRAY_DATA(b_arr);
+			const T* BT_RESTRICT c = BT_TYPED_ARRAY_DATA(c_arr);
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, (A)a[i] * b[i] + c[i]);
+		} else if (b_arr) {
+			const T* BT_RESTRICT b = BT_TYPED_ARRAY_DATA(b_arr);
+			A c = BT_TA_FROM_NUMBER(T, c_scalar);
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, (A)a[i] * b[i] + c);
+		} else if (c_arr) {
+			A b = BT_TA_FROM_NUMBER(T, b_scalar);
+			const T* BT_RESTRICT c = BT_TYPED_ARRAY_DATA(c_arr);
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, a[i] * b + c[i]);
+		} else {
+			A b = BT_TA_FROM_NUMBER(T, b_scalar), c = BT_TA_FROM_NUMBER(T, c_scalar);
+			for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_NARROW(T, a[i] * b + c);
+		}
+	)
+}
+
+static void bt_ta_clamp(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+	bt_number lo = bt_get_number(bt_arg(thread, 1));
+	bt_number hi = bt_get_number(bt_arg(thread, 2));
+
+	BT_TA_DISPATCH(bt_ta_kind(arr),
+		T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);
+		T l = BT_TA_FROM_NUMBER(T, lo), h = BT_TA_FROM_NUMBER(T, hi);
+		for (uint32_t i = 0; i < length; ++i) {
+			T v = a[i] < l ? l : a[i];
+			a[i] = v > h ? h : v;
+		}
+	)
+}
+
+// a[i] = a[i] + (b[i] - a[i]) * t
+static void bt_ta_lerp(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+	bt_Userdata* other = bt_ta_operand(thread, 1, length);
+	bt_number t = bt_get_number(bt_arg(thread, 2));
+
+	if (other == arr) return;
+
+	BT_TA_DISPATCH(bt_ta_kind(arr),
+		T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);
+		const T* BT_RESTRICT b = BT_TYPED_ARRAY_DATA(other);
+		for (uint32_t i = 0; i < length; ++i) a[i] = BT_TA_FROM_NUMBER(T, a[i] + ((double)b[i] - a[i]) * t);
+	)
+}
+
+// Reductions keep BT_TA_LANES independent partials so they vectorize without reassociating floating point math
+static void bt_ta_sum(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+	bt_number result = 0;
+
+	BT_TA_DISPATCH_ACC(bt_ta_kind(arr),
+		const T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);
+		A lanes[BT_TA_LANES] = { 0 };
+		uint32_t i = 0;
+		for (; i + BT_TA_LANES <= length; i += BT_TA_LANES) {
+			for (uint32_t l = 0; l < BT_TA_LANES; ++l) lanes[l] += a[i + l];
+		}
+		for (; i < length; ++i) lanes[0] += a[i];
+		A total = 0;
+		for (uint32_t l = 0; l < BT_TA_LANES; ++l) total += lanes[l];
+		result = (bt_number)total;
+	)
+
+	bt_return(thread, BT_VALUE_NUMBER(result));
+}
+
+static void bt_ta_dot(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* arr = bt_ta_arg(thread, 0);
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;
+	bt_Userdata* other = bt_ta_operand(thread, 1, length);
+	bt_number result = 0;
+
+	BT_TA_DISPATCH(bt_ta_kind(arr),
+		const T* a = BT_TYPED_ARRAY_DATA(arr);
+		const T* b = BT_TYPED_ARRAY_DATA(other);
+		// int32 products add up past what an int64 can hold, so every element type accumulates in double
+		double lanes[BT_TA_LANES] = { 0 };
+		uint32_t i = 0;
+		for (; i + BT_TA_LANES <= length; i += BT_TA_LANES) {
+			for (uint32_t l = 0; l < BT_TA_LANES; ++l) lanes[l] += (double)a[i + l] * b[i + l];
+		}
+		for (; i < length; ++i) lanes[0] += (double)a[i] * b[i];
+		double total = 0;
+		for (uint32_t l = 0; l < BT_TA_LANES; ++l) total += lanes[l];
+		result = total;
+	)
+
+	bt_return(thread, BT_VALUE_NUMBER(result));
+}
+
+// min and max of an empty array are null, like popping an empty array
+#define BT_TA_EXTREME(name, cmp)                                                          \
+static void name(bt_Context* ctx, bt_Thread* thread)                                      \
+{                                                                                         \
+	bt_Userdata* arr = bt_ta_arg(thread, 0);                                              \
+	uint32_t length = BT_TYPED_ARRAY(arr)->length;                                        \
+	bt_Value result = BT_VALUE_NULL;                                                      \
+                                                                                          \
+	if (length) {                                                                         \
+		BT_TA_DISPATCH(bt_ta_kind(arr),                                                   \
+			const T* BT_RESTRICT a = BT_TYPED_ARRAY_DATA(arr);                               \
+			T lanes[BT_TA_LANES];                                                         \
+			for (uint32_t l = 0; l < BT_TA_LANES; ++l) lanes[l] = a[0];                   \
+			uint32_t i = 0;                                                               \
+			for (; i + BT_TA_LANES <= length; i += BT_TA_LANES) {                         \
+				for (uint32_t l = 0; l < BT_TA_LANES; ++l) {                              \
+					T v = a[i + l];                                                       \
+					lanes[l] = v cmp lanes[l] ? v : lanes[l];                             \
+				}                                                                         \
+			}                                                                             \
+			for (; i < length; ++i) lanes[0] = a[i] cmp lanes[0] ? a[i] : lanes[0];       \
+			T best = lanes[0];                                                            \
+			for (uint32_t l = 1; l < BT_TA_LANES; ++l) best = lanes[l] cmp best ? lanes[l] : best; \
+			result = BT_VALUE_NUMBER((bt_number)best);                                    \
+		)                                                                                 \
+	}                                                                                     \
+                                                                                          \
+	bt_return(thread, result);                                                            \
+}
+
+BT_TA_EXTREME(bt_ta_min, <)
+BT_TA_EXTREME(bt_ta_max, >)
+
+static void bt_ta_add_method(bt_Context* ctx, bt_Module* module, bt_Type* type, const char* name, bt_Type* ret, bt_Type** args, uint8_t argc, bt_NativeProc proc)
+{
+	bt_Type* sig = bt_make_signature_type(ctx, ret, args, argc);
+	bt_NativeFn* fn_ref = bt_make_native(ctx, module, sig, proc);
+	bt_type_add_field(ctx, type, sig, BT_VALUE_CSTRING(ctx, name), BT_VALUE_OBJECT(fn_ref));
+}
+
+static void bt_ta_open(bt_Context* ctx, bt_Module* module, const char* name, const char* ctor, const char* key, bt_ElementType elements, bt_NativeProc ctor_proc)
+{
+	bt_Type* type = bt_make_typed_array_type(ctx, name, elements);
+	bt_Type* number = bt_type_number(ctx);
+	bt_Type* numbers = bt_make_array_type(ctx, number);
+
+	bt_type_add_field(ctx, ctx->types.array, bt_type_type(ctx), BT_VALUE_CSTRING(ctx, key), BT_VALUE_OBJECT(type));
+	bt_module_export(ctx, module, bt_type_type(ctx), BT_VALUE_CSTRING(ctx, name), BT_VALUE_OBJECT(type));
+
+	// takes either a length, for a zeroed array, or a regular array of numbers to copy
+	bt_Type* ctor_variants[] = { number, numbers };
+	bt_Type* ctor_arg = bt_make_union_from(ctx, ctor_variants, 2);
+	bt_Type* ctor_sig = bt_make_signature_type(ctx, type, &ctor_arg, 1);
+	bt_NativeFn* fn_ref = bt_make_native(ctx, module, ctor_sig, ctor_proc);
+	bt_module_export(ctx, module, ctor_sig, BT_VALUE_CSTRING(ctx, ctor), BT_VALUE_OBJECT(fn_ref));
+
+	bt_Type* operand_variants[] = { number, type };
+	bt_Type* operand = bt_make_union_from(ctx, operand_variants, 2);
+
+	bt_Type* self_args[] = { type };
+	bt_Type* length_sig = bt_make_signature_type(ctx, number, self_args, 1);
+	bt_NativeFn* length_ref = bt_make_native_direct(ctx, module, length_sig, BT_DIRECT_USERDATA, (bt_DirectProc){ .userdata = bt_ta_length });
+	bt_type_add_field(ctx, type, length_sig, BT_VALUE_CSTRING(ctx, "length"), BT_VALUE_OBJECT(length_ref));
+
+	bt_ta_add_method(ctx, module, type, "to_array", numbers, self_args, 1, bt_ta_to_array);
+	bt_ta_add_method(ctx, module, type, "sum", number, self_args, 1, bt_ta_sum);
+	bt_Type* maybe_number = bt_type_make_nullable(ctx, number);
+	bt_ta_add_method(ctx, module, type, "min", maybe_number, self_args, 1, bt_ta_min);
+	bt_ta_add_method(ctx, module, type, "max", maybe_number, self_args, 1, bt_ta_max);
+
+	bt_Type* scalar_args[] = { type, number };
+	bt_ta_add_method(ctx, module, type, "fill", NULL, scalar_args, 2, bt_ta_fill);
+
+	bt_Type* operand_args[] = { type, operand };
+	bt_ta_add_method(ctx, module, type, "add", NULL, operand_args, 2, bt_ta_add);
+	bt_ta_add_method(ctx, module, type, "mul", NULL, operand_args, 2, bt_ta_mul);
+
+	bt_Type* fma_args[] = { type, operand, operand };
+	bt_ta_add_method(ctx, module, type, "fma", NULL, fma_args, 3, bt_ta_fma);
+
+	bt_Type* dot_args[] = { type, type };
+	bt_ta_add_method(ctx, module, type, "dot", number, dot_args, 2, bt_ta_dot);
+
+	bt_Type* clamp_args[] = { type, number, number };
+	bt_ta_add_method(ctx, module, type, "clamp", NULL, clamp_args, 3, bt_ta_clamp);
+
+	bt_Type* lerp_args[] = { type, type, number };
+	bt_ta_add_method(ctx, module, type, "lerp", NULL, lerp_args, 3, bt_ta_lerp);
+}
+
 void boltstd_open_arrays(bt_Context* context)
 {
 	bt_Module* module = bt_make_module(context);
@@ -365,12 +941,12 @@ void boltstd_open_arrays(bt_Context* context)
 	bt_type_add_field(context, array, arr_push_sig, BT_VALUE_CSTRING(context, "push"), BT_VALUE_OBJECT(fn_ref));
 	bt_module_export(context, module, arr_push_sig, BT_VALUE_CSTRING(context, "push"), BT_VALUE_OBJECT(fn_ref));
 
-	bt_arr_each_iter_fn = BT_VALUE_OBJECT(bt_make_native(context, module, NULL, bt_arr_each_iter));
+	bt_Value each_iter_ref = BT_VALUE_OBJECT(bt_make_native(context, module, NULL, bt_arr_each_iter));
 	bt_Type* arr_each_sig = bt_make_poly_signature_type(context, "each([T]): fn: T?", bt_arr_each_type);
 	fn_ref = bt_make_native(context, module, arr_each_sig, bt_arr_each);
 	bt_type_add_field(context, array, arr_each_sig, BT_VALUE_CSTRING(context, "each"), BT_VALUE_OBJECT(fn_ref));
 	bt_module_export(context, module, arr_each_sig, BT_VALUE_CSTRING(context, "each"), BT_VALUE_OBJECT(fn_ref));
-	bt_type_add_field(context, array, arr_each_sig, BT_VALUE_CSTRING(context, "$_each_iter"), bt_arr_each_iter_fn);
+	bt_type_add_field(context, array, arr_each_sig, BT_VALUE_CSTRING(context, "$_each_iter"), each_iter_ref);
 
 	bt_Type* arr_clone_sig = bt_make_poly_signature_type(context, "clone([T]): [T]", bt_arr_clone_type);
 	fn_ref = bt_make_native(context, module, arr_clone_sig, bt_arr_clone);
@@ -402,5 +978,19 @@ void boltstd_open_arrays(bt_Context* context)
 	bt_type_add_field(context, array, arr_sort_sig, BT_VALUE_CSTRING(context, "sort"), BT_VALUE_OBJECT(fn_ref));
 	bt_module_export(context, module, arr_sort_sig, BT_VALUE_CSTRING(context, "sort"), BT_VALUE_OBJECT(fn_ref));
 
+	bt_Type* arr_sort_stable_sig = bt_make_poly_signature_type(context, "sort_stable([T], null | fn(T, T): bool): [T]", bt_arr_sort_type);
+	fn_ref = bt_make_native(context, module, arr_sort_stable_sig, bt_arr_sort);
+	bt_type_add_field(context, array, arr_sort_stable_sig, BT_VALUE_CSTRING(context, "sort_stable"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, arr_sort_stable_sig, BT_VALUE_CSTRING(context, "sort_stable"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_Type* arr_sort_by_sig = bt_make_poly_signature_type(context, "sort_by([T], fn(T): number | string): [T]", bt_arr_sort_by_type);
+	fn_ref = bt_make_native(context, module, arr_sort_by_sig, bt_arr_sort_by);
+	bt_type_add_field(context, array, arr_sort_by_sig, BT_VALUE_CSTRING(context, "sort_by"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, arr_sort_by_sig, BT_VALUE_CSTRING(context, "sort_by"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_ta_open(context, module, "Float32Array", "float32", "$_float32", BT_ELEMENTS_F32, bt_ta_float32);
+	bt_ta_open(context, module, "Float64Array", "float64", "$_float64", BT_ELEMENTS_F64, bt_ta_float64);
+	bt_ta_open(context, module, "Int32Array", "int32", "$_int32", BT_ELEMENTS_I32, bt_ta_int32);
+
 	bt_register_module(context, BT_VALUE_CSTRING(context, "arrays"), module);
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "boltstd_channel.h"
+
+#include "../bt_embedding.h"
+#include "../bt_channel.h"
+
+static void bt_ch_send(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Channel* channel = bt_channel_unwrap((bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0)));
+	bt_return(thread, BT_VALUE_BOOL(bt_channel_send(ctx, channel, bt_arg(thread, 1))));
+}
+
+static void bt_ch_receive(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Channel* channel = bt_channel_unwrap((bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0)));
+
+	bt_Value result;
+	if (!bt_channel_receive(ctx, channel, &result)) result = BT_VALUE_NULL;
+
+	bt_return(thread, result);
+}
+
+static void bt_ch_count(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Channel* channel = bt_channel_unwrap((bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0)));
+	bt_return(thread, BT_VALUE_NUMBER(bt_channel_count(channel)));
+}
+
+void boltstd_open_channel(bt_Context* context)
+{
+	bt_Module* module = bt_make_module(context);
+	bt_Type* channel = context->types.channel;
+	bt_Type* any = bt_type_any(context);
+	bt_Type* number = bt_type_number(context);
+	bt_Type* boolean = bt_type_bool(context);
+
+	bt_module_export(context, module, bt_type_type(context), BT_VALUE_CSTRING(context, "Channel"), BT_VALUE_OBJECT(channel));
+
+	// returns false if the value isn't plain data, see bt_channel.h
+	bt_Type* send_args[] = { channel, any };
+	bt_Type* send_sig = bt_make_signature_type(context, boolean, send_args, 2);
+	bt_NativeFn* fn_ref = bt_make_native(context, module, send_sig, bt_ch_send);
+	bt_type_add_field(context, channel, send_sig, BT_VALUE_CSTRING(context, "send"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, send_sig, BT_VALUE_CSTRING(context, "send"), BT_VALUE_OBJECT(fn_ref));
+
+	// null once the channel is empty
+	bt_Type* receive_sig = bt_make_signature_type(context, any, &channel, 1);
+	fn_ref = bt_make_native(context, module, receive_sig, bt_ch_receive);
+	bt_type_add_field(context, channel, receive_sig, BT_VALUE_CSTRING(context, "receive"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, receive_sig, BT_VALUE_CSTRING(context, "receive"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_Type* count_sig = bt_make_signature_type(context, number, &channel, 1);
+	fn_ref = bt_make_native(context, module, count_sig, bt_ch_count);
+	bt_type_add_field(context, channel, count_sig, BT_VALUE_CSTRING(context, "count"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, count_sig, BT_VALUE_CSTRING(context, "count"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_register_module(context, BT_VALUE_CSTRING(context, "channel"), module);
+}
@@ -0,0 +1,104 @@
+#include "boltstd_coroutine.h"
+
+#include "../bt_embedding.h"
+#include "../bt_coroutine.h"
+
+static const char* bt_coroutine_status_names[] = { "ready", "suspended", "running", "done", "failed" };
+
+static bt_Type* bt_co_create_type(bt_Context* ctx, bt_Type** args, uint8_t argc)
+{
+	if (argc != 1) return NULL;
+	bt_Type* arg = bt_type_dealias(args[0]);
+
+	if (arg->category != BT_TYPE_CATEGORY_SIGNATURE || arg->as.fn.args.length != 0 || arg->as.fn.is_vararg) return NULL;
+
+	return bt_make_signature_type(ctx, ctx->types.coroutine, &arg, 1);
+}
+
+static void bt_co_create(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Object* fn = BT_AS_OBJECT(bt_arg(thread, 0));
+
+	bt_bool is_script = BT_OBJECT_GET_TYPE(fn) == BT_OBJECT_TYPE_FN
+		|| (BT_OBJECT_GET_TYPE(fn) == BT_OBJECT_TYPE_CLOSURE && BT_OBJECT_GET_TYPE(((bt_Closure*)fn)->fn) == BT_OBJECT_TYPE_FN);
+	if (!is_script) {
+		bt_runtime_error(thread, "Coroutines can only be created from bolt functions!", NULL);
+	}
+
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_coroutine(ctx, (bt_Callable*)fn)));
+}
+
+static void bt_co_resume(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* co = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	bt_Value value = bt_argc(thread) > 1 ? bt_arg(thread, 1) : BT_VALUE_NULL;
+
+	bt_CoroutineStatus status = bt_coroutine_status(co);
+	if (status != BT_COROUTINE_READY && status != BT_COROUTINE_SUSPENDED) {
+		bt_runtime_error(thread, "Attempted to resume a coroutine that isn't suspended!", NULL);
+	}
+
+	// errors inside the coroutine have already been reported, it's left in the failed state
+	bt_Value result = BT_VALUE_NULL;
+	if (!bt_resume(ctx, co, value, &result)) result = BT_VALUE_NULL;
+
+	bt_return(thread, result);
+}
+
+static void bt_co_yield(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_yield(thread, bt_argc(thread) > 0 ? bt_arg(thread, 0) : BT_VALUE_NULL);
+}
+
+static void bt_co_status(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* co = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	bt_return(thread, BT_VALUE_CSTRING(ctx, bt_coroutine_status_names[bt_coroutine_status(co)]));
+}
+
+static void bt_co_done(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* co = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	bt_CoroutineStatus status = bt_coroutine_status(co);
+	bt_return(thread, BT_VALUE_BOOL(status == BT_COROUTINE_DONE || status == BT_COROUTINE_FAILED));
+}
+
+void boltstd_open_coroutine(bt_Context* context)
+{
+	bt_Module* module = bt_make_module(context);
+	bt_Type* coroutine = context->types.coroutine;
+	bt_Type* any = bt_type_any(context);
+	bt_Type* number = bt_type_number(context);
+	bt_Type* string = bt_type_string(context);
+	bt_Type* boolean = bt_type_bool(context);
+
+	bt_module_export(context, module, bt_type_type(context), BT_VALUE_CSTRING(context, "Coroutine"), BT_VALUE_OBJECT(coroutine));
+
+	bt_Type* create_sig = bt_make_poly_signature_type(context, "create(fn): Coroutine", bt_co_create_type);
+	bt_NativeFn* fn_ref = bt_make_native(context, module, create_sig, bt_co_create);
+	bt_module_export(context, module, create_sig, BT_VALUE_CSTRING(context, "create"), BT_VALUE_OBJECT(fn_ref));
+
+	// an optional second argument becomes the result of the yield being resumed
+	bt_Type* resume_sig = bt_make_signature_type(context, any, &coroutine, 1);
+	resume_sig = bt_make_signature_vararg(context, resume_sig, any);
+	fn_ref = bt_make_native(context, module, resume_sig, bt_co_resume);
+	bt_type_add_field(context, coroutine, resume_sig, BT_VALUE_CSTRING(context, "resume"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, resume_sig, BT_VALUE_CSTRING(context, "resume"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_module_export_native(context, module, "yield", bt_co_yield, any, &any, 1);
+
+	// the scheduler in the host decides what a yielded number means, usually the time to sleep in seconds
+	bt_module_export_native(context, module, "wait", bt_co_yield, any, &number, 1);
+
+	bt_Type* status_sig = bt_make_signature_type(context, string, &coroutine, 1);
+	fn_ref = bt_make_native(context, module, status_sig, bt_co_status);
+	bt_type_add_field(context, coroutine, status_sig, BT_VALUE_CSTRING(context, "status"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, status_sig, BT_VALUE_CSTRING(context, "status"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_Type* done_sig = bt_make_signature_type(context, boolean, &coroutine, 1);
+	fn_ref = bt_make_native(context, module, done_sig, bt_co_done);
+	bt_type_add_field(context, coroutine, done_sig, BT_VALUE_CSTRING(context, "done"), BT_VALUE_OBJECT(fn_ref));
+	bt_module_export(context, module, done_sig, BT_VALUE_CSTRING(context, "done"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_register_module(context, BT_VALUE_CSTRING(context, "coroutine"), module);
+}
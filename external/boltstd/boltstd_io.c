@@ -6,16 +6,52 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 static const char* io_file_type_name = "File";
+static const char* io_mapping_type_name = "Mapping";
+static const char* io_lines_iter_name = "$_lines_iter";
+static const char* io_mapping_lines_iter_name = "$_mapping_lines_iter";
 static const char* close_error_reason = "File already closed";
+static const char* map_error_reason = "Failed to map file";
+static const char* too_big_error_reason = "File too big";
 
 typedef struct btio_FileState {
 	FILE* handle;
 	bt_bool is_open;
+
+	// reused by read_line and lines, grows to the longest line read so far
+	char* line;
+	uint32_t line_capacity;
+
+	// writes are batched here when the file was given a write buffer, until it fills or is flushed
+	char* pending;
+	uint32_t pending_length, pending_capacity;
+	// set once something is written to the stream, reads have to flush it first
+	bt_bool unflushed;
 } btio_FileState;
 
+typedef struct btio_MappingState {
+	const char* data;
+	uint64_t size;
+	bt_bool is_open;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} btio_MappingState;
+
 static const char* error_to_desc(int32_t error)
 {
 	switch (error) {
@@ -47,13 +83,48 @@ static const char* error_to_desc(int32_t error)
 	}
 }
 
+static bt_bool btio_flush_pending(btio_FileState* state)
+{
+	if (state->pending_length == 0) return BT_TRUE;
+
+	size_t n_written = fwrite(state->pending, 1, state->pending_length, state->handle);
+	bt_bool success = n_written == state->pending_length;
+	state->pending_length = 0;
+	state->unflushed = BT_TRUE;
+
+	return success;
+}
+
+/** Writes out pending data ahead of a read. On update streams ("r+", "w+", "a+") a read may not directly follow a write without a flush in between */
+static void btio_flush_before_read(btio_FileState* state)
+{
+	btio_flush_pending(state);
+	if (state->unflushed) {
+		fflush(state->handle);
+		state->unflushed = BT_FALSE;
+	}
+}
+
+static void btio_release(bt_Context* ctx, btio_FileState* state)
+{
+	btio_flush_pending(state);
+	fclose(state->handle);
+	state->handle = 0;
+	state->is_open = BT_FALSE;
+
+	if (state->line) bt_gc_free(ctx, state->line, state->line_capacity);
+	if (state->pending) bt_gc_free(ctx, state->pending, state->pending_capacity);
+	state->line = 0;
+	state->line_capacity = 0;
+	state->pending = 0;
+	state->pending_capacity = 0;
+}
+
 static void btio_file_finalizer(bt_Context* ctx, bt_Userdata* userdata)
 {
 	btio_FileState* state = bt_userdata_get(userdata);
 	if (state->is_open) {
-		fclose(state->handle);
-		state->handle = 0;
-		state->is_open = BT_FALSE;
+		btio_release(ctx, state);
 	}
 }
 
@@ -67,6 +138,7 @@ static void btio_open(bt_Context* ctx, bt_Thread* thread)
 
 	if (file) {
 		btio_FileState state;
+		memset(&state, 0, sizeof(state));
 		state.handle = file;
 		state.is_open = BT_TRUE;
 
@@ -87,10 +159,9 @@ static void btio_close(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 	
 	if (state->is_open) {
-		fclose(state->handle);
-		state->handle = 0;
-		state->is_open = BT_FALSE;
-		bt_return(thread, BT_VALUE_NULL);
+		bt_bool flushed = btio_flush_pending(state);
+		btio_release(ctx, state);
+		bt_return(thread, flushed ? BT_VALUE_NULL : boltstd_make_error(ctx, error_to_desc(errno)));
 	}
 	else {
 		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
@@ -103,6 +174,7 @@ static void btio_get_size(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 
 	if (state->is_open) {
+		btio_flush_pending(state);
 		int64_t pos = ftell(state->handle);
 		fseek(state->handle, 0, SEEK_END);
 		int64_t size = ftell(state->handle);
@@ -122,6 +194,7 @@ static void btio_seek_set(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 
 	if (state->is_open) {
+		btio_flush_pending(state);
 		fseek(state->handle, (long)pos, SEEK_SET);
 		bt_return(thread, BT_VALUE_NULL);
 	}
@@ -137,6 +210,7 @@ static void btio_seek_relative(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 
 	if (state->is_open) {
+		btio_flush_pending(state);
 		fseek(state->handle, (long)pos, SEEK_CUR);
 		bt_return(thread, BT_VALUE_NULL);
 	}
@@ -151,6 +225,7 @@ static void btio_seek_end(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 
 	if (state->is_open) {
+		btio_flush_pending(state);
 		fseek(state->handle, 0, SEEK_END);
 		bt_return(thread, BT_VALUE_NULL);
 	}
@@ -165,6 +240,7 @@ static void btio_tell(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 
 	if (state->is_open) {
+		btio_flush_pending(state);
 		int64_t pos = ftell(state->handle);
 		bt_return(thread, BT_VALUE_NUMBER(pos));
 	}
@@ -175,44 +251,134 @@ static void btio_tell(bt_Context* ctx, bt_Thread* thread)
 
 static void btio_read(bt_Context* ctx, bt_Thread* thread)
 {
-	bt_gc_pause(ctx);
-	
 	bt_Userdata* file = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
 	size_t size = (size_t)BT_AS_NUMBER(bt_arg(thread, 1));
 	btio_FileState* state = bt_userdata_get(file);
 
-	if (state->is_open) {
-		if (size == 0) {
-			int64_t pos = ftell(state->handle);
-			fseek(state->handle, 0, SEEK_END);
-			size = (size_t)ftell(state->handle);
-			fseek(state->handle, (long)pos, SEEK_SET);
-		}
+	if (!state->is_open) {
+		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
+		return;
+	}
 
-		char* buffer = bt_gc_alloc(ctx, size);
+	btio_flush_before_read(state);
 
-		size_t n_read = fread(buffer, 1, size, state->handle);
+	if (size == 0) {
+		int64_t pos = ftell(state->handle);
+		fseek(state->handle, 0, SEEK_END);
+		int64_t end = ftell(state->handle);
+		fseek(state->handle, (long)pos, SEEK_SET);
+		size = end > pos ? (size_t)(end - pos) : 0;
+	}
 
-		bt_String* as_string = bt_make_string_len(ctx, buffer, (uint32_t)n_read);
-		bt_gc_free(ctx, buffer, size);
+	if (size > INT32_MAX) {
+		bt_return(thread, boltstd_make_error(ctx, too_big_error_reason));
+		return;
+	}
+
+	bt_String* as_string;
+	size_t n_read;
 
+	if (size <= BT_STRINGTABLE_MAX_LEN) {
+		// short reads go through the string table like any other short string
+		char buffer[BT_STRINGTABLE_MAX_LEN];
+		n_read = fread(buffer, 1, size, state->handle);
+		as_string = bt_make_string_len(ctx, buffer, (uint32_t)n_read);
+	}
+	else {
+		// read straight into the string's storage, the file is only copied once
+		as_string = bt_make_string_empty(ctx, (uint32_t)size);
+		n_read = fread(BT_STRING_STR(as_string), 1, size, state->handle);
+
+		// the size is exact for regular files, text mode translation or a shrinking file can still come up short
 		if (n_read != size) {
-			if (!feof(state->handle)) {
-				bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
-			}
-			else {
-				bt_return(thread, BT_VALUE_OBJECT(as_string));
-			}
-		}
-		else {
-			bt_return(thread, BT_VALUE_OBJECT(as_string));
+			as_string = bt_make_string_len(ctx, BT_STRING_STR(as_string), (uint32_t)n_read);
 		}
 	}
+
+	if (n_read != size && !feof(state->handle)) {
+		bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
+	}
 	else {
+		bt_return(thread, BT_VALUE_OBJECT(as_string));
+	}
+}
+
+/** Reads up to and including the next newline into the file's line buffer, returning the length without the line ending or -1 at the end of the file */
+static int64_t btio_read_line_into(bt_Context* ctx, btio_FileState* state)
+{
+	uint32_t length = 0;
+
+	for (;;) {
+		if (state->line_capacity - length < 2) {
+			uint32_t new_capacity = state->line_capacity ? state->line_capacity * 2 : 256;
+			state->line = bt_gc_realloc(ctx, state->line, state->line_capacity, new_capacity);
+			state->line_capacity = new_capacity;
+		}
+
+		char* dest = state->line + length;
+		if (!fgets(dest, state->line_capacity - length, state->handle)) break;
+
+		length += (uint32_t)strlen(dest);
+		if (state->line[length - 1] == '\n') break;
+	}
+
+	if (length == 0) return -1;
+
+	if (state->line[length - 1] == '\n') length--;
+	if (length && state->line[length - 1] == '\r') length--;
+
+	return length;
+}
+
+static void btio_read_line(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* file = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	btio_FileState* state = bt_userdata_get(file);
+
+	if (!state->is_open) {
 		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
+		return;
+	}
+
+	btio_flush_before_read(state);
+
+	int64_t length = btio_read_line_into(ctx, state);
+	if (length < 0) {
+		bt_return(thread, ferror(state->handle) ? boltstd_make_error(ctx, error_to_desc(errno)) : BT_VALUE_NULL);
 	}
+	else {
+		bt_return(thread, BT_VALUE_OBJECT(bt_make_string_len(ctx, state->line, (uint32_t)length)));
+	}
+}
 
-	bt_gc_unpause(ctx);
+static void btio_lines(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Module* module = bt_get_module(thread);
+	bt_push(thread, bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, io_lines_iter_name)));
+	bt_push(thread, bt_arg(thread, 0));
+
+	bt_return(thread, bt_make_closure(thread, 1));
+}
+
+static void btio_lines_iter(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* file = (bt_Userdata*)BT_AS_OBJECT(bt_getup(thread, 0));
+	btio_FileState* state = bt_userdata_get(file);
+
+	if (!state->is_open) {
+		bt_return(thread, BT_VALUE_NULL);
+		return;
+	}
+
+	btio_flush_before_read(state);
+
+	int64_t length = btio_read_line_into(ctx, state);
+	if (length < 0) {
+		bt_return(thread, BT_VALUE_NULL);
+	}
+	else {
+		bt_return(thread, BT_VALUE_OBJECT(bt_make_string_len(ctx, state->line, (uint32_t)length)));
+	}
 }
 
 static void btio_write(bt_Context* ctx, bt_Thread* thread)
@@ -221,18 +387,82 @@ static void btio_write(bt_Context* ctx, bt_Thread* thread)
 	bt_String* content = (bt_String*)BT_AS_OBJECT(bt_arg(thread, 1));
 	btio_FileState* state = bt_userdata_get(file);
 
-	if (state->is_open) {
-		size_t n_written = fwrite(BT_STRING_STR(content), 1, content->len, state->handle);
+	if (!state->is_open) {
+		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
+		return;
+	}
 
-		if (n_written != content->len) {
-			bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
+	if (state->pending_capacity) {
+		if (state->pending_length + content->len > state->pending_capacity) {
+			if (!btio_flush_pending(state)) {
+				bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
+				return;
+			}
 		}
-		else {
+
+		if (content->len <= state->pending_capacity) {
+			memcpy(state->pending + state->pending_length, BT_STRING_STR(content), content->len);
+			state->pending_length += content->len;
 			bt_return(thread, BT_VALUE_NULL);
+			return;
 		}
 	}
+
+	size_t n_written = fwrite(BT_STRING_STR(content), 1, content->len, state->handle);
+	state->unflushed = BT_TRUE;
+
+	if (n_written != content->len) {
+		bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
+	}
 	else {
+		bt_return(thread, BT_VALUE_NULL);
+	}
+}
+
+static void btio_set_write_buffer(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* file = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	bt_number capacity = BT_AS_NUMBER(bt_arg(thread, 1));
+	btio_FileState* state = bt_userdata_get(file);
+
+	if (!(capacity >= 0 && capacity <= INT32_MAX)) {
+		bt_runtime_error(thread, "Write buffer capacity must be between 0 and 2147483647", NULL);
+	}
+
+	if (!state->is_open) {
+		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
+		return;
+	}
+
+	if (!btio_flush_pending(state)) {
+		bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
+		return;
+	}
+
+	uint32_t new_capacity = (uint32_t)capacity;
+	if (state->pending) bt_gc_free(ctx, state->pending, state->pending_capacity);
+	state->pending = new_capacity ? bt_gc_alloc(ctx, new_capacity) : 0;
+	state->pending_capacity = new_capacity;
+
+	bt_return(thread, BT_VALUE_NULL);
+}
+
+static void btio_flush(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* file = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	btio_FileState* state = bt_userdata_get(file);
+
+	if (!state->is_open) {
 		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
+		return;
+	}
+
+	if (!btio_flush_pending(state) || fflush(state->handle) != 0) {
+		bt_return(thread, boltstd_make_error(ctx, error_to_desc(errno)));
+	}
+	else {
+		state->unflushed = BT_FALSE;
+		bt_return(thread, BT_VALUE_NULL);
 	}
 }
 
@@ -242,6 +472,7 @@ static void btio_iseof(bt_Context* ctx, bt_Thread* thread)
 	btio_FileState* state = bt_userdata_get(file);
 
 	if (state->is_open) {
+		btio_flush_pending(state);
 		int32_t result = feof(state->handle);
 		bt_return(thread, bt_make_bool(result != 0));
 	}
@@ -264,6 +495,217 @@ static void btio_delete(bt_Context* ctx, bt_Thread* thread)
 	}
 }
 
+static void btio_unmap_state(btio_MappingState* state)
+{
+#ifdef _WIN32
+	if (state->data) UnmapViewOfFile(state->data);
+	if (state->mapping) CloseHandle(state->mapping);
+	if (state->file != INVALID_HANDLE_VALUE) CloseHandle(state->file);
+	state->mapping = 0;
+	state->file = INVALID_HANDLE_VALUE;
+#else
+	if (state->data) munmap((void*)state->data, (size_t)state->size);
+#endif
+	state->data = 0;
+	state->size = 0;
+	state->is_open = BT_FALSE;
+}
+
+static bt_bool btio_map_state(btio_MappingState* state, const char* path)
+{
+	memset(state, 0, sizeof(btio_MappingState));
+
+#ifdef _WIN32
+	state->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (state->file == INVALID_HANDLE_VALUE) return BT_FALSE;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(state->file, &size)) {
+		btio_unmap_state(state);
+		return BT_FALSE;
+	}
+
+	state->size = (uint64_t)size.QuadPart;
+	state->is_open = BT_TRUE;
+
+	// empty files can't be mapped, they're left as an open mapping without data
+	if (state->size == 0) return BT_TRUE;
+
+	state->mapping = CreateFileMappingA(state->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (state->mapping) state->data = MapViewOfFile(state->mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (!state->data) {
+		btio_unmap_state(state);
+		return BT_FALSE;
+	}
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return BT_FALSE;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return BT_FALSE;
+	}
+
+	state->size = (uint64_t)info.st_size;
+	state->is_open = BT_TRUE;
+
+	if (state->size) {
+		void* data = mmap(NULL, (size_t)state->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			state->is_open = BT_FALSE;
+			return BT_FALSE;
+		}
+
+		// mappings are mostly scanned front to back, let the kernel read ahead aggressively
+		madvise(data, (size_t)state->size, MADV_SEQUENTIAL);
+		state->data = data;
+	}
+
+	// the mapping keeps the file alive on its own
+	close(fd);
+#endif
+
+	return BT_TRUE;
+}
+
+static btio_MappingState* btio_mapping_arg(bt_Thread* thread, bt_Value value)
+{
+	btio_MappingState* state = bt_userdata_get((bt_Userdata*)BT_AS_OBJECT(value));
+	if (!state->is_open) bt_runtime_error(thread, "Mapping already closed", NULL);
+	return state;
+}
+
+static void btio_mapping_finalizer(bt_Context* ctx, bt_Userdata* userdata)
+{
+	btio_MappingState* state = bt_userdata_get(userdata);
+	if (state->is_open) {
+		btio_unmap_state(state);
+	}
+}
+
+static void btio_map(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_String* path = (bt_String*)BT_AS_OBJECT(bt_arg(thread, 0));
+
+	btio_MappingState state;
+	if (btio_map_state(&state, BT_STRING_STR(path))) {
+		bt_Module* module = bt_get_module(thread);
+		bt_Type* mapping_type = (bt_Type*)bt_object(bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, io_mapping_type_name)));
+
+		bt_Userdata* result = bt_make_userdata(ctx, mapping_type, &state, sizeof(btio_MappingState));
+		bt_return(thread, BT_VALUE_OBJECT(result));
+	}
+	else {
+#ifdef _WIN32
+		bt_return(thread, boltstd_make_error(ctx, map_error_reason));
+#else
+		bt_return(thread, boltstd_make_error(ctx, errno ? error_to_desc(errno) : map_error_reason));
+#endif
+	}
+}
+
+static void btio_unmap(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Userdata* mapping = (bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, 0));
+	btio_MappingState* state = bt_userdata_get(mapping);
+
+	if (state->is_open) {
+		btio_unmap_state(state);
+		bt_return(thread, BT_VALUE_NULL);
+	}
+	else {
+		bt_return(thread, boltstd_make_error(ctx, close_error_reason));
+	}
+}
+
+static void btio_mapping_size(bt_Context* ctx, bt_Thread* thread)
+{
+	btio_MappingState* state = btio_mapping_arg(thread, bt_arg(thread, 0));
+	bt_return(thread, BT_VALUE_NUMBER((bt_number)state->size));
+}
+
+static void btio_mapping_slice(bt_Context* ctx, bt_Thread* thread)
+{
+	btio_MappingState* state = btio_mapping_arg(thread, bt_arg(thread, 0));
+	bt_number start = BT_AS_NUMBER(bt_arg(thread, 1));
+	bt_number length = BT_AS_NUMBER(bt_arg(thread, 2));
+
+	if (start < 0 || start > (bt_number)state->size) bt_runtime_error(thread, "Attempted to slice outside of bounds!", NULL);
+	if (length < 0 || length > INT32_MAX || start + length > (bt_number)state->size) bt_runtime_error(thread, "Invalid size for slice!", NULL);
+
+	// only the pages covered by the slice are ever touched
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_string_len(ctx, state->data + (uint64_t)start, (uint32_t)length)));
+}
+
+static void btio_mapping_find(bt_Context* ctx, bt_Thread* thread)
+{
+	btio_MappingState* state = btio_mapping_arg(thread, bt_arg(thread, 0));
+	bt_String* needle = (bt_String*)BT_AS_OBJECT(bt_arg(thread, 1));
+	bt_number start = BT_AS_NUMBER(bt_arg(thread, 2));
+
+	if (start < 0 || start > (bt_number)state->size) bt_runtime_error(thread, "Attempted to search outside of bounds!", NULL);
+
+	const char* needle_str = BT_STRING_STR(needle);
+	uint64_t pos = (uint64_t)start;
+
+	if (needle->len == 0) {
+		bt_return(thread, BT_VALUE_NUMBER((bt_number)pos));
+		return;
+	}
+
+	// memchr for the first character does the bulk of the scanning
+	while (pos + needle->len <= state->size) {
+		const char* found = memchr(state->data + pos, needle_str[0], (size_t)(state->size - pos - needle->len + 1));
+		if (!found) break;
+
+		pos = (uint64_t)(found - state->data);
+		if (memcmp(found, needle_str, needle->len) == 0) {
+			bt_return(thread, BT_VALUE_NUMBER((bt_number)pos));
+			return;
+		}
+
+		pos++;
+	}
+
+	bt_return(thread, BT_VALUE_NUMBER(-1));
+}
+
+static void btio_mapping_lines(bt_Context* ctx, bt_Thread* thread)
+{
+	btio_mapping_arg(thread, bt_arg(thread, 0));
+
+	bt_Module* module = bt_get_module(thread);
+	bt_push(thread, bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, io_mapping_lines_iter_name)));
+	bt_push(thread, bt_arg(thread, 0));
+	bt_push(thread, BT_VALUE_NUMBER(0));
+
+	bt_return(thread, bt_make_closure(thread, 2));
+}
+
+static void btio_mapping_lines_iter(bt_Context* ctx, bt_Thread* thread)
+{
+	btio_MappingState* state = bt_userdata_get((bt_Userdata*)BT_AS_OBJECT(bt_getup(thread, 0)));
+	uint64_t pos = (uint64_t)BT_AS_NUMBER(bt_getup(thread, 1));
+
+	if (!state->is_open || pos >= state->size) {
+		bt_return(thread, BT_VALUE_NULL);
+		return;
+	}
+
+	const char* line = state->data + pos;
+	const char* newline = memchr(line, '\n', (size_t)(state->size - pos));
+	uint64_t length = newline ? (uint64_t)(newline - line) : state->size - pos;
+	bt_setup(thread, 1, BT_VALUE_NUMBER((bt_number)(pos + length + (newline ? 1 : 0))));
+
+	if (length && line[length - 1] == '\r') length--;
+	if (length > INT32_MAX) bt_runtime_error(thread, "Line too long to fit in a string!", NULL);
+
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_string_len(ctx, line, (uint32_t)length)));
+}
+
 void boltstd_open_io(bt_Context* context)
 {
 	bt_Module* module = bt_make_module(context);
@@ -312,5 +754,41 @@ void boltstd_open_io(bt_Context* context)
 	bt_module_export_native(context, module, "is_eof", btio_iseof, boolean, &io_file_type, 1);
 	bt_module_export_native(context, module, "delete", btio_delete, optional_error, &string, 1);
 
+	bt_Type* optional_string = bt_type_make_nullable(context, string);
+	bt_Type* line_or_error_types[] = { optional_string, bt_error_type };
+	bt_Type* line_or_error = bt_make_union_from(context, line_or_error_types, 2);
+	bt_module_export_native(context, module, "read_line", btio_read_line, line_or_error, &io_file_type, 1);
+
+	bt_Type* lines_iter_sig = bt_make_signature_type(context, optional_string, NULL, 0);
+	bt_module_export_native(context, module, "lines", btio_lines, lines_iter_sig, &io_file_type, 1);
+	bt_module_set_storage(module, BT_VALUE_CSTRING(context, io_lines_iter_name),
+		BT_VALUE_OBJECT(bt_make_native(context, module, lines_iter_sig, btio_lines_iter)));
+
+	bt_module_export_native(context, module, "set_write_buffer", btio_set_write_buffer, optional_error, seek_args, 2);
+	bt_module_export_native(context, module, "flush", btio_flush, optional_error, &io_file_type, 1);
+
+	bt_Type* io_mapping_type = bt_make_userdata_type(context, io_mapping_type_name);
+	bt_userdata_type_set_finalizer(io_mapping_type, btio_mapping_finalizer);
+
+	bt_module_export(context, module, bt_make_alias_type(context, io_mapping_type_name, io_mapping_type),
+		BT_VALUE_CSTRING(context, io_mapping_type_name), bt_value((bt_Object*)io_mapping_type));
+	bt_module_set_storage(module, BT_VALUE_CSTRING(context, io_mapping_type_name), bt_value((bt_Object*)io_mapping_type));
+
+	bt_Type* mapping_or_error_types[] = { io_mapping_type, bt_error_type };
+	bt_Type* mapping_or_error = bt_make_union_from(context, mapping_or_error_types, 2);
+	bt_module_export_native(context, module, "map", btio_map, mapping_or_error, &string, 1);
+	bt_module_export_native(context, module, "unmap", btio_unmap, optional_error, &io_mapping_type, 1);
+	bt_module_export_native(context, module, "mapping_size", btio_mapping_size, number, &io_mapping_type, 1);
+
+	bt_Type* slice_args[] = { io_mapping_type, number, number };
+	bt_module_export_native(context, module, "mapping_slice", btio_mapping_slice, string, slice_args, 3);
+
+	bt_Type* find_args[] = { io_mapping_type, string, number };
+	bt_module_export_native(context, module, "mapping_find", btio_mapping_find, number, find_args, 3);
+
+	bt_module_export_native(context, module, "mapping_lines", btio_mapping_lines, lines_iter_sig, &io_mapping_type, 1);
+	bt_module_set_storage(module, BT_VALUE_CSTRING(context, io_mapping_lines_iter_name),
+		BT_VALUE_OBJECT(bt_make_native(context, module, lines_iter_sig, btio_mapping_lines_iter)));
+
 	bt_register_module(context, BT_VALUE_CSTRING(context, "io"), module);
 }
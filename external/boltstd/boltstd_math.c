@@ -31,10 +31,9 @@ static void bt_min(bt_Context* ctx, bt_Thread* thread)
 	bt_return(thread, BT_VALUE_NUMBER(min));
 }
 
-static void bt_random(bt_Context* ctx, bt_Thread* thread)
+static double random_unit(void)
 {
-	double val = (double)rand() / (double)RAND_MAX;
-	bt_return(thread, bt_make_number(val));
+	return (double)rand() / (double)RAND_MAX;
 }
 
 static void bt_random_seed(bt_Context* ctx, bt_Thread* thread)
@@ -46,51 +45,16 @@ static void bt_random_seed(bt_Context* ctx, bt_Thread* thread)
 
 static double deg(double x) { return (x * 180.0) / M_PI; }
 static double rad(double x) { return (x / 180.0) * M_PI; }
-
-#define SIMPLE_OP(name, op)                               \
-static void bt_##name(bt_Context* ctx, bt_Thread* thread) \
-{                                                         \
-	bt_number num = BT_AS_NUMBER(bt_arg(thread, 0));      \
-	bt_return(thread, BT_VALUE_NUMBER(op(num)));          \
-} 
-
-SIMPLE_OP(sqrt, sqrt);
-SIMPLE_OP(abs, fabs);
-SIMPLE_OP(round, round);
-SIMPLE_OP(ceil, ceil);
-SIMPLE_OP(floor, floor);
-SIMPLE_OP(trunc, trunc);
-SIMPLE_OP(sign, signbit);
-
-SIMPLE_OP(sin, sin);
-SIMPLE_OP(cos, cos);
-SIMPLE_OP(tan, tan);
-
-SIMPLE_OP(asin, asin);
-SIMPLE_OP(acos, acos);
-SIMPLE_OP(atan, atan);
-
-SIMPLE_OP(sinh, sinh);
-SIMPLE_OP(cosh, cosh);
-SIMPLE_OP(tanh, tanh);
-
-SIMPLE_OP(asinh, asinh);
-SIMPLE_OP(acosh, acosh);
-SIMPLE_OP(atanh, atanh);
-
-SIMPLE_OP(log, log);
-SIMPLE_OP(log10, log10);
-SIMPLE_OP(log2, log2);
-SIMPLE_OP(exp, exp);
-
-SIMPLE_OP(deg, deg);
-SIMPLE_OP(rad, rad);
+static double sign(double x) { return signbit(x); }
 
 static double imod(double x, double y)
 {
 	return (double)(((uint64_t)x) % ((uint64_t)y));
 }
 
+static double lerp(double a, double b, double t) { return a + (b - a) * t; }
+static double clamp(double x, double lo, double hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
 static void bt_ispow2(bt_Context* ctx, bt_Thread* thread)
 {
 	bt_number num = BT_AS_NUMBER(bt_arg(thread, 0));
@@ -99,19 +63,6 @@ static void bt_ispow2(bt_Context* ctx, bt_Thread* thread)
 	bt_return(thread, BT_VALUE_BOOL(((as_int + 1) & as_int) == 0));
 }
 
-#define COMPLEX_OP(name, op)                              \
-static void bt_##name(bt_Context* ctx, bt_Thread* thread) \
-{                                                         \
-	bt_number num1 = BT_AS_NUMBER(bt_arg(thread, 0));     \
-	bt_number num2 = BT_AS_NUMBER(bt_arg(thread, 1));     \
-	bt_return(thread, BT_VALUE_NUMBER(op(num1, num2)));   \
-} 
-
-COMPLEX_OP(pow, pow);
-COMPLEX_OP(mod, fmod);
-COMPLEX_OP(imod, imod);
-COMPLEX_OP(atan2, atan2);
-
 void boltstd_open_math(bt_Context* context)
 {
 	bt_Module* module = bt_make_module(context);
@@ -134,62 +85,69 @@ void boltstd_open_math(bt_Context* context)
 	bt_module_export(context, module, context->types.number, BT_VALUE_CSTRING(context, "epsilon"), BT_VALUE_NUMBER(DBL_EPSILON));
 
 	bt_Type* double_num_arg[] = { context->types.number, context->types.number };
+	bt_Type* triple_num_arg[] = { context->types.number, context->types.number, context->types.number };
 
 	bt_Type* min_max_sig = bt_make_signature_vararg(context, bt_make_signature_type(context, context->types.number, &context->types.number, 1), context->types.number);
 
 	bt_module_export(context, module, min_max_sig, BT_VALUE_CSTRING(context, "min"), BT_VALUE_OBJECT(bt_make_native(context, module, min_max_sig, bt_min)));
 	bt_module_export(context, module, min_max_sig, BT_VALUE_CSTRING(context, "max"), BT_VALUE_OBJECT(bt_make_native(context, module, min_max_sig, bt_max)));
 
+	bt_Type* to_num_sig = bt_make_signature_type(context, context->types.number, NULL, 0);
 	bt_Type* num_to_num_sig = bt_make_signature_type(context, context->types.number, &context->types.number, 1);
 	bt_Type* two_num_to_num_sig = bt_make_signature_type(context, context->types.number, double_num_arg, 2);
+	bt_Type* three_num_to_num_sig = bt_make_signature_type(context, context->types.number, triple_num_arg, 3);
+
+#define IMPL_DIRECT(name, sig, kind, field, op) \
+bt_module_export(context, module, sig, BT_VALUE_CSTRING(context, #name), BT_VALUE_OBJECT(bt_make_native_direct(context, module, sig, kind, (bt_DirectProc){ .field = op })));
 
-#define IMPL_SIMPLE_OP(name) \
-bt_module_export(context, module, num_to_num_sig, BT_VALUE_CSTRING(context, #name), BT_VALUE_OBJECT(bt_make_native(context, module, num_to_num_sig, bt_##name)));
+#define IMPL_SIMPLE_OP(name, op) IMPL_DIRECT(name, num_to_num_sig, BT_DIRECT_NUM_1, num_1, op)
+#define IMPL_COMPLEX_OP(name, op) IMPL_DIRECT(name, two_num_to_num_sig, BT_DIRECT_NUM_2, num_2, op)
+#define IMPL_TERNARY_OP(name, op) IMPL_DIRECT(name, three_num_to_num_sig, BT_DIRECT_NUM_3, num_3, op)
 
-#define IMPL_COMPLEX_OP(name) \
-bt_module_export(context, module, two_num_to_num_sig, BT_VALUE_CSTRING(context, #name), BT_VALUE_OBJECT(bt_make_native(context, module, two_num_to_num_sig, bt_##name)));
+	IMPL_SIMPLE_OP(sqrt, sqrt);
+	IMPL_SIMPLE_OP(abs, fabs);
+	IMPL_SIMPLE_OP(round, round);
+	IMPL_SIMPLE_OP(ceil, ceil);
+	IMPL_SIMPLE_OP(floor, floor);
+	IMPL_SIMPLE_OP(trunc, trunc);
+	IMPL_SIMPLE_OP(sign, sign);
 
-	IMPL_SIMPLE_OP(sqrt);
-	IMPL_SIMPLE_OP(abs);
-	IMPL_SIMPLE_OP(round);
-	IMPL_SIMPLE_OP(ceil);
-	IMPL_SIMPLE_OP(floor);
-	IMPL_SIMPLE_OP(trunc);
-	IMPL_SIMPLE_OP(sign);
+	IMPL_SIMPLE_OP(sin, sin);
+	IMPL_SIMPLE_OP(cos, cos);
+	IMPL_SIMPLE_OP(tan, tan);
 
-	IMPL_SIMPLE_OP(sin);
-	IMPL_SIMPLE_OP(cos);
-	IMPL_SIMPLE_OP(tan);
+	IMPL_SIMPLE_OP(asin, asin);
+	IMPL_SIMPLE_OP(acos, acos);
+	IMPL_SIMPLE_OP(atan, atan);
 
-	IMPL_SIMPLE_OP(asin);
-	IMPL_SIMPLE_OP(acos);
-	IMPL_SIMPLE_OP(atan);
+	IMPL_SIMPLE_OP(sinh, sinh);
+	IMPL_SIMPLE_OP(cosh, cosh);
+	IMPL_SIMPLE_OP(tanh, tanh);
 
-	IMPL_SIMPLE_OP(sinh);
-	IMPL_SIMPLE_OP(cosh);
-	IMPL_SIMPLE_OP(tanh);
+	IMPL_SIMPLE_OP(asinh, asinh);
+	IMPL_SIMPLE_OP(acosh, acosh);
+	IMPL_SIMPLE_OP(atanh, atanh);
 
-	IMPL_SIMPLE_OP(asinh);
-	IMPL_SIMPLE_OP(acosh);
-	IMPL_SIMPLE_OP(atanh);
+	IMPL_SIMPLE_OP(log, log);
+	IMPL_SIMPLE_OP(log10, log10);
+	IMPL_SIMPLE_OP(log2, log2);
+	IMPL_SIMPLE_OP(exp, exp);
 
-	IMPL_SIMPLE_OP(log);
-	IMPL_SIMPLE_OP(log10);
-	IMPL_SIMPLE_OP(log2);
-	IMPL_SIMPLE_OP(exp);
+	IMPL_SIMPLE_OP(deg, deg);
+	IMPL_SIMPLE_OP(rad, rad);
 
-	IMPL_SIMPLE_OP(deg);
-	IMPL_SIMPLE_OP(rad);
+	IMPL_COMPLEX_OP(pow, pow);
+	IMPL_COMPLEX_OP(mod, fmod);
+	IMPL_COMPLEX_OP(imod, imod);
+	IMPL_COMPLEX_OP(atan2, atan2);
 
-	IMPL_COMPLEX_OP(pow);
-	IMPL_COMPLEX_OP(mod);
-	IMPL_COMPLEX_OP(imod);
-	IMPL_COMPLEX_OP(atan2);
+	IMPL_TERNARY_OP(lerp, lerp);
+	IMPL_TERNARY_OP(clamp, clamp);
 
 	bt_module_export_native(context, module, "ispow2", bt_ispow2, context->types.boolean, &context->types.number, 1);
 	
 	bt_module_export_native(context, module, "random_seed", bt_random_seed, NULL, &context->types.number, 1); 
-	bt_module_export_native(context, module, "random", bt_random, context->types.number, NULL, 0); 
+	IMPL_DIRECT(random, to_num_sig, BT_DIRECT_NUM_0, num_0, random_unit);
 
 	bt_register_module(context, BT_VALUE_CSTRING(context, "math"), module);
 }
\ No newline at end of file
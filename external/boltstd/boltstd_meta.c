@@ -8,6 +8,19 @@ static const char* annotation_type_name = "Annotation";
 static const char* annotation_name_key_name = "name";
 static const char* annotation_args_key_name = "args";
 
+static const char* intern_stats_type_name = "InternStats";
+static const char* intern_stats_entries_key_name = "entries";
+static const char* intern_stats_capacity_key_name = "capacity";
+static const char* intern_stats_avg_probe_key_name = "avg_probe";
+static const char* intern_stats_max_probe_key_name = "max_probe";
+
+static const char* pool_stats_type_name = "PoolStats";
+static const char* pool_stats_size_key_name = "size";
+static const char* pool_stats_pages_key_name = "pages";
+static const char* pool_stats_live_key_name = "live";
+static const char* pool_stats_free_key_name = "free";
+static const char* pool_stats_allocations_key_name = "allocations";
+
 static void btstd_gc(bt_Context* ctx, bt_Thread* thread)
 {
 	uint32_t n_collected = bt_collect(&ctx->gc, 0);
@@ -24,6 +37,45 @@ static void btstd_nextcycle(bt_Context* ctx, bt_Thread* thread)
 	bt_return(thread, bt_make_number((bt_number)ctx->gc.next_cycle));
 }
 
+static void btstd_intern_stats(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Module* module = bt_get_module(thread);
+	bt_Type* stats_type = (bt_Type*)bt_object(bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, intern_stats_type_name)));
+
+	bt_StringTableStats stats = bt_get_string_table_stats(ctx);
+
+	bt_Table* result = bt_make_table_from_proto(ctx, stats_type);
+	bt_return(thread, BT_VALUE_OBJECT(result));
+
+	bt_table_set(ctx, result, BT_VALUE_CSTRING(ctx, intern_stats_entries_key_name), bt_make_number(stats.entries));
+	bt_table_set(ctx, result, BT_VALUE_CSTRING(ctx, intern_stats_capacity_key_name), bt_make_number(stats.capacity));
+	bt_table_set(ctx, result, BT_VALUE_CSTRING(ctx, intern_stats_avg_probe_key_name), bt_make_number(stats.avg_probe));
+	bt_table_set(ctx, result, BT_VALUE_CSTRING(ctx, intern_stats_max_probe_key_name), bt_make_number(stats.max_probe));
+}
+
+static void btstd_pool_stats(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Module* module = bt_get_module(thread);
+	bt_Type* stats_type = (bt_Type*)bt_object(bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, pool_stats_type_name)));
+
+	bt_PoolClassStats stats[BT_POOL_CLASS_COUNT];
+	uint32_t count = bt_pool_get_stats(ctx, stats, BT_POOL_CLASS_COUNT);
+
+	bt_Array* result = bt_make_array(ctx, count);
+	bt_return(thread, BT_VALUE_OBJECT(result));
+
+	for (uint32_t i = 0; i < count; ++i) {
+		bt_Table* entry = bt_make_table_from_proto(ctx, stats_type);
+		bt_array_push(ctx, result, BT_VALUE_OBJECT(entry));
+
+		bt_table_set(ctx, entry, BT_VALUE_CSTRING(ctx, pool_stats_size_key_name), bt_make_number(stats[i].object_size));
+		bt_table_set(ctx, entry, BT_VALUE_CSTRING(ctx, pool_stats_pages_key_name), bt_make_number(stats[i].pages));
+		bt_table_set(ctx, entry, BT_VALUE_CSTRING(ctx, pool_stats_live_key_name), bt_make_number(stats[i].live_objects));
+		bt_table_set(ctx, entry, BT_VALUE_CSTRING(ctx, pool_stats_free_key_name), bt_make_number(stats[i].free_slots));
+		bt_table_set(ctx, entry, BT_VALUE_CSTRING(ctx, pool_stats_allocations_key_name), bt_make_number((bt_number)stats[i].allocations));
+	}
+}
+
 static void btstd_grey(bt_Context* ctx, bt_Thread* thread)
 {
 	if (!BT_IS_OBJECT(bt_arg(thread, 0))) return;
@@ -207,15 +259,33 @@ void boltstd_open_meta(bt_Context* context)
 	bt_tableshape_add_layout(context, annotation_type, bt_type_string(context), BT_VALUE_CSTRING(context, annotation_name_key_name), bt_type_string(context));
 	bt_tableshape_add_layout(context, annotation_type, bt_type_string(context), BT_VALUE_CSTRING(context, annotation_args_key_name), bt_make_array_type(context, any));
 	bt_module_set_storage(module, BT_VALUE_CSTRING(context, annotation_type_name), bt_value((bt_Object*)annotation_type));
+
+	bt_Type* intern_stats_type = bt_make_tableshape_type(context, intern_stats_type_name, BT_TRUE);
+	bt_tableshape_add_layout(context, intern_stats_type, string, BT_VALUE_CSTRING(context, intern_stats_entries_key_name), number);
+	bt_tableshape_add_layout(context, intern_stats_type, string, BT_VALUE_CSTRING(context, intern_stats_capacity_key_name), number);
+	bt_tableshape_add_layout(context, intern_stats_type, string, BT_VALUE_CSTRING(context, intern_stats_avg_probe_key_name), number);
+	bt_tableshape_add_layout(context, intern_stats_type, string, BT_VALUE_CSTRING(context, intern_stats_max_probe_key_name), number);
+	bt_module_set_storage(module, BT_VALUE_CSTRING(context, intern_stats_type_name), bt_value((bt_Object*)intern_stats_type));
+
+	bt_Type* pool_stats_type = bt_make_tableshape_type(context, pool_stats_type_name, BT_TRUE);
+	bt_tableshape_add_layout(context, pool_stats_type, string, BT_VALUE_CSTRING(context, pool_stats_size_key_name), number);
+	bt_tableshape_add_layout(context, pool_stats_type, string, BT_VALUE_CSTRING(context, pool_stats_pages_key_name), number);
+	bt_tableshape_add_layout(context, pool_stats_type, string, BT_VALUE_CSTRING(context, pool_stats_live_key_name), number);
+	bt_tableshape_add_layout(context, pool_stats_type, string, BT_VALUE_CSTRING(context, pool_stats_free_key_name), number);
+	bt_tableshape_add_layout(context, pool_stats_type, string, BT_VALUE_CSTRING(context, pool_stats_allocations_key_name), number);
+	bt_module_set_storage(module, BT_VALUE_CSTRING(context, pool_stats_type_name), bt_value((bt_Object*)pool_stats_type));
 	
 	bt_module_export(context, module, number, BT_VALUE_CSTRING(context, "stack_size"),     bt_make_number(BT_STACK_SIZE));
 	bt_module_export(context, module, number, BT_VALUE_CSTRING(context, "callstack_size"), bt_make_number(BT_CALLSTACK_SIZE));
 	bt_module_export(context, module, string, BT_VALUE_CSTRING(context, "version"),        bt_value((bt_Object*)bt_make_string(context, BOLT_VERSION)));
 	bt_module_export(context, module, type,   BT_VALUE_CSTRING(context, "Annotation"),     bt_value((bt_Object*)annotation_type));
+	bt_module_export(context, module, type,   BT_VALUE_CSTRING(context, "InternStats"),    bt_value((bt_Object*)intern_stats_type));
+	bt_module_export(context, module, type,   BT_VALUE_CSTRING(context, "PoolStats"),      bt_value((bt_Object*)pool_stats_type));
 	
 	bt_Type* findtype_ret = bt_type_make_nullable(context, type);
 	bt_Type* findmodule_ret = bt_type_make_nullable(context, bt_type_table(context));
 	bt_Type* annotation_arr = bt_make_array_type(context, annotation_type);
+	bt_Type* pool_stats_arr = bt_make_array_type(context, pool_stats_type);
 	
 	bt_Type* regtype_args[]         = { string, type };
 	bt_Type* getenumname_args[]     = { type,   any };
@@ -230,6 +300,8 @@ void boltstd_open_meta(bt_Context* context)
 	bt_module_export_native(context, module, "remove_reference",  btstd_remove_reference,      number,         &any,                 1);
 	bt_module_export_native(context, module, "mem_size",          btstd_memsize,               number,         NULL,                 0);
 	bt_module_export_native(context, module, "next_cycle",        btstd_nextcycle,             number,         NULL,                 0);
+	bt_module_export_native(context, module, "intern_stats",      btstd_intern_stats,          intern_stats_type, NULL,            0);
+	bt_module_export_native(context, module, "pool_stats",        btstd_pool_stats,            pool_stats_arr, NULL,                 0);
 	bt_module_export_native(context, module, "register_type",     btstd_register_type,         NULL,           regtype_args,         2);
 	bt_module_export_native(context, module, "find_type",         btstd_find_type,             findtype_ret,   &string,              1);
 	bt_module_export_native(context, module, "get_enum_name",     btstd_get_enum_name,         string,         getenumname_args,     2);
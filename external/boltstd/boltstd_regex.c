@@ -6,7 +6,12 @@
 
 #include "../bt_embedding.h"
 
+#include <string.h>
+
+#define BTREGEX_CACHE_SIZE 32
+
 static const char* regex_type_name = "Regex";
+static const char* regex_cache_name = "$_cache";
 
 typedef struct btregex_Regex {
     pm_Regex* regex;
@@ -14,10 +19,74 @@ typedef struct btregex_Regex {
     size_t group_count, regex_size;
 } btregex_Regex;
 
+/** Recently compiled expressions keyed by their source, the least recently used one is evicted once full */
+typedef struct btregex_Cache {
+    bt_String* sources[BTREGEX_CACHE_SIZE];
+    bt_Userdata* regexes[BTREGEX_CACHE_SIZE];
+    uint64_t last_used[BTREGEX_CACHE_SIZE];
+    uint64_t clock;
+    uint32_t count;
+} btregex_Cache;
+
+static void btregex_cache_tracer(bt_Context* ctx, bt_Userdata* userdata)
+{
+    btregex_Cache* cache = bt_userdata_get(userdata);
+    for (uint32_t i = 0; i < cache->count; ++i) {
+        bt_grey_obj(ctx, (bt_Object*)cache->sources[i]);
+        bt_grey_obj(ctx, (bt_Object*)cache->regexes[i]);
+    }
+}
+
+static bt_Userdata* btregex_cache_find(btregex_Cache* cache, bt_String* source)
+{
+    for (uint32_t i = 0; i < cache->count; ++i) {
+        bt_String* cached = cache->sources[i];
+        // short sources are interned, so most hits are found by identity
+        if (cached == source || (cached->len == source->len && memcmp(BT_STRING_STR(cached), BT_STRING_STR(source), source->len) == 0)) {
+            cache->last_used[i] = ++cache->clock;
+            return cache->regexes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void btregex_cache_insert(bt_Context* ctx, btregex_Cache* cache, bt_String* source, bt_Userdata* regex)
+{
+    uint32_t slot = cache->count;
+    if (slot == BTREGEX_CACHE_SIZE) {
+        slot = 0;
+        for (uint32_t i = 1; i < cache->count; ++i) {
+            if (cache->last_used[i] < cache->last_used[slot]) slot = i;
+        }
+    }
+    else {
+        cache->count++;
+    }
+
+    cache->sources[slot] = source;
+    cache->regexes[slot] = regex;
+    cache->last_used[slot] = ++cache->clock;
+
+    BT_GC_BARRIER(ctx, BT_VALUE_OBJECT(source));
+    BT_GC_BARRIER(ctx, BT_VALUE_OBJECT(regex));
+}
+
 static void btregex_compile(bt_Context* ctx, bt_Thread* thread)
 {
     bt_String* source = (bt_String*)bt_object(bt_arg(thread, 0));
 
+    bt_Module* module = bt_get_module(thread);
+    bt_Userdata* cache_ref = (bt_Userdata*)bt_object(bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, regex_cache_name)));
+    btregex_Cache* cache = bt_userdata_get(cache_ref);
+
+    // regexes are immutable once compiled, so repeated compiles of the same source can share one
+    bt_Userdata* cached = btregex_cache_find(cache, source);
+    if (cached) {
+        bt_return(thread, BT_VALUE_OBJECT(cached));
+        return;
+    }
+
     const char* err = NULL;
     int size = pm_expsize(bt_string_get(source), &err);
     if (size == 0) {
@@ -40,10 +109,11 @@ static void btregex_compile(bt_Context* ctx, bt_Thread* thread)
     wrapped.group_count = pm_getgroups(result);
     wrapped.regex_size = size;
 
-    bt_Module* module = bt_get_module(thread);
     bt_Type* regex_type = (bt_Type*)bt_object(bt_module_get_storage(module, BT_VALUE_CSTRING(ctx, regex_type_name)));
-    
-    bt_return(thread, bt_value((bt_Object*)bt_make_userdata(ctx, regex_type, &wrapped, sizeof(btregex_Regex))));
+    bt_Userdata* compiled = bt_make_userdata(ctx, regex_type, &wrapped, sizeof(btregex_Regex));
+    btregex_cache_insert(ctx, cache, source, compiled);
+
+    bt_return(thread, bt_value((bt_Object*)compiled));
 }
 
 static void btregex_regex_finalizer(bt_Context* ctx, bt_Userdata* userdata)
@@ -92,14 +162,14 @@ static void btregex_match(bt_Context* ctx, bt_Thread* thread)
     bt_return(thread, bt_make_null());
 }
 
-static bt_Value bt_regex_all_iter_fn;
-
 static void btregex_all(bt_Context* ctx, bt_Thread* thread)
 {
     bt_Value regex = bt_arg(thread, 0);
     bt_Value pattern = bt_arg(thread, 1);
     
-    bt_push(thread, bt_regex_all_iter_fn);
+    // looked up per call, every context has its own iterator
+    bt_Type* regex_type = ((bt_Userdata*)BT_AS_OBJECT(regex))->type;
+    bt_push(thread, bt_table_get(regex_type->prototype_values, BT_VALUE_CSTRING(ctx, "$_all_iter")));
     bt_push(thread, regex);
     bt_push(thread, pattern);
     bt_push(thread, bt_make_number(0));
@@ -142,6 +212,13 @@ void boltstd_open_regex(bt_Context* context)
     bt_module_export(context, module, bt_type_type(context), BT_VALUE_CSTRING(context, regex_type_name), BT_VALUE_OBJECT(regex_type));
     bt_module_set_storage(module, BT_VALUE_CSTRING(context, regex_type_name), bt_value((bt_Object*)regex_type));
 
+    bt_Type* cache_type = bt_make_userdata_type(context, "RegexCache");
+    bt_userdata_type_set_tracer(cache_type, btregex_cache_tracer);
+    btregex_Cache cache;
+    memset(&cache, 0, sizeof(cache));
+    bt_Userdata* cache_ref = bt_make_userdata(context, cache_type, &cache, sizeof(btregex_Cache));
+    bt_module_set_storage(module, BT_VALUE_CSTRING(context, regex_cache_name), BT_VALUE_OBJECT(cache_ref));
+
     bt_Type* string = bt_type_string(context);
     bt_Type* number = bt_type_number(context);
 
@@ -170,8 +247,8 @@ void boltstd_open_regex(bt_Context* context)
     bt_module_export(context, module, match_sig, BT_VALUE_CSTRING(context, "eval"), BT_VALUE_OBJECT(match_ref));
 
     bt_Type* all_iter_sig = bt_make_signature_type(context, match_return, NULL, 0);
-    bt_regex_all_iter_fn = bt_value((bt_Object*)bt_make_native(context, module, all_iter_sig, bt_regex_all_iter));
-    bt_type_add_field(context, regex_type, all_iter_sig, BT_VALUE_CSTRING(context, "$_all_iter"), bt_regex_all_iter_fn);
+    bt_Value all_iter_ref = bt_value((bt_Object*)bt_make_native(context, module, all_iter_sig, bt_regex_all_iter));
+    bt_type_add_field(context, regex_type, all_iter_sig, BT_VALUE_CSTRING(context, "$_all_iter"), all_iter_ref);
     
     bt_Type* all_sig = bt_make_signature_type(context, all_iter_sig, match_args, 2);
     bt_NativeFn* all_ref = bt_make_native(context, module, all_sig, btregex_all);
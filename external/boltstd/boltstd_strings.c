@@ -1,6 +1,8 @@
 #include "boltstd_strings.h"
 
 #include "../bt_embedding.h"
+#include "../bt_userdata.h"
+#include "../bt_gc.h"
 
 #include <memory.h>
 #include <string.h>
@@ -39,25 +41,8 @@ static void bt_str_remainder(bt_Context* ctx, bt_Thread* thread)
 
 static void bt_strings_concat(bt_Context* ctx, bt_Thread* thread)
 {
-	uint8_t argc = bt_argc(thread);
-
-	uint32_t total_len = 0;
-	for (uint8_t i = 0; i < argc; i++) {
-		bt_String* str = (bt_String*)bt_object(bt_arg(thread, i));
-		total_len += str->len;
-	}
-
-	bt_String* result = bt_make_string_empty(ctx, total_len);
-
-	uint32_t progress = 0;
-	for (uint8_t i = 0; i < argc; i++) {
-		bt_String* str = (bt_String*)bt_object(bt_arg(thread, i));
-		memcpy(BT_STRING_STR(result) + progress, BT_STRING_STR(str), str->len);
-		progress += str->len;
-	}
-
-	BT_STRING_STR(result)[total_len] = 0;
-
+	// arguments are laid out contiguously on the stack
+	bt_String* result = bt_string_concat_many(ctx, thread->stack + thread->top, bt_argc(thread));
 	bt_return(thread, BT_VALUE_OBJECT(result));
 }
 
@@ -65,11 +50,15 @@ typedef bt_Buffer(char) bt_StringBuffer;
 
 static void push_string(bt_Context* ctx, bt_StringBuffer* output, const char* cstr, size_t len)
 {
-	bt_buffer_reserve(output, ctx, output->length + len);
-
-	for (uint32_t i = 0; i < len; i++) {
-		bt_buffer_push(ctx, output, cstr[i]);
+	// grow geometrically, builders append to the same buffer over and over
+	if (output->length + len > output->capacity) {
+		size_t capacity = output->capacity ? output->capacity * 2 : 32;
+		while (capacity < output->length + len) capacity *= 2;
+		bt_buffer_reserve(output, ctx, capacity);
 	}
+
+	memcpy(output->elements + output->length, cstr, len);
+	output->length += (uint32_t)len;
 }
 
 static void sprint_invalid(bt_Context* ctx, bt_StringBuffer* output) 
@@ -117,17 +106,11 @@ static void sprint_string(bt_Context* ctx, bt_StringBuffer* output, bt_Value val
 	push_string(ctx, output, BT_STRING_STR(as_str), as_str->len);
 }
 
-static void bt_string_format(bt_Context* ctx, bt_Thread* thread)
+// Appends `format` to `output`, filling in its specifiers with the arguments from `current_arg` on
+static void format_into(bt_Context* ctx, bt_Thread* thread, bt_StringBuffer* output, bt_String* format, uint8_t current_arg)
 {
 	uint8_t argc = bt_argc(thread);
 
-	bt_String* format = (bt_String*)bt_object(bt_arg(thread, 0));
-
-	bt_StringBuffer output;
-	bt_buffer_empty(&output);
-
-	uint8_t current_arg = 1;
-
 	char* current_format = BT_STRING_STR(format);
 	while (*current_format) {
 		if (*current_format == '%') {
@@ -136,32 +119,39 @@ static void bt_string_format(bt_Context* ctx, bt_Thread* thread)
 
 			switch (specifier) {
 			case '%':
-				bt_buffer_push(ctx, &output, '%');
+				push_string(ctx, output, "%", 1);
 				break;
 			case 'd': case 'i':
-				sprint_uint64_t(ctx, &output, current_arg < argc ? bt_arg(thread, current_arg++) : BT_VALUE_NULL);
+				sprint_uint64_t(ctx, output, current_arg < argc ? bt_arg(thread, current_arg++) : BT_VALUE_NULL);
 				break;
 			case 'f':
-				sprint_float(ctx, &output, current_arg < argc ? bt_arg(thread, current_arg++) : BT_VALUE_NULL);
+				sprint_float(ctx, output, current_arg < argc ? bt_arg(thread, current_arg++) : BT_VALUE_NULL);
 				break;
 			case 's': case 'v':
-				sprint_string(ctx, &output, current_arg < argc ? bt_arg(thread, current_arg++) : BT_VALUE_NULL);
+				sprint_string(ctx, output, current_arg < argc ? bt_arg(thread, current_arg++) : BT_VALUE_NULL);
 				break;
 			default:
-				sptint_unknown_specifier(ctx, &output);
+				sptint_unknown_specifier(ctx, output);
 				break;
 			}
 		}
 		else {
-			bt_buffer_push(ctx, &output, *current_format);
-			current_format++;
+			const char* run = current_format;
+			while (*current_format && *current_format != '%') current_format++;
+			push_string(ctx, output, run, current_format - run);
 		}
 	}
+}
+
+static void bt_string_format(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_StringBuffer output;
+	bt_buffer_empty(&output);
 
-	bt_buffer_push(ctx, &output, '\0');
+	format_into(ctx, thread, &output, (bt_String*)bt_object(bt_arg(thread, 0)), 1);
 
-	bt_String* result = bt_make_string_len(ctx, output.elements, output.length);
-	bt_buffer_destroy(ctx, &output);
+	bt_String* result = bt_make_string_len(ctx, output.length ? output.elements : "", output.length);
+	if (output.capacity) bt_gc_free(ctx, output.elements, output.capacity);
 
 	bt_return(thread, BT_VALUE_OBJECT(result));
 }
@@ -324,6 +314,110 @@ static void bt_string_compare_at(bt_Context* ctx, bt_Thread* thread) {
 	bt_return(thread, bt_make_bool(strncmp(bt_string_get(self) + idx, bt_string_get(arg), bt_string_length(arg)) == 0));
 }
 
+// StringBuilder accumulates text in a growable buffer outside of the managed heap and only makes a string when asked,
+// so building text piece by piece copies every byte a constant number of times instead of once per append
+typedef struct bt_StringBuilder {
+	bt_StringBuffer buffer;
+} bt_StringBuilder;
+
+static bt_StringBuilder* bt_sb_arg(bt_Thread* thread)
+{
+	return (bt_StringBuilder*)bt_userdata_get((bt_Userdata*)bt_object(bt_arg(thread, 0)));
+}
+
+static void bt_sb_finalizer(bt_Context* ctx, bt_Userdata* userdata)
+{
+	bt_StringBuilder* builder = (bt_StringBuilder*)bt_userdata_get(userdata);
+	if (builder->buffer.capacity) bt_gc_free(ctx, builder->buffer.elements, builder->buffer.capacity);
+}
+
+static void bt_sb_make(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Type* type = (bt_Type*)bt_object(bt_table_get(ctx->types.string->prototype_values, BT_VALUE_CSTRING(ctx, "$_builder")));
+
+	bt_StringBuilder builder;
+	bt_buffer_empty(&builder.buffer);
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_userdata(ctx, type, &builder, sizeof(builder))));
+}
+
+static void bt_sb_append(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_StringBuilder* builder = bt_sb_arg(thread);
+	bt_Value value = bt_arg(thread, 1);
+
+	if (BT_IS_OBJECT(value) && BT_OBJECT_GET_TYPE(BT_AS_OBJECT(value)) == BT_OBJECT_TYPE_STRING) {
+		bt_String* str = (bt_String*)BT_AS_OBJECT(value);
+		push_string(ctx, &builder->buffer, BT_STRING_STR(str), str->len);
+	}
+	else if (!BT_IS_OBJECT(value)) {
+		// numbers, bools and null are printed straight into the buffer without an intermediate string
+		char buf[512];
+		int32_t len = bt_to_string_inplace(ctx, buf, sizeof(buf), value);
+		push_string(ctx, &builder->buffer, buf, len);
+	}
+	else {
+		sprint_string(ctx, &builder->buffer, value);
+	}
+
+	bt_return(thread, bt_arg(thread, 0));
+}
+
+static void bt_sb_append_format(bt_Context* ctx, bt_Thread* thread)
+{
+	format_into(ctx, thread, &bt_sb_arg(thread)->buffer, (bt_String*)bt_object(bt_arg(thread, 1)), 2);
+	bt_return(thread, bt_arg(thread, 0));
+}
+
+static void bt_sb_length(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_return(thread, BT_VALUE_NUMBER(bt_sb_arg(thread)->buffer.length));
+}
+
+static void bt_sb_clear(bt_Context* ctx, bt_Thread* thread)
+{
+	// keeps the capacity around, builders are usually reused for text of similar size
+	bt_sb_arg(thread)->buffer.length = 0;
+}
+
+static void bt_sb_to_string(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_StringBuilder* builder = bt_sb_arg(thread);
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_string_len(ctx, builder->buffer.length ? builder->buffer.elements : "", builder->buffer.length)));
+}
+
+static void add_builder_method(bt_Context* ctx, bt_Module* module, bt_Type* builder, const char* name, bt_Type* sig, bt_NativeProc proc)
+{
+	bt_NativeFn* fn_ref = bt_make_native(ctx, module, sig, proc);
+	bt_type_add_field(ctx, builder, sig, BT_VALUE_CSTRING(ctx, name), BT_VALUE_OBJECT(fn_ref));
+}
+
+static void open_builder(bt_Context* ctx, bt_Module* module)
+{
+	bt_Type* string = bt_type_string(ctx);
+	bt_Type* number = bt_type_number(ctx);
+	bt_Type* any = bt_type_any(ctx);
+
+	bt_Type* builder = bt_make_userdata_type(ctx, "StringBuilder");
+	bt_userdata_type_set_finalizer(builder, bt_sb_finalizer);
+	bt_type_add_field(ctx, string, bt_type_type(ctx), BT_VALUE_CSTRING(ctx, "$_builder"), BT_VALUE_OBJECT(builder));
+	bt_module_export(ctx, module, bt_type_type(ctx), BT_VALUE_CSTRING(ctx, "StringBuilder"), BT_VALUE_OBJECT(builder));
+
+	bt_Type* make_sig = bt_make_signature_type(ctx, builder, NULL, 0);
+	bt_NativeFn* fn_ref = bt_make_native(ctx, module, make_sig, bt_sb_make);
+	bt_module_export(ctx, module, make_sig, BT_VALUE_CSTRING(ctx, "builder"), BT_VALUE_OBJECT(fn_ref));
+
+	bt_Type* append_args[] = { builder, any };
+	add_builder_method(ctx, module, builder, "append", bt_make_signature_type(ctx, builder, append_args, 2), bt_sb_append);
+
+	bt_Type* format_args[] = { builder, string };
+	bt_Type* format_sig = bt_make_signature_vararg(ctx, bt_make_signature_type(ctx, builder, format_args, 2), any);
+	add_builder_method(ctx, module, builder, "append_format", format_sig, bt_sb_append_format);
+
+	add_builder_method(ctx, module, builder, "length", bt_make_signature_type(ctx, number, &builder, 1), bt_sb_length);
+	add_builder_method(ctx, module, builder, "clear", bt_make_signature_type(ctx, NULL, &builder, 1), bt_sb_clear);
+	add_builder_method(ctx, module, builder, "to_string", bt_make_signature_type(ctx, string, &builder, 1), bt_sb_to_string);
+}
+
 void boltstd_open_strings(bt_Context* context)
 {
 	bt_Module* module = bt_make_module(context);
@@ -418,5 +512,7 @@ void boltstd_open_strings(bt_Context* context)
 	bt_type_add_field(context, string, compare_at_sig, BT_VALUE_CSTRING(context, "compare_at"), BT_VALUE_OBJECT(fn_ref));
 	bt_module_export(context, module, compare_at_sig, BT_VALUE_CSTRING(context, "compare_at"), BT_VALUE_OBJECT(fn_ref));
 	
+	open_builder(context, module);
+
 	bt_register_module(context, BT_VALUE_CSTRING(context, "strings"), module);
 }
\ No newline at end of file
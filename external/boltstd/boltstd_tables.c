@@ -45,7 +45,7 @@ static void bt_table_pairs(bt_Context* ctx, bt_Thread* thread)
 static void bt_table_pairs_iter(bt_Context* ctx, bt_Thread* thread)
 {
 	bt_Table* tbl = (bt_Table*)BT_AS_OBJECT(bt_getup(thread, 0));
-	uint16_t idx = (uint16_t)BT_AS_NUMBER(bt_getup(thread, 1));
+	uint32_t idx = (uint32_t)BT_AS_NUMBER(bt_getup(thread, 1));
 
 	if (idx >= tbl->length) {
 		bt_return(thread, BT_VALUE_NULL);
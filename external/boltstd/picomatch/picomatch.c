@@ -333,6 +333,7 @@ static int compile_internal(pm_Regex* result, const char** source, int in_block,
         switch (ch) {
         case '\0':
             (*source)--;
+            if (!emit_branch_end(result, branch_fix, measure)) return 0;
             return 1;
         case '^':
             if (!emit_op(result, OP_MATCHBOL, measure)) return 0;
@@ -454,6 +455,118 @@ static int compile_body(pm_Regex* result, const char* source, int measure) {
     return 1;
 }
 
+static int matches_class(const char* source, char class, int* consume);
+static int matches_set(const unsigned char* op, const char* source);
+
+/**
+ * Finds the longest literal on the top level of the expression. Every match has to contain it,
+ * so subjects without it can be rejected with a single scan.
+ */
+static void find_required_literal(pm_Regex* expr) {
+    int pc = 0;
+
+    while (pc < expr->size) {
+        unsigned char* op = CODE_BASE(expr) + pc;
+        switch (*op) {
+        case OP_OPENGROUP:
+        case OP_CLOSEGROUP:
+        case ARG_CLASS:
+            pc += 2;
+            break;
+        case OP_MATCHBOL:
+        case OP_MATCHEOL:
+        case OP_MATCHANY:
+            pc++;
+            break;
+        case OP_MATCHEXACT:
+            if (*(op + 1) > expr->required_length) {
+                expr->required_start = pc + 2;
+                expr->required_length = *(op + 1);
+            }
+            pc += *(op + 1) + 2;
+            break;
+        case OP_MATCHSET:
+        case OP_INVMATCHSET:
+            pc += *(op + 1) + 2;
+            break;
+        // Anything that may be skipped or taken in a different branch isn't required
+        case OP_CHOOSE:
+            if (*(op + 2) == 0) return;
+            pc += *(op + 2);
+            break;
+        case OP_BLOCK:
+        case OP_ZERO_ONE:
+        case OP_ZERO_MORE:
+        case OP_ZERO_MORE_LAZY:
+        case OP_ONE_MORE:
+        case OP_ONE_MORE_LAZY:
+            if (*(op + 1) == 0) return;
+            pc += *(op + 1);
+            break;
+        case OP_COUNT_RANGE:
+            if (*(op + 3) == 0) return;
+            pc += *(op + 3);
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+/**
+ * Collects every character a match starting at `pc` can begin with into the bitset `set`.
+ * Returns 0 if that can't be determined, or if the match could begin without consuming anything.
+ */
+static int find_first_set(pm_Regex* expr, int pc, unsigned char* set) {
+    while (pc < expr->size) {
+        unsigned char* op = CODE_BASE(expr) + pc;
+        switch (*op) {
+        case OP_OPENGROUP:
+        case OP_CLOSEGROUP:
+            pc += 2;
+            break;
+        case OP_MATCHEXACT:
+            if (*(op + 1) == 0) return 0;
+            set[*(op + 2) >> 3] |= 1 << (*(op + 2) & 7);
+            return 1;
+        case OP_MATCHSET:
+        case OP_INVMATCHSET: {
+            // word boundaries depend on the following character too
+            for (int i = 0; i + 1 < *(op + 1); i++) {
+                if (*(op + 2 + i) == ARG_CLASS && (*(op + 3 + i) == 'b' || *(op + 3 + i) == 'B')) return 0;
+            }
+
+            for (int ch = 0; ch < 256; ch++) {
+                char probe[2] = { (char)ch, 0 };
+                if (matches_set(op, probe)) set[ch >> 3] |= 1 << (ch & 7);
+            }
+            return 1;
+        }
+        case ARG_CLASS:
+            if (*(op + 1) == 'b' || *(op + 1) == 'B') return 0;
+            for (int ch = 0; ch < 256; ch++) {
+                char probe[2] = { (char)ch, 0 };
+                if (matches_class(probe, (char)*(op + 1), 0)) set[ch >> 3] |= 1 << (ch & 7);
+            }
+            return 1;
+        case OP_CHOOSE:
+            if (*(op + 1) == 0 || *(op + 2) == 0) return 0;
+            return find_first_set(expr, pc + 3, set) && find_first_set(expr, pc + *(op + 1), set);
+        case OP_BLOCK:
+        case OP_ONE_MORE:
+        case OP_ONE_MORE_LAZY:
+            return find_first_set(expr, pc + 2, set);
+        case OP_COUNT_RANGE:
+            if (*(op + 1) == 0) return 0;
+            return find_first_set(expr, pc + 4, set);
+        default:
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
 int pm_expsize(const char* source, const char** err) {
     pm_Regex result = { 0 };
     result.num_groups = 1; // Include base match
@@ -482,6 +595,11 @@ int pm_compile(pm_Regex* result, int result_size, const char* source) {
 
     if (!compile_body(result, source, 0)) return 0;
 
+    if (!result->is_anchored) {
+        find_required_literal(result);
+        result->has_first_set = find_first_set(result, 0, result->first_set);
+    }
+
     return 1;
 }
 
@@ -513,6 +631,34 @@ static int matches_class(const char* source, char class, int* consume) {
     }
 }
 
+/** Tests the character at `source` against the set starting at `op`, inverted sets included */
+static int matches_set(const unsigned char* op, const char* source) {
+    char current = *source;
+    int result = (*op) == OP_INVMATCHSET;
+    int set_idx = 0;
+    while (set_idx < *(op + 1)) {
+        unsigned char set_op = *(op + 2 + set_idx);
+        if (set_op == ARG_RANGE) {
+            if (current >= *(op + 2 + set_idx + 1) && current <= *(op + 2 + set_idx + 2)) {
+                return !result;
+            }
+            set_idx += 3;
+        } else if (set_op == ARG_CLASS) {
+            if (matches_class(source, (char)(*(op + 2 + set_idx + 1)), 0)) {
+                return !result;
+            }
+            set_idx += 2;
+        } else {
+            if (current == (char)set_op) {
+                return !result;
+            }
+            set_idx++;
+        }
+    }
+
+    return result;
+}
+
 static int match(pm_Regex* expr, int pc, const char* source, int len, int* offset, pm_Group* groups, int group_count, int spec_depth, int spec);
 
 static void match_loop(pm_Regex* expr, int pc, const char* source, int len, int* offset, int spec_depth) {
@@ -569,7 +715,8 @@ static int match(pm_Regex* expr, int pc, const char* source, int len, int* offse
         unsigned char* op = CODE_BASE(expr) + pc;
         switch (*op) {
         case OP_END:
-            if (block_depth > 0 && spec) block_depth--;
+            // speculative continuations unwind out of blocks, but never past the end of the expression
+            if (block_depth > 0 && spec && pc + 1 < expr->size) block_depth--;
             else return result;
             pc++;
             break;
@@ -591,36 +738,11 @@ static int match(pm_Regex* expr, int pc, const char* source, int len, int* offse
             pc++;
             break;
         case OP_MATCHSET:
-        case OP_INVMATCHSET: {
-            char current = source[*offset];
-            result = (*op) == OP_INVMATCHSET;
-            int set_idx = 0;
-            while (set_idx < *(op + 1)) {
-                unsigned char set_op = *(op + 2 + set_idx);
-                if (set_op == ARG_RANGE) {
-                    if (current >= *(op + 2 + set_idx + 1) && current <= *(op + 2 + set_idx + 2)) {
-                        result = !result;
-                        break;
-                    }
-                    set_idx += 3;
-                } else if (set_op == ARG_CLASS) {
-                    if (matches_class(source + (*offset), (char)(*(op + 2 + set_idx + 1)), 0)) {
-                        result = !result;
-                        break;
-                    }
-                    set_idx++;
-                } else {
-                    if (current == (char)set_op) {
-                        result = !result;
-                        break;
-                    }
-                    set_idx++;
-                }
-            }
+        case OP_INVMATCHSET:
+            result = *offset < len && matches_set(op, source + (*offset));
             if (result) (*offset)++;
             pc += *(op + 1) + 2;
             break;
-        }
         case OP_MATCHBOL:
             result = *offset == 0;
             pc++;
@@ -701,7 +823,8 @@ static int match(pm_Regex* expr, int pc, const char* source, int len, int* offse
             pc += *(op + 1);
             break;
         case ARG_CLASS:
-            result  = matches_class(source, *(op + 1), offset);
+            // word boundaries don't consume, and may look at the terminator
+            result = (*offset < len || *(op + 1) == 'b' || *(op + 1) == 'B') && matches_class(source + (*offset), *(op + 1), offset);
             pc += 2;
             break;
         default:
@@ -713,6 +836,21 @@ static int match(pm_Regex* expr, int pc, const char* source, int len, int* offse
     return result;
 }
 
+/** Returns whether `literal` occurs anywhere in the first `len` characters of `source` */
+static int find_literal(const char* source, int len, const char* literal, int literal_len) {
+    const char* end = source + len - literal_len + 1;
+    const char* at = source;
+
+    while (at < end) {
+        at = memchr(at, literal[0], end - at);
+        if (!at) return 0;
+        if (memcmp(at, literal, literal_len) == 0) return 1;
+        at++;
+    }
+
+    return 0;
+}
+
 int pm_match(pm_Regex* expr, const char* source, int len, pm_Group* groups, int group_count, int* remainder) {
     if (!source) return 0;
     if (len == 0) {
@@ -727,7 +865,18 @@ int pm_match(pm_Regex* expr, const char* source, int len, pm_Group* groups, int
     } else {
         int offset = 0;
         int result = 0;
+
+        if (expr->required_length && !find_literal(source, len, (const char*)CODE_BASE(expr) + expr->required_start, expr->required_length)) {
+            if (remainder) *remainder = 0;
+            return 0;
+        }
+
         for (int i = 0; i < len && result == 0; i++) {
+            if (expr->has_first_set) {
+                while (i < len && !(expr->first_set[(unsigned char)source[i] >> 3] & (1 << ((unsigned char)source[i] & 7)))) i++;
+                if (i == len) break;
+            }
+
             offset = i;
             result = match(expr, 0, source, len, &offset, groups, group_count, 0, 0);
         }
@@ -32,6 +32,11 @@ typedef struct pm_Regex {
     int size, capacity;
     int num_groups;
     int is_anchored;
+
+    /* Prefilter info, filled in by `pm_compile` for unanchored expressions */
+    int has_first_set;
+    unsigned char first_set[32];
+    int required_start, required_length;
 } pm_Regex;
 
 /**
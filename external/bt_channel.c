@@ -0,0 +1,287 @@
+#include "bt_channel.h"
+
+#include "bt_gc.h"
+#include "bt_userdata.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BT_ATOMIC_EXCHANGE(ptr, value) _InterlockedExchange((volatile long*)(ptr), (value))
+#define BT_ATOMIC_STORE(ptr, value) _InterlockedExchange((volatile long*)(ptr), (value))
+#define BT_ATOMIC_ADD(ptr, value) (_InterlockedExchangeAdd((volatile long*)(ptr), (value)) + (value))
+#define BT_PAUSE() _mm_pause()
+#else
+#define BT_ATOMIC_EXCHANGE(ptr, value) __atomic_exchange_n((ptr), (value), __ATOMIC_ACQUIRE)
+#define BT_ATOMIC_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#define BT_ATOMIC_ADD(ptr, value) __atomic_add_fetch((ptr), (value), __ATOMIC_ACQ_REL)
+#if defined(__x86_64__) || defined(__i386__)
+#define BT_PAUSE() __builtin_ia32_pause()
+#else
+#define BT_PAUSE()
+#endif
+#endif
+
+// deeper values are rejected, which also catches cycles
+#define BT_CHANNEL_MAX_DEPTH 64
+
+typedef enum {
+	BT_MESSAGE_VALUE,
+	BT_MESSAGE_STRING,
+	BT_MESSAGE_ARRAY,
+	BT_MESSAGE_TABLE,
+} bt_MessageTag;
+
+typedef struct bt_Message {
+	struct bt_Message* next;
+	size_t size, capacity;
+	uint8_t data[];
+} bt_Message;
+
+struct bt_Channel {
+	bt_Alloc alloc;
+	bt_Realloc realloc;
+	bt_Free free;
+
+	// the lock only guards the queue links, messages are encoded and decoded outside of it
+	volatile long lock;
+	volatile long refs;
+
+	bt_Message* head;
+	bt_Message* tail;
+	uint32_t count;
+};
+
+static void channel_lock(bt_Channel* channel)
+{
+	while (BT_ATOMIC_EXCHANGE(&channel->lock, 1)) {
+		while (channel->lock) BT_PAUSE();
+	}
+}
+
+static void channel_unlock(bt_Channel* channel)
+{
+	BT_ATOMIC_STORE(&channel->lock, 0);
+}
+
+bt_Channel* bt_make_channel(bt_Context* ctx)
+{
+	bt_Channel* channel = ctx->alloc(sizeof(bt_Channel));
+	channel->alloc = ctx->alloc;
+	channel->realloc = ctx->realloc;
+	channel->free = ctx->free;
+	channel->lock = 0;
+	channel->refs = 1;
+	channel->head = NULL;
+	channel->tail = NULL;
+	channel->count = 0;
+	return channel;
+}
+
+void bt_channel_retain(bt_Channel* channel)
+{
+	BT_ATOMIC_ADD(&channel->refs, 1);
+}
+
+void bt_channel_release(bt_Channel* channel)
+{
+	if (BT_ATOMIC_ADD(&channel->refs, -1) != 0) return;
+
+	bt_Message* message = channel->head;
+	while (message) {
+		bt_Message* next = message->next;
+		channel->free(message);
+		message = next;
+	}
+
+	channel->free(channel);
+}
+
+typedef struct bt_MessageWriter {
+	bt_Channel* channel;
+	bt_Message* message;
+} bt_MessageWriter;
+
+static void write_bytes(bt_MessageWriter* w, const void* data, size_t size)
+{
+	bt_Message* message = w->message;
+	if (message->size + size > message->capacity) {
+		size_t capacity = message->capacity * 2;
+		while (capacity < message->size + size) capacity *= 2;
+		message = w->channel->realloc(message, sizeof(bt_Message) + capacity);
+		message->capacity = capacity;
+		w->message = message;
+	}
+
+	memcpy(message->data + message->size, data, size);
+	message->size += size;
+}
+
+static void write_tag(bt_MessageWriter* w, bt_MessageTag tag, uint32_t length)
+{
+	uint8_t as_byte = (uint8_t)tag;
+	write_bytes(w, &as_byte, sizeof(as_byte));
+	if (tag != BT_MESSAGE_VALUE) write_bytes(w, &length, sizeof(length));
+}
+
+static bt_bool write_value(bt_MessageWriter* w, bt_Value value, uint32_t depth)
+{
+	if (!BT_IS_OBJECT(value)) {
+		write_tag(w, BT_MESSAGE_VALUE, 0);
+		write_bytes(w, &value, sizeof(value));
+		return BT_TRUE;
+	}
+
+	if (depth == BT_CHANNEL_MAX_DEPTH) return BT_FALSE;
+
+	bt_Object* obj = BT_AS_OBJECT(value);
+	switch (BT_OBJECT_GET_TYPE(obj)) {
+	case BT_OBJECT_TYPE_STRING: {
+		bt_String* str = (bt_String*)obj;
+		write_tag(w, BT_MESSAGE_STRING, str->len);
+		write_bytes(w, BT_STRING_STR(str), str->len);
+		return BT_TRUE;
+	}
+	case BT_OBJECT_TYPE_ARRAY: {
+		bt_Array* arr = (bt_Array*)obj;
+		write_tag(w, BT_MESSAGE_ARRAY, arr->length);
+		for (uint32_t i = 0; i < arr->length; ++i) {
+			if (!write_value(w, arr->items[i], depth + 1)) return BT_FALSE;
+		}
+		return BT_TRUE;
+	}
+	case BT_OBJECT_TYPE_TABLE: {
+		bt_Table* tbl = (bt_Table*)obj;
+		bt_TablePair* pairs = BT_TABLE_PAIRS(tbl);
+		write_tag(w, BT_MESSAGE_TABLE, tbl->length);
+		for (uint32_t i = 0; i < tbl->length; ++i) {
+			if (!write_value(w, pairs[i].key, depth + 1)) return BT_FALSE;
+			if (!write_value(w, pairs[i].value, depth + 1)) return BT_FALSE;
+		}
+		return BT_TRUE;
+	}
+	default:
+		return BT_FALSE;
+	}
+}
+
+bt_bool bt_channel_send(bt_Context* ctx, bt_Channel* channel, bt_Value value)
+{
+	const size_t initial_capacity = 64;
+	bt_MessageWriter w;
+	w.channel = channel;
+	w.message = channel->alloc(sizeof(bt_Message) + initial_capacity);
+	w.message->next = NULL;
+	w.message->size = 0;
+	w.message->capacity = initial_capacity;
+
+	if (!write_value(&w, value, 0)) {
+		channel->free(w.message);
+		return BT_FALSE;
+	}
+
+	channel_lock(channel);
+	if (channel->tail) channel->tail->next = w.message;
+	else channel->head = w.message;
+	channel->tail = w.message;
+	channel->count++;
+	channel_unlock(channel);
+
+	return BT_TRUE;
+}
+
+static bt_Value read_value(bt_Context* ctx, const uint8_t** current, bt_bool as_key)
+{
+	bt_MessageTag tag = (bt_MessageTag)**current;
+	*current += 1;
+
+	if (tag == BT_MESSAGE_VALUE) {
+		bt_Value value;
+		memcpy(&value, *current, sizeof(value));
+		*current += sizeof(value);
+		return value;
+	}
+
+	uint32_t length;
+	memcpy(&length, *current, sizeof(length));
+	*current += sizeof(length);
+
+	switch (tag) {
+	case BT_MESSAGE_STRING: {
+		const char* str = (const char*)*current;
+		*current += length;
+		// keys are hashed up front like the ones in compiled code
+		bt_String* result = as_key ? bt_make_string_hashed_len(ctx, str, length) : bt_make_string_len(ctx, str, length);
+		return BT_VALUE_OBJECT(result);
+	}
+	case BT_MESSAGE_ARRAY: {
+		bt_Array* arr = bt_make_array(ctx, length);
+		for (uint32_t i = 0; i < length; ++i) {
+			bt_array_push(ctx, arr, read_value(ctx, current, BT_FALSE));
+		}
+		return BT_VALUE_OBJECT(arr);
+	}
+	case BT_MESSAGE_TABLE: {
+		bt_Table* tbl = bt_make_table(ctx, (uint16_t)(length < UINT16_MAX ? length : UINT16_MAX));
+		for (uint32_t i = 0; i < length; ++i) {
+			bt_Value key = read_value(ctx, current, BT_TRUE);
+			bt_Value value = read_value(ctx, current, BT_FALSE);
+			bt_table_set(ctx, tbl, key, value);
+		}
+		return BT_VALUE_OBJECT(tbl);
+	}
+	default:
+		return BT_VALUE_NULL;
+	}
+}
+
+bt_bool bt_channel_receive(bt_Context* ctx, bt_Channel* channel, bt_Value* value)
+{
+	channel_lock(channel);
+	bt_Message* message = channel->head;
+	if (message) {
+		channel->head = message->next;
+		if (!channel->head) channel->tail = NULL;
+		channel->count--;
+	}
+	channel_unlock(channel);
+
+	if (!message) return BT_FALSE;
+
+	// nothing is reachable until the whole value is built, so hold the collector off instead of rooting each part
+	bt_gc_pause(ctx);
+	const uint8_t* current = message->data;
+	*value = read_value(ctx, &current, BT_FALSE);
+	bt_gc_unpause(ctx);
+
+	channel->free(message);
+	return BT_TRUE;
+}
+
+uint32_t bt_channel_count(bt_Channel* channel)
+{
+	return channel->count;
+}
+
+static void channel_finalizer(bt_Context* ctx, bt_Userdata* userdata)
+{
+	bt_channel_release(bt_channel_unwrap(userdata));
+}
+
+bt_Type* bt_make_channel_type(bt_Context* ctx)
+{
+	bt_Type* type = bt_make_userdata_type(ctx, "Channel");
+	bt_userdata_type_set_finalizer(type, channel_finalizer);
+	return type;
+}
+
+bt_Userdata* bt_channel_wrap(bt_Context* ctx, bt_Channel* channel)
+{
+	bt_channel_retain(channel);
+	return bt_make_userdata(ctx, ctx->types.channel, &channel, sizeof(bt_Channel*));
+}
+
+bt_Channel* bt_channel_unwrap(bt_Userdata* userdata)
+{
+	return *(bt_Channel**)bt_userdata_get(userdata);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_context.h"
+
+/***
+ * Channels pass values between contexts, including contexts running on different os threads at the same time.
+ * A channel is a first in, first out queue of messages that any number of contexts can send to and receive from.
+ *
+ * Sending copies the value out of the sender's heap and receiving rebuilds it in the receiver's, so nothing is shared.
+ * Only plain data can be sent: null, booleans, numbers, enum values, strings, and arrays and tables of those.
+ * Tables arrive without their prototype, and cyclic or very deeply nested values can't be sent.
+ *
+ * Channels are reference counted, a context holds a reference for every `Channel` userdata wrapping one.
+ */
+
+typedef struct bt_Channel bt_Channel;
+
+/** Creates an empty channel holding a single reference, allocated with the handlers of `ctx` but otherwise independent of it */
+BOLT_API bt_Channel* bt_make_channel(bt_Context* ctx);
+/** Adds a reference to `channel` */
+BOLT_API void bt_channel_retain(bt_Channel* channel);
+/** Removes a reference from `channel`, freeing it and any pending messages once the last one is gone */
+BOLT_API void bt_channel_release(bt_Channel* channel);
+
+/** Copies `value` into a message at the back of `channel`. Returns BT_FALSE if the value can't be sent */
+BOLT_API bt_bool bt_channel_send(bt_Context* ctx, bt_Channel* channel, bt_Value value);
+/** Takes the message at the front of `channel` and rebuilds it in `ctx`. Returns BT_FALSE if the channel is empty */
+BOLT_API bt_bool bt_channel_receive(bt_Context* ctx, bt_Channel* channel, bt_Value* value);
+/** Returns the number of pending messages, which may already be out of date if other threads use the channel */
+BOLT_API uint32_t bt_channel_count(bt_Channel* channel);
+
+/** Wraps `channel` in a new userdata of the `Channel` type, which holds a reference until it's collected */
+BOLT_API bt_Userdata* bt_channel_wrap(bt_Context* ctx, bt_Channel* channel);
+/** Returns the channel wrapped by `userdata`, which must be of the `Channel` type */
+BOLT_API bt_Channel* bt_channel_unwrap(bt_Userdata* userdata);
+
+/** Creates the `Channel` userdata type, called by `bt_open` */
+BOLT_API bt_Type* bt_make_channel_type(bt_Context* ctx);
+
+#if __cplusplus
+}
+#endif
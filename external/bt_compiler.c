@@ -24,9 +24,21 @@ typedef struct Constant {
 typedef struct CompilerBinding {
     bt_StrSlice name;
     bt_Token* source;
+    // const bindings with a constant initializer are folded into their uses and never get a register
+    bt_Value constant;
+    bt_bool is_constant;
     uint8_t loc;
 } CompilerBinding;
 
+// A constant or import used as an operand inside a loop, loaded into `loc` once before the loop is entered
+typedef struct Invariant {
+    bt_Value constant;
+    uint16_t import_idx;
+    uint8_t loc;
+} Invariant;
+
+#define MAX_INVARIANTS 16
+
 typedef enum StorageClass {
     STORAGE_INVALID,
     STORAGE_REGISTER,
@@ -49,6 +61,9 @@ typedef struct FunctionContext {
     uint16_t pending_breaks[16][16];
     uint8_t break_counts[16];
 
+    Invariant invariants[MAX_INVARIANTS];
+    uint8_t invariant_top;
+
     bt_Buffer(Constant) constants;
     bt_InstructionBuffer output;
     bt_DebugLocBuffer debug;
@@ -74,7 +89,9 @@ static bt_Fn* compile_fn(bt_Compiler* compiler, FunctionContext* parent, bt_AstN
 static uint8_t find_upval(FunctionContext* ctx, bt_StrSlice name);
 static uint8_t find_binding(FunctionContext* ctx, bt_StrSlice name);
 static uint8_t find_named(FunctionContext* ctx, bt_StrSlice name);
+static bt_bool find_constant(FunctionContext* ctx, bt_StrSlice name, bt_Value* result);
 static uint8_t push(FunctionContext* ctx, bt_Value value);
+static void emit_load_constant(FunctionContext* ctx, bt_Value value, uint8_t loc);
 static uint8_t push_load(FunctionContext* ctx, bt_Value value);
 static bt_bool compile_if(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_expr, uint8_t expr_loc);
 static bt_bool compile_for(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_expr, uint8_t expr_loc);
@@ -122,7 +139,11 @@ static uint32_t emit_op(FunctionContext* ctx, bt_Op op)
 
     if (ctx->compiler->options.generate_debug_info) {
         if (ctx->compiler->debug_top) {
-            bt_AstNode* node = ctx->compiler->debug_stack[ctx->compiler->debug_top - 1];
+            // literal tokens store their literal index in `idx` rather than their token index, so use the enclosing node
+            uint32_t top = ctx->compiler->debug_top - 1;
+            while (top > 0 && ctx->compiler->debug_stack[top]->type == BT_AST_NODE_LITERAL) top--;
+
+            bt_AstNode* node = ctx->compiler->debug_stack[top];
             if (node->source) {
                 bt_buffer_push(ctx->context, &ctx->debug, node->source->idx);
             }
@@ -168,6 +189,25 @@ static uint32_t emit(FunctionContext* ctx, bt_OpCode code)
     return emit_abc(ctx, code, 0, 0, 0, BT_FALSE);
 }
 
+// Field accesses by constant key are followed by an empty IDX_EXT, which the interpreter uses as the site's inline cache
+static uint32_t emit_load_idx_k(FunctionContext* ctx, bt_Value is_prototypical, uint8_t result_loc, uint8_t obj_loc, uint8_t key_idx)
+{
+    if (is_prototypical != BT_VALUE_NULL && ctx->compiler->options.predict_hash_slots) {
+        return emit_abc(ctx, BT_OP_LOAD_PROTO, result_loc, obj_loc, key_idx, BT_FALSE);
+    }
+
+    uint32_t loc = emit_abc(ctx, BT_OP_LOAD_IDX_K, result_loc, obj_loc, key_idx, BT_FALSE);
+    emit_aibc(ctx, BT_OP_IDX_EXT, 0, 0);
+    return loc;
+}
+
+static uint32_t emit_store_idx_k(FunctionContext* ctx, uint8_t tbl_loc, uint8_t key_idx, uint8_t value_loc)
+{
+    uint32_t loc = emit_abc(ctx, BT_OP_STORE_IDX_K, tbl_loc, key_idx, value_loc, BT_FALSE);
+    emit_aibc(ctx, BT_OP_IDX_EXT, 0, 0);
+    return loc;
+}
+
 static void compile_error(bt_Compiler* compiler, const char* message, uint16_t line, uint16_t col)
 {
     compiler->context->on_error(BT_ERROR_COMPILE, compiler->input->tokenizer->source_name, message, line, col);
@@ -208,6 +248,12 @@ static void load_fn(FunctionContext* ctx, bt_AstNode* expr, bt_Fn* fn, uint8_t r
 
         for (uint8_t i = 0; i < expr->as.fn.upvals.length; ++i) {
             bt_ParseBinding* binding = expr->as.fn.upvals.elements + i;
+            bt_Value constant;
+            if (find_constant(ctx, binding->name, &constant)) {
+                emit_load_constant(ctx, constant, start + i + 1);
+                continue;
+            }
+
             uint8_t loc = find_binding(ctx, binding->name);
             if (loc != INVALID_BINDING) {
                 emit_ab(ctx, BT_OP_MOVE, start + i + 1, loc, BT_FALSE);
@@ -268,6 +314,8 @@ static uint8_t make_binding_at_loc(FunctionContext* ctx, bt_StrSlice name, uint8
     new_binding.loc = loc;
     new_binding.name = name;
     new_binding.source = source;
+    new_binding.constant = BT_VALUE_NULL;
+    new_binding.is_constant = BT_FALSE;
 
     ctx->bindnings[ctx->binding_top++] = new_binding;
     
@@ -284,13 +332,31 @@ static uint8_t find_binding(FunctionContext* ctx, bt_StrSlice name)
     for (int32_t i = ctx->binding_top - 1; i >= 0; --i) {
         CompilerBinding* binding = ctx->bindnings + i;
         if (bt_strslice_compare(binding->name, name)) {
-            return binding->loc;
+            return binding->is_constant ? INVALID_BINDING : binding->loc;
         }
     }
 
     return INVALID_BINDING;
 }
 
+// Finds the value of `name` if it refers to a folded const binding, either in this function or captured from an outer one
+static bt_bool find_constant(FunctionContext* ctx, bt_StrSlice name, bt_Value* result)
+{
+    for (int32_t i = ctx->binding_top - 1; i >= 0; --i) {
+        CompilerBinding* binding = ctx->bindnings + i;
+        if (bt_strslice_compare(binding->name, name)) {
+            *result = binding->constant;
+            return binding->is_constant;
+        }
+    }
+
+    if (ctx->outer && find_upval(ctx, name) != INVALID_BINDING) {
+        return find_constant(ctx->outer, name, result);
+    }
+
+    return BT_FALSE;
+}
+
 static uint8_t find_upval(FunctionContext* ctx, bt_StrSlice name)
 {
     bt_AstNode* fn = ctx->fn;
@@ -322,6 +388,49 @@ static uint16_t find_import(FunctionContext* ctx, bt_StrSlice name)
     return INVALID_BINDING;
 }
 
+// The value a call's callee is known to have at compile time, or null if it can only be known at runtime
+static bt_Value static_callee(FunctionContext* ctx, bt_AstNode* callee)
+{
+    if (callee->type == BT_AST_NODE_IMPORT_REFERENCE) {
+        uint16_t loc = find_import(ctx, callee->source->source);
+        if (loc == INVALID_BINDING) return BT_VALUE_NULL;
+        return find_module(ctx)->imports.elements[loc]->value;
+    }
+
+    // `module.export` through a module imported as a whole
+    if (callee->type == BT_AST_NODE_BINARY_OP && callee->source->type == BT_TOKEN_PERIOD &&
+        callee->as.binary_op.left->type == BT_AST_NODE_IMPORT_REFERENCE && callee->as.binary_op.right->type == BT_AST_NODE_LITERAL) {
+        bt_Value module = static_callee(ctx, callee->as.binary_op.left);
+        bt_Token* name = callee->as.binary_op.right->source;
+        if (!BT_IS_OBJECT(module) || BT_OBJECT_GET_TYPE(BT_AS_OBJECT(module)) != BT_OBJECT_TYPE_TABLE || name->type != BT_TOKEN_IDENTIFIER_LITERAL) return BT_VALUE_NULL;
+
+        return bt_table_get((bt_Table*)BT_AS_OBJECT(module),
+            BT_VALUE_OBJECT(bt_make_string_hashed_len(ctx->context, name->source.source, name->source.length)));
+    }
+
+    return BT_VALUE_NULL;
+}
+
+// The kind of direct native `callee` is if all of the call's arguments are statically typed the way it takes them, see bt_make_native_direct
+static bt_DirectKind direct_call_kind(FunctionContext* ctx, bt_Value callee, bt_AstBuffer* args)
+{
+    if (!ctx->compiler->options.direct_native_calls || !BT_IS_OBJECT(callee)) return BT_DIRECT_NONE;
+    if (BT_OBJECT_GET_TYPE(BT_AS_OBJECT(callee)) != BT_OBJECT_TYPE_NATIVE_FN) return BT_DIRECT_NONE;
+
+    bt_DirectKind kind = ((bt_NativeFn*)BT_AS_OBJECT(callee))->direct_kind;
+    if (kind == BT_DIRECT_NONE || bt_direct_arity(kind) != args->length) return BT_DIRECT_NONE;
+
+    for (uint8_t i = 0; i < args->length; i++) {
+        bt_Type* type = args->elements[i]->resulting_type;
+        if (i == 0 && bt_direct_takes_userdata(kind)) {
+            if (!type || type->category != BT_TYPE_CATEGORY_USERDATA) return BT_DIRECT_NONE;
+        }
+        else if (type != ctx->context->types.number) return BT_DIRECT_NONE;
+    }
+
+    return kind;
+}
+
 bt_Compiler bt_open_compiler(bt_Parser* parser, bt_CompilerOptions options)
 {
     bt_Compiler result;
@@ -350,6 +459,134 @@ static uint32_t op_count(FunctionContext* ctx)
     return ctx->output.length;    
 }
 
+// Emits the conditional jump for `condition`, which was just compiled into `condition_loc`.
+// Numeric comparisons are fused with the jump, the returned op holds the offset to patch either way
+static uint32_t emit_jmpf(FunctionContext* ctx, bt_AstNode* condition, uint8_t condition_loc)
+{
+    // `and`/`or` conditions also end in a comparison, but their short-circuit jumps land past it and expect the result in a register
+    bt_TokenType op_type = condition->type == BT_AST_NODE_BINARY_OP ? condition->source->type : BT_TOKEN_EOS;
+    bt_bool is_comparison = op_type == BT_TOKEN_LT || op_type == BT_TOKEN_LTE || op_type == BT_TOKEN_GT || op_type == BT_TOKEN_GTE ||
+        op_type == BT_TOKEN_EQUALS || op_type == BT_TOKEN_NOTEQ;
+
+    if (ctx->compiler->options.fuse_instructions && is_comparison && op_count(ctx)) {
+        bt_Op* last = op_at(ctx, op_count(ctx) - 1);
+        if (BT_IS_ACCELERATED(*last) && BT_GET_A(*last) == condition_loc) {
+            bt_OpCode fused = BT_OP_JMPF;
+            switch (BT_GET_OPCODE(*last)) {
+            case BT_OP_LT:  fused = BT_OP_LT_JMPF;  break;
+            case BT_OP_LTE: fused = BT_OP_LTE_JMPF; break;
+            case BT_OP_EQ:  fused = BT_OP_EQ_JMPF;  break;
+            case BT_OP_NEQ: fused = BT_OP_NEQ_JMPF; break;
+            default: break;
+            }
+
+            if (fused != BT_OP_JMPF) {
+                *last = BT_MAKE_OP_ABC(fused, BT_GET_B(*last), BT_GET_C(*last), 0);
+                return emit_aibc(ctx, BT_OP_IDX_EXT, 0, 0);
+            }
+        }
+    }
+
+    return emit_aibc(ctx, BT_OP_JMPF, condition_loc, 0);
+}
+
+// Evaluates `node` at compile time if it's made up only of number and boolean literals, folded const bindings and operators on them
+static bt_bool fold_constant(FunctionContext* ctx, bt_AstNode* node, bt_Value* result)
+{
+    switch (node->type) {
+    case BT_AST_NODE_LITERAL:
+        switch (node->source->type) {
+        case BT_TOKEN_TRUE_LITERAL:   *result = BT_VALUE_TRUE;  return BT_TRUE;
+        case BT_TOKEN_FALSE_LITERAL:  *result = BT_VALUE_FALSE; return BT_TRUE;
+        case BT_TOKEN_NUMBER_LITERAL: *result = BT_VALUE_NUMBER(ctx->compiler->input->tokenizer->literals.elements[node->source->idx].as_num); return BT_TRUE;
+        default: return BT_FALSE;
+        }
+    case BT_AST_NODE_IDENTIFIER:
+        return find_constant(ctx, node->source->source, result);
+    case BT_AST_NODE_UNARY_OP: {
+        bt_Value operand;
+        if (!fold_constant(ctx, node->as.unary_op.operand, &operand)) return BT_FALSE;
+
+        bt_TokenType op_type = node->source->type;
+        if ((op_type == BT_TOKEN_MINUS || op_type == BT_TOKEN_PLUS) && BT_IS_NUMBER(operand)) {
+            *result = op_type == BT_TOKEN_MINUS ? BT_VALUE_NUMBER(-BT_AS_NUMBER(operand)) : operand;
+            return BT_TRUE;
+        }
+
+        if (op_type == BT_TOKEN_NOT && BT_IS_BOOL(operand)) {
+            *result = BT_VALUE_BOOL(BT_IS_FALSE(operand));
+            return BT_TRUE;
+        }
+
+        return BT_FALSE;
+    }
+    case BT_AST_NODE_BINARY_OP: {
+        bt_Value lhs, rhs;
+        if (!fold_constant(ctx, node->as.binary_op.left, &lhs) || !fold_constant(ctx, node->as.binary_op.right, &rhs)) return BT_FALSE;
+
+        if (BT_IS_BOOL(lhs) && BT_IS_BOOL(rhs)) {
+            switch (node->source->type) {
+            case BT_TOKEN_AND:     *result = BT_VALUE_BOOL(BT_IS_TRUE(lhs) && BT_IS_TRUE(rhs)); return BT_TRUE;
+            case BT_TOKEN_OR:      *result = BT_VALUE_BOOL(BT_IS_TRUE(lhs) || BT_IS_TRUE(rhs)); return BT_TRUE;
+            case BT_TOKEN_EQUALS:  *result = BT_VALUE_BOOL(lhs == rhs); return BT_TRUE;
+            case BT_TOKEN_NOTEQ:   *result = BT_VALUE_BOOL(lhs != rhs); return BT_TRUE;
+            default: return BT_FALSE;
+            }
+        }
+
+        if (!BT_IS_NUMBER(lhs) || !BT_IS_NUMBER(rhs)) return BT_FALSE;
+
+        bt_number a = BT_AS_NUMBER(lhs), b = BT_AS_NUMBER(rhs);
+        switch (node->source->type) {
+        case BT_TOKEN_PLUS:   *result = BT_VALUE_NUMBER(a + b); return BT_TRUE;
+        case BT_TOKEN_MINUS:  *result = BT_VALUE_NUMBER(a - b); return BT_TRUE;
+        case BT_TOKEN_MUL:    *result = BT_VALUE_NUMBER(a * b); return BT_TRUE;
+        case BT_TOKEN_DIV:    *result = BT_VALUE_NUMBER(a / b); return BT_TRUE;
+        case BT_TOKEN_EQUALS: *result = BT_VALUE_BOOL(a == b);  return BT_TRUE;
+        case BT_TOKEN_NOTEQ:  *result = BT_VALUE_BOOL(a != b);  return BT_TRUE;
+        case BT_TOKEN_LT:     *result = BT_VALUE_BOOL(a < b);   return BT_TRUE;
+        case BT_TOKEN_LTE:    *result = BT_VALUE_BOOL(a <= b);  return BT_TRUE;
+        case BT_TOKEN_GT:     *result = BT_VALUE_BOOL(a > b);   return BT_TRUE;
+        case BT_TOKEN_GTE:    *result = BT_VALUE_BOOL(a >= b);  return BT_TRUE;
+        default: return BT_FALSE;
+        }
+    }
+    default:
+        return BT_FALSE;
+    }
+}
+
+// Loads a folded number or boolean into `loc`, integers that fit the immediate don't take up a constant slot
+static void emit_load_constant(FunctionContext* ctx, bt_Value value, uint8_t loc)
+{
+    if (BT_IS_BOOL(value)) {
+        emit_ab(ctx, BT_OP_LOAD_BOOL, loc, BT_IS_TRUE(value), BT_FALSE);
+        return;
+    }
+
+    bt_number num = BT_AS_NUMBER(value);
+    if (floor(num) == num && num < (bt_number)INT16_MAX && num > (bt_number)INT16_MIN && !(num == 0 && signbit(num))) {
+        emit_aibc(ctx, BT_OP_LOAD_SMALL, loc, (int16_t)num);
+    }
+    else {
+        emit_ab(ctx, BT_OP_LOAD, loc, push(ctx, value), BT_FALSE);
+    }
+}
+
+// Returns whether `node` is a number constant that fits the signed 8-bit immediate of ADD_I
+static bt_bool get_small_int_literal(FunctionContext* ctx, bt_AstNode* node, int16_t* result)
+{
+    bt_Value value;
+    if (node->type != BT_AST_NODE_LITERAL && !ctx->compiler->options.optimize_bytecode) return BT_FALSE;
+    if (!fold_constant(ctx, node, &value) || !BT_IS_NUMBER(value)) return BT_FALSE;
+
+    bt_number num = BT_AS_NUMBER(value);
+    if (floor(num) != num || num < INT8_MIN || num > INT8_MAX) return BT_FALSE;
+
+    *result = (int16_t)num;
+    return BT_TRUE;
+}
+
 static uint8_t push(FunctionContext* ctx, bt_Value value)
 {
     for (uint8_t idx = 0; idx < ctx->constants.length; idx++)
@@ -480,9 +717,28 @@ static void restore_registers(FunctionContext* ctx)
 
 static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_t result_loc);
 
+// The register a loop enclosing `expr` already loaded its value into, see hoist_invariants
+static uint8_t find_invariant(FunctionContext* ctx, bt_AstNode* expr)
+{
+    if (ctx->invariant_top == 0) return INVALID_BINDING;
+
+    bt_Value constant = BT_VALUE_NULL;
+    uint16_t import_idx = UINT16_MAX;
+    if (expr->type == BT_AST_NODE_IMPORT_REFERENCE) import_idx = find_import(ctx, expr->source->source);
+    else if (!fold_constant(ctx, expr, &constant)) return INVALID_BINDING;
+
+    for (uint8_t i = 0; i < ctx->invariant_top; ++i) {
+        Invariant* invariant = ctx->invariants + i;
+        if (invariant->import_idx == import_idx && invariant->constant == constant) return invariant->loc;
+    }
+
+    return INVALID_BINDING;
+}
+
 static uint8_t find_binding_or_compile_temp(FunctionContext* ctx, bt_AstNode* expr)
 {
-    uint8_t loc = INVALID_BINDING;
+    uint8_t loc = find_invariant(ctx, expr);
+    if (loc != INVALID_BINDING) return loc;
 
     if(expr->type == BT_AST_NODE_IDENTIFIER) {
         loc = find_named(ctx, expr->source->source);
@@ -562,6 +818,47 @@ static bt_bool is_assigning(bt_TokenType op) {
     }
 }
 
+// Whether the last op `expr` compiles to writes only its result register, and isn't the target of a jump inside `expr`
+static bt_bool ends_in_single_op(bt_AstNode* expr)
+{
+    switch (expr->type) {
+    case BT_AST_NODE_LITERAL: case BT_AST_NODE_ENUM_LITERAL: case BT_AST_NODE_VALUE_LITERAL: case BT_AST_NODE_IDENTIFIER:
+    case BT_AST_NODE_IMPORT_REFERENCE: case BT_AST_NODE_TYPE: case BT_AST_NODE_CALL: case BT_AST_NODE_RECURSIVE_CALL:
+    case BT_AST_NODE_UNARY_OP:
+        return BT_TRUE;
+    case BT_AST_NODE_BINARY_OP: {
+        bt_TokenType op_type = expr->source->type;
+        return op_type != BT_TOKEN_AND && op_type != BT_TOKEN_OR && op_type != BT_TOKEN_QUESTIONPERIOD && !is_assigning(op_type);
+    }
+    default:
+        return BT_FALSE;
+    }
+}
+
+// Moves the result of `expr`, compiled into the temporary `src` by the ops from `start` on, into `dst`.
+// If the last of those ops wrote `src` it's retargeted to write `dst` directly and the move is dropped
+static void emit_move(FunctionContext* ctx, uint8_t dst, uint8_t src, bt_AstNode* expr, uint32_t start)
+{
+    if (ctx->compiler->options.optimize_bytecode && op_count(ctx) > start && ends_in_single_op(expr)) {
+        bt_Op* last = op_at(ctx, op_count(ctx) - 1);
+        if (BT_GET_A(*last) == src) {
+            switch (BT_GET_OPCODE(*last)) {
+            case BT_OP_LOAD: case BT_OP_LOAD_SMALL: case BT_OP_LOAD_NULL: case BT_OP_LOAD_BOOL: case BT_OP_LOAD_IMPORT:
+            case BT_OP_MOVE: case BT_OP_LOADUP: case BT_OP_NEG: case BT_OP_NOT: case BT_OP_ADD: case BT_OP_SUB: case BT_OP_MUL:
+            case BT_OP_DIV: case BT_OP_ADD_I: case BT_OP_EQ: case BT_OP_NEQ: case BT_OP_MFEQ: case BT_OP_MFNEQ: case BT_OP_LT:
+            case BT_OP_LTE: case BT_OP_LOAD_IDX: case BT_OP_LOAD_SUB_F: case BT_OP_LOAD_ELEM_F: case BT_OP_LOAD_VALUE_F:
+            case BT_OP_EXPECT: case BT_OP_COALESCE: case BT_OP_TCHECK: case BT_OP_TCAST: case BT_OP_CONCAT: case BT_OP_CALL:
+            case BT_OP_CALL_DIRECT: case BT_OP_REC_CALL:
+                BT_SET_A(*last, dst);
+                return;
+            default: break;
+            }
+        }
+    }
+
+    emit_ab(ctx, BT_OP_MOVE, dst, src, BT_FALSE);
+}
+
 static bt_Value get_from_proto(bt_Type* type, bt_Value key)
 {
     if (!type) return BT_VALUE_NULL;
@@ -579,12 +876,90 @@ static bt_Value get_from_proto(bt_Type* type, bt_Value key)
     return bt_table_get(proto, key);
 }
 
+// Longer chains of string `+` are split into several CONCATs, the operands need consecutive registers
+#define BT_CONCAT_MAX_OPERANDS 32
+
+static bt_bool is_string_concat(FunctionContext* ctx, bt_AstNode* expr)
+{
+    return expr->type == BT_AST_NODE_BINARY_OP && expr->source->type == BT_TOKEN_PLUS &&
+        bt_type_dealias(expr->as.binary_op.left->resulting_type) == ctx->context->types.string &&
+        bt_type_dealias(expr->as.binary_op.right->resulting_type) == ctx->context->types.string;
+}
+
+// Lowers `a + b + c + ...` on strings into a single CONCAT, so the intermediate strings are never built
+static void compile_concat(FunctionContext* ctx, bt_AstNode* expr, uint8_t result_loc)
+{
+    // the chain leans left, collect its operands right to left
+    bt_AstNode* operands[BT_CONCAT_MAX_OPERANDS];
+    uint8_t count = 0;
+
+    bt_AstNode* current = expr;
+    while (is_string_concat(ctx, current) && count < BT_CONCAT_MAX_OPERANDS - 1) {
+        operands[count++] = current->as.binary_op.right;
+        current = current->as.binary_op.left;
+    }
+    operands[count++] = current;
+
+    push_registers(ctx);
+
+    uint8_t base_loc = get_registers(ctx, count);
+    for (uint8_t i = 0; i < count; ++i) {
+        compile_expression(ctx, operands[count - i - 1], base_loc + i);
+    }
+
+    emit_abc(ctx, BT_OP_CONCAT, result_loc, base_loc, count, BT_FALSE);
+
+    restore_registers(ctx);
+}
+
+// Typed arrays are userdata holding packed numbers, numeric subscripts on them go through LOAD_ELEM_F/STORE_ELEM_F
+static bt_bool is_typed_array(bt_Type* type)
+{
+    type = bt_type_dealias(type);
+    return type && type->category == BT_TYPE_CATEGORY_USERDATA && type->as.userdata.elements != BT_ELEMENTS_NONE;
+}
+
+// Returns the packed field/member path if `expr` is `obj.field.member` where `field` is an inline value field of a userdata, otherwise -1
+// These are always accessed through LOAD_VALUE_F/STORE_VALUE_F, boxing `field` would make writes to `member` land in a temporary copy
+static int32_t get_value_member_path(bt_AstNode* expr)
+{
+    if (expr->type != BT_AST_NODE_BINARY_OP || expr->source->type != BT_TOKEN_PERIOD || !expr->as.binary_op.userdata_field) return -1;
+
+    bt_AstNode* lhs = expr->as.binary_op.left;
+    if (lhs->type != BT_AST_NODE_BINARY_OP || lhs->source->type != BT_TOKEN_PERIOD || !lhs->as.binary_op.userdata_field) return -1;
+
+    bt_Type* owner = bt_type_dealias(lhs->as.binary_op.left->resulting_type);
+    if (!owner || owner->category != BT_TYPE_CATEGORY_USERDATA) return -1;
+
+    bt_UserdataField* field = owner->as.userdata.fields.elements + lhs->as.binary_op.idx;
+    if (field->getter || !field->bolt_type->as.userdata.value_size) return -1;
+
+    bt_UserdataField* member = field->bolt_type->as.userdata.fields.elements + expr->as.binary_op.idx;
+    if (!member->getter || !member->setter) return -1;
+
+    // both indices are packed into a byte each, userdata with wider field lists take the generic route
+    if (owner->as.userdata.fields.length > 0xFF || field->bolt_type->as.userdata.fields.length > 0xFF) return -1;
+
+    return (lhs->as.binary_op.idx << 8) | expr->as.binary_op.idx;
+}
+
 static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_t result_loc)
 {
     if (ctx->compiler->options.generate_debug_info) {
         ctx->compiler->debug_stack[ctx->compiler->debug_top++] = expr;
     }
 
+    bt_Value folded;
+    if (ctx->compiler->options.optimize_bytecode && (expr->type == BT_AST_NODE_IDENTIFIER || expr->type == BT_AST_NODE_UNARY_OP ||
+        expr->type == BT_AST_NODE_BINARY_OP) && fold_constant(ctx, expr, &folded)) {
+        emit_load_constant(ctx, folded, result_loc);
+
+        if (ctx->compiler->options.generate_debug_info) {
+            --ctx->compiler->debug_top;
+        }
+        return BT_TRUE;
+    }
+
     switch (expr->type) {
     case BT_AST_NODE_LITERAL: {
         bt_Token* inner = expr->source;
@@ -600,15 +975,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
             break;
         case BT_TOKEN_NUMBER_LITERAL: {
             bt_Literal* lit = ctx->compiler->input->tokenizer->literals.elements + inner->idx;
-            bt_number num = lit->as_num;
-
-            if (floor(num) == num && num < (bt_number)INT16_MAX && num >(bt_number)INT16_MIN) {
-                emit_aibc(ctx, BT_OP_LOAD_SMALL, result_loc, (int16_t)num);
-            }
-            else {
-                uint8_t idx = push(ctx, BT_VALUE_NUMBER(lit->as_num));
-                emit_ab(ctx, BT_OP_LOAD, result_loc, idx, BT_FALSE);
-            }
+            emit_load_constant(ctx, BT_VALUE_NUMBER(lit->as_num), result_loc);
         } break;
         case BT_TOKEN_STRING_LITERAL: {
             bt_Literal* lit = ctx->compiler->input->tokenizer->literals.elements + inner->idx;
@@ -667,6 +1034,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
         push_registers(ctx);
 
         uint8_t start_loc = get_registers(ctx, args->length + 1);
+        bt_Value callee = BT_VALUE_NULL;
 
         // TODO(bearish): factor this out with common table indexing code
         if (expr->as.call.is_methodcall) {
@@ -687,6 +1055,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
                 }
                 uint8_t idx = push(ctx, hoisted);
                 emit_ab(ctx, BT_OP_LOAD, start_loc, idx, BT_FALSE);
+                callee = hoisted;
             }
             else if (lhs->as.binary_op.accelerated && ctx->compiler->options.predict_hash_slots) {
                 if (lhs->as.binary_op.left->resulting_type->category != BT_TYPE_CATEGORY_ARRAY) {
@@ -702,18 +1071,23 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
                     BT_VALUE_OBJECT(bt_make_string_hashed_len(ctx->context, rhs->source->source.source, rhs->source->source.length)));
                 bt_Value is_prototypical = get_from_proto(lhs->as.binary_op.from, lhs->as.binary_op.key);
 
-                emit_abc(ctx, (is_prototypical == BT_VALUE_NULL || !ctx->compiler->options.predict_hash_slots) ? BT_OP_LOAD_IDX_K : BT_OP_LOAD_PROTO, start_loc, obj_loc, idx, BT_FALSE);
+                emit_load_idx_k(ctx, is_prototypical, start_loc, obj_loc, idx);
+                callee = is_prototypical;
             }
         }
         else {
             compile_expression(ctx, lhs, start_loc);
+            callee = static_callee(ctx, lhs);
         }
 
         for (uint8_t i = expr->as.call.is_methodcall; i < args->length; i++) {
             compile_expression(ctx, args->elements[i], start_loc + i + 1);
         }
 
-        emit_abc(ctx, BT_OP_CALL, result_loc, start_loc, args->length, BT_FALSE);
+        // the accelerate bit tells calls passing a userdata apart from ones of the same arity passing a number
+        bt_DirectKind direct_kind = direct_call_kind(ctx, callee, args);
+        if (direct_kind != BT_DIRECT_NONE) emit_abc(ctx, BT_OP_CALL_DIRECT, result_loc, start_loc, args->length, bt_direct_takes_userdata(direct_kind));
+        else emit_abc(ctx, BT_OP_CALL, result_loc, start_loc, args->length, BT_FALSE);
 
         restore_registers(ctx);
     } break;
@@ -763,12 +1137,21 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
         restore_registers(ctx);
     } break;
     case BT_AST_NODE_BINARY_OP: {
+        if (ctx->compiler->options.fuse_instructions && is_string_concat(ctx, expr) && is_string_concat(ctx, expr->as.binary_op.left)) {
+            compile_concat(ctx, expr, result_loc);
+            break;
+        }
+
         push_registers(ctx);
 
         bt_AstNode* lhs = expr->as.binary_op.left;
         bt_AstNode* rhs = expr->as.binary_op.right;
 
-        uint8_t lhs_loc = find_binding_or_compile_loc(ctx, lhs, result_loc);
+        // for members of inline value fields the lhs is the owning userdata, the field itself never gets loaded
+        int32_t value_path = get_value_member_path(expr);
+        uint8_t lhs_loc = value_path >= 0
+            ? find_binding_or_compile_loc(ctx, lhs->as.binary_op.left, result_loc)
+            : find_binding_or_compile_loc(ctx, lhs, result_loc);
 
         uint8_t handled = 0;
         uint8_t test = 0;
@@ -776,8 +1159,12 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
         case BT_TOKEN_AND:
             test = 1;
         case BT_TOKEN_OR: {
+            // binding operands aren't compiled into the result, it has to be given their values
+            if (lhs_loc != result_loc) emit_ab(ctx, BT_OP_MOVE, result_loc, lhs_loc, BT_FALSE);
+
             uint32_t instruction_idx = emit_aibc(ctx, BT_OP_TEST, result_loc, 0);
             uint8_t rhs_loc = find_binding_or_compile_loc(ctx, rhs, result_loc);
+            if (rhs_loc != result_loc) emit_ab(ctx, BT_OP_MOVE, result_loc, rhs_loc, BT_FALSE);
 
             bt_Op* test_op = op_at(ctx, instruction_idx);
             uint32_t jmp_loc = op_count(ctx);
@@ -811,6 +1198,12 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
             question_loc = emit_aibc(ctx, BT_OP_TEST, test_loc, 0);
         }
             
+        if (value_path >= 0) {
+            uint8_t idx = push(ctx, bt_make_number(value_path));
+            emit_abc(ctx, BT_OP_LOAD_VALUE_F, result_loc, lhs_loc, idx, BT_FALSE);
+            goto try_store;
+        }
+            
         if (expr->source->type == BT_TOKEN_PERIOD || expr->source->type == BT_TOKEN_QUESTIONPERIOD) {    
         hoist_fail:
             if (expr->as.binary_op.hoistable && ctx->compiler->options.allow_method_hoisting) {
@@ -825,7 +1218,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
                 goto try_store;
             }
             else if (expr->as.binary_op.accelerated && ctx->compiler->options.predict_hash_slots) {
-                if (expr->as.binary_op.left->resulting_type->category != BT_TYPE_CATEGORY_ARRAY) {
+                if (expr->as.binary_op.left->resulting_type->category != BT_TYPE_CATEGORY_ARRAY && !is_typed_array(expr->as.binary_op.left->resulting_type)) {
                     uint8_t idx = push(ctx,
                         BT_VALUE_OBJECT(bt_make_string_hashed_len(ctx->context, rhs->source->source.source, rhs->source->source.length)));
                     
@@ -839,12 +1232,25 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
                     BT_VALUE_OBJECT(bt_make_string_hashed_len(ctx->context, rhs->source->source.source, rhs->source->source.length)));
 
                 bt_Value is_prototypical = get_from_proto(expr->as.binary_op.from, expr->as.binary_op.key);
-                emit_abc(ctx, (is_prototypical == BT_VALUE_NULL || !ctx->compiler->options.predict_hash_slots) ? BT_OP_LOAD_IDX_K : BT_OP_LOAD_PROTO, result_loc, lhs_loc, idx, BT_FALSE);
+                emit_load_idx_k(ctx, is_prototypical, result_loc, lhs_loc, idx);
 
                 goto try_store;
             }
         }
             
+        if (ctx->compiler->options.fuse_instructions && ctx->compiler->options.accelerate_arithmetic && expr->as.binary_op.accelerated) {
+            bt_TokenType op_type = expr->source->type;
+            int16_t imm;
+            if ((op_type == BT_TOKEN_PLUS || op_type == BT_TOKEN_PLUSEQ || op_type == BT_TOKEN_MINUS || op_type == BT_TOKEN_MINUSEQ) && get_small_int_literal(ctx, rhs, &imm)) {
+                if (op_type == BT_TOKEN_MINUS || op_type == BT_TOKEN_MINUSEQ) imm = -imm;
+                if (imm >= INT8_MIN && imm <= INT8_MAX) {
+                    emit_abc(ctx, BT_OP_ADD_I, result_loc, lhs_loc, (uint8_t)(int8_t)imm, BT_TRUE);
+                    goto try_store;
+                }
+            }
+        }
+
+        uint32_t rhs_start = op_count(ctx);
         uint8_t rhs_loc = find_binding_or_compile_temp(ctx, rhs);
 
 #define HOISTABLE_OP(unhoisted) \
@@ -904,6 +1310,8 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
         case BT_TOKEN_PERIOD:
             if (expr->as.binary_op.accelerated && expr->as.binary_op.left->resulting_type->category == BT_TYPE_CATEGORY_ARRAY && ctx->compiler->options.typed_array_subscript) {
                 emit_abc(ctx, BT_OP_LOAD_SUB_F, result_loc, lhs_loc, rhs_loc, BT_FALSE);
+            } else if (expr->as.binary_op.accelerated && is_typed_array(expr->as.binary_op.left->resulting_type) && ctx->compiler->options.typed_array_subscript) {
+                emit_abc(ctx, BT_OP_LOAD_ELEM_F, result_loc, lhs_loc, rhs_loc, BT_FALSE);
             } else emit_abc(ctx, BT_OP_LOAD_IDX, result_loc, lhs_loc, rhs_loc, BT_FALSE);
             break;
         case BT_TOKEN_EQUALS:
@@ -925,7 +1333,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
             emit_abc(ctx, BT_OP_LTE, result_loc, rhs_loc, lhs_loc, expr->as.binary_op.accelerated && ctx->compiler->options.accelerate_arithmetic);
             break;
         case BT_TOKEN_ASSIGN:
-            emit_ab(ctx, BT_OP_MOVE, result_loc, rhs_loc, BT_FALSE);
+            emit_move(ctx, result_loc, rhs_loc, rhs, rhs_start);
             break;
         default:
             compile_error_token(ctx->compiler, "Invalid binary operator '%*s'", expr->source);
@@ -952,6 +1360,15 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
         }
         else if (storage == STORAGE_INDEX) {
             push_registers(ctx);
+
+            int32_t store_path = get_value_member_path(lhs);
+            if (store_path >= 0) {
+                uint8_t obj_loc = find_binding_or_compile_temp(ctx, lhs->as.binary_op.left->as.binary_op.left);
+                uint8_t idx = push(ctx, bt_make_number(store_path));
+                emit_abc(ctx, BT_OP_STORE_VALUE_F, obj_loc, idx, result_loc, BT_FALSE);
+                goto stored_fast;
+            }
+
             uint8_t tbl_loc = find_binding_or_compile_temp(ctx, lhs->as.binary_op.left);
 
             if (lhs->as.binary_op.accelerated) {
@@ -961,6 +1378,12 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
                     uint8_t idx_loc = find_binding_or_compile_temp(ctx, lhs->as.binary_op.right);
                     emit_abc(ctx, BT_OP_STORE_SUB_F, tbl_loc, idx_loc, result_loc, BT_FALSE);
                 }
+                else if (is_typed_array(lhs->as.binary_op.left->resulting_type)) {
+                    if (!ctx->compiler->options.typed_array_subscript) goto failed_array;
+
+                    uint8_t idx_loc = find_binding_or_compile_temp(ctx, lhs->as.binary_op.right);
+                    emit_abc(ctx, BT_OP_STORE_ELEM_F, tbl_loc, idx_loc, result_loc, BT_FALSE);
+                }
                 else if (ctx->compiler->options.predict_hash_slots)
                 {
                     bt_Token* source = lhs->as.binary_op.right->source;
@@ -979,7 +1402,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
                 bt_Token* source = lhs->as.binary_op.right->source;
                 uint8_t idx = push(ctx,
                     BT_VALUE_OBJECT(bt_make_string_hashed_len(ctx->context, source->source.source, source->source.length)));
-                emit_abc(ctx, BT_OP_STORE_IDX_K, tbl_loc, idx, result_loc, BT_FALSE);
+                emit_store_idx_k(ctx, tbl_loc, idx, result_loc);
                 goto stored_fast;
             }
 
@@ -1034,12 +1457,12 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
 
             if (expr->as.table.typed && ctx->compiler->options.predict_hash_slots && expr->resulting_type->as.table_shape.sealed) {
                 bt_Table* layout = resulting->as.table_shape.layout;
-                int16_t idx = bt_table_get_idx(layout, entry->as.table_field.key);
+                int32_t idx = bt_table_get_idx(layout, entry->as.table_field.key);
                 uint8_t key_idx = push(ctx, entry->as.table_field.key);
 
                 // If index is too large for acceleration, or part of an unsealed table, fallback to the slow method
                 if (idx == -1 || idx > UINT8_MAX) {
-                    emit_abc(ctx, BT_OP_STORE_IDX_K, result_loc, key_idx, val_loc, BT_FALSE);
+                    emit_store_idx_k(ctx, result_loc, key_idx, val_loc);
                 } else {
                     emit_abc(ctx, BT_OP_STORE_IDX, result_loc, (uint8_t)idx, val_loc, BT_TRUE);
                     emit_aibc(ctx, BT_OP_IDX_EXT, 0, key_idx);
@@ -1047,7 +1470,7 @@ static bt_bool compile_expression(FunctionContext* ctx, bt_AstNode* expr, uint8_
             }
             else {
                 uint8_t key_idx = push(ctx, entry->as.table_field.key);
-                emit_abc(ctx, BT_OP_STORE_IDX_K, result_loc, key_idx, val_loc, BT_FALSE);
+                emit_store_idx_k(ctx, result_loc, key_idx, val_loc);
             }
         }
 
@@ -1131,6 +1554,10 @@ static bt_bool compile_expression_body(FunctionContext* ctx, bt_AstBuffer* body,
             ctx->pending_breaks[ctx->loop_depth - 1][ctx->break_counts[ctx->loop_depth - 1]++] = break_loc;
         }
         else if (!compile_statement(ctx, stmt)) { pop_scope(ctx); return BT_FALSE; }
+
+        // nothing after leaving the block can run
+        bt_AstNodeType stmt_type = stmt->type;
+        if (ctx->compiler->options.optimize_bytecode && (stmt_type == BT_AST_NODE_RETURN || stmt_type == BT_AST_NODE_BREAK || stmt_type == BT_AST_NODE_CONTINUE)) break;
     }
 
     if (is_expr) {
@@ -1192,7 +1619,7 @@ static bt_bool compile_match(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_
         
         bt_AstNode* branch = stmt->as.match.branches.elements[i];
         uint8_t condition_loc = find_binding_or_compile_temp(ctx, branch->as.match_branch.condition);
-        uint32_t jmp_loc = emit_a(ctx, BT_OP_JMPF, condition_loc);
+        uint32_t jmp_loc = emit_jmpf(ctx, branch->as.match_branch.condition, condition_loc);
 
         if (is_expr) {
             uint8_t result_loc = expr_loc;
@@ -1252,8 +1679,21 @@ static bt_bool compile_if(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_exp
         }
         
         uint32_t jump_loc = 0;
+        bt_bool has_jump = BT_FALSE, always_taken = BT_FALSE;
+
+        bt_Value folded;
+        if (ctx->compiler->options.optimize_bytecode && !current->as.branch.is_let && current->as.branch.condition &&
+            fold_constant(ctx, current->as.branch.condition, &folded) && BT_IS_BOOL(folded)) {
+            // a branch that can never be taken isn't compiled, one that always is ends the chain
+            if (BT_IS_FALSE(folded)) {
+                current = current->as.branch.next;
+                restore_registers(ctx);
+                continue;
+            }
 
-        if (current->as.branch.is_let) {
+            always_taken = BT_TRUE;
+        }
+        else if (current->as.branch.is_let) {
             push_scope(ctx);
             uint8_t bind_loc = make_binding(ctx, current->as.branch.identifier->source, current->as.branch.identifier);
             compile_expression(ctx, current->as.branch.condition, bind_loc);
@@ -1262,10 +1702,12 @@ static bt_bool compile_if(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_exp
             emit_a(ctx, BT_OP_LOAD_NULL, test_loc);
             emit_abc(ctx, BT_OP_NEQ, test_loc, bind_loc, test_loc, BT_FALSE);
             jump_loc = emit_a(ctx, BT_OP_JMPF, test_loc);
+            has_jump = BT_TRUE;
         }
         else if (current->as.branch.condition) {
             uint8_t condition_loc = find_binding_or_compile_temp(ctx, current->as.branch.condition);
-            jump_loc = emit_a(ctx, BT_OP_JMPF, condition_loc);
+            jump_loc = emit_jmpf(ctx, current->as.branch.condition, condition_loc);
+            has_jump = BT_TRUE;
         }
 
         if (is_expr) {
@@ -1278,18 +1720,18 @@ static bt_bool compile_if(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_exp
             compile_body(ctx, &current->as.branch.body);
         }
         
-        if (current->as.branch.next) end_points[end_top++] = emit(ctx, BT_OP_JMP);
+        if (current->as.branch.next && !always_taken) end_points[end_top++] = emit(ctx, BT_OP_JMP);
         
         if (current->as.branch.is_let) {
             pop_scope(ctx);
         }
 
-        if (current->as.branch.condition) {
+        if (has_jump) {
             bt_Op* jmpf = op_at(ctx, jump_loc);
             BT_SET_IBC(*jmpf, ctx->output.length - jump_loc - 1);
         }
 
-        current = current->as.branch.next;
+        current = always_taken ? NULL : current->as.branch.next;
         restore_registers(ctx);
     }
 
@@ -1302,6 +1744,123 @@ static bt_bool compile_if(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_exp
     return BT_TRUE;
 }
 
+// Registers above this are left to the loop body, hoisting is only worth it while there's room to spare
+#define INVARIANT_REGISTER_LIMIT 128
+
+static void hoist_invariant(FunctionContext* ctx, bt_AstNode* operand)
+{
+    if (ctx->invariant_top == MAX_INVARIANTS || find_invariant(ctx, operand) != INVALID_BINDING) return;
+
+    Invariant invariant;
+    invariant.constant = BT_VALUE_NULL;
+    invariant.import_idx = UINT16_MAX;
+
+    if (operand->type == BT_AST_NODE_IMPORT_REFERENCE) {
+        invariant.import_idx = find_import(ctx, operand->source->source);
+        if (invariant.import_idx == INVALID_BINDING) return;
+    }
+    else if (!fold_constant(ctx, operand, &invariant.constant)) return;
+
+    invariant.loc = get_register(ctx);
+    if (invariant.loc >= INVARIANT_REGISTER_LIMIT) return;
+
+    if (invariant.import_idx != UINT16_MAX) emit_ab(ctx, BT_OP_LOAD_IMPORT, invariant.loc, (uint8_t)invariant.import_idx, BT_FALSE);
+    else emit_load_constant(ctx, invariant.constant, invariant.loc);
+
+    ctx->invariants[ctx->invariant_top++] = invariant;
+}
+
+static void hoist_invariants(FunctionContext* ctx, bt_AstNode* node);
+
+static void hoist_invariants_in(FunctionContext* ctx, bt_AstBuffer* body)
+{
+    for (uint32_t i = 0; i < body->length; ++i) {
+        if (body->elements[i]) hoist_invariants(ctx, body->elements[i]);
+    }
+}
+
+// Loads the constants and imports `node` uses as operands, which would otherwise be loaded into a temporary on every
+// iteration, into registers kept for the rest of the loop. Uses find them through find_binding_or_compile_temp
+static void hoist_invariants(FunctionContext* ctx, bt_AstNode* node)
+{
+    if (!node) return;
+
+    bt_Value folded;
+    switch (node->type) {
+    case BT_AST_NODE_UNARY_OP:
+        if (node->as.unary_op.operand->type == BT_AST_NODE_IMPORT_REFERENCE) hoist_invariant(ctx, node->as.unary_op.operand);
+        hoist_invariants(ctx, node->as.unary_op.operand);
+        break;
+    case BT_AST_NODE_BINARY_OP: {
+        if (fold_constant(ctx, node, &folded)) break;
+
+        bt_AstNode* rhs = node->as.binary_op.right;
+        bt_TokenType op_type = node->source->type;
+        bt_bool is_additive = op_type == BT_TOKEN_PLUS || op_type == BT_TOKEN_PLUSEQ || op_type == BT_TOKEN_MINUS || op_type == BT_TOKEN_MINUSEQ;
+
+        // the lhs is compiled into the result, and small additions are already folded into ADD_I
+        int16_t imm;
+        bt_bool is_temp = op_type != BT_TOKEN_AND && op_type != BT_TOKEN_OR && op_type != BT_TOKEN_ASSIGN &&
+            !(is_additive && get_small_int_literal(ctx, rhs, &imm));
+        if (is_temp && (rhs->type == BT_AST_NODE_IMPORT_REFERENCE || fold_constant(ctx, rhs, &folded))) hoist_invariant(ctx, rhs);
+
+        hoist_invariants(ctx, node->as.binary_op.left);
+        hoist_invariants(ctx, rhs);
+    } break;
+    case BT_AST_NODE_LET:
+        hoist_invariants(ctx, node->as.let.initializer);
+        break;
+    case BT_AST_NODE_RETURN:
+        hoist_invariants(ctx, node->as.ret.expr);
+        break;
+    case BT_AST_NODE_EXPORT:
+        hoist_invariants(ctx, node->as.exp.value);
+        break;
+    case BT_AST_NODE_CALL:
+        hoist_invariants(ctx, node->as.call.fn);
+    case BT_AST_NODE_RECURSIVE_CALL:
+        hoist_invariants_in(ctx, &node->as.call.args);
+        break;
+    case BT_AST_NODE_IF:
+        hoist_invariants(ctx, node->as.branch.condition);
+        hoist_invariants_in(ctx, &node->as.branch.body);
+        hoist_invariants(ctx, node->as.branch.next);
+        break;
+    case BT_AST_NODE_MATCH:
+        hoist_invariants(ctx, node->as.match.condition);
+        hoist_invariants_in(ctx, &node->as.match.branches);
+        hoist_invariants_in(ctx, &node->as.match.else_branch);
+        break;
+    case BT_AST_NODE_MATCH_BRANCH:
+        hoist_invariants(ctx, node->as.match_branch.condition);
+        hoist_invariants_in(ctx, &node->as.match_branch.body);
+        break;
+    case BT_AST_NODE_LOOP_WHILE:
+        hoist_invariants(ctx, node->as.loop_while.condition);
+        hoist_invariants_in(ctx, &node->as.loop.body);
+        break;
+    case BT_AST_NODE_LOOP_ITERATOR:
+        hoist_invariants(ctx, node->as.loop_iterator.iterator);
+        hoist_invariants_in(ctx, &node->as.loop.body);
+        break;
+    case BT_AST_NODE_LOOP_NUMERIC:
+        hoist_invariants_in(ctx, &node->as.loop.body);
+        break;
+    case BT_AST_NODE_TABLE:
+        hoist_invariants_in(ctx, &node->as.table.fields);
+        break;
+    case BT_AST_NODE_TABLE_ENTRY:
+        hoist_invariants(ctx, node->as.table_field.value_expr);
+        break;
+    case BT_AST_NODE_ARRAY:
+        hoist_invariants_in(ctx, &node->as.arr.items);
+        break;
+    default:
+        // functions are compiled separately, with their own loops
+        break;
+    }
+}
+
 static bt_bool compile_for(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_expr, uint8_t expr_loc)
 {
     push_registers(ctx);
@@ -1310,6 +1869,12 @@ static bt_bool compile_for(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_ex
     if (is_expr) {
         emit_aibc(ctx, BT_OP_ARRAY, expr_loc, 0);
     }
+
+    uint8_t invariant_base = ctx->invariant_top;
+    if (ctx->compiler->options.optimize_bytecode) {
+        if (stmt->type == BT_AST_NODE_LOOP_WHILE) hoist_invariants(ctx, stmt->as.loop_while.condition);
+        hoist_invariants_in(ctx, &stmt->as.loop.body);
+    }
     
     uint32_t loop_start, skip_loc;
     switch (stmt->type) {
@@ -1344,8 +1909,16 @@ static bt_bool compile_for(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_ex
             uint8_t condition_loc = get_register(ctx);
 
             loop_start = ctx->output.length;
+
+            // `while true` only ever exits through a break or return
+            bt_Value folded;
+            if (ctx->compiler->options.optimize_bytecode && fold_constant(ctx, stmt->as.loop_while.condition, &folded) && BT_IS_TRUE(folded)) {
+                skip_loc = UINT32_MAX;
+                break;
+            }
+
             compile_expression(ctx, stmt->as.loop_while.condition, condition_loc);
-            skip_loc = emit_aibc(ctx, BT_OP_JMPF, condition_loc, 0);
+            skip_loc = emit_jmpf(ctx, stmt->as.loop_while.condition, condition_loc);
         } break;
     default:
         compile_error_token(ctx->compiler, "Invalid loop type '%*s'", stmt->source);
@@ -1363,10 +1936,13 @@ static bt_bool compile_for(FunctionContext* ctx, bt_AstNode* stmt, bt_bool is_ex
     }
 
     emit_aibc(ctx, BT_OP_JMP, 0, loop_start - ctx->output.length - 1);
-    bt_Op* skip_op = op_at(ctx, skip_loc);
-    BT_SET_IBC(*skip_op, ctx->output.length - skip_loc - 1);
+    if (skip_loc != UINT32_MAX) {
+        bt_Op* skip_op = op_at(ctx, skip_loc);
+        BT_SET_IBC(*skip_op, ctx->output.length - skip_loc - 1);
+    }
     
     resolve_breaks(ctx);
+    ctx->invariant_top = invariant_base;
     pop_scope(ctx);
     restore_registers(ctx);
 
@@ -1381,6 +1957,20 @@ static bt_bool compile_statement(FunctionContext* ctx, bt_AstNode* stmt)
 
     switch (stmt->type) {
     case BT_AST_NODE_LET: {
+        // a const binding whose value is known is folded into every use, so it needs neither a register nor the store
+        bt_Value folded;
+        if (ctx->compiler->options.optimize_bytecode && stmt->as.let.is_const && stmt->as.let.initializer &&
+            fold_constant(ctx, stmt->as.let.initializer, &folded)) {
+            make_binding_at_loc(ctx, stmt->as.let.name, INVALID_BINDING, stmt->source);
+            ctx->bindnings[ctx->binding_top - 1].constant = folded;
+            ctx->bindnings[ctx->binding_top - 1].is_constant = BT_TRUE;
+
+            if (ctx->compiler->options.generate_debug_info) {
+                --ctx->compiler->debug_top;
+            }
+            return BT_TRUE;
+        }
+
         uint8_t new_loc = make_binding(ctx, stmt->as.let.name, stmt->source);
         if (new_loc == INVALID_BINDING) compile_error_token(ctx->compiler, "Failed to make binding for '%.*s'", stmt->source);
         if (stmt->as.let.initializer) {
@@ -1398,6 +1988,17 @@ static bt_bool compile_statement(FunctionContext* ctx, bt_AstNode* stmt)
     case BT_AST_NODE_RETURN: {
         if (stmt->as.ret.expr) {
             uint8_t ret_loc = find_binding_or_compile_temp(ctx, stmt->as.ret.expr);
+
+            // `return f(...)` reuses the current frame when f is a bolt function, the RETURN still handles native callees
+            bt_AstNodeType expr_type = stmt->as.ret.expr->type;
+            if ((expr_type == BT_AST_NODE_CALL || expr_type == BT_AST_NODE_RECURSIVE_CALL) && ctx->output.length) {
+                bt_Op* last = ctx->output.elements + ctx->output.length - 1;
+                if (BT_GET_A(*last) == ret_loc) {
+                    if (BT_GET_OPCODE(*last) == BT_OP_CALL) *last = BT_MAKE_OP_ABC(BT_OP_TAILCALL, BT_GET_A(*last), BT_GET_B(*last), BT_GET_C(*last));
+                    else if (BT_GET_OPCODE(*last) == BT_OP_REC_CALL) *last = BT_MAKE_OP_ABC(BT_OP_REC_TAILCALL, BT_GET_A(*last), BT_GET_B(*last), BT_GET_C(*last));
+                }
+            }
+
             emit_a(ctx, BT_OP_RETURN, ret_loc);
         }
         else {
@@ -1440,7 +2041,12 @@ static bt_bool compile_statement(FunctionContext* ctx, bt_AstNode* stmt)
         }
         else {
             uint8_t binding_loc = find_binding(ctx, stmt->as.exp.name);
-            if (binding_loc == INVALID_BINDING) {
+            bt_Value constant;
+            if (binding_loc == INVALID_BINDING && find_constant(ctx, stmt->as.exp.name, &constant)) {
+                binding_loc = get_register(ctx);
+                emit_load_constant(ctx, constant, binding_loc);
+            }
+            else if (binding_loc == INVALID_BINDING) {
                 uint8_t alias_loc = find_named(ctx, stmt->as.exp.name);
                 if (alias_loc == INVALID_BINDING) {
                     compile_error_token(ctx->compiler, "Failed to find identifer '%.*s' for export", stmt->source);
@@ -22,6 +22,12 @@ typedef struct bt_CompilerOptions {
 	bt_bool predict_hash_slots;
 	/** If enabled, the compiler will generate accelerated opcodes for array indexing whenever the type information allows */
 	bt_bool typed_array_subscript;
+	/** If enabled, the compiler will fuse common instruction sequences (numeric compare + branch, add of a small constant) into single opcodes */
+	bt_bool fuse_instructions;
+	/** If enabled, calls to natives registered with `bt_make_native_direct` pass their statically typed arguments unboxed, without a native frame */
+	bt_bool direct_native_calls;
+	/** If enabled, the compiler folds constant expressions, skips unreachable code, coalesces moves between temporaries and loads loop invariant operands once before the loop */
+	bt_bool optimize_bytecode;
 } bt_CompilerOptions;
 
 typedef struct bt_Compiler {
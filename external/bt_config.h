@@ -20,6 +20,14 @@
 // compiled bytecode to the console.
 //#define BOLT_PRINT_DEBUG
 
+// Counts executed opcodes and adjacent opcode pairs in the context, dump them with `bt_debug_dump_op_histogram`.
+// Useful to find out which instruction sequences are worth fusing, slows down dispatch noticeably.
+//#define BOLT_OP_HISTOGRAM
+
+// Counts hits and misses of the inline caches on field accesses by constant key per instruction,
+// dump them with `bt_debug_dump_ic_stats`. Useful to find code that keeps taking the generic lookup.
+//#define BOLT_IC_STATS
+
 // Inline threading allows for bolt to make indirect jumps from each instruction to each next instruction
 // In theory, this increases performance due to branch prediction, but costs more code size.
 // Will increase perf in most scenarios, but not all.
@@ -60,10 +68,10 @@
 #define BT_CALLSTACK_SIZE 128
 #endif
 
-// The number of root entries in the string deduplication table
-// 126 is tuned to cover the standard ascii charset 
+// The initial number of slots in the string deduplication table, must be a power of two
+// The table doubles in size whenever it becomes half full
 #ifndef BT_STRINGTABLE_SIZE
-#define BT_STRINGTABLE_SIZE 126
+#define BT_STRINGTABLE_SIZE 256
 #endif
 
 // The maximum length of a string that is considered for interning
@@ -72,6 +80,34 @@
 #define BT_STRINGTABLE_MAX_LEN 24
 #endif
 
+// The number of entries at which an outline table builds an open-addressing hash index over its pairs
+// Below this, lookups are a linear scan, which is faster for the small shapes most scripts use
+// Inline tables (literals and tableshape instances) are never hashed, so their slots stay predictable
+#ifndef BT_TABLE_HASH_THRESHOLD
+#define BT_TABLE_HASH_THRESHOLD 16
+#endif
+
+// The largest struct that can be declared with bt_make_value_type, members of inline value fields are copied through a buffer this size on the stack
+#ifndef BT_VALUE_TYPE_MAX_SIZE
+#define BT_VALUE_TYPE_MAX_SIZE 64
+#endif
+
+// Objects up to this many bytes are allocated from size-class pages instead of the general purpose allocator
+// Must be a multiple of 16, every 16 bytes adds a size class
+#ifndef BT_POOL_MAX_OBJECT_SIZE
+#define BT_POOL_MAX_OBJECT_SIZE 256
+#endif
+
+// The size of a single page of pooled objects, pages are allocated aligned to this size so it must be a power of two
+#ifndef BT_POOL_PAGE_SIZE
+#define BT_POOL_PAGE_SIZE (16 * 1024)
+#endif
+
+// The number of empty pages kept by the pool for reuse before they are returned to the page allocator
+#ifndef BT_POOL_CACHED_PAGES
+#define BT_POOL_CACHED_PAGES 8
+#endif
+
 // The size of the temporary root stack kept by the bolt context
 // to stop temporary objects from being collected while in use 
 #ifndef BT_TEMPROOTS_SIZE
@@ -11,6 +11,7 @@ extern "C" {
 #include "bt_object.h"
 #include "bt_gc.h"
 #include "bt_compiler.h"
+#include "bt_pool.h"
 
 #include <setjmp.h>
 #include <stdint.h>
@@ -18,19 +19,43 @@ extern "C" {
 typedef void* (*bt_Alloc)(size_t size);
 typedef void* (*bt_Realloc)(void* ptr, size_t size);
 typedef void (*bt_Free)(void* ptr);
+typedef void* (*bt_AllocPage)(size_t size);
+typedef void (*bt_FreePage)(void* page, size_t size);
 
 typedef char* (*bt_ReadFile)(bt_Context* ctx, const char* path, void** out_handle);
 typedef void (*bt_CloseFile)(bt_Context* ctx, const char* path, void*  in_handle);
 typedef void (*bt_FreeSource)(bt_Context* ctx, char* source);
 typedef void (*bt_Write)(bt_Context* ctx, const char* msg);
 
+#ifdef BOLT_IC_STATS
+#define BT_IC_STATS_SITES 1024
+
+/** Hit counters of a single inline cache, `site` is the extension op holding the cache */
+typedef struct bt_InlineCacheSite {
+	bt_Op* site;
+	uint64_t hits, misses;
+	char location[64];
+} bt_InlineCacheSite;
+#endif
+
 /** An entry into the string deduplication table */
 typedef struct bt_StringTableEntry {
 	uint64_t hash;
 	bt_String* string;
 } bt_StringTableEntry;
 
-typedef bt_Buffer(bt_StringTableEntry) bt_StringTableBucket;
+/** Open-addressed set of interned strings, probed linearly from their hash and compared bytewise */
+typedef struct bt_StringTable {
+	bt_StringTableEntry* entries;
+	uint32_t capacity, count;
+} bt_StringTable;
+
+/** Occupancy and probe length statistics for the string deduplication table */
+typedef struct bt_StringTableStats {
+	uint32_t entries, capacity;
+	uint32_t max_probe;
+	double avg_probe;
+} bt_StringTableStats;
 
 /** Error category passed to the callback provided in the handlers */
 typedef enum {
@@ -62,6 +87,17 @@ typedef struct bt_NativeFrame {
 	int8_t return_loc;
 } bt_NativeFrame;
 
+/** Caller state saved when a bolt function calls another bolt function, restored when the callee returns inside the same interpreter loop */
+typedef struct bt_ScriptFrame {
+	bt_Op* ip;
+	bt_Value* constants;
+	bt_Value* upv;
+	bt_Module* module;
+	uint32_t top;
+	int8_t return_loc;
+	bt_bool is_iter;
+} bt_ScriptFrame;
+
 /** Module include path template */
 typedef struct bt_Path {
 	char* spec;
@@ -74,6 +110,9 @@ typedef struct bt_Path {
  * free - matching free
  * realloc - matching realloc
  *
+ * alloc_page - optional, allocates a block of `size` bytes aligned to `size`, used for pooled objects (see bt_pool.h)
+ * free_page - matching free
+ *
  * on_error - callback for whenever the parser, compiler, or runtime encounters an error
  *
  * write - print a string to stdout
@@ -86,6 +125,8 @@ typedef struct bt_Handlers {
 	bt_Alloc alloc;
 	bt_Free free;
 	bt_Realloc realloc;
+	bt_AllocPage alloc_page;
+	bt_FreePage free_page;
 	bt_ErrorFunc on_error;
 
 	bt_Write write;
@@ -106,6 +147,8 @@ struct bt_Context {
 	bt_Alloc alloc;
 	bt_Free free;
 	bt_Realloc realloc;
+	bt_AllocPage alloc_page;
+	bt_FreePage free_page;
 	bt_ErrorFunc on_error;
 
 	bt_Write write;
@@ -120,11 +163,15 @@ struct bt_Context {
 	uint32_t troot_top;
 
 	bt_GC gc;
+	bt_Pool pool;
 	uint32_t n_allocated;
 
 	bt_Path* module_paths;
+	// see bt_image.h, searched in order before the module paths
+	const struct bt_Image** images;
+	uint32_t image_count;
 
-	bt_StringTableBucket string_table[BT_STRINGTABLE_SIZE];
+	bt_StringTable string_table;
 
 	struct {
 		bt_Type* any;
@@ -135,6 +182,8 @@ struct bt_Context {
 		bt_Type* array;
 		bt_Type* table;
 		bt_Type* type;
+		bt_Type* coroutine;
+		bt_Type* channel;
 	} types;
 
 	struct {
@@ -155,6 +204,26 @@ struct bt_Context {
 	bt_Table* native_references;
 
 	struct bt_Thread* current_thread;
+	// runner threads not currently used by a coroutine, linked through `outer`
+	struct bt_Thread* idle_runners;
+
+	// see bt_module_cache.h, NULL unless enabled
+	struct bt_ModuleCache* module_cache;
+
+	// see bt_profiler.h, the interpreter only calls into the profiler while `profiling` is set
+	struct bt_Profiler* profiler;
+	bt_bool profiling;
+
+#ifdef BOLT_OP_HISTOGRAM
+	uint64_t op_counts[BT_OP_COUNT];
+	uint64_t op_pairs[BT_OP_COUNT][BT_OP_COUNT];
+#endif
+
+#ifdef BOLT_IC_STATS
+	// open addressed by site, sites past capacity aren't recorded
+	bt_InlineCacheSite ic_sites[BT_IC_STATS_SITES];
+	uint32_t ic_site_count;
+#endif
 };
 
 /** A single thread of bolt execution. Threads cannot be executed in parallel on the same context, but can be suspended and swapped */
@@ -168,10 +237,22 @@ typedef struct bt_Thread {
 	bt_NativeFrame native_stack[BT_CALLSTACK_SIZE];
 	uint32_t native_depth;
 
+	// indexed by callstack depth, only valid for frames entered from bolt code
+	bt_ScriptFrame script_stack[BT_CALLSTACK_SIZE];
+
 	bt_String* last_error;
 	jmp_buf error_loc;
 
 	bt_Context* context;
+
+	// the thread that was current when this one started executing, scanned by the gc along with it
+	struct bt_Thread* outer;
+
+	// set while the thread is running a coroutine, see bt_coroutine.h
+	struct bt_Coroutine* coroutine;
+	bt_Value yield_value;
+	uint32_t reentry;
+	bt_bool yielding;
 	
 	bt_bool should_report;
 } bt_Thread;
@@ -231,6 +312,10 @@ BOLT_API uint32_t bt_get_debug_index(bt_Callable* callable, bt_Op* ip);
 BOLT_API bt_String* bt_get_or_make_interned(bt_Context* ctx, const char* str, uint32_t len);
 /** Evict a string from the deduplication table */
 BOLT_API void bt_remove_interned(bt_Context* ctx, bt_String* str);
+/** Drop every interned string that wasn't marked by the gc, called once marking completes */
+BOLT_API void bt_sweep_interned(bt_Context* ctx);
+/** Gather occupancy and probe length statistics for the string deduplication table */
+BOLT_API bt_StringTableStats bt_get_string_table_stats(bt_Context* ctx);
 
 #if __cplusplus
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_context.h"
+
+/***
+ * Resumable script functions. A coroutine wraps a bolt function that can suspend itself with `bt_yield`, handing a value back
+ * to whoever resumed it, and later continue from the same point when resumed again.
+ *
+ * Coroutines don't own a thread. They run on runner threads borrowed from the context for the duration of a resume,
+ * and on yield the live part of the runner (values, frames and the instruction pointer) is copied into a snapshot sized to fit.
+ * A suspended coroutine therefore only costs its snapshot, which grows to the deepest point it has yielded from and is reused after that.
+ *
+ * Yielding is only possible from bolt code running directly inside the coroutine, not from bolt code called back by a native function.
+ * Coroutines are userdata of the `Coroutine` type, and keep their function and suspended values alive while reachable.
+ */
+
+typedef enum {
+	BT_COROUTINE_READY,
+	BT_COROUTINE_SUSPENDED,
+	BT_COROUTINE_RUNNING,
+	BT_COROUTINE_DONE,
+	BT_COROUTINE_FAILED,
+} bt_CoroutineStatus;
+
+typedef struct bt_Coroutine {
+	bt_Callable* entry;
+
+	// one allocation: `stack_size` values, then `depth` callstack frames, then `depth` script frames
+	uint8_t* snapshot;
+	uint32_t stack_size, depth, capacity;
+
+	// state of the innermost suspended frame, the outer ones are kept in the saved script frames
+	uint32_t top, resume_loc;
+	bt_Op* ip;
+	bt_Value* constants;
+	bt_Module* module;
+	int8_t return_loc;
+
+	bt_CoroutineStatus status;
+} bt_Coroutine;
+
+/** Wraps `callable` in a new coroutine that starts running it on the first resume. `callable` must be a bolt function taking no arguments */
+BOLT_API bt_Userdata* bt_make_coroutine(bt_Context* ctx, bt_Callable* callable);
+/** Returns the coroutine state held by `coroutine`, which must be userdata of the `Coroutine` type */
+BOLT_API bt_Coroutine* bt_coroutine_get(bt_Userdata* coroutine);
+/** Returns the status of `coroutine` */
+BOLT_API bt_CoroutineStatus bt_coroutine_status(bt_Userdata* coroutine);
+
+/**
+ * Runs `coroutine` until it yields or returns. `value` becomes the result of the pending yield and is ignored on the first resume.
+ * On success `result` receives the yielded or returned value, check the status to tell them apart.
+ * Returns BT_FALSE if the coroutine can't be resumed or raised an error, which leaves it in the failed state.
+ */
+BOLT_API bt_bool bt_resume(bt_Context* ctx, bt_Userdata* coroutine, bt_Value value, bt_Value* result);
+
+/** Suspends the coroutine running on `thread` once the calling native function returns, passing `value` to the resumer */
+BOLT_API void bt_yield(bt_Thread* thread, bt_Value value);
+
+#if __cplusplus
+}
+#endif
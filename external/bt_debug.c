@@ -2,8 +2,10 @@
 
 #include "bt_value.h"
 #include "bt_gc.h"
+#include "bt_context.h"
 
 #include <stdio.h>
+#include <string.h>
 
 static const char* ast_node_type_to_string(bt_AstNode* node)
 {
@@ -159,7 +161,12 @@ static bt_bool is_op_abc(uint8_t op) {
 	case BT_OP_COALESCE: case BT_OP_TCHECK:
 	case BT_OP_TCAST: case BT_OP_TSET:
 	case BT_OP_CALL: case BT_OP_REC_CALL:
+	case BT_OP_TAILCALL: case BT_OP_REC_TAILCALL:
 	case BT_OP_LOAD_SUB_F: case BT_OP_STORE_SUB_F:
+	case BT_OP_ADD_I:
+	case BT_OP_LOAD_VALUE_F: case BT_OP_STORE_VALUE_F:
+	case BT_OP_LOAD_ELEM_F: case BT_OP_STORE_ELEM_F:
+	case BT_OP_CONCAT: case BT_OP_CALL_DIRECT:
 		return BT_TRUE;
 	default:
 		return BT_FALSE;
@@ -173,6 +180,8 @@ static bt_bool is_op_ab(uint8_t op) {
 	case BT_OP_NEG: case BT_OP_NOT:
 	case BT_OP_EXPECT:
 	case BT_OP_APPEND_F:
+	case BT_OP_LT_JMPF: case BT_OP_LTE_JMPF:
+	case BT_OP_EQ_JMPF: case BT_OP_NEQ_JMPF:
 		return BT_TRUE;
 	default:
 		return BT_FALSE;
@@ -337,3 +346,119 @@ bt_String* bt_debug_dump_fn(bt_Context* ctx, bt_Callable* function)
 
 	return result;
 }
+
+bt_String* bt_debug_dump_op_histogram(bt_Context* ctx, uint32_t max_entries)
+{
+#ifdef BOLT_OP_HISTOGRAM
+	// this function does a lot of intermediate allocating, let's pause until end
+	bt_gc_pause(ctx);
+
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < BT_OP_COUNT; ++i) total += ctx->op_counts[i];
+
+	char buffer[128];
+	bt_String* result = bt_make_string_empty(ctx, 0);
+	buffer[sprintf(buffer, "Executed ops: %llu\n\tOpcodes:\n", (unsigned long long)total)] = 0;
+	result = bt_string_append_cstr(ctx, result, buffer);
+
+	// repeatedly pick the largest remaining entry, the tables are tiny so this is plenty fast
+	uint8_t taken[BT_OP_COUNT] = { 0 };
+	for (uint32_t n = 0; n < max_entries; ++n) {
+		int32_t best = -1;
+		for (uint32_t i = 0; i < BT_OP_COUNT; ++i) {
+			if (!taken[i] && ctx->op_counts[i] && (best < 0 || ctx->op_counts[i] > ctx->op_counts[best])) best = i;
+		}
+		if (best < 0) break;
+
+		taken[best] = 1;
+		buffer[sprintf(buffer, "\t  %-14s %12llu  %5.2f%%\n", op_to_mnemonic[best], (unsigned long long)ctx->op_counts[best],
+			total ? 100.0 * (double)ctx->op_counts[best] / (double)total : 0.0)] = 0;
+		result = bt_string_append_cstr(ctx, result, buffer);
+	}
+
+	result = bt_string_append_cstr(ctx, result, "\tPairs:\n");
+
+	uint64_t last_count = UINT64_MAX;
+	uint32_t last_idx = 0;
+	for (uint32_t n = 0; n < max_entries; ++n) {
+		// entries are visited in descending count order, ties broken by index
+		int32_t best = -1;
+		for (uint32_t i = 0; i < BT_OP_COUNT * BT_OP_COUNT; ++i) {
+			uint64_t count = ctx->op_pairs[i / BT_OP_COUNT][i % BT_OP_COUNT];
+			if (!count || count > last_count || (count == last_count && i <= last_idx)) continue;
+			if (best < 0 || count > ctx->op_pairs[best / BT_OP_COUNT][best % BT_OP_COUNT]) best = i;
+		}
+		if (best < 0) break;
+
+		last_count = ctx->op_pairs[best / BT_OP_COUNT][best % BT_OP_COUNT];
+		last_idx = best;
+		buffer[sprintf(buffer, "\t  %-14s -> %-14s %12llu\n", op_to_mnemonic[best / BT_OP_COUNT], op_to_mnemonic[best % BT_OP_COUNT], (unsigned long long)last_count)] = 0;
+		result = bt_string_append_cstr(ctx, result, buffer);
+	}
+
+	bt_gc_unpause(ctx);
+	return result;
+#else
+	return bt_make_string(ctx, "Op histogram is disabled, define BOLT_OP_HISTOGRAM in bt_config.h");
+#endif
+}
+
+void bt_debug_reset_op_histogram(bt_Context* ctx)
+{
+#ifdef BOLT_OP_HISTOGRAM
+	memset(ctx->op_counts, 0, sizeof(ctx->op_counts));
+	memset(ctx->op_pairs, 0, sizeof(ctx->op_pairs));
+#endif
+}
+
+bt_String* bt_debug_dump_ic_stats(bt_Context* ctx, uint32_t max_entries)
+{
+#ifdef BOLT_IC_STATS
+	// this function does a lot of intermediate allocating, let's pause until end
+	bt_gc_pause(ctx);
+
+	uint64_t hits = 0, misses = 0;
+	for (uint32_t i = 0; i < BT_IC_STATS_SITES; ++i) {
+		hits += ctx->ic_sites[i].hits;
+		misses += ctx->ic_sites[i].misses;
+	}
+
+	char buffer[160];
+	bt_String* result = bt_make_string_empty(ctx, 0);
+	buffer[sprintf(buffer, "Inline caches: %u sites, %llu hits, %llu misses, %5.2f%% hit rate\n", ctx->ic_site_count,
+		(unsigned long long)hits, (unsigned long long)misses, hits + misses ? 100.0 * (double)hits / (double)(hits + misses) : 0.0)] = 0;
+	result = bt_string_append_cstr(ctx, result, buffer);
+
+	// sites that miss the most come first, they're the ones still paying for the generic lookup
+	uint8_t taken[BT_IC_STATS_SITES] = { 0 };
+	for (uint32_t n = 0; n < max_entries; ++n) {
+		int32_t best = -1;
+		for (uint32_t i = 0; i < BT_IC_STATS_SITES; ++i) {
+			bt_InlineCacheSite* site = ctx->ic_sites + i;
+			if (taken[i] || !site->site) continue;
+			if (best < 0 || site->misses > ctx->ic_sites[best].misses ||
+				(site->misses == ctx->ic_sites[best].misses && site->hits > ctx->ic_sites[best].hits)) best = i;
+		}
+		if (best < 0) break;
+
+		taken[best] = 1;
+		bt_InlineCacheSite* site = ctx->ic_sites + best;
+		buffer[sprintf(buffer, "\t  %-40.40s %12llu hits %12llu misses  %5.2f%%\n", site->location, (unsigned long long)site->hits,
+			(unsigned long long)site->misses, 100.0 * (double)site->hits / (double)(site->hits + site->misses))] = 0;
+		result = bt_string_append_cstr(ctx, result, buffer);
+	}
+
+	bt_gc_unpause(ctx);
+	return result;
+#else
+	return bt_make_string(ctx, "Inline cache stats are disabled, define BOLT_IC_STATS in bt_config.h");
+#endif
+}
+
+void bt_debug_reset_ic_stats(bt_Context* ctx)
+{
+#ifdef BOLT_IC_STATS
+	memset(ctx->ic_sites, 0, sizeof(ctx->ic_sites));
+	ctx->ic_site_count = 0;
+#endif
+}
@@ -20,6 +20,22 @@ BOLT_API void bt_debug_print_parse_tree(bt_Parser* parser);
  */
 BOLT_API bt_String* bt_debug_dump_fn(bt_Context* ctx, bt_Callable* function);
 
+/**
+ * Dumps the `max_entries` most executed opcodes and adjacent opcode pairs recorded since the last reset.
+ * Only records anything if `BOLT_OP_HISTOGRAM` is defined, useful to decide which instruction sequences to fuse.
+ */
+BOLT_API bt_String* bt_debug_dump_op_histogram(bt_Context* ctx, uint32_t max_entries);
+/** Clears the counters dumped by `bt_debug_dump_op_histogram` */
+BOLT_API void bt_debug_reset_op_histogram(bt_Context* ctx);
+
+/**
+ * Dumps the hit and miss counts of the inline caches on field accesses by constant key, worst `max_entries` sites first.
+ * Only records anything if `BOLT_IC_STATS` is defined, sites are named by module path and line.
+ */
+BOLT_API bt_String* bt_debug_dump_ic_stats(bt_Context* ctx, uint32_t max_entries);
+/** Clears the counters dumped by `bt_debug_dump_ic_stats` */
+BOLT_API void bt_debug_reset_ic_stats(bt_Context* ctx);
+
 #if __cplusplus
 }
 #endif
\ No newline at end of file
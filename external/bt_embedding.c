@@ -29,6 +29,7 @@ BOLT_API bt_Value bt_getup(bt_Thread* thread, uint8_t idx)
 BOLT_API void bt_setup(bt_Thread* thread, uint8_t idx, bt_Value value)
 {
 	BT_CLOSURE_UPVALS(BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]))[idx] = value;
+	BT_GC_BARRIER(thread->context, value);
 }
 
 bt_Module* bt_get_module(bt_Thread* thread)
@@ -5,11 +5,13 @@
 #endif
 
 #include <string.h>
+#include <time.h>
 
 #include "bt_type.h"
 #include "bt_context.h"
 #include "bt_compiler.h"
 #include "bt_userdata.h"
+#include "bt_profiler.h"
 
 void* bt_gc_alloc(bt_Context* ctx, size_t size)
 {
@@ -43,16 +45,31 @@ void bt_gc_free(bt_Context* ctx, void* ptr, size_t size)
 	ctx->free(ptr);
 }
 
+static void gc_allocation_step(bt_GC* gc);
+
 bt_Object* bt_allocate(bt_Context* context, uint32_t full_size, bt_ObjectType type)
 {
-	bt_Object* obj = bt_gc_alloc(context, full_size);
+	// small objects come from the size-class pool, which also accounts for them
+	bt_Object* obj = bt_pool_alloc(context, full_size);
+	bt_bool pooled = obj != NULL;
+	if (!pooled) obj = bt_gc_alloc(context, full_size);
 	memset(obj, 0, full_size);
 
 	BT_OBJECT_SET_TYPE(obj, type);
+	if (pooled) BT_OBJECT_SET_POOLED(obj);
 	if (context->next) BT_OBJECT_SET_NEXT(context->next, obj);
 	context->next = obj;
 
-	if (context->gc.bytes_allocated >= context->gc.next_cycle) {
+	// Objects created mid-cycle are allocated black, they are revisited when marking finishes
+	if (context->gc.phase != BT_GC_PHASE_IDLE) BT_OBJECT_MARK(obj);
+
+	// While a cycle is in flight every allocation pays for a slice of it, bounding how much garbage can float
+	if (context->gc.step_size && (context->gc.phase != BT_GC_PHASE_IDLE || context->gc.bytes_allocated >= context->gc.next_cycle)) {
+		bt_push_root(context, obj);
+		gc_allocation_step(&context->gc);
+		bt_pop_root(context);
+	}
+	else if (context->gc.bytes_allocated >= context->gc.next_cycle) {
 		bt_push_root(context, obj);
 		bt_collect(&context->gc, 0);
 		bt_pop_root(context);
@@ -84,6 +101,7 @@ static void free_subobjects(bt_Context* context, bt_Object* obj)
 	} break;
 	case BT_OBJECT_TYPE_MODULE: {
 		bt_Module* mod = (bt_Module*)obj;
+		if (context->profiler) bt_profiler_forget(context, obj);
 		bt_buffer_destroy(context, &mod->constants);
 		bt_buffer_destroy(context, &mod->instructions);
 		bt_buffer_destroy(context, &mod->imports);
@@ -97,11 +115,13 @@ static void free_subobjects(bt_Context* context, bt_Object* obj)
 
 			bt_buffer_destroy(context, &mod->debug_tokens);
 			bt_gc_free(context, mod->debug_locs, sizeof(bt_DebugLocBuffer));
-			context->free(mod->debug_source); // FIXME: Size of this is not tracked
+			// Modules loaded from serialized blobs carry debug locations without source text
+			if (mod->debug_source) context->free(mod->debug_source); // FIXME: Size of this is not tracked
 		}
 	} break;
 	case BT_OBJECT_TYPE_FN: {
 		bt_Fn* fn = (bt_Fn*)obj;
+		if (context->profiler) bt_profiler_forget(context, obj);
 		bt_buffer_destroy(context, &fn->constants);
 		bt_buffer_destroy(context, &fn->instructions);
 		if (fn->debug) {
@@ -109,10 +129,13 @@ static void free_subobjects(bt_Context* context, bt_Object* obj)
 			bt_gc_free(context, fn->debug, sizeof(bt_DebugLocBuffer));
 		}
 	} break;
+	case BT_OBJECT_TYPE_NATIVE_FN:
+		if (context->profiler) bt_profiler_forget(context, obj);
+		break;
 	case BT_OBJECT_TYPE_TABLE: {
 		bt_Table* tbl = (bt_Table*)obj;
 		if (!tbl->is_inline && tbl->capacity > 0) {
-			bt_gc_free(context, tbl->outline, tbl->capacity * sizeof(bt_TablePair));
+			bt_gc_free(context, tbl->outline, tbl->capacity * sizeof(bt_TablePair) + bt_table_index_capacity(tbl) * sizeof(uint32_t));
 		}
 	} break;
 	case BT_OBJECT_TYPE_STRING: {
@@ -162,7 +185,8 @@ static size_t get_object_size(bt_Object* obj)
 void bt_free(bt_Context* context, bt_Object* obj)
 {
 	free_subobjects(context, obj);
-	bt_gc_free(context, obj, get_object_size(obj));
+	if (BT_OBJECT_IS_POOLED(obj)) bt_pool_free(context, obj);
+	else bt_gc_free(context, obj, get_object_size(obj));
 }
 
 void bt_make_gc(bt_Context* ctx)
@@ -176,6 +200,8 @@ void bt_make_gc(bt_Context* ctx)
 	bt_gc_set_min_size(ctx, ctx->gc.next_cycle);
 	bt_gc_set_growth_pct(ctx, 150);
 	bt_gc_set_pause_growth_pct(ctx, 115);
+	bt_gc_set_step_size(ctx, 64);
+	bt_gc_set_step_start_pct(ctx, 80);
 }
 
 void bt_destroy_gc(bt_Context* ctx, bt_GC* gc)
@@ -235,6 +261,26 @@ void bt_gc_set_pause_growth_pct(bt_Context* ctx, size_t growth_pct)
 	ctx->gc.pause_growth_pct = (uint32_t)growth_pct;
 }
 
+uint32_t bt_gc_get_step_size(bt_Context* ctx)
+{
+	return ctx->gc.step_size;
+}
+
+void bt_gc_set_step_size(bt_Context* ctx, uint32_t step_size)
+{
+	ctx->gc.step_size = step_size;
+}
+
+uint32_t bt_gc_get_step_start_pct(bt_Context* ctx)
+{
+	return ctx->gc.step_start_pct;
+}
+
+void bt_gc_set_step_start_pct(bt_Context* ctx, uint32_t step_start_pct)
+{
+	ctx->gc.step_start_pct = step_start_pct;
+}
+
 static void grey(bt_GC* gc, bt_Object* obj) {
 	if (!obj || BT_OBJECT_GET_MARK(obj)) return;
 
@@ -370,6 +416,10 @@ static void blacken(bt_GC* gc, bt_Object* obj)
 	case BT_OBJECT_TYPE_USERDATA: {
 		bt_Userdata* userdata = (bt_Userdata*)obj;
 		grey(gc, (bt_Object*)userdata->type);
+		// userdata is rooted by its allocation before the type is set, with a zeroed payload
+		if (userdata->type && userdata->type->as.userdata.tracer) {
+			userdata->type->as.userdata.tracer(gc->ctx, userdata);
+		}
 	} break;
 	case BT_OBJECT_TYPE_ARRAY: {
 		bt_Array* arr = (bt_Array*)obj;
@@ -392,13 +442,8 @@ static void calc_next_cycle(bt_GC* gc, size_t growth_factor)
 	if (gc->next_cycle < gc->min_size) gc->next_cycle = gc->min_size;
 }
 
-uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
+static void grey_roots(bt_GC* gc)
 {
-	if (gc->pause_count > 0) {
-		calc_next_cycle(gc, gc->pause_growth_pct);
-		return 0;
-	}
-	
 	bt_Context* ctx = gc->ctx;
 
 	grey(gc, (bt_Object*)ctx->types.any);
@@ -409,6 +454,8 @@ uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
 	grey(gc, (bt_Object*)ctx->types.array);
 	grey(gc, (bt_Object*)ctx->types.table);
 	grey(gc, (bt_Object*)ctx->types.type);
+	grey(gc, (bt_Object*)ctx->types.coroutine);
+	grey(gc, (bt_Object*)ctx->types.channel);
 	
 	grey(gc, (bt_Object*)ctx->meta_names.add);
 	grey(gc, (bt_Object*)ctx->meta_names.sub);
@@ -426,12 +473,12 @@ uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
 	grey(gc, (bt_Object*)ctx->loaded_modules);
 	grey(gc, (bt_Object*)ctx->native_references);
 
-	for (uint32_t i = 0; i < gc->ctx->troot_top; ++i) {
-		grey(gc, (bt_Object*)gc->ctx->troots[i]);
+	for (uint32_t i = 0; i < ctx->troot_top; ++i) {
+		grey(gc, (bt_Object*)ctx->troots[i]);
 	}
 	
-	if (gc->ctx->current_thread) {
-		bt_Thread* thr = gc->ctx->current_thread;
+	// threads that started another one are suspended in a native call until it finishes, their stacks are still live
+	for (bt_Thread* thr = ctx->current_thread; thr; thr = thr->outer) {
 		uint32_t top = thr->top + BT_STACKFRAME_GET_SIZE(thr->callstack[thr->depth - 1]) 
 			+ BT_STACKFRAME_GET_USER_TOP(thr->callstack[thr->depth - 1]);
 
@@ -445,28 +492,63 @@ uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
 			if (BT_IS_OBJECT(val)) grey(gc, BT_AS_OBJECT(val));
 		}
 
-		grey(gc, (bt_Object*)gc->ctx->current_thread->last_error);
+		grey(gc, (bt_Object*)thr->last_error);
 	}
+}
+
+static void begin_cycle(bt_GC* gc)
+{
+	gc->phase = BT_GC_PHASE_MARK;
+	gc->cycle_tail = gc->ctx->next;
+	grey_roots(gc);
+}
 
-	while (gc->grey_count) {
+/** Blacken up to `budget` pending greys, or all of them if `budget` is 0. Returns the number of objects traversed */
+static uint32_t propagate(bt_GC* gc, uint32_t budget)
+{
+	uint32_t n_traversed = 0;
+	while (gc->grey_count && (budget == 0 || n_traversed < budget)) {
 		bt_Object* obj = gc->greys[--gc->grey_count];
 		blacken(gc, obj);
+		n_traversed++;
 	}
 
-	// Clear interned strings that are no longer referenced from the string table
-	for (uint32_t i = 0; i < BT_STRINGTABLE_SIZE; i++) {
-		bt_StringTableBucket* bucket = &ctx->string_table[i];
-		for (uint32_t idx = 0; idx < bucket->length; ++idx) {
-			if (!BT_OBJECT_GET_MARK((bt_Object*)bucket->elements[idx].string)) {
-				bucket->elements[idx] = bucket->elements[--bucket->length];
-				idx--;				
-			}
-		}
+	return n_traversed;
+}
+
+/** Atomically completes the mark phase. Roots are re-scanned as the stack isn't covered by write barriers */
+static void finish_mark(bt_GC* gc)
+{
+	bt_Context* ctx = gc->ctx;
+
+	grey_roots(gc);
+
+	// Anything allocated since the cycle began was born black, and may have had white objects stored into it unguarded
+	bt_Object* current = gc->cycle_tail ? (bt_Object*)BT_OBJECT_NEXT(gc->cycle_tail) : NULL;
+	while (current) {
+		blacken(gc, current);
+		current = (bt_Object*)BT_OBJECT_NEXT(current);
 	}
-	
-	uint32_t n_collected = 0;
 
-	bt_Object* prev = ctx->root;
+	propagate(gc, 0);
+
+	// Clear interned strings that are no longer referenced from the string table
+	bt_sweep_interned(ctx);
+
+	gc->cycle_tail = NULL;
+	gc->sweep_prev = ctx->root;
+	gc->phase = BT_GC_PHASE_SWEEP;
+}
+
+/** 
+ * Sweep up to `budget` objects, or the whole heap if `budget` is 0, stopping early once `n_collected` reaches `max_collect`.
+ * Returns BT_TRUE if the sweep finished and the cycle is complete
+ */
+static bt_bool sweep(bt_GC* gc, uint32_t budget, uint32_t max_collect, uint32_t* n_collected)
+{
+	bt_Context* ctx = gc->ctx;
+
+	bt_Object* prev = gc->sweep_prev;
 	bt_Object* current = (bt_Object*)BT_OBJECT_NEXT(prev);
 
 	bt_Thread gc_thread = { 0 };
@@ -476,7 +558,16 @@ uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
 	bt_Thread* old_thr = ctx->current_thread;
 	ctx->current_thread = &gc_thread;
 
+	uint32_t n_swept = 0;
 	while (current) {
+		if ((budget != 0 && n_swept >= budget) || (max_collect != 0 && *n_collected >= max_collect)) {
+			gc->sweep_prev = prev;
+			ctx->current_thread = old_thr;
+			return BT_FALSE;
+		}
+
+		n_swept++;
+
 		if (BT_OBJECT_GET_MARK(current)) {
 			BT_OBJECT_CLEAR(current);
 
@@ -488,16 +579,116 @@ uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
 				
 			current = (bt_Object*)BT_OBJECT_NEXT(current);
 			BT_OBJECT_SET_NEXT(prev, current);
+			if (ctx->next == to_free) ctx->next = prev;
 			bt_free(ctx, to_free);
 
-			n_collected++;
-			if (max_collect != 0 && n_collected >= max_collect) return n_collected;
+			(*n_collected)++;
 		}
 	}
 
-	calc_next_cycle(gc, gc->cycle_growth_pct);
 	ctx->current_thread = old_thr;
 
+	gc->sweep_prev = NULL;
+	gc->phase = BT_GC_PHASE_IDLE;
+	calc_next_cycle(gc, gc->cycle_growth_pct);
+
+	return BT_TRUE;
+}
+
+/** Perform roughly `budget` units of incremental work on the current cycle. Returns BT_TRUE once the cycle is complete */
+static bt_bool advance(bt_GC* gc, uint32_t budget, uint32_t* n_collected)
+{
+	if (gc->phase == BT_GC_PHASE_MARK) {
+		if (gc->grey_count) {
+			propagate(gc, budget);
+			return BT_FALSE;
+		}
+
+		finish_mark(gc);
+	}
+
+	if (gc->phase == BT_GC_PHASE_SWEEP) {
+		return sweep(gc, budget, 0, n_collected);
+	}
+
+	return BT_TRUE;
+}
+
+static void gc_allocation_step(bt_GC* gc)
+{
+	if (gc->pause_count > 0) {
+		calc_next_cycle(gc, gc->pause_growth_pct);
+		return;
+	}
+
+	if (gc->phase == BT_GC_PHASE_IDLE) begin_cycle(gc);
+
+	uint32_t n_collected = 0;
+	advance(gc, gc->step_size, &n_collected);
+}
+
+uint32_t bt_collect(bt_GC* gc, uint32_t max_collect)
+{
+	if (gc->pause_count > 0) {
+		calc_next_cycle(gc, gc->pause_growth_pct);
+		return 0;
+	}
+	
+	uint32_t n_collected = 0;
+
+	// Objects allocated during an in-flight cycle were assumed live, so finish it before starting a fresh one
+	if (gc->phase == BT_GC_PHASE_MARK) {
+		propagate(gc, 0);
+		finish_mark(gc);
+	}
+
+	if (gc->phase == BT_GC_PHASE_SWEEP) {
+		if (!sweep(gc, 0, max_collect, &n_collected)) return n_collected;
+	}
+
+	begin_cycle(gc);
+	propagate(gc, 0);
+	finish_mark(gc);
+	sweep(gc, 0, max_collect, &n_collected);
+
+	return n_collected;
+}
+
+static uint64_t get_timestamp_us()
+{
+	struct timespec ts;
+#ifdef _MSC_VER
+	timespec_get(&ts, TIME_UTC);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+	uint64_t seconds = ts.tv_sec;
+	uint64_t nano_seconds = ts.tv_nsec;
+
+	return (seconds * 1000000) + (nano_seconds / 1000);
+}
+
+// How many objects to process between checks of the clock in bt_gc_step
+#define BT_GC_STEP_GRANULARITY 64
+
+uint32_t bt_gc_step(bt_Context* ctx, uint32_t budget_us)
+{
+	bt_GC* gc = &ctx->gc;
+	if (gc->pause_count > 0) return 0;
+
+	if (gc->phase == BT_GC_PHASE_IDLE) {
+		if (gc->bytes_allocated < (gc->next_cycle / 100) * gc->step_start_pct) return 0;
+		begin_cycle(gc);
+	}
+
+	uint32_t n_collected = 0;
+	uint64_t start = get_timestamp_us();
+
+	while (!advance(gc, BT_GC_STEP_GRANULARITY, &n_collected)) {
+		if (get_timestamp_us() - start >= budget_us) break;
+	}
+
 	return n_collected;
 }
 
@@ -8,6 +8,13 @@ extern "C" {
 
 #include <stdint.h>
 
+/** The phase an incremental gc cycle is currently in */
+typedef enum {
+	BT_GC_PHASE_IDLE,
+	BT_GC_PHASE_MARK,
+	BT_GC_PHASE_SWEEP,
+} bt_GCPhase;
+
 /** Contains all internal state for the garbage collector, such as memory stats and pending greys */
 typedef struct bt_GC {
 	size_t next_cycle, bytes_allocated, min_size;
@@ -16,6 +23,11 @@ typedef struct bt_GC {
 	bt_Object** greys;
 	uint32_t pause_count;
 
+	uint32_t step_size, step_start_pct;
+	bt_GCPhase phase;
+	bt_Object* cycle_tail;
+	bt_Object* sweep_prev;
+
 	bt_Context* ctx;
 } bt_GC;
 
@@ -77,10 +89,27 @@ BOLT_API size_t bt_gc_get_pause_growth_pct(bt_Context* ctx);
 /** Set the percentage of slack given if the gc hits the threshold during a pause, expressed as an integer */
 BOLT_API void bt_gc_set_pause_growth_pct(bt_Context* ctx, size_t growth_pct);
 
+/** Get the number of objects traversed or swept per allocation while a cycle is in progress. 0 means full collections are ran instead */
+BOLT_API uint32_t bt_gc_get_step_size(bt_Context* ctx);
+/** Set the number of objects traversed or swept per allocation while a cycle is in progress. 0 means full collections are ran instead */
+BOLT_API void bt_gc_set_step_size(bt_Context* ctx, uint32_t step_size);
+
+/** Get the percentage of the cycle threshold at which `bt_gc_step` starts a new incremental cycle, expressed as an integer */
+BOLT_API uint32_t bt_gc_get_step_start_pct(bt_Context* ctx);
+/** Set the percentage of the cycle threshold at which `bt_gc_step` starts a new incremental cycle, expressed as an integer */
+BOLT_API void bt_gc_set_step_start_pct(bt_Context* ctx, uint32_t step_start_pct);
+
 /** Add an object to the grey set, meaning it'll be traversed during the next cycle */
 BOLT_API void bt_grey_obj(bt_Context* ctx, bt_Object* obj);
-/** Perform a gc cycle, stopping after `max_collect` objects. Returns the number of objects collected */
+/** Finish any in-progress cycle, then perform a full one, stopping after `max_collect` objects. Returns the number of objects collected */
 BOLT_API uint32_t bt_collect(bt_GC* gc, uint32_t max_collect);
+/** Advance the incremental collector for at most `budget_us` microseconds, starting a new cycle if needed. Returns the number of objects collected */
+BOLT_API uint32_t bt_gc_step(bt_Context* ctx, uint32_t budget_us);
+
+/** Write barrier, must be used when storing `value` into an object that may already have been traversed */
+#define BT_GC_BARRIER(ctx, value) do { \
+	if ((ctx)->gc.phase == BT_GC_PHASE_MARK && BT_IS_OBJECT(value)) bt_grey_obj((ctx), BT_AS_OBJECT(value)); \
+} while (0)
 
 /** Pauses the gc, stopping it from cycling even if over budget. Uses a counter internally to allow safe nesting */
 BOLT_API void bt_gc_pause(bt_Context* ctx);
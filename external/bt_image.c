@@ -0,0 +1,143 @@
+#include "bt_image.h"
+
+#include "bt_context.h"
+#include "bt_gc.h"
+#include "bt_serialize.h"
+
+#include <string.h>
+
+typedef struct bt_ImageModule {
+	char* name;
+	uint32_t name_len;
+	uint8_t* data;
+	size_t size;
+} bt_ImageModule;
+
+struct bt_Image {
+	bt_Alloc alloc;
+	bt_Realloc realloc;
+	bt_Free free;
+
+	bt_ImageModule* modules;
+	uint32_t count, capacity;
+	bt_bool frozen;
+};
+
+bt_Image* bt_make_image(bt_Context* ctx)
+{
+	bt_Image* image = ctx->alloc(sizeof(bt_Image));
+	image->alloc = ctx->alloc;
+	image->realloc = ctx->realloc;
+	image->free = ctx->free;
+	image->modules = NULL;
+	image->count = 0;
+	image->capacity = 0;
+	image->frozen = BT_FALSE;
+	return image;
+}
+
+void bt_destroy_image(bt_Image* image)
+{
+	for (uint32_t i = 0; i < image->count; ++i) {
+		image->free(image->modules[i].name);
+		image->free(image->modules[i].data);
+	}
+
+	if (image->modules) image->free(image->modules);
+	image->free(image);
+}
+
+static bt_ImageModule* find_module(const bt_Image* image, const char* name, uint32_t name_len)
+{
+	for (uint32_t i = 0; i < image->count; ++i) {
+		bt_ImageModule* module = image->modules + i;
+		if (module->name_len == name_len && memcmp(module->name, name, name_len) == 0) return module;
+	}
+
+	return NULL;
+}
+
+bt_bool bt_image_add_serialized(bt_Image* image, const char* name, const void* data, size_t size)
+{
+	uint32_t name_len = (uint32_t)strlen(name);
+	if (image->frozen || find_module(image, name, name_len)) return BT_FALSE;
+
+	if (image->count == image->capacity) {
+		image->capacity = image->capacity ? image->capacity * 2 : 8;
+		image->modules = image->realloc(image->modules, image->capacity * sizeof(bt_ImageModule));
+	}
+
+	bt_ImageModule* module = image->modules + image->count++;
+	module->name = image->alloc(name_len + 1);
+	memcpy(module->name, name, name_len + 1);
+	module->name_len = name_len;
+	module->data = image->alloc(size);
+	memcpy(module->data, data, size);
+	module->size = size;
+	return BT_TRUE;
+}
+
+typedef struct bt_ImageWrite {
+	bt_Image* image;
+	const char* name;
+	bt_bool added;
+} bt_ImageWrite;
+
+static void write_module(void* userdata, const void* data, size_t size)
+{
+	bt_ImageWrite* write = userdata;
+	write->added = bt_image_add_serialized(write->image, write->name, data, size);
+}
+
+bt_bool bt_image_add_module(bt_Context* ctx, bt_Image* image, const char* name, bt_Module* module)
+{
+	if (image->frozen || find_module(image, name, (uint32_t)strlen(name))) return BT_FALSE;
+
+	bt_ImageWrite write = { image, name, BT_FALSE };
+	if (!bt_serialize_module(ctx, module, BT_TRUE, write_module, &write)) return BT_FALSE;
+	return write.added;
+}
+
+void bt_image_freeze(bt_Image* image)
+{
+	image->frozen = BT_TRUE;
+}
+
+bt_bool bt_image_has_module(const bt_Image* image, const char* name)
+{
+	return find_module(image, name, (uint32_t)strlen(name)) != NULL;
+}
+
+bt_bool bt_attach_image(bt_Context* ctx, const bt_Image* image)
+{
+	if (!image->frozen) return BT_FALSE;
+
+	for (uint32_t i = 0; i < ctx->image_count; ++i) {
+		if (ctx->images[i] == image) return BT_TRUE;
+	}
+
+	ctx->images = bt_gc_realloc(ctx, (void*)ctx->images, ctx->image_count * sizeof(bt_Image*), (ctx->image_count + 1) * sizeof(bt_Image*));
+	ctx->images[ctx->image_count++] = image;
+	return BT_TRUE;
+}
+
+void bt_detach_image(bt_Context* ctx, const bt_Image* image)
+{
+	for (uint32_t i = 0; i < ctx->image_count; ++i) {
+		if (ctx->images[i] != image) continue;
+
+		memmove((void*)(ctx->images + i), ctx->images + i + 1, (ctx->image_count - i - 1) * sizeof(bt_Image*));
+		--ctx->image_count;
+		return;
+	}
+}
+
+bt_Module* bt_image_load_module(bt_Context* ctx, bt_String* name)
+{
+	for (uint32_t i = 0; i < ctx->image_count; ++i) {
+		bt_ImageModule* module = find_module(ctx->images[i], BT_STRING_STR(name), name->len);
+		if (module) return bt_deserialize_module(ctx, module->data, module->size, module->name);
+	}
+
+	return NULL;
+}
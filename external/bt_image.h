@@ -0,0 +1,48 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_object.h"
+
+/***
+ * Images share compiled modules between contexts. An image is a read-only set of serialized modules, filled in by one context
+ * and then frozen, after which any number of contexts on any os threads can attach it at the same time.
+ *
+ * Importing a module that isn't loaded yet checks the attached images before the module paths, so every context runs its own
+ * instance of the module, with its own globals, materialized from the shared bytecode without compiling it again.
+ * Live objects are never shared, each context keeps its own heap and collector and the contexts don't need to be synchronized.
+ *
+ * Like serialized modules, image modules resolve their imports and registered types against the loading context,
+ * so contexts attaching an image need the same native modules and types as the one that built it.
+ */
+
+typedef struct bt_Image bt_Image;
+
+/** Creates an empty image, allocated with the handlers of `ctx` but otherwise independent of it */
+BOLT_API bt_Image* bt_make_image(bt_Context* ctx);
+/** Frees `image`, every context it's attached to must have been closed or detached it first */
+BOLT_API void bt_destroy_image(bt_Image* image);
+
+/** Serializes `module` into `image` under `name`, the name it's imported by. Fails if the image is frozen or the name is taken */
+BOLT_API bt_bool bt_image_add_module(bt_Context* ctx, bt_Image* image, const char* name, bt_Module* module);
+/** Copies an already serialized module into `image` under `name`, see `bt_serialize_module`. Fails if the image is frozen or the name is taken */
+BOLT_API bt_bool bt_image_add_serialized(bt_Image* image, const char* name, const void* data, size_t size);
+/** Makes `image` read-only, it can't be attached before this */
+BOLT_API void bt_image_freeze(bt_Image* image);
+/** Returns whether `image` has a module named `name` */
+BOLT_API bt_bool bt_image_has_module(const bt_Image* image, const char* name);
+
+/** Makes the modules in the frozen `image` importable in `ctx`. Images attached earlier take precedence */
+BOLT_API bt_bool bt_attach_image(bt_Context* ctx, const bt_Image* image);
+/** Stops importing from `image` in `ctx`. Modules already loaded from it stay loaded */
+BOLT_API void bt_detach_image(bt_Context* ctx, const bt_Image* image);
+
+/** Loads the module `name` from the images attached to `ctx`, without registering it. Returns NULL if no image has it or it fails to load */
+BOLT_API bt_Module* bt_image_load_module(bt_Context* ctx, bt_String* name);
+
+#if __cplusplus
+}
+#endif
@@ -0,0 +1,310 @@
+#include "bt_module_cache.h"
+
+#include "bt_context.h"
+#include "bt_gc.h"
+#include "bt_serialize.h"
+
+#include <string.h>
+
+#define CACHE_MAGIC 0x434d5442 // "BTMC"
+
+typedef struct bt_ModuleCache {
+	bt_ReadCache read;
+	bt_WriteCache write;
+	void* userdata;
+	// owned copy when the cache was set up by `bt_set_module_cache_dir`
+	char* directory;
+} bt_ModuleCache;
+
+typedef struct Output {
+	bt_Context* ctx;
+	uint8_t* data;
+	size_t length, capacity;
+	bt_bool serialized;
+} Output;
+
+typedef struct Input {
+	const uint8_t* current;
+	const uint8_t* end;
+} Input;
+
+static uint64_t mix(uint64_t h, uint64_t value)
+{
+	h ^= value;
+	h *= 0x5bd1e9955bd1e995;
+	h ^= h >> 47;
+	return h;
+}
+
+// Everything that changes the compiled output of a source file, bump alongside new compiler options
+static uint64_t entry_key(bt_Context* ctx, bt_String* name, uint64_t source_hash)
+{
+	bt_CompilerOptions* options = &ctx->compiler_options;
+	uint64_t flags = (uint64_t)options->generate_debug_info | ((uint64_t)options->accelerate_arithmetic << 1) |
+		((uint64_t)options->allow_method_hoisting << 2) | ((uint64_t)options->predict_hash_slots << 3) |
+		((uint64_t)options->typed_array_subscript << 4) | ((uint64_t)options->fuse_instructions << 5) |
+		((uint64_t)options->direct_native_calls << 6) | ((uint64_t)options->optimize_bytecode << 7);
+
+#ifdef BOLT_BITMASK_OP
+	flags |= 1ull << 32;
+#endif
+
+	uint64_t key = mix(source_hash, bt_hash_str(BT_STRING_STR(name), name->len));
+	key = mix(key, flags);
+	return mix(key, BT_SERIALIZE_VERSION);
+}
+
+static void put(Output* out, const void* data, size_t size)
+{
+	if (out->length + size > out->capacity) {
+		size_t new_capacity = out->capacity ? out->capacity * 2 : 256;
+		while (new_capacity < out->length + size) new_capacity *= 2;
+
+		out->data = out->ctx->realloc(out->data, new_capacity);
+		out->capacity = new_capacity;
+	}
+
+	memcpy(out->data + out->length, data, size);
+	out->length += size;
+}
+
+static void put_u32(Output* out, uint32_t value) { put(out, &value, sizeof(value)); }
+static void put_u64(Output* out, uint64_t value) { put(out, &value, sizeof(value)); }
+
+static bt_bool take(Input* in, void* out, size_t size)
+{
+	if ((size_t)(in->end - in->current) < size) return BT_FALSE;
+	memcpy(out, in->current, size);
+	in->current += size;
+	return BT_TRUE;
+}
+
+static void write_serialized(void* userdata, const void* data, size_t size)
+{
+	Output* out = userdata;
+	put(out, data, size);
+	out->serialized = BT_TRUE;
+}
+
+static void silent_error(bt_ErrorType type, const char* module, const char* message, uint16_t line, uint16_t col) {}
+
+// The loaded module an import was taken from, found the same way the serializer names it
+static int32_t import_owner(bt_Context* ctx, bt_ModuleImport* import)
+{
+	bt_TablePair* pairs = BT_TABLE_PAIRS(ctx->loaded_modules);
+	for (uint32_t i = 0; i < ctx->loaded_modules->length; ++i) {
+		if (!BT_IS_OBJECT(pairs[i].value) || BT_OBJECT_GET_TYPE(BT_AS_OBJECT(pairs[i].value)) != BT_OBJECT_TYPE_MODULE) continue;
+
+		bt_Module* mod = (bt_Module*)BT_AS_OBJECT(pairs[i].value);
+		if (import->value == BT_VALUE_OBJECT(mod->exports) || bt_table_get(mod->exports, BT_VALUE_OBJECT(import->name)) == import->value) {
+			return (int32_t)i;
+		}
+	}
+
+	return -1;
+}
+
+void bt_set_module_cache(bt_Context* ctx, bt_ReadCache read, bt_WriteCache write, void* userdata)
+{
+	bt_module_cache_destroy(ctx);
+	if (!read && !write) return;
+
+	bt_ModuleCache* cache = ctx->alloc(sizeof(bt_ModuleCache));
+	cache->read = read;
+	cache->write = write;
+	cache->userdata = userdata;
+	cache->directory = NULL;
+	ctx->module_cache = cache;
+}
+
+#ifdef BOLT_ALLOW_FOPEN
+#include <stdio.h>
+
+static void cache_file_path(char* buffer, size_t size, const char* directory, uint64_t key, const char* suffix)
+{
+	snprintf(buffer, size, "%s/%016llx.btc%s", directory, (unsigned long long)key, suffix);
+}
+
+static void* read_cache_file(bt_Context* ctx, uint64_t key, size_t* out_size, void* userdata)
+{
+	char path[BT_MODULE_PATH_SIZE];
+	cache_file_path(path, sizeof(path), userdata, key, "");
+
+	FILE* file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	void* data = size > 0 ? ctx->alloc((size_t)size) : NULL;
+	if (data && fread(data, 1, (size_t)size, file) != (size_t)size) {
+		ctx->free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+	*out_size = (size_t)size;
+	return data;
+}
+
+static void write_cache_file(bt_Context* ctx, uint64_t key, const void* data, size_t size, void* userdata)
+{
+	char path[BT_MODULE_PATH_SIZE], temp_path[BT_MODULE_PATH_SIZE];
+	cache_file_path(path, sizeof(path), userdata, key, "");
+	cache_file_path(temp_path, sizeof(temp_path), userdata, key, ".tmp");
+
+	// written aside and moved over the old entry, so a concurrent or interrupted run never reads half a file
+	FILE* file = fopen(temp_path, "wb");
+	if (!file) return;
+
+	bt_bool written = fwrite(data, 1, size, file) == size;
+	written = fclose(file) == 0 && written;
+
+	if (written) {
+		remove(path);
+		if (rename(temp_path, path) == 0) return;
+	}
+
+	remove(temp_path);
+}
+#endif
+
+bt_bool bt_set_module_cache_dir(bt_Context* ctx, const char* directory)
+{
+#ifdef BOLT_ALLOW_FOPEN
+	size_t length = strlen(directory);
+	char* copy = ctx->alloc(length + 1);
+	memcpy(copy, directory, length + 1);
+
+	bt_set_module_cache(ctx, read_cache_file, write_cache_file, copy);
+	ctx->module_cache->directory = copy;
+	return BT_TRUE;
+#else
+	return BT_FALSE;
+#endif
+}
+
+bt_Module* bt_module_cache_load(bt_Context* ctx, bt_String* name, const char* source)
+{
+	bt_ModuleCache* cache = ctx->module_cache;
+	if (!cache || !cache->read) return NULL;
+
+	uint32_t source_len = (uint32_t)strlen(source);
+	uint64_t source_hash = bt_hash_str(source, source_len);
+	uint64_t key = entry_key(ctx, name, source_hash);
+
+	size_t size = 0;
+	uint8_t* data = cache->read(ctx, key, &size, cache->userdata);
+	if (!data) return NULL;
+
+	bt_Module* result = NULL;
+	Input in = { data, data + size };
+
+	uint32_t header[4];
+	uint64_t stored_hash;
+	if (!take(&in, header, sizeof(header)) || !take(&in, &stored_hash, sizeof(stored_hash))) goto done;
+	if (header[0] != CACHE_MAGIC || header[1] != BT_SERIALIZE_VERSION || header[2] != source_len || stored_hash != source_hash) goto done;
+
+	// every import has to resolve to a module loaded with the same key the entry was compiled against
+	uint64_t module_key = key;
+	for (uint32_t i = 0; i < header[3]; ++i) {
+		uint32_t name_len;
+		uint64_t dep_key;
+		if (!take(&in, &name_len, sizeof(name_len)) || (size_t)(in.end - in.current) < name_len) goto done;
+
+		const char* dep_name = (const char*)in.current;
+		in.current += name_len;
+		if (!take(&in, &dep_key, sizeof(dep_key))) goto done;
+
+		bt_Module* dep = bt_find_module(ctx, BT_VALUE_OBJECT(bt_make_string_len(ctx, dep_name, name_len)), BT_TRUE);
+		if (!dep || dep->cache_key != dep_key) goto done;
+
+		module_key = mix(module_key, dep_key);
+	}
+
+	bt_ErrorFunc on_error = ctx->on_error;
+	ctx->on_error = silent_error;
+	result = bt_deserialize_module(ctx, in.current, (size_t)(in.end - in.current), NULL);
+	ctx->on_error = on_error;
+
+	if (result) result->cache_key = module_key;
+
+done:
+	ctx->free(data);
+	return result;
+}
+
+void bt_module_cache_store(bt_Context* ctx, bt_Module* module, bt_String* name, const char* source)
+{
+	bt_ModuleCache* cache = ctx->module_cache;
+	if (!cache) return;
+
+	uint32_t source_len = (uint32_t)strlen(source);
+	uint64_t source_hash = bt_hash_str(source, source_len);
+	uint64_t key = entry_key(ctx, name, source_hash);
+
+	bt_TablePair* loaded = BT_TABLE_PAIRS(ctx->loaded_modules);
+	uint32_t* deps = module->imports.length ? ctx->alloc(sizeof(uint32_t) * module->imports.length) : NULL;
+	uint32_t dep_count = 0;
+	bt_bool complete = BT_TRUE;
+
+	for (uint32_t i = 0; i < module->imports.length; ++i) {
+		bt_ModuleImport* import = module->imports.elements[i];
+
+		bt_Value prelude_entry = bt_table_get(ctx->prelude, BT_VALUE_OBJECT(import->name));
+		if (BT_IS_OBJECT(prelude_entry) && BT_AS_OBJECT(prelude_entry) == (bt_Object*)import) continue;
+
+		int32_t owner = import_owner(ctx, import);
+		if (owner == -1 || !BT_IS_OBJECT(loaded[owner].key) || BT_OBJECT_GET_TYPE(BT_AS_OBJECT(loaded[owner].key)) != BT_OBJECT_TYPE_STRING) {
+			complete = BT_FALSE;
+			continue;
+		}
+
+		bt_bool seen = BT_FALSE;
+		for (uint32_t j = 0; j < dep_count && !seen; ++j) seen = deps[j] == (uint32_t)owner;
+		if (!seen) deps[dep_count++] = (uint32_t)owner;
+	}
+
+	uint64_t module_key = key;
+	for (uint32_t i = 0; i < dep_count; ++i) {
+		module_key = mix(module_key, ((bt_Module*)BT_AS_OBJECT(loaded[deps[i]].value))->cache_key);
+	}
+	module->cache_key = module_key;
+
+	if (complete && cache->write) {
+		Output out = { ctx, NULL, 0, 0, BT_FALSE };
+		put_u32(&out, CACHE_MAGIC);
+		put_u32(&out, BT_SERIALIZE_VERSION);
+		put_u32(&out, source_len);
+		put_u32(&out, dep_count);
+		put_u64(&out, source_hash);
+
+		for (uint32_t i = 0; i < dep_count; ++i) {
+			bt_String* dep_name = (bt_String*)BT_AS_OBJECT(loaded[deps[i]].key);
+			put_u32(&out, dep_name->len);
+			put(&out, BT_STRING_STR(dep_name), dep_name->len);
+			put_u64(&out, ((bt_Module*)BT_AS_OBJECT(loaded[deps[i]].value))->cache_key);
+		}
+
+		bt_ErrorFunc on_error = ctx->on_error;
+		ctx->on_error = silent_error;
+		bt_bool serialized = bt_serialize_module(ctx, module, ctx->compiler_options.generate_debug_info, write_serialized, &out);
+		ctx->on_error = on_error;
+
+		if (serialized && out.serialized) cache->write(ctx, key, out.data, out.length, cache->userdata);
+		if (out.data) ctx->free(out.data);
+	}
+
+	if (deps) ctx->free(deps);
+}
+
+void bt_module_cache_destroy(bt_Context* ctx)
+{
+	bt_ModuleCache* cache = ctx->module_cache;
+	if (!cache) return;
+
+	if (cache->directory) ctx->free(cache->directory);
+	ctx->free(cache);
+	ctx->module_cache = NULL;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_object.h"
+
+/***
+ * Opt-in cache of compiled modules, so imports whose source didn't change since the last run are loaded without tokenizing,
+ * parsing or compiling them again. Entries are serialized modules (see bt_serialize.h) keyed by a hash of the module's source,
+ * its import name and the compiler options, and are handed to a pair of callbacks that decide where they're kept.
+ *
+ * Compiled code bakes in the layout of the types it imports, so every entry also records the modules it imports and the
+ * cache key they were loaded with, and is only used if all of them still match. Modules that aren't loaded from source
+ * (native modules, modules from images or registered by the host) have no key, changing them requires clearing the cache.
+ *
+ * The cache never reports errors, an entry that can't be written or loaded is silently compiled from source instead.
+ * Like serialized modules, entries aren't verified beyond their headers, so only point the cache at storage you trust.
+ */
+
+/** Returns the entry stored under `key` allocated with the context's `alloc`, or NULL if there is none. The cache frees it */
+typedef void* (*bt_ReadCache)(bt_Context* ctx, uint64_t key, size_t* out_size, void* userdata);
+/** Stores `size` bytes of `data` under `key`, replacing any previous entry */
+typedef void (*bt_WriteCache)(bt_Context* ctx, uint64_t key, const void* data, size_t size, void* userdata);
+
+/** Enables the module cache with custom storage, passing NULL callbacks disables it */
+BOLT_API void bt_set_module_cache(bt_Context* ctx, bt_ReadCache read, bt_WriteCache write, void* userdata);
+/** Enables the module cache, keeping one file per module in the existing `directory`. Only available with `BOLT_ALLOW_FOPEN` */
+BOLT_API bt_bool bt_set_module_cache_dir(bt_Context* ctx, const char* directory);
+
+/** Loads the module `name` from the cache if an entry for the nul terminated `source` exists and its imports are unchanged, without running it */
+BOLT_API bt_Module* bt_module_cache_load(bt_Context* ctx, bt_String* name, const char* source);
+/** Computes the cache key of `module`, freshly compiled from `source`, and writes it to the cache */
+BOLT_API void bt_module_cache_store(bt_Context* ctx, bt_Module* module, bt_String* name, const char* source);
+
+/** Frees the cache state, called when the context is closed */
+BOLT_API void bt_module_cache_destroy(bt_Context* ctx);
+
+#if __cplusplus
+}
+#endif
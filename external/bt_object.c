@@ -2,6 +2,7 @@
 
 #include "bt_context.h"
 #include "bt_userdata.h"
+#include "bt_embedding.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -220,6 +221,24 @@ bt_String* bt_string_concat(bt_Context* ctx, bt_String* a, bt_String* b)
     return result;
 }
 
+bt_String* bt_string_concat_many(bt_Context* ctx, const bt_Value* strings, uint32_t count)
+{
+    uint32_t length = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        length += ((bt_String*)BT_AS_OBJECT(strings[i]))->len;
+    }
+
+    bt_String* result = bt_make_string_empty(ctx, length);
+    char* added = BT_STRING_STR(result);
+    for (uint32_t i = 0; i < count; ++i) {
+        bt_String* str = (bt_String*)BT_AS_OBJECT(strings[i]);
+        memcpy(added, BT_STRING_STR(str), str->len);
+        added += str->len;
+    }
+
+    return result;
+}
+
 bt_String* bt_string_append_cstr(bt_Context* ctx, bt_String* a, const char* b)
 {
     uint32_t b_len = (uint32_t)strlen(b);
@@ -278,49 +297,152 @@ bt_Table* bt_make_table_from_proto(bt_Context* ctx, bt_Type* prototype)
     return result;
 }
 
-bt_bool bt_table_set(bt_Context* ctx, bt_Table* tbl, bt_Value key, bt_Value value)
+static uint32_t index_capacity_for(uint32_t capacity)
 {
-    bt_String* as_str = (bt_String*)BT_VALUE_OBJECT(key);
+    if (capacity < BT_TABLE_HASH_THRESHOLD) return 0;
+
+    // Keep the index at most half full so probe chains stay short
+    uint32_t result = BT_TABLE_HASH_THRESHOLD;
+    while (result < capacity * 2) result *= 2;
+    return result;
+}
+
+uint32_t bt_table_index_capacity(bt_Table* tbl)
+{
+    return tbl->is_inline ? 0 : index_capacity_for(tbl->capacity);
+}
+
+#define TABLE_INDEX(tbl) ((uint32_t*)((tbl)->outline + (tbl)->capacity))
+
+/** Index slots hold the pair index plus one, leaving 0 to mark an empty slot */
+static void index_insert(bt_Table* tbl, uint32_t pair_idx)
+{
+    uint32_t* index = TABLE_INDEX(tbl);
+    uint32_t mask = index_capacity_for(tbl->capacity) - 1;
+    uint32_t slot = (uint32_t)bt_value_hash(tbl->outline[pair_idx].key) & mask;
+
+    while (index[slot]) slot = (slot + 1) & mask;
+    index[slot] = pair_idx + 1;
+}
+
+static void index_rebuild(bt_Table* tbl)
+{
+    memset(TABLE_INDEX(tbl), 0, index_capacity_for(tbl->capacity) * sizeof(uint32_t));
     for (uint32_t i = 0; i < tbl->length; ++i) {
-        bt_TablePair* pair = BT_TABLE_PAIRS(tbl) + i;
-        if (bt_value_is_equal(pair->key, key)) {
-            pair->value = value;
-            return BT_TRUE;
+        index_insert(tbl, i);
+    }
+}
+
+/** Returns the index slot currently pointing at `pair_idx` */
+static uint32_t index_find_slot(bt_Table* tbl, uint32_t pair_idx)
+{
+    uint32_t* index = TABLE_INDEX(tbl);
+    uint32_t mask = index_capacity_for(tbl->capacity) - 1;
+    uint32_t slot = (uint32_t)bt_value_hash(tbl->outline[pair_idx].key) & mask;
+
+    while (index[slot] != pair_idx + 1) slot = (slot + 1) & mask;
+    return slot;
+}
+
+/** Removes the slot for `pair_idx`, shifting the rest of the probe chain back instead of leaving tombstones */
+static void index_remove(bt_Table* tbl, uint32_t pair_idx)
+{
+    uint32_t* index = TABLE_INDEX(tbl);
+    uint32_t mask = index_capacity_for(tbl->capacity) - 1;
+
+    uint32_t hole = index_find_slot(tbl, pair_idx);
+    uint32_t next = hole;
+    for (;;) {
+        next = (next + 1) & mask;
+        if (index[next] == 0) break;
+
+        uint32_t home = (uint32_t)bt_value_hash(tbl->outline[index[next] - 1].key) & mask;
+        // Only move the entry if its home slot doesn't lie cyclically between the hole and its current slot
+        bt_bool in_between = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+        if (!in_between) {
+            index[hole] = index[next];
+            hole = next;
         }
     }
 
+    index[hole] = 0;
+}
+
+static int32_t table_find(bt_Table* tbl, bt_Value key)
+{
+    bt_TablePair* pairs = BT_TABLE_PAIRS(tbl);
+
+    if (bt_table_index_capacity(tbl)) {
+        uint32_t* index = TABLE_INDEX(tbl);
+        uint32_t mask = index_capacity_for(tbl->capacity) - 1;
+        uint32_t slot = (uint32_t)bt_value_hash(key) & mask;
+
+        while (index[slot]) {
+            uint32_t idx = index[slot] - 1;
+            if (bt_value_is_equal(pairs[idx].key, key)) return (int32_t)idx;
+            slot = (slot + 1) & mask;
+        }
+
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < tbl->length; ++i) {
+        if (bt_value_is_equal(pairs[i].key, key)) return (int32_t)i;
+    }
+
+    return -1;
+}
+
+bt_bool bt_table_set(bt_Context* ctx, bt_Table* tbl, bt_Value key, bt_Value value)
+{
+    int32_t found = table_find(tbl, key);
+    if (found != -1) {
+        BT_TABLE_PAIRS(tbl)[found].value = value;
+        BT_GC_BARRIER(ctx, value);
+        return BT_TRUE;
+    }
+
     if (tbl->capacity <= tbl->length) {
         uint32_t old_cap = tbl->capacity;
+        size_t old_size = old_cap * sizeof(bt_TablePair) + bt_table_index_capacity(tbl) * sizeof(uint32_t);
+
         tbl->capacity *= 2;
         if (tbl->capacity == 0) tbl->capacity = 4;
 
+        size_t new_size = tbl->capacity * sizeof(bt_TablePair) + index_capacity_for(tbl->capacity) * sizeof(uint32_t);
+
         if (tbl->is_inline) {
             uint64_t old_start = (uint64_t)tbl->outline;
-            tbl->outline = bt_gc_alloc(ctx, sizeof(bt_TablePair) * tbl->capacity);
+            tbl->outline = bt_gc_alloc(ctx, new_size);
 
             tbl->outline->key = old_start;
             memcpy((uint8_t*)tbl->outline + sizeof(bt_TablePair*), (uint8_t*)BT_TABLE_PAIRS(tbl) + sizeof(bt_TablePair*), sizeof(bt_TablePair) * tbl->length - sizeof(bt_TablePair*));
             tbl->is_inline = BT_FALSE;
         }
         else {
-            tbl->outline = bt_gc_realloc(ctx, tbl->outline, old_cap * sizeof(bt_TablePair), sizeof(bt_TablePair) * tbl->capacity);
+            tbl->outline = bt_gc_realloc(ctx, tbl->outline, old_size, new_size);
         }
+
+        if (bt_table_index_capacity(tbl)) index_rebuild(tbl);
     }
 
     (BT_TABLE_PAIRS(tbl) + tbl->length)->key = key;
     (BT_TABLE_PAIRS(tbl) + tbl->length)->value = value;
     tbl->length++;
 
+    if (bt_table_index_capacity(tbl)) index_insert(tbl, tbl->length - 1);
+
+    BT_GC_BARRIER(ctx, key);
+    BT_GC_BARRIER(ctx, value);
+
     return BT_FALSE;
 }
 
 bt_Value bt_table_get(bt_Table* tbl, bt_Value key)
 {
-    for (uint32_t i = 0; i < tbl->length; ++i) {
-        bt_TablePair* pair = BT_TABLE_PAIRS(tbl) + i;
-        if (bt_value_is_equal(pair->key, key)) {
-            return pair->value;
-        }
+    int32_t found = table_find(tbl, key);
+    if (found != -1) {
+        return BT_TABLE_PAIRS(tbl)[found].value;
     }
 
     if (tbl->prototype) {
@@ -330,32 +452,30 @@ bt_Value bt_table_get(bt_Table* tbl, bt_Value key)
     return BT_VALUE_NULL;
 }
 
-int16_t bt_table_get_idx(bt_Table* tbl, bt_Value key)
+int32_t bt_table_get_idx(bt_Table* tbl, bt_Value key)
 {
-    for (uint32_t i = 0; i < tbl->length; ++i) {
-        bt_TablePair* pair = BT_TABLE_PAIRS(tbl) + i;
-        if (bt_value_is_equal(pair->key, key)) {
-            return i;
-        }
-    }
-
-    return -1;
+    return table_find(tbl, key);
 }
 
 BOLT_API bt_bool bt_table_delete_key(bt_Table* tbl, bt_Value key)
 {
+    int32_t found = table_find(tbl, key);
+    if (found == -1) return BT_FALSE;
+
     bt_TablePair* start = BT_TABLE_PAIRS(tbl);
+    uint32_t last = tbl->length - 1;
+    bt_bool hashed = bt_table_index_capacity(tbl) != 0;
 
-    for (uint32_t i = 0; i < tbl->length; i++) {
-        if (bt_value_is_equal(key, start[i].key)) {
-            memcpy(start + i, start + tbl->length - 1, sizeof(bt_TablePair));
-            tbl->length--;
+    if (hashed) index_remove(tbl, (uint32_t)found);
 
-            return BT_TRUE;
-        }
+    if ((uint32_t)found != last) {
+        if (hashed) TABLE_INDEX(tbl)[index_find_slot(tbl, last)] = found + 1;
+        memcpy(start + found, start + last, sizeof(bt_TablePair));
     }
 
-    return BT_FALSE;
+    tbl->length--;
+
+    return BT_TRUE;
 }
 
 bt_Array* bt_make_array(bt_Context* ctx, uint32_t initial_capacity)
@@ -379,6 +499,7 @@ uint64_t bt_array_push(bt_Context* ctx, bt_Array* arr, bt_Value value)
     }
 
     arr->items[arr->length++] = value;
+    BT_GC_BARRIER(ctx, value);
 
     return arr->length;
 }
@@ -401,6 +522,7 @@ bt_bool bt_array_set(bt_Context* ctx, bt_Array* arr, uint64_t index, bt_Value va
 {
     if (index >= arr->length) bt_runtime_error(ctx->current_thread, "Array index out of bounds!", NULL);
     arr->items[index] = value;
+    BT_GC_BARRIER(ctx, value);
     return BT_TRUE;
 }
 
@@ -442,6 +564,7 @@ bt_Module* bt_make_module(bt_Context* ctx)
     
     result->debug_source = 0;
     result->stack_size = 0;
+    result->cache_key = 0;
     result->name = 0;
     result->path = 0;
 
@@ -471,6 +594,71 @@ bt_NativeFn* bt_make_native(bt_Context* ctx, bt_Module* module, bt_Type* signatu
     result->module = module;
     result->type = signature;
     result->fn = proc;
+    result->direct_kind = BT_DIRECT_NONE;
+
+    return result;
+}
+
+// The native being run by a dynamic call, natives can be wrapped in closures when bound as methods
+static bt_NativeFn* current_native(bt_Thread* thread)
+{
+    bt_Callable* callable = BT_STACKFRAME_GET_CALLABLE(thread->callstack[thread->depth - 1]);
+    if (BT_OBJECT_GET_TYPE(callable) == BT_OBJECT_TYPE_CLOSURE) return (bt_NativeFn*)callable->cl.fn;
+    return &callable->native;
+}
+
+static double arg_number(bt_Thread* thread, uint8_t idx)
+{
+    return BT_AS_NUMBER(bt_arg(thread, idx));
+}
+
+static void* arg_userdata(bt_Thread* thread, uint8_t idx)
+{
+    return BT_USERDATA_VALUE((bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, idx)));
+}
+
+static void call_direct_num_0(bt_Context* ctx, bt_Thread* thread)
+{
+    bt_return(thread, BT_VALUE_NUMBER(current_native(thread)->direct.num_0()));
+}
+
+static void call_direct_num_1(bt_Context* ctx, bt_Thread* thread)
+{
+    bt_return(thread, BT_VALUE_NUMBER(current_native(thread)->direct.num_1(arg_number(thread, 0))));
+}
+
+static void call_direct_num_2(bt_Context* ctx, bt_Thread* thread)
+{
+    bt_return(thread, BT_VALUE_NUMBER(current_native(thread)->direct.num_2(arg_number(thread, 0), arg_number(thread, 1))));
+}
+
+static void call_direct_num_3(bt_Context* ctx, bt_Thread* thread)
+{
+    bt_return(thread, BT_VALUE_NUMBER(current_native(thread)->direct.num_3(arg_number(thread, 0), arg_number(thread, 1), arg_number(thread, 2))));
+}
+
+static void call_direct_userdata(bt_Context* ctx, bt_Thread* thread)
+{
+    bt_return(thread, BT_VALUE_NUMBER(current_native(thread)->direct.userdata(arg_userdata(thread, 0))));
+}
+
+static void call_direct_userdata_num(bt_Context* ctx, bt_Thread* thread)
+{
+    current_native(thread)->direct.userdata_num(arg_userdata(thread, 0), arg_number(thread, 1));
+}
+
+bt_NativeFn* bt_make_native_direct(bt_Context* ctx, bt_Module* module, bt_Type* signature, bt_DirectKind kind, bt_DirectProc proc)
+{
+    static const bt_NativeProc wrappers[BT_DIRECT_COUNT] = {
+        NULL, call_direct_num_0, call_direct_num_1, call_direct_num_2, call_direct_num_3, call_direct_userdata, call_direct_userdata_num
+    };
+
+    assert(kind > BT_DIRECT_NONE && kind < BT_DIRECT_COUNT);
+    assert(signature->category == BT_TYPE_CATEGORY_SIGNATURE && !signature->as.fn.is_vararg && signature->as.fn.args.length == bt_direct_arity(kind));
+
+    bt_NativeFn* result = bt_make_native(ctx, module, signature, wrappers[kind]);
+    result->direct = proc;
+    result->direct_kind = (uint8_t)kind;
 
     return result;
 }
@@ -576,12 +764,14 @@ bt_Value bt_get(bt_Context* ctx, bt_Object* obj, bt_Value key)
     case BT_OBJECT_TYPE_USERDATA: {
         bt_Userdata* userdata = (bt_Userdata*)obj;
         bt_Type* type = userdata->type;
+
+        if (type->as.userdata.elements && BT_IS_NUMBER(key)) return bt_typed_array_get(ctx, userdata, (uint64_t)BT_AS_NUMBER(key));
         
         bt_FieldBuffer* fields = &type->as.userdata.fields;
         for (uint32_t i = 0; i < fields->length; i++) {
             bt_UserdataField* field = fields->elements + i;
             if (bt_value_is_equal(BT_VALUE_OBJECT(field->name), key)) {
-                return field->getter(ctx, bt_userdata_get(userdata), field->offset);
+                return bt_userdata_get_field(ctx, userdata, field);
             }
         }
 
@@ -615,11 +805,16 @@ void bt_set(bt_Context* ctx, bt_Object* obj, bt_Value key, bt_Value value)
         bt_Userdata* userdata = (bt_Userdata*)obj;
         bt_Type* type = userdata->type;
 
+        if (type->as.userdata.elements && BT_IS_NUMBER(key)) {
+            bt_typed_array_set(ctx, userdata, (uint64_t)BT_AS_NUMBER(key), value);
+            return;
+        }
+
         bt_FieldBuffer* fields = &type->as.userdata.fields;
         for (uint32_t i = 0; i < fields->length; i++) {
             bt_UserdataField* field = fields->elements + i;
             if (bt_value_is_equal(BT_VALUE_OBJECT(field->name), key)) {
-                field->setter(ctx, bt_userdata_get(userdata), field->offset, value);
+                bt_userdata_set_field(ctx, userdata, field, value);
                 return;
             }
         }
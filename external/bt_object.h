@@ -39,7 +39,7 @@ typedef bt_Buffer(bt_Op) bt_InstructionBuffer;
  * should be a `bt_Object` such that it's safe to cast to/from it.
  *
  * When the `BOLT_USE_MASKED_GC_HEADER` macro is defined, we use the empty bits in the `next` pointer to store
- * type information as well as the object's GC mark
+ * type information, the object's GC mark and whether it was allocated from the object pool
  */
 #ifdef BOLT_USE_MASKED_GC_HEADER
 typedef struct bt_Object {
@@ -48,7 +48,7 @@ typedef struct bt_Object {
 
 #define BT_OBJ_PTR_BITS 0b0000000000000000111111111111111111111111111111111111111111111100ull
 
-#define BT_OBJECT_SET_TYPE(__obj, __type) ((bt_Object*)(__obj))->mask &= (BT_OBJ_PTR_BITS | 1ull); ((bt_Object*)(__obj))->mask |= (uint64_t)(__type) << 56ull
+#define BT_OBJECT_SET_TYPE(__obj, __type) ((bt_Object*)(__obj))->mask &= (BT_OBJ_PTR_BITS | 3ull); ((bt_Object*)(__obj))->mask |= (uint64_t)(__type) << 56ull
 #define BT_OBJECT_GET_TYPE(__obj) ((((bt_Object*)(__obj))->mask) >> 56)
 
 #define BT_OBJECT_NEXT(__obj) (((bt_Object*)(__obj))->mask & BT_OBJ_PTR_BITS)
@@ -57,11 +57,15 @@ typedef struct bt_Object {
 #define BT_OBJECT_GET_MARK(__obj) ((__obj)->mask & 1ull)
 #define BT_OBJECT_MARK(__obj) (__obj)->mask |= 1ull
 #define BT_OBJECT_CLEAR(__obj) (__obj)->mask &= ~1ull
+
+#define BT_OBJECT_IS_POOLED(__obj) ((__obj)->mask & 2ull)
+#define BT_OBJECT_SET_POOLED(__obj) (__obj)->mask |= 2ull
 #else
 typedef struct bt_Object {
 	struct bt_Object* next;
 	uint64_t type : 5;
 	uint64_t mark : 1;
+	uint64_t pooled : 1;
 } bt_Object;
 
 #define BT_OBJECT_SET_TYPE(__obj, __type) ((bt_Object*)(__obj))->type = __type
@@ -73,6 +77,9 @@ typedef struct bt_Object {
 #define BT_OBJECT_GET_MARK(__obj) ((bt_Object*)(__obj)->mark)
 #define BT_OBJECT_MARK(__obj) (__obj)->mark = 1
 #define BT_OBJECT_CLEAR(__obj) (__obj)->mark = 0
+
+#define BT_OBJECT_IS_POOLED(__obj) ((__obj)->pooled)
+#define BT_OBJECT_SET_POOLED(__obj) (__obj)->pooled = 1
 #endif
 
 typedef struct bt_TablePair {
@@ -84,11 +91,15 @@ typedef struct bt_TablePair {
  * If a lookup fails, `prototype` is fell back upon if present
  * Tables with inline allocations will evict to a second allocation
  * on growth, as moving the existing allocation would break the gc chain
+ * Large outline tables keep a hash index of pair indices directly after their pairs,
+ * the pairs themselves are never reordered by it
  */
 typedef struct bt_Table {
 	bt_Object obj;
 	struct bt_Table* prototype;
-	uint16_t is_inline, length, capacity, inline_capacity;
+	uint32_t length, capacity;
+	uint32_t is_inline : 1;
+	uint32_t inline_capacity : 31;
 	union {
 		bt_TablePair* outline; bt_Value inline_first;
 	};
@@ -155,6 +166,8 @@ typedef struct bt_Module {
 	bt_Table* exports;
 	bt_Table* storage;
 	bt_Type* type;
+	// identifies the source and imports this module was compiled from, see bt_module_cache.h. 0 if not loaded through the cache
+	uint64_t cache_key;
 	uint8_t stack_size;
 } bt_Module;
 
@@ -184,12 +197,36 @@ typedef struct bt_Closure {
 
 typedef void (*bt_NativeProc)(bt_Context* ctx, bt_Thread* thread);
 
+/** Fixed signatures a native can be registered with to be called directly with unboxed arguments, see `bt_make_native_direct` */
+typedef enum {
+	BT_DIRECT_NONE,
+	BT_DIRECT_NUM_0,        /* number() */
+	BT_DIRECT_NUM_1,        /* number(number) */
+	BT_DIRECT_NUM_2,        /* number(number, number) */
+	BT_DIRECT_NUM_3,        /* number(number, number, number) */
+	BT_DIRECT_USERDATA,     /* number(userdata) */
+	BT_DIRECT_USERDATA_NUM, /* void(userdata, number) */
+	BT_DIRECT_COUNT,
+} bt_DirectKind;
+
+typedef union bt_DirectProc {
+	double (*num_0)(void);
+	double (*num_1)(double);
+	double (*num_2)(double, double);
+	double (*num_3)(double, double, double);
+	double (*userdata)(void* data);
+	void (*userdata_num)(void* data, double);
+} bt_DirectProc;
+
 /** A native function reference that can be invoked by bolt */
 typedef struct bt_NativeFn {
 	bt_Object obj;
 	bt_Module* module;
 	bt_Type* type;
 	bt_NativeProc fn;
+	// only valid if `direct_kind` isn't BT_DIRECT_NONE, in which case `fn` is a generic wrapper around it
+	bt_DirectProc direct;
+	uint8_t direct_kind;
 } bt_NativeFn;
 
 /** Union of all callable types */
@@ -203,6 +240,8 @@ typedef union {
 
 struct bt_Userdata;
 typedef void (*bt_UserdataFinalizer)(bt_Context* ctx, struct bt_Userdata* userdata);
+/** Called when the gc traverses a userdata object, should pass every bolt object the user object refers to to `bt_grey_obj` */
+typedef void (*bt_UserdataTracer)(bt_Context* ctx, struct bt_Userdata* userdata);
 
 /**
  * Opaque userdata object, contains an inline allocation of the user object
@@ -266,6 +305,8 @@ BOLT_API bt_StrSlice bt_as_strslice(bt_String* str);
 BOLT_API const char* const bt_string_get(bt_String* str);
 /** Make a new string out of substrings `a` and `b` */
 BOLT_API bt_String* bt_string_concat(bt_Context* ctx, bt_String* a, bt_String* b);
+/** Make a new string out of the `count` managed strings in `strings`, copying each of them once */
+BOLT_API bt_String* bt_string_concat_many(bt_Context* ctx, const bt_Value* strings, uint32_t count);
 /** Make a new string out of managed string `a` and character data `b` */
 BOLT_API bt_String* bt_string_append_cstr(bt_Context* ctx, bt_String* a, const char* b);
 /** Get the length of the string */
@@ -291,8 +332,10 @@ BOLT_API bt_Table* bt_make_table_from_proto(bt_Context* ctx, bt_Type* prototype)
 BOLT_API bt_bool bt_table_set(bt_Context* ctx, bt_Table* tbl, bt_Value key, bt_Value value);
 /** Get the value at `key` in `tbl`. Returns BT_VALUE_NULL if key wasn't found */
 BOLT_API bt_Value bt_table_get(bt_Table* tbl, bt_Value key);
-/** Returns the numeric index of the `key` in `tbl`. Used internally in the compiler for precomputing hash slots */
-BOLT_API int16_t bt_table_get_idx(bt_Table* tbl, bt_Value key);
+/** Returns the numeric index of the `key` in `tbl`, or -1 if not present. Used internally in the compiler for precomputing hash slots */
+BOLT_API int32_t bt_table_get_idx(bt_Table* tbl, bt_Value key);
+/** Returns the number of hash index slots trailing the outline pairs of `tbl`, or 0 if it's searched linearly */
+BOLT_API uint32_t bt_table_index_capacity(bt_Table* tbl);
 /** Remove the entry for `key` in `tbl` */
 BOLT_API bt_bool bt_table_delete_key(bt_Table* tbl, bt_Value key);
 
@@ -358,6 +401,32 @@ BOLT_API bt_Fn* bt_make_fn(bt_Context* ctx, bt_Module* module, bt_Type* signatur
  */
 BOLT_API bt_NativeFn* bt_make_native(bt_Context* ctx, bt_Module* module, bt_Type* signature, bt_NativeProc proc);
 
+/**
+ * Creates a managed reference to a native function with one of the fixed signatures in `bt_DirectKind`
+ * Calls the compiler can resolve to it and whose arguments are statically known to match are emitted as `CALL_DIRECT`,
+ * which passes the unboxed arguments straight to `proc` without setting up a native frame.
+ * Other calls go through a generic wrapper, so the function can still be stored, passed around and called dynamically
+ * `signature` must describe the same parameters and return type as `kind`
+ * `proc` can't raise errors, call back into bolt or allocate bolt objects
+ */
+BOLT_API bt_NativeFn* bt_make_native_direct(bt_Context* ctx, bt_Module* module, bt_Type* signature, bt_DirectKind kind, bt_DirectProc proc);
+/** Returns the number of arguments a native of `kind` is called with */
+static inline uint8_t bt_direct_arity(bt_DirectKind kind)
+{
+	switch (kind) {
+	case BT_DIRECT_NUM_1: case BT_DIRECT_USERDATA: return 1;
+	case BT_DIRECT_NUM_2: case BT_DIRECT_USERDATA_NUM: return 2;
+	case BT_DIRECT_NUM_3: return 3;
+	default: return 0;
+	}
+}
+
+/** Returns whether natives of `kind` take a userdata as their first argument */
+static inline bt_bool bt_direct_takes_userdata(bt_DirectKind kind)
+{
+	return kind == BT_DIRECT_USERDATA || kind == BT_DIRECT_USERDATA_NUM;
+}
+
 /** Finds the return type of the signature of `callable` */
 BOLT_API bt_Type* bt_get_return_type(bt_Callable* callable);
 /** Finds the module responsible for owning `callable` */
@@ -40,8 +40,8 @@ extern "C" {
     X(NOT)         /*  R(a) = not R(b)                               */             \
     X(LOAD_IDX)    /*  R(a) = R(b).[R(c)]                            */             \
     X(STORE_IDX)   /*  R(b).[R(c)] = R(a)                            */             \
-    X(LOAD_IDX_K)  /*  R(a) = R(b).[L(c)]                            */             \
-    X(STORE_IDX_K) /*  R(b).[L(c)] = R(a)                            */             \
+    X(LOAD_IDX_K)  /*  R(a) = R(b).[L(c)], inline cache in ext       */             \
+    X(STORE_IDX_K) /*  R(b).[L(c)] = R(a), inline cache in ext       */             \
     X(LOAD_PROTO)  /*  R(a) = R(b).prototype[L(c)]                   */             \
     X(EXPECT)      /*  R(a) = R(b) ? FAIL                            */             \
     X(COALESCE)    /*  R(a) = R(b) == null ? R(c) : R(b)             */             \
@@ -50,6 +50,8 @@ extern "C" {
     X(TSET)        /*  (R(a) as Type)[R(b)]: R(c+1) = R(c)           */             \
     X(CALL)        /*  R(a) = R(b)(R(b + 1) .. R(b + c))             */             \
     X(REC_CALL)    /*  R(a) = cur_fn((R(b) .. R(b + c))              */             \
+    X(TAILCALL)    /*  return R(b)(R(b + 1) .. R(b + c)), reusing frame */          \
+    X(REC_TAILCALL) /* return cur_fn(R(b) .. R(b + c)), reusing frame  */             \
     X(JMP)         /*  pc += ibc                                     */             \
     X(JMPF)        /*  if(R(a) == BT_FALSE) pc += ibc                */             \
     X(RETURN)      /*  R(frame->ret_pos) = R(a)                      */             \
@@ -67,6 +69,31 @@ extern "C" {
     X(LOAD_SUB_F)                                                                   \
     X(STORE_SUB_F)                                                                  \
     X(APPEND_F)                                                                     \
+                                                                                    \
+    /*  Fused superinstructions, only emitted for numeric operands. */              \
+    /*  The compare-and-branch ops keep their jump offset in a trailing IDX_EXT */  \
+    X(LT_JMPF)     /*  if(!(R(a) < R(b))) pc += ext.ibc              */             \
+    X(LTE_JMPF)    /*  if(!(R(a) <= R(b))) pc += ext.ibc             */             \
+    X(EQ_JMPF)     /*  if(!(R(a) == R(b))) pc += ext.ibc             */             \
+    X(NEQ_JMPF)    /*  if(!(R(a) != R(b))) pc += ext.ibc             */             \
+    X(ADD_I)       /*  R(a) = R(b) + (int8)c                         */             \
+                                                                                    \
+    /*  Members of inline value fields, read and written without boxing the value. */ \
+    /*  L(c) packs the field index and the value type's member index */             \
+    X(LOAD_VALUE_F)  /*  R(a) = R(b).field.member                      */           \
+    X(STORE_VALUE_F) /*  R(a).field.member = R(c)                      */           \
+                                                                                    \
+    /*  Typed array indexing, used when the indexed type is known to have packed */ \
+    /*  numeric elements and the index known to be a number */                      \
+    X(LOAD_ELEM_F)   /*  R(a) = R(b)[R(c)]                             */           \
+    X(STORE_ELEM_F)  /*  R(a)[R(b)] = R(c)                             */           \
+                                                                                    \
+    /*  Chains of string `+` lowered into a single allocation */                    \
+    X(CONCAT)        /*  R(a) = R(b) + ... + R(b + c - 1)              */           \
+                                                                                    \
+    /*  Calls to natives with a fixed signature, see bt_make_native_direct. */      \
+    /*  Reverts to a plain CALL if R(b) turns out not to be one at runtime */       \
+    X(CALL_DIRECT)   /*  R(a) = R(b)(R(b + 1) .. R(b + c)), unboxed    */           \
 																					\
 	/* Extension for other fast opcodes that need an additional op to store data */ \
 	X(IDX_EXT)
@@ -75,6 +102,7 @@ typedef enum {
 #define X(op) BT_OP_##op,
 		BT_OPS_X
 #undef X
+		BT_OP_COUNT
 } bt_OpCode;
 
 #ifdef BOLT_BITMASK_OP
@@ -101,6 +129,7 @@ typedef uint32_t bt_Op;
 #define BT_GET_IBC(op) (int16_t)(op >> 16)
 #define BT_GET_UBC(op) (op >> 16)
 
+#define BT_SET_A(op, a) (op) = (((op) & (~(bt_Op)0x0000FF00)) | (((bt_Op)((uint8_t)a)) << 8))
 #define BT_SET_IBC(op, ibc) (op) = (((op) & (~(bt_Op)0xFFFF0000)) | (((uint32_t)((uint16_t)ibc)) << 16))
 #else
 typedef struct bt_Op {
@@ -128,6 +157,7 @@ typedef struct bt_Op {
 #define BT_GET_IBC(op) op.ibc
 #define BT_GET_UBC(op) op.ubc
 
+#define BT_SET_A(op, _a) ((op).a = (_a))
 #define BT_SET_IBC(op, _ibc) ((op).ibc = (_ibc))
 #endif
 
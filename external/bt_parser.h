@@ -86,6 +86,7 @@ typedef struct bt_AstNode {
 			bt_Value key;
 			bt_bool hoistable;
 			bt_bool from_mf;
+			bt_bool userdata_field;
 		} binary_op;
 
 		struct {
@@ -0,0 +1,171 @@
+#include "bt_pool.h"
+
+#include "bt_context.h"
+
+#include <string.h>
+
+// slots start after the page header, rounded up so objects keep their 16 byte alignment
+#define PAGE_HEADER_SIZE ((sizeof(bt_PoolPage) + BT_POOL_GRANULARITY - 1) & ~(size_t)(BT_POOL_GRANULARITY - 1))
+#define PAGE_OF(ptr) ((bt_PoolPage*)((uintptr_t)(ptr) & ~(uintptr_t)(BT_POOL_PAGE_SIZE - 1)))
+
+static void link_page(bt_PoolPage** list, bt_PoolPage* page)
+{
+	page->prev = NULL;
+	page->next = *list;
+	if (*list) (*list)->prev = page;
+	*list = page;
+}
+
+static void unlink_page(bt_PoolPage** list, bt_PoolPage* page)
+{
+	if (page->prev) page->prev->next = page->next;
+	else *list = page->next;
+	if (page->next) page->next->prev = page->prev;
+	page->prev = page->next = NULL;
+}
+
+void bt_pool_init(bt_Context* ctx)
+{
+	bt_Pool* pool = &ctx->pool;
+	memset(pool, 0, sizeof(bt_Pool));
+
+	for (uint32_t i = 0; i < BT_POOL_CLASS_COUNT; ++i) {
+		bt_PoolClass* cls = pool->classes + i;
+		cls->object_size = (i + 1) * BT_POOL_GRANULARITY;
+		cls->capacity = (uint32_t)((BT_POOL_PAGE_SIZE - PAGE_HEADER_SIZE) / cls->object_size);
+	}
+}
+
+static void free_pages(bt_Context* ctx, bt_PoolPage* page)
+{
+	while (page) {
+		bt_PoolPage* next = page->next;
+		ctx->free_page(page, BT_POOL_PAGE_SIZE);
+		page = next;
+	}
+}
+
+void bt_pool_destroy(bt_Context* ctx)
+{
+	bt_Pool* pool = &ctx->pool;
+	if (!ctx->free_page) return;
+
+	for (uint32_t i = 0; i < BT_POOL_CLASS_COUNT; ++i) {
+		free_pages(ctx, pool->classes[i].partial);
+		free_pages(ctx, pool->classes[i].full);
+		pool->classes[i].partial = pool->classes[i].full = NULL;
+		pool->classes[i].pages = pool->classes[i].live = 0;
+	}
+
+	free_pages(ctx, pool->cached);
+	pool->cached = NULL;
+	pool->cached_count = 0;
+}
+
+static bt_PoolPage* make_page(bt_Context* ctx, uint32_t size_class)
+{
+	bt_Pool* pool = &ctx->pool;
+	bt_PoolPage* page = pool->cached;
+	if (page) {
+		unlink_page(&pool->cached, page);
+		pool->cached_count--;
+	}
+	else {
+		page = ctx->alloc_page(BT_POOL_PAGE_SIZE);
+		if (!page) return NULL;
+	}
+
+	page->free_list = NULL;
+	page->used = 0;
+	page->bump = (uint32_t)PAGE_HEADER_SIZE;
+	page->size_class = size_class;
+	page->is_full = BT_FALSE;
+	return page;
+}
+
+void* bt_pool_alloc(bt_Context* ctx, size_t size)
+{
+	if (size > BT_POOL_MAX_OBJECT_SIZE || size == 0 || !ctx->alloc_page) return NULL;
+
+	uint32_t size_class = (uint32_t)((size - 1) / BT_POOL_GRANULARITY);
+	bt_PoolClass* cls = ctx->pool.classes + size_class;
+
+	bt_PoolPage* page = cls->partial;
+	if (!page) {
+		page = make_page(ctx, size_class);
+		if (!page) return NULL;
+		link_page(&cls->partial, page);
+		cls->pages++;
+	}
+
+	// reuse freed slots first, then hand out the part of the page that was never touched
+	void* result = page->free_list;
+	if (result) page->free_list = *(void**)result;
+	else {
+		result = (uint8_t*)page + page->bump;
+		page->bump += cls->object_size;
+	}
+
+	if (++page->used == cls->capacity) {
+		unlink_page(&cls->partial, page);
+		link_page(&cls->full, page);
+		page->is_full = BT_TRUE;
+	}
+
+	cls->live++;
+	cls->allocations++;
+	ctx->gc.bytes_allocated += cls->object_size;
+
+	return result;
+}
+
+void bt_pool_free(bt_Context* ctx, void* ptr)
+{
+	bt_Pool* pool = &ctx->pool;
+	bt_PoolPage* page = PAGE_OF(ptr);
+	bt_PoolClass* cls = pool->classes + page->size_class;
+
+	*(void**)ptr = page->free_list;
+	page->free_list = ptr;
+
+	if (page->is_full) {
+		unlink_page(&cls->full, page);
+		link_page(&cls->partial, page);
+		page->is_full = BT_FALSE;
+	}
+
+	cls->live--;
+	ctx->gc.bytes_allocated -= cls->object_size;
+
+	if (--page->used == 0) {
+		unlink_page(&cls->partial, page);
+		cls->pages--;
+
+		if (pool->cached_count < BT_POOL_CACHED_PAGES) {
+			link_page(&pool->cached, page);
+			pool->cached_count++;
+		}
+		else {
+			ctx->free_page(page, BT_POOL_PAGE_SIZE);
+		}
+	}
+}
+
+uint32_t bt_pool_get_stats(bt_Context* ctx, bt_PoolClassStats* stats, uint32_t max_classes)
+{
+	for (uint32_t i = 0; i < BT_POOL_CLASS_COUNT && i < max_classes; ++i) {
+		bt_PoolClass* cls = ctx->pool.classes + i;
+		stats[i].object_size = cls->object_size;
+		stats[i].pages = cls->pages;
+		stats[i].live_objects = cls->live;
+		stats[i].free_slots = cls->pages * cls->capacity - cls->live;
+		stats[i].allocations = cls->allocations;
+	}
+
+	return BT_POOL_CLASS_COUNT;
+}
+
+uint32_t bt_pool_get_cached_pages(bt_Context* ctx)
+{
+	return ctx->pool.cached_count;
+}
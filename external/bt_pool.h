@@ -0,0 +1,74 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_config.h"
+
+#include <stdint.h>
+
+/***
+ * Size-class allocator for small garbage collected objects.
+ * Objects up to `BT_POOL_MAX_OBJECT_SIZE` bytes are carved out of `BT_POOL_PAGE_SIZE` pages, one size class per page,
+ * and freed slots are threaded onto a free list inside their page. Pages are aligned to their size so an object
+ * finds its page by masking its address. Empty pages are kept in a small cache that every size class draws from.
+ *
+ * Pages come from the `alloc_page`/`free_page` handlers, if those aren't set every object goes through `alloc` instead.
+ */
+
+#define BT_POOL_GRANULARITY 16
+#define BT_POOL_CLASS_COUNT (BT_POOL_MAX_OBJECT_SIZE / BT_POOL_GRANULARITY)
+
+/** Page header, followed by the page's slots */
+typedef struct bt_PoolPage {
+	struct bt_PoolPage* prev, * next;
+	void* free_list;
+	uint32_t used, bump;
+	uint32_t size_class;
+	bt_bool is_full;
+} bt_PoolPage;
+
+/** All pages of one object size. Allocations are served from the first partial page */
+typedef struct bt_PoolClass {
+	bt_PoolPage* partial;
+	bt_PoolPage* full;
+	uint32_t object_size, capacity;
+	uint32_t pages, live;
+	uint64_t allocations;
+} bt_PoolClass;
+
+typedef struct bt_Pool {
+	bt_PoolClass classes[BT_POOL_CLASS_COUNT];
+	bt_PoolPage* cached;
+	uint32_t cached_count;
+} bt_Pool;
+
+/** Usage of a single size class, as returned by `bt_pool_get_stats` */
+typedef struct bt_PoolClassStats {
+	uint32_t object_size;
+	uint32_t pages;
+	uint32_t live_objects;
+	uint32_t free_slots;
+	uint64_t allocations;
+} bt_PoolClassStats;
+
+/** Sets up an empty pool in `ctx`, pages are only allocated once objects need them */
+BOLT_API void bt_pool_init(bt_Context* ctx);
+/** Releases every page, including ones still holding objects */
+BOLT_API void bt_pool_destroy(bt_Context* ctx);
+
+/** Returns a slot for an object of `size` bytes, or NULL if it's too large or there is no page allocator */
+BOLT_API void* bt_pool_alloc(bt_Context* ctx, size_t size);
+/** Returns a slot handed out by `bt_pool_alloc` to its page */
+BOLT_API void bt_pool_free(bt_Context* ctx, void* ptr);
+
+/** Writes the stats of up to `max_classes` size classes, smallest first, and returns the number of size classes */
+BOLT_API uint32_t bt_pool_get_stats(bt_Context* ctx, bt_PoolClassStats* stats, uint32_t max_classes);
+/** Returns the number of empty pages kept around for reuse */
+BOLT_API uint32_t bt_pool_get_cached_pages(bt_Context* ctx);
+
+#if __cplusplus
+}
+#endif
@@ -28,10 +28,14 @@ extern "C" {
 #ifdef _MSC_VER
 #define BT_FORCE_INLINE __forceinline
 #define BT_NO_INLINE __declspec(noinline)
+#define BT_THREAD_LOCAL __declspec(thread)
+#define BT_RESTRICT __restrict
 #define BT_ASSUME(x) __assume(x)
 #else
 #define BT_FORCE_INLINE __attribute__((always_inline)) inline
 #define BT_NO_INLINE
+#define BT_THREAD_LOCAL _Thread_local
+#define BT_RESTRICT __restrict__
 #if __has_builtin(__builtin_assume)
   #define BT_ASSUME(x) __builtin_assume(x)
 #else
@@ -0,0 +1,700 @@
+#include "bt_profiler.h"
+
+#include "bt_context.h"
+#include "bt_type.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_SAMPLE_INTERVAL_US 1000
+// the clock is only read every this many hooks in sampling mode
+#define SAMPLE_CHECK_PERIOD 64
+#define EMPTY_SLOT UINT32_MAX
+
+/** Instrumentation state of a running call, pushed on enter and popped on exit */
+typedef struct ShadowFrame {
+	bt_Thread* thread;
+	uint32_t depth, function;
+	uint64_t start, child;
+} ShadowFrame;
+
+/** Per-function bookkeeping that isn't part of the public results */
+typedef struct FunctionState {
+	// NULL once the object is freed, its results stay but a new object at the same address gets its own entry
+	bt_Object* key;
+	uint32_t active;
+	uint64_t last_sample;
+} FunctionState;
+
+/** A unique sampled callstack, its frames are stored outermost first in the shared frame pool */
+typedef struct SampledStack {
+	uint64_t hash;
+	uint32_t offset, length;
+	uint64_t count;
+} SampledStack;
+
+typedef struct bt_Profiler {
+	bt_ProfileMode mode;
+	uint64_t interval_ns, next_sample;
+	uint32_t countdown;
+	uint64_t sample_id;
+
+	bt_ProfileScope scope;
+	void* scope_userdata;
+
+	bt_ProfileFunction* functions;
+	FunctionState* states;
+	uint32_t function_count, function_capacity;
+	uint32_t* function_slots;
+	uint32_t function_slot_capacity;
+
+	ShadowFrame* shadow;
+	uint32_t shadow_count, shadow_capacity;
+
+	bt_ProfileLine* lines;
+	uint32_t line_count, line_capacity;
+	uint32_t* line_slots;
+	uint32_t line_slot_capacity;
+
+	SampledStack* stacks;
+	uint32_t stack_count, stack_capacity;
+	uint32_t* stack_slots;
+	uint32_t stack_slot_capacity;
+	uint32_t* frames;
+	uint32_t frame_count, frame_capacity;
+
+	uint32_t scratch[BT_CALLSTACK_SIZE];
+} bt_Profiler;
+
+static uint64_t get_timestamp_ns()
+{
+	struct timespec ts;
+#ifdef _MSC_VER
+	timespec_get(&ts, TIME_UTC);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t hash_u64(uint64_t x)
+{
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdull;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ull;
+	x ^= x >> 33;
+	return x;
+}
+
+/** Makes room for `needed` elements, growing by doubling. The profiler's memory isn't tracked by the gc, so profiling doesn't change collection timing */
+static void* reserve(bt_Context* ctx, void* elements, uint32_t* capacity, uint32_t needed, size_t element_size)
+{
+	if (needed <= *capacity) return elements;
+
+	uint32_t new_capacity = *capacity ? *capacity : 16;
+	while (new_capacity < needed) new_capacity *= 2;
+
+	elements = elements ? ctx->realloc(elements, new_capacity * element_size) : ctx->alloc(new_capacity * element_size);
+	*capacity = new_capacity;
+	return elements;
+}
+
+/** Allocates an empty slot table, slots hold indices into a dense array */
+static uint32_t* make_slots(bt_Context* ctx, uint32_t capacity)
+{
+	uint32_t* slots = ctx->alloc(capacity * sizeof(uint32_t));
+	memset(slots, 0xff, capacity * sizeof(uint32_t));
+	return slots;
+}
+
+static char* copy_cstr(bt_Context* ctx, const char* str, size_t len)
+{
+	char* result = ctx->alloc(len + 1);
+	memcpy(result, str, len);
+	result[len] = 0;
+	return result;
+}
+
+static const char* module_name(bt_Module* module)
+{
+	if (!module) return "<native>";
+	if (module->name) return BT_STRING_STR(module->name);
+	if (module->path) return BT_STRING_STR(module->path);
+	return "<anonymous>";
+}
+
+/** Searches `table` for `value`, returning the key it's stored under */
+static bt_String* find_key(bt_Table* table, bt_Object* value)
+{
+	if (!table) return NULL;
+
+	bt_TablePair* pairs = BT_TABLE_PAIRS(table);
+	for (uint32_t i = 0; i < table->length; ++i) {
+		if (BT_IS_OBJECT(pairs[i].value) && BT_AS_OBJECT(pairs[i].value) == value && BT_IS_OBJECT(pairs[i].key)) {
+			return (bt_String*)BT_AS_OBJECT(pairs[i].key);
+		}
+	}
+
+	return NULL;
+}
+
+/** Names `fn` after its export, or the method of an exported type it implements. Writes into `buffer`, returns whether a name was found */
+static bt_bool find_export_name(bt_Module* module, bt_Object* fn, char* buffer, size_t size)
+{
+	if (!module || !module->exports) return BT_FALSE;
+
+	bt_String* name = find_key(module->exports, fn);
+	if (name) {
+		snprintf(buffer, size, "%s.%s", module_name(module), BT_STRING_STR(name));
+		return BT_TRUE;
+	}
+
+	bt_TablePair* pairs = BT_TABLE_PAIRS(module->exports);
+	for (uint32_t i = 0; i < module->exports->length; ++i) {
+		if (!BT_IS_OBJECT(pairs[i].value) || BT_OBJECT_GET_TYPE(BT_AS_OBJECT(pairs[i].value)) != BT_OBJECT_TYPE_TYPE) continue;
+
+		bt_Type* type = (bt_Type*)BT_AS_OBJECT(pairs[i].value);
+		name = find_key(type->prototype_values, fn);
+		if (name && BT_IS_OBJECT(pairs[i].key)) {
+			snprintf(buffer, size, "%s.%s.%s", module_name(module), BT_STRING_STR(BT_AS_OBJECT(pairs[i].key)), BT_STRING_STR(name));
+			return BT_TRUE;
+		}
+	}
+
+	return BT_FALSE;
+}
+
+/** Returns the 1-based source line `ip` was compiled from, or 0 without debug info. A NULL `ip` means the callable's first instruction */
+static uint32_t get_line(bt_Callable* callable, bt_Op* ip)
+{
+	bt_DebugLocBuffer* locs = bt_get_debug_locs(callable);
+	if (!locs || locs->length == 0) return 0;
+
+	uint32_t index = ip ? bt_get_debug_index(callable, ip) : 0;
+	if (index >= locs->length) index = locs->length - 1;
+
+	bt_TokenBuffer* tokens = bt_get_debug_tokens(callable);
+	if (!tokens || locs->elements[index] >= tokens->length) return 0;
+
+	return tokens->elements[locs->elements[index]]->line;
+}
+
+/** Returns the first source line a function's code comes from, which is where it's defined */
+static uint32_t get_definition_line(bt_Callable* callable)
+{
+	bt_DebugLocBuffer* locs = bt_get_debug_locs(callable);
+	bt_TokenBuffer* tokens = bt_get_debug_tokens(callable);
+	if (!locs || !tokens) return 0;
+
+	uint32_t line = 0;
+	for (uint32_t i = 0; i < locs->length; ++i) {
+		if (locs->elements[i] >= tokens->length) continue;
+		uint32_t loc_line = tokens->elements[locs->elements[i]]->line;
+		if (line == 0 || loc_line < line) line = loc_line;
+	}
+
+	return line;
+}
+
+static void register_function(bt_Context* ctx, bt_Profiler* profiler, bt_Object* key)
+{
+	char buffer[256];
+	bt_ProfileFunction* function = profiler->functions + profiler->function_count;
+	memset(function, 0, sizeof(bt_ProfileFunction));
+
+	bt_Module* module = NULL;
+	switch (BT_OBJECT_GET_TYPE(key)) {
+	case BT_OBJECT_TYPE_FN:
+		module = ((bt_Fn*)key)->module;
+		function->line = get_definition_line((bt_Callable*)key);
+		if (!find_export_name(module, key, buffer, sizeof(buffer))) {
+			snprintf(buffer, sizeof(buffer), "%s:%u", module_name(module), function->line);
+		}
+		break;
+	case BT_OBJECT_TYPE_MODULE:
+		module = (bt_Module*)key;
+		snprintf(buffer, sizeof(buffer), "%s", module_name(module));
+		break;
+	case BT_OBJECT_TYPE_NATIVE_FN: {
+		bt_NativeFn* native = (bt_NativeFn*)key;
+		module = native->module;
+		if (!find_export_name(module, key, buffer, sizeof(buffer))) {
+			snprintf(buffer, sizeof(buffer), "<native %s>", native->type && native->type->name ? native->type->name : "fn");
+		}
+	} break;
+	default:
+		snprintf(buffer, sizeof(buffer), "<unknown>");
+	}
+
+	function->name = copy_cstr(ctx, buffer, strlen(buffer));
+	const char* mod_name = module_name(module);
+	function->module = copy_cstr(ctx, mod_name, strlen(mod_name));
+
+	FunctionState* state = profiler->states + profiler->function_count;
+	state->key = key;
+	state->active = 0;
+	state->last_sample = 0;
+}
+
+static uint32_t get_function(bt_Context* ctx, bt_Profiler* profiler, bt_Callable* callable)
+{
+	// closures are attributed to the function they wrap
+	bt_Object* key = (bt_Object*)callable;
+	if (BT_OBJECT_GET_TYPE(key) == BT_OBJECT_TYPE_CLOSURE) key = (bt_Object*)callable->cl.fn;
+
+	if (profiler->function_count * 2 >= profiler->function_slot_capacity) {
+		uint32_t new_capacity = profiler->function_slot_capacity ? profiler->function_slot_capacity * 2 : 64;
+		uint32_t* slots = make_slots(ctx, new_capacity);
+		for (uint32_t i = 0; i < profiler->function_count; ++i) {
+			if (!profiler->states[i].key) continue;
+			uint32_t slot = (uint32_t)hash_u64((uint64_t)profiler->states[i].key) & (new_capacity - 1);
+			while (slots[slot] != EMPTY_SLOT) slot = (slot + 1) & (new_capacity - 1);
+			slots[slot] = i;
+		}
+
+		if (profiler->function_slots) ctx->free(profiler->function_slots);
+		profiler->function_slots = slots;
+		profiler->function_slot_capacity = new_capacity;
+	}
+
+	uint32_t mask = profiler->function_slot_capacity - 1;
+	uint32_t slot = (uint32_t)hash_u64((uint64_t)key) & mask;
+	while (profiler->function_slots[slot] != EMPTY_SLOT) {
+		uint32_t index = profiler->function_slots[slot];
+		if (profiler->states[index].key == key) return index;
+		slot = (slot + 1) & mask;
+	}
+
+	// the public results and the private state are parallel arrays sharing one capacity
+	uint32_t capacity = profiler->function_capacity;
+	profiler->functions = reserve(ctx, profiler->functions, &capacity, profiler->function_count + 1, sizeof(bt_ProfileFunction));
+	profiler->states = reserve(ctx, profiler->states, &profiler->function_capacity, profiler->function_count + 1, sizeof(FunctionState));
+
+	register_function(ctx, profiler, key);
+	profiler->function_slots[slot] = profiler->function_count;
+	return profiler->function_count++;
+}
+
+void bt_profiler_forget(bt_Context* ctx, bt_Object* obj)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	if (!profiler || !profiler->function_slot_capacity) return;
+
+	// forgotten entries keep their slot, so probing for other keys still passes over them
+	uint32_t mask = profiler->function_slot_capacity - 1;
+	uint32_t slot = (uint32_t)hash_u64((uint64_t)obj) & mask;
+	while (profiler->function_slots[slot] != EMPTY_SLOT) {
+		FunctionState* state = profiler->states + profiler->function_slots[slot];
+		if (state->key == obj) {
+			state->key = NULL;
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+}
+
+static void record_line(bt_Context* ctx, bt_Profiler* profiler, uint32_t function, uint32_t line)
+{
+	if (profiler->line_count * 2 >= profiler->line_slot_capacity) {
+		uint32_t new_capacity = profiler->line_slot_capacity ? profiler->line_slot_capacity * 2 : 64;
+		uint32_t* slots = make_slots(ctx, new_capacity);
+		for (uint32_t i = 0; i < profiler->line_count; ++i) {
+			bt_ProfileLine* entry = profiler->lines + i;
+			uint32_t slot = (uint32_t)hash_u64(((uint64_t)entry->function << 32) | entry->line) & (new_capacity - 1);
+			while (slots[slot] != EMPTY_SLOT) slot = (slot + 1) & (new_capacity - 1);
+			slots[slot] = i;
+		}
+
+		if (profiler->line_slots) ctx->free(profiler->line_slots);
+		profiler->line_slots = slots;
+		profiler->line_slot_capacity = new_capacity;
+	}
+
+	uint32_t mask = profiler->line_slot_capacity - 1;
+	uint32_t slot = (uint32_t)hash_u64(((uint64_t)function << 32) | line) & mask;
+	while (profiler->line_slots[slot] != EMPTY_SLOT) {
+		bt_ProfileLine* entry = profiler->lines + profiler->line_slots[slot];
+		if (entry->function == function && entry->line == line) {
+			entry->samples++;
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	profiler->lines = reserve(ctx, profiler->lines, &profiler->line_capacity, profiler->line_count + 1, sizeof(bt_ProfileLine));
+	bt_ProfileLine* entry = profiler->lines + profiler->line_count;
+	entry->function = function;
+	entry->line = line;
+	entry->samples = 1;
+	profiler->line_slots[slot] = profiler->line_count++;
+}
+
+static void record_stack(bt_Context* ctx, bt_Profiler* profiler, uint32_t* frames, uint32_t length)
+{
+	uint64_t hash = length;
+	for (uint32_t i = 0; i < length; ++i) hash = hash_u64(hash ^ frames[i]);
+
+	if (profiler->stack_count * 2 >= profiler->stack_slot_capacity) {
+		uint32_t new_capacity = profiler->stack_slot_capacity ? profiler->stack_slot_capacity * 2 : 64;
+		uint32_t* slots = make_slots(ctx, new_capacity);
+		for (uint32_t i = 0; i < profiler->stack_count; ++i) {
+			uint32_t slot = (uint32_t)profiler->stacks[i].hash & (new_capacity - 1);
+			while (slots[slot] != EMPTY_SLOT) slot = (slot + 1) & (new_capacity - 1);
+			slots[slot] = i;
+		}
+
+		if (profiler->stack_slots) ctx->free(profiler->stack_slots);
+		profiler->stack_slots = slots;
+		profiler->stack_slot_capacity = new_capacity;
+	}
+
+	uint32_t mask = profiler->stack_slot_capacity - 1;
+	uint32_t slot = (uint32_t)hash & mask;
+	while (profiler->stack_slots[slot] != EMPTY_SLOT) {
+		SampledStack* stack = profiler->stacks + profiler->stack_slots[slot];
+		if (stack->hash == hash && stack->length == length && memcmp(profiler->frames + stack->offset, frames, length * sizeof(uint32_t)) == 0) {
+			stack->count++;
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	profiler->frames = reserve(ctx, profiler->frames, &profiler->frame_capacity, profiler->frame_count + length, sizeof(uint32_t));
+	memcpy(profiler->frames + profiler->frame_count, frames, length * sizeof(uint32_t));
+
+	profiler->stacks = reserve(ctx, profiler->stacks, &profiler->stack_capacity, profiler->stack_count + 1, sizeof(SampledStack));
+	SampledStack* stack = profiler->stacks + profiler->stack_count;
+	stack->hash = hash;
+	stack->offset = profiler->frame_count;
+	stack->length = length;
+	stack->count = 1;
+
+	profiler->frame_count += length;
+	profiler->stack_slots[slot] = profiler->stack_count++;
+}
+
+static void take_sample(bt_Context* ctx, bt_Profiler* profiler, bt_Thread* thread, bt_Op* ip)
+{
+	profiler->sample_id++;
+
+	uint32_t length = 0;
+	bt_Callable* leaf = NULL;
+	// frame 0 is the thread's empty root frame
+	for (uint32_t i = 1; i < thread->depth; ++i) {
+		bt_Callable* callable = BT_STACKFRAME_GET_CALLABLE(thread->callstack[i]);
+		if (!callable) continue;
+
+		uint32_t function = get_function(ctx, profiler, callable);
+		profiler->scratch[length++] = function;
+		leaf = callable;
+
+		// recursive functions only count once towards their inclusive samples
+		FunctionState* state = profiler->states + function;
+		if (state->last_sample != profiler->sample_id) {
+			state->last_sample = profiler->sample_id;
+			profiler->functions[function].samples++;
+		}
+	}
+
+	if (length == 0) return;
+
+	uint32_t function = profiler->scratch[length - 1];
+	profiler->functions[function].self_samples++;
+
+	uint32_t line = BT_OBJECT_GET_TYPE(leaf) == BT_OBJECT_TYPE_NATIVE_FN ? 0 : get_line(leaf, ip);
+	if (line) record_line(ctx, profiler, function, line);
+
+	record_stack(ctx, profiler, profiler->scratch, length);
+}
+
+void bt_profiler_tick(bt_Context* ctx, bt_Thread* thread, bt_Op* ip)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	if (profiler->mode != BT_PROFILE_SAMPLE || --profiler->countdown) return;
+	profiler->countdown = SAMPLE_CHECK_PERIOD;
+
+	uint64_t now = get_timestamp_ns();
+	if (now < profiler->next_sample) return;
+	profiler->next_sample = now + profiler->interval_ns;
+
+	take_sample(ctx, profiler, thread, ip);
+}
+
+/** Drops frames that were unwound by a runtime error without returning through the profiler */
+static void drop_unwound(bt_Profiler* profiler, bt_Thread* thread, uint32_t depth)
+{
+	while (profiler->shadow_count) {
+		ShadowFrame* top = profiler->shadow + profiler->shadow_count - 1;
+		if (top->thread != thread || top->depth < depth) break;
+
+		profiler->states[top->function].active--;
+		profiler->shadow_count--;
+		if (profiler->scope) profiler->scope(profiler->scope_userdata, NULL);
+	}
+}
+
+void bt_profiler_enter(bt_Context* ctx, bt_Thread* thread, bt_Callable* callable)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	if (profiler->mode == BT_PROFILE_SAMPLE) {
+		bt_profiler_tick(ctx, thread, NULL);
+		return;
+	}
+
+	uint32_t depth = thread->depth - 1;
+	drop_unwound(profiler, thread, depth);
+
+	uint32_t function = get_function(ctx, profiler, callable);
+	profiler->functions[function].calls++;
+	profiler->states[function].active++;
+
+	profiler->shadow = reserve(ctx, profiler->shadow, &profiler->shadow_capacity, profiler->shadow_count + 1, sizeof(ShadowFrame));
+	ShadowFrame* frame = profiler->shadow + profiler->shadow_count++;
+	frame->thread = thread;
+	frame->depth = depth;
+	frame->function = function;
+	frame->child = 0;
+
+	if (profiler->scope) profiler->scope(profiler->scope_userdata, profiler->functions[function].name);
+	// taken last so the bookkeeping above isn't billed to the callee
+	frame->start = get_timestamp_ns();
+}
+
+void bt_profiler_exit(bt_Context* ctx, bt_Thread* thread)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	// entries and back-edges are enough to keep sampling going
+	if (profiler->mode == BT_PROFILE_SAMPLE) return;
+
+	uint64_t now = get_timestamp_ns();
+	uint32_t depth = thread->depth - 1;
+	drop_unwound(profiler, thread, depth + 1);
+
+	if (profiler->shadow_count == 0) return;
+	ShadowFrame* frame = profiler->shadow + profiler->shadow_count - 1;
+	// frames entered before the profiler started have nothing to pop
+	if (frame->thread != thread || frame->depth != depth) return;
+	profiler->shadow_count--;
+
+	uint64_t elapsed = now - frame->start;
+	bt_ProfileFunction* function = profiler->functions + frame->function;
+	function->exclusive_ns += elapsed > frame->child ? elapsed - frame->child : 0;
+	// only the outermost activation of a recursive function adds to its inclusive time
+	if (--profiler->states[frame->function].active == 0) function->inclusive_ns += elapsed;
+	if (profiler->shadow_count) profiler->shadow[profiler->shadow_count - 1].child += elapsed;
+
+	if (profiler->scope) profiler->scope(profiler->scope_userdata, NULL);
+}
+
+static void clear_results(bt_Profiler* profiler)
+{
+	for (uint32_t i = 0; i < profiler->function_count; ++i) {
+		bt_ProfileFunction* function = profiler->functions + i;
+		function->calls = 0;
+		function->inclusive_ns = function->exclusive_ns = 0;
+		function->samples = function->self_samples = 0;
+		profiler->states[i].last_sample = 0;
+	}
+
+	profiler->line_count = 0;
+	if (profiler->line_slots) memset(profiler->line_slots, 0xff, profiler->line_slot_capacity * sizeof(uint32_t));
+
+	profiler->stack_count = 0;
+	profiler->frame_count = 0;
+	if (profiler->stack_slots) memset(profiler->stack_slots, 0xff, profiler->stack_slot_capacity * sizeof(uint32_t));
+
+	profiler->sample_id = 0;
+}
+
+void bt_profiler_start(bt_Context* ctx, bt_ProfileMode mode, uint32_t sample_interval_us)
+{
+	if (!ctx->profiler) {
+		ctx->profiler = ctx->alloc(sizeof(bt_Profiler));
+		memset(ctx->profiler, 0, sizeof(bt_Profiler));
+	}
+
+	bt_Profiler* profiler = ctx->profiler;
+	clear_results(profiler);
+	for (uint32_t i = 0; i < profiler->function_count; ++i) profiler->states[i].active = 0;
+	profiler->shadow_count = 0;
+
+	profiler->mode = mode;
+	profiler->interval_ns = (uint64_t)(sample_interval_us ? sample_interval_us : DEFAULT_SAMPLE_INTERVAL_US) * 1000;
+	profiler->next_sample = get_timestamp_ns() + profiler->interval_ns;
+	profiler->countdown = SAMPLE_CHECK_PERIOD;
+
+	ctx->profiling = BT_TRUE;
+}
+
+void bt_profiler_stop(bt_Context* ctx)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	if (!profiler) return;
+
+	// close the scopes of calls still in flight so external profilers stay balanced
+	if (profiler->scope) {
+		for (uint32_t i = 0; i < profiler->shadow_count; ++i) profiler->scope(profiler->scope_userdata, NULL);
+	}
+
+	for (uint32_t i = 0; i < profiler->function_count; ++i) profiler->states[i].active = 0;
+	profiler->shadow_count = 0;
+	ctx->profiling = BT_FALSE;
+}
+
+bt_bool bt_profiler_is_running(bt_Context* ctx)
+{
+	return ctx->profiling;
+}
+
+void bt_profiler_reset(bt_Context* ctx)
+{
+	if (ctx->profiler) clear_results(ctx->profiler);
+}
+
+void bt_profiler_set_scope_callback(bt_Context* ctx, bt_ProfileScope scope, void* userdata)
+{
+	if (!ctx->profiler) {
+		ctx->profiler = ctx->alloc(sizeof(bt_Profiler));
+		memset(ctx->profiler, 0, sizeof(bt_Profiler));
+	}
+
+	ctx->profiler->scope = scope;
+	ctx->profiler->scope_userdata = userdata;
+}
+
+const bt_ProfileFunction* bt_profiler_get_functions(bt_Context* ctx, uint32_t* count)
+{
+	*count = ctx->profiler ? ctx->profiler->function_count : 0;
+	return ctx->profiler ? ctx->profiler->functions : NULL;
+}
+
+const bt_ProfileLine* bt_profiler_get_lines(bt_Context* ctx, uint32_t* count)
+{
+	*count = ctx->profiler ? ctx->profiler->line_count : 0;
+	return ctx->profiler ? ctx->profiler->lines : NULL;
+}
+
+/** Growable text buffer for the dumps, turned into a single string at the end instead of appending string by string */
+typedef struct TextBuffer {
+	char* data;
+	uint32_t length, capacity;
+} TextBuffer;
+
+static void text_append(bt_Context* ctx, TextBuffer* text, const char* str, uint32_t length)
+{
+	text->data = reserve(ctx, text->data, &text->capacity, text->length + length, 1);
+	memcpy(text->data + text->length, str, length);
+	text->length += length;
+}
+
+static bt_String* text_finish(bt_Context* ctx, TextBuffer* text)
+{
+	bt_String* result = bt_make_string_len_uninterned(ctx, text->data ? text->data : "", text->length);
+	if (text->data) ctx->free(text->data);
+	return result;
+}
+
+bt_String* bt_profiler_dump_folded(bt_Context* ctx)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	TextBuffer text = { 0 };
+	char buffer[32];
+
+	for (uint32_t i = 0; profiler && i < profiler->stack_count; ++i) {
+		SampledStack* stack = profiler->stacks + i;
+		for (uint32_t j = 0; j < stack->length; ++j) {
+			if (j) text_append(ctx, &text, ";", 1);
+
+			// separators can't appear inside frame names
+			uint32_t start = text.length;
+			const char* name = profiler->functions[profiler->frames[stack->offset + j]].name;
+			text_append(ctx, &text, name, (uint32_t)strlen(name));
+			for (uint32_t k = start; k < text.length; ++k) {
+				if (text.data[k] == ';' || text.data[k] == ' ') text.data[k] = '_';
+			}
+		}
+
+		int length = snprintf(buffer, sizeof(buffer), " %llu\n", (unsigned long long)stack->count);
+		text_append(ctx, &text, buffer, (uint32_t)length);
+	}
+
+	return text_finish(ctx, &text);
+}
+
+bt_String* bt_profiler_dump_report(bt_Context* ctx, uint32_t max_entries)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	TextBuffer text = { 0 };
+	char buffer[512];
+
+	if (!profiler) return text_finish(ctx, &text);
+
+	bt_bool sampled = profiler->mode == BT_PROFILE_SAMPLE;
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < profiler->function_count; ++i) {
+		total += sampled ? profiler->functions[i].self_samples : profiler->functions[i].exclusive_ns;
+	}
+
+	int length = sampled
+		? snprintf(buffer, sizeof(buffer), "%-40s %10s %10s %7s\n", "function", "self", "total", "self%")
+		: snprintf(buffer, sizeof(buffer), "%-40s %10s %12s %12s %7s\n", "function", "calls", "self us", "total us", "self%");
+	text_append(ctx, &text, buffer, (uint32_t)length);
+
+	// repeatedly pick the most expensive remaining function, reports are meant to be short
+	uint64_t last_cost = UINT64_MAX;
+	uint32_t last_index = 0;
+	for (uint32_t n = 0; n < max_entries; ++n) {
+		int32_t best = -1;
+		uint64_t best_cost = 0;
+		for (uint32_t i = 0; i < profiler->function_count; ++i) {
+			bt_ProfileFunction* function = profiler->functions + i;
+			uint64_t cost = sampled ? function->self_samples : function->exclusive_ns;
+			if ((sampled ? function->samples : function->calls) == 0) continue;
+			if (cost > last_cost || (cost == last_cost && i <= last_index)) continue;
+			if (best < 0 || cost > best_cost) { best = i; best_cost = cost; }
+		}
+		if (best < 0) break;
+
+		last_cost = best_cost;
+		last_index = best;
+
+		bt_ProfileFunction* function = profiler->functions + best;
+		double pct = total ? 100.0 * (double)best_cost / (double)total : 0.0;
+		length = sampled
+			? snprintf(buffer, sizeof(buffer), "%-40s %10llu %10llu %6.2f%%\n", function->name,
+				(unsigned long long)function->self_samples, (unsigned long long)function->samples, pct)
+			: snprintf(buffer, sizeof(buffer), "%-40s %10llu %12.1f %12.1f %6.2f%%\n", function->name, (unsigned long long)function->calls,
+				(double)function->exclusive_ns / 1000.0, (double)function->inclusive_ns / 1000.0, pct);
+		if (length >= (int)sizeof(buffer)) length = sizeof(buffer) - 1;
+		text_append(ctx, &text, buffer, (uint32_t)length);
+	}
+
+	return text_finish(ctx, &text);
+}
+
+void bt_profiler_destroy(bt_Context* ctx)
+{
+	bt_Profiler* profiler = ctx->profiler;
+	if (!profiler) return;
+
+	for (uint32_t i = 0; i < profiler->function_count; ++i) {
+		ctx->free((char*)profiler->functions[i].name);
+		ctx->free((char*)profiler->functions[i].module);
+	}
+
+	void* buffers[] = {
+		profiler->functions, profiler->states, profiler->function_slots, profiler->shadow,
+		profiler->lines, profiler->line_slots, profiler->stacks, profiler->stack_slots, profiler->frames,
+	};
+
+	for (uint32_t i = 0; i < sizeof(buffers) / sizeof(buffers[0]); ++i) {
+		if (buffers[i]) ctx->free(buffers[i]);
+	}
+
+	ctx->free(profiler);
+	ctx->profiler = NULL;
+	ctx->profiling = BT_FALSE;
+}
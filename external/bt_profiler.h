@@ -0,0 +1,85 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_object.h"
+#include "bt_op.h"
+
+/***
+ * Opt-in script profiler, owned by the context and disabled (and free) until `bt_profiler_start` is called.
+ *
+ * Instrumented mode timestamps every call and return, recording call counts and inclusive/exclusive time per function.
+ * Sampling mode only looks at the clock every few calls and loop back-edges, and snapshots the callstack of the running
+ * thread once per interval. Samples are aggregated per function, per source line of the innermost frame and per unique
+ * callstack, the latter can be dumped in the folded format flamegraph tools consume. As samples are only taken on calls and
+ * back-edges, line costs land on the call or loop that was executing rather than on individual statements.
+ *
+ * Functions are identified by their exported name (`module.name`) when they have one, otherwise by module and first line (`module:line`).
+ * Closures are attributed to the function they wrap. Results survive the functions they describe being collected, a function
+ * allocated at a collected one's address afterwards is recorded separately.
+ */
+
+typedef enum {
+	BT_PROFILE_INSTRUMENT,
+	BT_PROFILE_SAMPLE,
+} bt_ProfileMode;
+
+/** Aggregated cost of one function since the last reset. Times are only recorded in instrumented mode, samples only in sampling mode */
+typedef struct bt_ProfileFunction {
+	const char* name;
+	const char* module;
+	uint32_t line;
+	uint64_t calls;
+	uint64_t inclusive_ns, exclusive_ns;
+	uint64_t samples, self_samples;
+} bt_ProfileFunction;
+
+/** Samples whose innermost frame was executing `line` of `function`, an index into `bt_profiler_get_functions` */
+typedef struct bt_ProfileLine {
+	uint32_t function;
+	uint32_t line;
+	uint64_t samples;
+} bt_ProfileLine;
+
+/** Called when an instrumented function is entered (with its name) or left (with NULL), used to forward scopes to an external profiler */
+typedef void (*bt_ProfileScope)(void* userdata, const char* name);
+
+/** Starts profiling in `mode`, discarding previous results. `sample_interval_us` is only used in sampling mode, 0 picks a default */
+BOLT_API void bt_profiler_start(bt_Context* ctx, bt_ProfileMode mode, uint32_t sample_interval_us);
+/** Stops recording, results stay available until the next start or reset */
+BOLT_API void bt_profiler_stop(bt_Context* ctx);
+/** Returns whether the profiler is currently recording */
+BOLT_API bt_bool bt_profiler_is_running(bt_Context* ctx);
+/** Clears all counters and samples while keeping the profiler running, call it once per frame for per-frame results */
+BOLT_API void bt_profiler_reset(bt_Context* ctx);
+
+/** Sets a callback invoked around every instrumented call, the names passed stay valid until the context is closed */
+BOLT_API void bt_profiler_set_scope_callback(bt_Context* ctx, bt_ProfileScope scope, void* userdata);
+
+/** Returns every function seen since the profiler was first started, including ones without cost since the last reset */
+BOLT_API const bt_ProfileFunction* bt_profiler_get_functions(bt_Context* ctx, uint32_t* count);
+/** Returns the per-line self samples recorded since the last reset, in no particular order */
+BOLT_API const bt_ProfileLine* bt_profiler_get_lines(bt_Context* ctx, uint32_t* count);
+
+/** Dumps the sampled callstacks as `outer;inner count` lines, the folded stack format read by flamegraph tools */
+BOLT_API bt_String* bt_profiler_dump_folded(bt_Context* ctx);
+/** Dumps a table of the `max_entries` most expensive functions, sorted by exclusive time or self samples */
+BOLT_API bt_String* bt_profiler_dump_report(bt_Context* ctx, uint32_t max_entries);
+
+/** Frees the profiler and everything it recorded, called by `bt_close` */
+BOLT_API void bt_profiler_destroy(bt_Context* ctx);
+
+/** VM hooks, only called while the profiler is running. Enter is called after the frame is pushed, exit before it's popped */
+BOLT_API void bt_profiler_enter(bt_Context* ctx, bt_Thread* thread, bt_Callable* callable);
+BOLT_API void bt_profiler_exit(bt_Context* ctx, bt_Thread* thread);
+/** Called on loop back-edges, `ip` is the instruction being executed in the innermost frame */
+BOLT_API void bt_profiler_tick(bt_Context* ctx, bt_Thread* thread, bt_Op* ip);
+/** GC hook, called when a function or module is freed so an object later allocated at its address isn't attributed its results */
+BOLT_API void bt_profiler_forget(bt_Context* ctx, bt_Object* obj);
+
+#if __cplusplus
+}
+#endif
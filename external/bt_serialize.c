@@ -0,0 +1,1217 @@
+#include "bt_serialize.h"
+
+#include "bt_context.h"
+#include "bt_type.h"
+#include "bt_gc.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define SERIALIZE_MAGIC 0x43425442u // "BTBC"
+#define SERIALIZE_ENDIAN_MARK 0x01020304u
+#define SERIALIZE_NO_STRING UINT32_MAX
+
+typedef enum {
+	SV_NONE,
+	SV_IMMEDIATE,
+	SV_REF,
+	SV_EXTERN,
+	SV_STRING,
+	SV_TYPE,
+	SV_FN,
+	SV_TABLE,
+	SV_ARRAY,
+	SV_ANNOTATION,
+} SerializedValueTag;
+
+typedef enum {
+	EXTERN_REGISTERED_TYPE,
+	EXTERN_PRELUDE,
+	EXTERN_MODULE_EXPORTS,
+	EXTERN_MODULE_TYPE,
+	EXTERN_MODULE_EXPORT,
+	EXTERN_MODULE_EXPORT_TYPE,
+} ExternKind;
+
+typedef enum {
+	IMPORT_PRELUDE,
+	IMPORT_MODULE,
+	IMPORT_ITEM,
+} ImportKind;
+
+#define TABLESHAPE_SEALED 1
+#define TABLESHAPE_FINAL 2
+#define TABLESHAPE_MAP 4
+
+/** Identity map from object pointers to indices, bt_Table compares types structurally so it can't be used here */
+typedef struct PtrMapEntry {
+	bt_Object* key;
+	uint32_t value;
+} PtrMapEntry;
+
+typedef struct PtrMap {
+	PtrMapEntry* entries;
+	uint32_t capacity, count;
+} PtrMap;
+
+static uint32_t ptrmap_slot(PtrMap* map, bt_Object* key)
+{
+	uint64_t h = (uint64_t)key;
+	h ^= h >> 33; h *= 0xff51afd7ed558ccdull; h ^= h >> 33;
+	return (uint32_t)h & (map->capacity - 1);
+}
+
+static bt_bool ptrmap_get(PtrMap* map, bt_Object* key, uint32_t* value)
+{
+	if (map->count == 0) return BT_FALSE;
+
+	uint32_t slot = ptrmap_slot(map, key);
+	while (map->entries[slot].key) {
+		if (map->entries[slot].key == key) {
+			*value = map->entries[slot].value;
+			return BT_TRUE;
+		}
+
+		slot = (slot + 1) & (map->capacity - 1);
+	}
+
+	return BT_FALSE;
+}
+
+static void ptrmap_set(bt_Context* ctx, PtrMap* map, bt_Object* key, uint32_t value)
+{
+	if ((map->count + 1) * 2 > map->capacity) {
+		PtrMapEntry* old_entries = map->entries;
+		uint32_t old_capacity = map->capacity;
+
+		map->capacity = old_capacity ? old_capacity * 2 : 64;
+		map->entries = bt_gc_alloc(ctx, map->capacity * sizeof(PtrMapEntry));
+		memset(map->entries, 0, map->capacity * sizeof(PtrMapEntry));
+
+		for (uint32_t i = 0; i < old_capacity; ++i) {
+			if (!old_entries[i].key) continue;
+
+			uint32_t slot = ptrmap_slot(map, old_entries[i].key);
+			while (map->entries[slot].key) slot = (slot + 1) & (map->capacity - 1);
+			map->entries[slot] = old_entries[i];
+		}
+
+		if (old_entries) bt_gc_free(ctx, old_entries, old_capacity * sizeof(PtrMapEntry));
+	}
+
+	uint32_t slot = ptrmap_slot(map, key);
+	while (map->entries[slot].key) slot = (slot + 1) & (map->capacity - 1);
+	map->entries[slot].key = key;
+	map->entries[slot].value = value;
+	map->count++;
+}
+
+static void ptrmap_destroy(bt_Context* ctx, PtrMap* map)
+{
+	if (map->entries) bt_gc_free(ctx, map->entries, map->capacity * sizeof(PtrMapEntry));
+	map->entries = NULL;
+	map->capacity = map->count = 0;
+}
+
+/** Layout fingerprint of a tableshape, used to detect referenced types that changed since the blob was written */
+static void layout_fingerprint(bt_Type* type, uint32_t* count, uint64_t* hash)
+{
+	*count = 0;
+	*hash = 0;
+
+	bt_Table* layout = type->as.table_shape.layout;
+	if (!layout) return;
+
+	for (uint32_t i = 0; i < layout->length; ++i) {
+		*hash = *hash * 31 + bt_value_hash(BT_TABLE_PAIRS(layout)[i].key);
+	}
+
+	*count = layout->length;
+}
+
+static void ensure_template(bt_Context* ctx, bt_Type* type)
+{
+	if (type->as.table_shape.tmpl) return;
+
+	bt_Table* layout = type->as.table_shape.layout;
+	bt_Table* result = bt_make_table(ctx, layout ? layout->length : 0);
+	for (uint32_t i = 0; i < (layout ? layout->length : 0u); ++i) {
+		bt_table_set(ctx, result, BT_TABLE_PAIRS(layout)[i].key, BT_VALUE_NULL);
+	}
+
+	result->prototype = bt_type_get_proto(ctx, type);
+	type->as.table_shape.tmpl = result;
+}
+
+static bt_bool is_tableshape(bt_Object* obj)
+{
+	if (BT_OBJECT_GET_TYPE(obj) != BT_OBJECT_TYPE_TYPE) return BT_FALSE;
+	bt_Type* type = (bt_Type*)obj;
+	return type->category == BT_TYPE_CATEGORY_TABLESHAPE && !type->as.table_shape.map;
+}
+
+/** WRITING */
+
+typedef struct ExternRef {
+	uint8_t kind;
+	bt_String* root;
+	bt_String* key;
+	bt_String* member;
+} ExternRef;
+
+typedef struct Writer {
+	bt_Context* ctx;
+	bt_Module* module;
+	bt_Buffer(uint8_t) output;
+
+	PtrMap memo;
+	uint32_t memo_count;
+
+	PtrMap externs;
+	bt_Buffer(ExternRef) extern_refs;
+
+	bt_bool include_debug;
+	uint32_t* token_remap;
+	bt_Buffer(uint32_t) used_tokens;
+
+	bt_bool failed;
+} Writer;
+
+static void write_error(Writer* w, const char* format, const char* detail)
+{
+	if (w->failed) return;
+	w->failed = BT_TRUE;
+
+	char message[512];
+	snprintf(message, sizeof(message), format, detail ? detail : "?");
+	w->ctx->on_error(BT_ERROR_COMPILE, w->module->path ? BT_STRING_STR(w->module->path) : "", message, 0, 0);
+}
+
+static void write_bytes(Writer* w, const void* data, size_t size)
+{
+	if (w->output.length + size > w->output.capacity) {
+		size_t new_cap = w->output.capacity ? w->output.capacity * 2 : 1024;
+		while (new_cap < w->output.length + size) new_cap *= 2;
+		bt_buffer_reserve(&w->output, w->ctx, new_cap);
+	}
+
+	memcpy(w->output.elements + w->output.length, data, size);
+	w->output.length += (uint32_t)size;
+}
+
+static void write_u8(Writer* w, uint8_t value) { write_bytes(w, &value, sizeof(value)); }
+static void write_u16(Writer* w, uint16_t value) { write_bytes(w, &value, sizeof(value)); }
+static void write_u32(Writer* w, uint32_t value) { write_bytes(w, &value, sizeof(value)); }
+static void write_u64(Writer* w, uint64_t value) { write_bytes(w, &value, sizeof(value)); }
+
+static void write_raw_string(Writer* w, const char* str, uint32_t len)
+{
+	if (!str) {
+		write_u32(w, SERIALIZE_NO_STRING);
+		return;
+	}
+
+	write_u32(w, len);
+	write_bytes(w, str, len);
+}
+
+static void write_string_ref(Writer* w, bt_String* str)
+{
+	if (str) write_raw_string(w, BT_STRING_STR(str), str->len);
+	else write_raw_string(w, NULL, 0);
+}
+
+static void write_object(Writer* w, bt_Object* obj);
+
+static void write_value(Writer* w, bt_Value value)
+{
+	if (!BT_IS_OBJECT(value)) {
+		write_u8(w, SV_IMMEDIATE);
+		write_u64(w, value);
+		return;
+	}
+
+	write_object(w, BT_AS_OBJECT(value));
+}
+
+static void write_table_pairs(Writer* w, bt_Table* table)
+{
+	if (!table) {
+		write_u32(w, UINT32_MAX);
+		return;
+	}
+
+	write_u32(w, table->length);
+	for (uint32_t i = 0; i < table->length; ++i) {
+		write_value(w, BT_TABLE_PAIRS(table)[i].key);
+		write_value(w, BT_TABLE_PAIRS(table)[i].value);
+	}
+}
+
+static void write_debug_locs(Writer* w, bt_DebugLocBuffer* locs)
+{
+	if (!w->include_debug || !locs || !w->token_remap) {
+		write_u8(w, 0);
+		return;
+	}
+
+	write_u8(w, 1);
+	write_u32(w, locs->length);
+
+	uint32_t n_tokens = w->module->debug_tokens.length;
+	for (uint32_t i = 0; i < locs->length; ++i) {
+		uint32_t original = locs->elements[i] < n_tokens ? locs->elements[i] : 0;
+		if (w->token_remap[original] == UINT32_MAX) {
+			w->token_remap[original] = w->used_tokens.length;
+			bt_buffer_push(w->ctx, &w->used_tokens, original);
+		}
+
+		write_u32(w, w->token_remap[original]);
+	}
+}
+
+static void write_code(Writer* w, uint8_t stack_size, bt_ValueBuffer* constants, bt_InstructionBuffer* instructions, bt_DebugLocBuffer* locs)
+{
+	write_u8(w, stack_size);
+
+	write_u32(w, constants->length);
+	for (uint32_t i = 0; i < constants->length; ++i) {
+		write_value(w, constants->elements[i]);
+	}
+
+	write_u32(w, instructions->length);
+	write_bytes(w, instructions->elements, instructions->length * sizeof(bt_Op));
+
+	write_debug_locs(w, locs);
+}
+
+static void write_type(Writer* w, bt_Type* type)
+{
+	if (type->is_polymorphic || type->category == BT_TYPE_CATEGORY_PRIMITIVE
+		|| type->category == BT_TYPE_CATEGORY_USERDATA || type->category == BT_TYPE_CATEGORY_NATIVE_FN) {
+		write_error(w, "Native type '%s' isn't reachable by name and can't be serialized", type->name);
+		return;
+	}
+
+	uint8_t flags = 0;
+	switch (type->category) {
+	case BT_TYPE_CATEGORY_TABLESHAPE:
+		if (type->as.table_shape.sealed) flags |= TABLESHAPE_SEALED;
+		if (type->as.table_shape.final) flags |= TABLESHAPE_FINAL;
+		if (type->as.table_shape.map) flags |= TABLESHAPE_MAP;
+		break;
+	case BT_TYPE_CATEGORY_SIGNATURE: flags = type->as.fn.is_vararg; break;
+	case BT_TYPE_CATEGORY_ENUM: flags = type->as.enum_.is_sealed; break;
+	}
+
+	write_u8(w, type->category);
+	write_u8(w, flags);
+
+	write_raw_string(w, type->name, type->name ? (uint32_t)strlen(type->name) : 0);
+	write_object(w, (bt_Object*)type->prototype);
+	write_object(w, (bt_Object*)type->annotations);
+
+	switch (type->category) {
+	case BT_TYPE_CATEGORY_TYPE:
+		write_object(w, (bt_Object*)type->as.type.boxed);
+		break;
+	case BT_TYPE_CATEGORY_ARRAY:
+		write_object(w, (bt_Object*)type->as.array.inner);
+		break;
+	case BT_TYPE_CATEGORY_TABLESHAPE: {
+		if (type->as.table_shape.map) {
+			write_object(w, (bt_Object*)type->as.table_shape.key_type);
+			write_object(w, (bt_Object*)type->as.table_shape.value_type);
+		}
+
+		write_object(w, (bt_Object*)type->as.table_shape.parent);
+
+		bt_Table* layout = type->as.table_shape.layout;
+		write_u32(w, layout ? layout->length : 0);
+		for (uint32_t i = 0; i < (layout ? layout->length : 0u); ++i) {
+			bt_TablePair* pair = BT_TABLE_PAIRS(layout) + i;
+			write_value(w, pair->key);
+			write_value(w, pair->value);
+			write_value(w, bt_table_get(type->as.table_shape.key_layout, pair->key));
+		}
+
+		write_table_pairs(w, type->as.table_shape.field_annotations);
+		write_table_pairs(w, type->prototype_types);
+		write_table_pairs(w, type->prototype_values);
+		write_u8(w, type->as.table_shape.tmpl != NULL);
+	} break;
+	case BT_TYPE_CATEGORY_SIGNATURE:
+		write_u32(w, type->as.fn.args.length);
+		for (uint32_t i = 0; i < type->as.fn.args.length; ++i) {
+			write_object(w, (bt_Object*)type->as.fn.args.elements[i]);
+		}
+
+		write_object(w, (bt_Object*)type->as.fn.return_type);
+		write_object(w, (bt_Object*)type->as.fn.varargs_type);
+		break;
+	case BT_TYPE_CATEGORY_UNION:
+		write_u32(w, type->as.selector.types.length);
+		for (uint32_t i = 0; i < type->as.selector.types.length; ++i) {
+			write_object(w, (bt_Object*)type->as.selector.types.elements[i]);
+		}
+		break;
+	case BT_TYPE_CATEGORY_ENUM:
+		write_object(w, (bt_Object*)type->as.enum_.name);
+		write_table_pairs(w, type->as.enum_.options);
+		break;
+	}
+}
+
+static void write_object(Writer* w, bt_Object* obj)
+{
+	if (w->failed) return;
+
+	if (!obj) {
+		write_u8(w, SV_NONE);
+		return;
+	}
+
+	uint32_t idx;
+	if (ptrmap_get(&w->memo, obj, &idx)) {
+		write_u8(w, SV_REF);
+		write_u32(w, idx);
+		return;
+	}
+
+	bt_bool is_extern = ptrmap_get(&w->externs, obj, &idx);
+
+	// Every object gets its memo slot before its contents are written, so cycles through types resolve to back-references
+	uint8_t tag = SV_NONE;
+	if (is_extern) tag = SV_EXTERN;
+	else switch (BT_OBJECT_GET_TYPE(obj)) {
+	case BT_OBJECT_TYPE_STRING: tag = SV_STRING; break;
+	case BT_OBJECT_TYPE_TYPE: tag = SV_TYPE; break;
+	case BT_OBJECT_TYPE_FN:
+		if (((bt_Fn*)obj)->module == w->module) tag = SV_FN;
+		break;
+	case BT_OBJECT_TYPE_TABLE:
+		if (((bt_Table*)obj)->prototype == NULL) tag = SV_TABLE;
+		break;
+	case BT_OBJECT_TYPE_ARRAY: tag = SV_ARRAY; break;
+	case BT_OBJECT_TYPE_ANNOTATION: tag = SV_ANNOTATION; break;
+	}
+
+	if (tag == SV_NONE) {
+		write_error(w, "Module references a value that can't be serialized (%s)",
+			BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_FN ? "function from another module" : "unnamed native object");
+		return;
+	}
+
+	write_u8(w, tag);
+	ptrmap_set(w->ctx, &w->memo, obj, w->memo_count++);
+
+	switch (tag) {
+	case SV_EXTERN: {
+		ExternRef* ref = w->extern_refs.elements + idx;
+		write_u8(w, ref->kind);
+		write_string_ref(w, ref->root);
+		write_string_ref(w, ref->key);
+		write_string_ref(w, ref->member);
+
+		if (is_tableshape(obj)) {
+			uint32_t count;
+			uint64_t hash;
+			layout_fingerprint((bt_Type*)obj, &count, &hash);
+			write_u8(w, 1);
+			write_u32(w, count);
+			write_u64(w, hash);
+			write_u8(w, ((bt_Type*)obj)->as.table_shape.tmpl != NULL);
+		}
+		else {
+			write_u8(w, 0);
+		}
+	} break;
+	case SV_STRING:
+		write_string_ref(w, (bt_String*)obj);
+		break;
+	case SV_TYPE:
+		write_type(w, (bt_Type*)obj);
+		break;
+	case SV_FN: {
+		bt_Fn* fn = (bt_Fn*)obj;
+		write_object(w, (bt_Object*)fn->signature);
+		write_code(w, fn->stack_size, &fn->constants, &fn->instructions, fn->debug);
+	} break;
+	case SV_TABLE:
+		write_table_pairs(w, (bt_Table*)obj);
+		break;
+	case SV_ARRAY: {
+		bt_Array* arr = (bt_Array*)obj;
+		write_u32(w, arr->length);
+		for (uint32_t i = 0; i < arr->length; ++i) write_value(w, arr->items[i]);
+	} break;
+	case SV_ANNOTATION: {
+		bt_Annotation* anno = (bt_Annotation*)obj;
+		write_object(w, (bt_Object*)anno->name);
+		write_object(w, (bt_Object*)anno->args);
+		write_object(w, (bt_Object*)anno->next);
+	} break;
+	}
+}
+
+static void index_extern(Writer* w, bt_Value value, ExternKind kind, bt_String* root, bt_String* key, bt_String* member)
+{
+	if (!BT_IS_OBJECT(value)) return;
+
+	bt_Object* obj = BT_AS_OBJECT(value);
+	if (BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_STRING) return;
+
+	uint32_t existing;
+	if (ptrmap_get(&w->externs, obj, &existing)) return;
+
+	ExternRef ref;
+	ref.kind = kind;
+	ref.root = root;
+	ref.key = key;
+	ref.member = member;
+
+	bt_buffer_push(w->ctx, &w->extern_refs, ref);
+	ptrmap_set(w->ctx, &w->externs, obj, w->extern_refs.length - 1);
+}
+
+static void index_extern_members(Writer* w, bt_Value value, ExternKind kind, bt_String* root, bt_String* key)
+{
+	if (!BT_IS_OBJECT(value) || BT_OBJECT_GET_TYPE(BT_AS_OBJECT(value)) != BT_OBJECT_TYPE_TYPE) return;
+
+	bt_Table* proto = ((bt_Type*)BT_AS_OBJECT(value))->prototype_values;
+	if (!proto) return;
+
+	for (uint32_t i = 0; i < proto->length; ++i) {
+		bt_TablePair* pair = BT_TABLE_PAIRS(proto) + i;
+		if (!BT_IS_OBJECT(pair->key) || BT_OBJECT_GET_TYPE(BT_AS_OBJECT(pair->key)) != BT_OBJECT_TYPE_STRING) continue;
+
+		index_extern(w, pair->value, kind, root, key, (bt_String*)BT_AS_OBJECT(pair->key));
+	}
+}
+
+static bt_bool is_string_key(bt_Value key)
+{
+	return BT_IS_OBJECT(key) && BT_OBJECT_GET_TYPE(BT_AS_OBJECT(key)) == BT_OBJECT_TYPE_STRING;
+}
+
+/** Name everything the module could have picked up from the context, first match wins */
+static void build_extern_index(Writer* w)
+{
+	bt_Context* ctx = w->ctx;
+
+	for (uint32_t i = 0; i < ctx->type_registry->length; ++i) {
+		bt_TablePair* pair = BT_TABLE_PAIRS(ctx->type_registry) + i;
+		if (!is_string_key(pair->key)) continue;
+
+		bt_String* name = (bt_String*)BT_AS_OBJECT(pair->key);
+		index_extern(w, pair->value, EXTERN_REGISTERED_TYPE, name, NULL, NULL);
+		index_extern_members(w, pair->value, EXTERN_REGISTERED_TYPE, name, NULL);
+	}
+
+	for (uint32_t i = 0; i < ctx->prelude->length; ++i) {
+		bt_TablePair* pair = BT_TABLE_PAIRS(ctx->prelude) + i;
+		if (!is_string_key(pair->key)) continue;
+
+		bt_String* name = (bt_String*)BT_AS_OBJECT(pair->key);
+		bt_ModuleImport* entry = (bt_ModuleImport*)BT_AS_OBJECT(pair->value);
+		index_extern(w, entry->value, EXTERN_PRELUDE, name, NULL, NULL);
+		index_extern_members(w, entry->value, EXTERN_PRELUDE, name, NULL);
+	}
+
+	for (uint32_t i = 0; i < ctx->loaded_modules->length; ++i) {
+		bt_TablePair* pair = BT_TABLE_PAIRS(ctx->loaded_modules) + i;
+		bt_Module* mod = (bt_Module*)BT_AS_OBJECT(pair->value);
+		if (!is_string_key(pair->key) || mod == w->module) continue;
+
+		bt_String* mod_name = (bt_String*)BT_AS_OBJECT(pair->key);
+		index_extern(w, BT_VALUE_OBJECT(mod->exports), EXTERN_MODULE_EXPORTS, mod_name, NULL, NULL);
+		index_extern(w, BT_VALUE_OBJECT(mod->type), EXTERN_MODULE_TYPE, mod_name, NULL, NULL);
+
+		for (uint32_t j = 0; j < mod->exports->length; ++j) {
+			bt_TablePair* export = BT_TABLE_PAIRS(mod->exports) + j;
+			if (!is_string_key(export->key)) continue;
+
+			bt_String* key = (bt_String*)BT_AS_OBJECT(export->key);
+			index_extern(w, export->value, EXTERN_MODULE_EXPORT, mod_name, key, NULL);
+			index_extern_members(w, export->value, EXTERN_MODULE_EXPORT, mod_name, key);
+		}
+
+		bt_Table* export_types = mod->type->as.table_shape.layout;
+		for (uint32_t j = 0; j < (export_types ? export_types->length : 0u); ++j) {
+			bt_TablePair* export = BT_TABLE_PAIRS(export_types) + j;
+			if (!is_string_key(export->key)) continue;
+
+			index_extern(w, export->value, EXTERN_MODULE_EXPORT_TYPE, mod_name, (bt_String*)BT_AS_OBJECT(export->key), NULL);
+		}
+	}
+}
+
+static void write_imports(Writer* w)
+{
+	bt_Context* ctx = w->ctx;
+	bt_ImportBuffer* imports = &w->module->imports;
+
+	write_u32(w, imports->length);
+	for (uint32_t i = 0; i < imports->length; ++i) {
+		bt_ModuleImport* import = imports->elements[i];
+
+		bt_Value prelude_entry = bt_table_get(ctx->prelude, BT_VALUE_OBJECT(import->name));
+		if (BT_IS_OBJECT(prelude_entry) && BT_AS_OBJECT(prelude_entry) == (bt_Object*)import) {
+			write_u8(w, IMPORT_PRELUDE);
+			write_string_ref(w, import->name);
+			write_string_ref(w, NULL);
+			continue;
+		}
+
+		bt_bool found = BT_FALSE;
+		for (uint32_t j = 0; j < ctx->loaded_modules->length && !found; ++j) {
+			bt_TablePair* pair = BT_TABLE_PAIRS(ctx->loaded_modules) + j;
+			bt_Module* mod = (bt_Module*)BT_AS_OBJECT(pair->value);
+			if (!is_string_key(pair->key)) continue;
+
+			if (import->value == BT_VALUE_OBJECT(mod->exports)) {
+				write_u8(w, IMPORT_MODULE);
+			}
+			else if (bt_table_get(mod->exports, BT_VALUE_OBJECT(import->name)) == import->value) {
+				write_u8(w, IMPORT_ITEM);
+			}
+			else continue;
+
+			write_string_ref(w, import->name);
+			write_string_ref(w, (bt_String*)BT_AS_OBJECT(pair->key));
+			found = BT_TRUE;
+		}
+
+		if (!found) write_error(w, "Can't find the module that import '%s' came from", BT_STRING_STR(import->name));
+	}
+}
+
+bt_bool bt_serialize_module(bt_Context* ctx, bt_Module* module, bt_bool include_debug, bt_SerializeWrite write, void* userdata)
+{
+	Writer w;
+	memset(&w, 0, sizeof(w));
+	w.ctx = ctx;
+	w.module = module;
+	bt_buffer_empty(&w.output);
+	bt_buffer_empty(&w.extern_refs);
+	bt_buffer_empty(&w.used_tokens);
+
+	w.include_debug = include_debug && module->debug_locs && module->debug_tokens.length;
+	if (w.include_debug) {
+		w.token_remap = bt_gc_alloc(ctx, module->debug_tokens.length * sizeof(uint32_t));
+		memset(w.token_remap, 0xFF, module->debug_tokens.length * sizeof(uint32_t));
+	}
+
+	bt_gc_pause(ctx);
+
+	build_extern_index(&w);
+
+	write_u32(&w, SERIALIZE_MAGIC);
+	write_u32(&w, BT_SERIALIZE_VERSION);
+	write_u32(&w, SERIALIZE_ENDIAN_MARK);
+
+	write_imports(&w);
+	write_code(&w, module->stack_size, &module->constants, &module->instructions, module->debug_locs);
+
+	write_u32(&w, w.used_tokens.length);
+	for (uint32_t i = 0; i < w.used_tokens.length; ++i) {
+		bt_Token* token = module->debug_tokens.elements[w.used_tokens.elements[i]];
+		write_u16(&w, token->line);
+		write_u16(&w, token->col);
+	}
+
+	bt_gc_unpause(ctx);
+
+	if (!w.failed) write(userdata, w.output.elements, w.output.length);
+
+	if (w.token_remap) bt_gc_free(ctx, w.token_remap, module->debug_tokens.length * sizeof(uint32_t));
+	bt_buffer_destroy(ctx, &w.used_tokens);
+	bt_buffer_destroy(ctx, &w.extern_refs);
+	bt_buffer_destroy(ctx, &w.output);
+	ptrmap_destroy(ctx, &w.externs);
+	ptrmap_destroy(ctx, &w.memo);
+
+	return !w.failed;
+}
+
+/** READING */
+
+typedef struct Reader {
+	bt_Context* ctx;
+	bt_Module* module;
+	const char* mod_name;
+
+	const uint8_t* current;
+	const uint8_t* end;
+
+	bt_Buffer(bt_Object*) memo;
+	bt_Buffer(bt_Type*) parented;
+	bt_Buffer(bt_Type*) templated;
+
+	uint32_t max_loc;
+	bt_bool failed;
+} Reader;
+
+static void read_error(Reader* r, const char* format, const char* detail)
+{
+	if (r->failed) return;
+	r->failed = BT_TRUE;
+
+	char message[512];
+	snprintf(message, sizeof(message), format, detail ? detail : "?");
+	r->ctx->on_error(BT_ERROR_COMPILE, r->mod_name ? r->mod_name : "", message, 0, 0);
+}
+
+static const uint8_t* read_bytes(Reader* r, size_t size)
+{
+	if (r->failed) return NULL;
+
+	if ((size_t)(r->end - r->current) < size) {
+		read_error(r, "Serialized module is truncated%s", "");
+		return NULL;
+	}
+
+	const uint8_t* result = r->current;
+	r->current += size;
+	return result;
+}
+
+#define READ_SCALAR(name, type)                           \
+	static type name(Reader* r)                           \
+	{                                                     \
+		type result = 0;                                  \
+		const uint8_t* data = read_bytes(r, sizeof(type)); \
+		if (data) memcpy(&result, data, sizeof(type));    \
+		return result;                                    \
+	}
+
+READ_SCALAR(read_u8, uint8_t)
+READ_SCALAR(read_u16, uint16_t)
+READ_SCALAR(read_u32, uint32_t)
+READ_SCALAR(read_u64, uint64_t)
+
+/** Returns NULL for an absent string, `len` is untouched in that case */
+static const char* read_raw_string(Reader* r, uint32_t* len)
+{
+	uint32_t length = read_u32(r);
+	if (r->failed || length == SERIALIZE_NO_STRING) return NULL;
+
+	const char* result = (const char*)read_bytes(r, length);
+	*len = length;
+	return result;
+}
+
+static bt_String* read_string_ref(Reader* r)
+{
+	uint32_t len = 0;
+	const char* str = read_raw_string(r, &len);
+	if (!str) return NULL;
+	return bt_make_string_hashed_len(r->ctx, str, len);
+}
+
+/** Counts have to fit in what's left of the blob, which guards every allocation sized from the input */
+static uint32_t read_count(Reader* r, size_t min_element_size)
+{
+	uint32_t count = read_u32(r);
+	if (!r->failed && (size_t)count * min_element_size > (size_t)(r->end - r->current)) {
+		read_error(r, "Serialized module has a corrupt element count%s", "");
+		return 0;
+	}
+
+	return r->failed ? 0 : count;
+}
+
+static bt_Object* read_object(Reader* r);
+
+static bt_Value read_value(Reader* r)
+{
+	if (r->failed) return BT_VALUE_NULL;
+
+	if (r->current < r->end && *r->current == SV_IMMEDIATE) {
+		r->current++;
+		return (bt_Value)read_u64(r);
+	}
+
+	bt_Object* obj = read_object(r);
+	return obj ? BT_VALUE_OBJECT(obj) : BT_VALUE_NULL;
+}
+
+static bt_Type* read_type_object(Reader* r)
+{
+	bt_Object* obj = read_object(r);
+	if (obj && BT_OBJECT_GET_TYPE(obj) != BT_OBJECT_TYPE_TYPE) {
+		read_error(r, "Serialized module has a non-type value where a type was expected%s", "");
+		return NULL;
+	}
+
+	return (bt_Type*)obj;
+}
+
+static bt_Table* read_table_pairs(Reader* r)
+{
+	uint32_t count = read_u32(r);
+	if (r->failed || count == UINT32_MAX) return NULL;
+	if ((size_t)count * 2 > (size_t)(r->end - r->current)) {
+		read_error(r, "Serialized module has a corrupt element count%s", "");
+		return NULL;
+	}
+
+	bt_Table* result = bt_make_table(r->ctx, count);
+	for (uint32_t i = 0; i < count && !r->failed; ++i) {
+		bt_Value key = read_value(r);
+		bt_Value value = read_value(r);
+		bt_table_set(r->ctx, result, key, value);
+	}
+
+	return result;
+}
+
+static bt_DebugLocBuffer* read_debug_locs(Reader* r)
+{
+	if (!read_u8(r)) return NULL;
+
+	uint32_t count = read_count(r, sizeof(uint32_t));
+	bt_DebugLocBuffer* locs = bt_gc_alloc(r->ctx, sizeof(bt_DebugLocBuffer));
+	bt_buffer_with_capacity(locs, r->ctx, count);
+
+	for (uint32_t i = 0; i < count && !r->failed; ++i) {
+		uint32_t loc = read_u32(r);
+		if (loc + 1 > r->max_loc) r->max_loc = loc + 1;
+		bt_buffer_push(r->ctx, locs, loc);
+	}
+
+	return locs;
+}
+
+static void read_code(Reader* r, uint8_t* stack_size, bt_ValueBuffer* constants, bt_InstructionBuffer* instructions, bt_DebugLocBuffer** locs)
+{
+	*stack_size = read_u8(r);
+
+	uint32_t n_constants = read_count(r, 1);
+	bt_buffer_reserve(constants, r->ctx, n_constants);
+	for (uint32_t i = 0; i < n_constants && !r->failed; ++i) {
+		bt_Value constant = read_value(r);
+		bt_buffer_push(r->ctx, constants, constant);
+	}
+
+	uint32_t n_instructions = read_count(r, sizeof(bt_Op));
+	const uint8_t* ops = read_bytes(r, n_instructions * sizeof(bt_Op));
+	if (ops) {
+		bt_buffer_reserve(instructions, r->ctx, n_instructions);
+		memcpy(instructions->elements, ops, n_instructions * sizeof(bt_Op));
+		instructions->length = n_instructions;
+	}
+
+	*locs = read_debug_locs(r);
+}
+
+static void set_type_name(bt_Context* ctx, bt_Type* type, const char* name, uint32_t len)
+{
+	if (type->name) bt_gc_free(ctx, type->name, strlen(type->name) + 1);
+	type->name = NULL;
+
+	if (name) {
+		type->name = bt_gc_alloc(ctx, len + 1);
+		memcpy(type->name, name, len);
+		type->name[len] = 0;
+	}
+}
+
+static bt_Type* read_type(Reader* r, uint32_t slot)
+{
+	bt_Context* ctx = r->ctx;
+	uint8_t category = read_u8(r);
+	uint8_t flags = read_u8(r);
+	if (r->failed) return NULL;
+
+	bt_Type* type = NULL;
+	switch (category) {
+	case BT_TYPE_CATEGORY_TYPE: type = bt_make_alias_type(ctx, NULL, NULL); break;
+	case BT_TYPE_CATEGORY_ARRAY: type = bt_make_array_type(ctx, NULL); break;
+	case BT_TYPE_CATEGORY_TABLESHAPE:
+		if (flags & TABLESHAPE_MAP) type = bt_make_map(ctx, NULL, NULL);
+		else type = bt_make_tableshape_type(ctx, NULL, (flags & TABLESHAPE_SEALED) != 0);
+		type->as.table_shape.final = (flags & TABLESHAPE_FINAL) != 0;
+		break;
+	case BT_TYPE_CATEGORY_SIGNATURE: type = bt_make_signature_type(ctx, NULL, NULL, 0); break;
+	case BT_TYPE_CATEGORY_UNION: type = bt_make_union(ctx); break;
+	case BT_TYPE_CATEGORY_ENUM: {
+		bt_StrSlice empty = { "", 0 };
+		type = bt_make_enum_type(ctx, empty, flags != 0);
+	} break;
+	default:
+		read_error(r, "Serialized module contains an unsupported type category%s", "");
+		return NULL;
+	}
+
+	r->memo.elements[slot] = (bt_Object*)type;
+
+	uint32_t name_len = 0;
+	const char* name = read_raw_string(r, &name_len);
+	set_type_name(ctx, type, name, name_len);
+
+	type->prototype = read_type_object(r);
+	type->annotations = (bt_Annotation*)read_object(r);
+
+	switch (category) {
+	case BT_TYPE_CATEGORY_TYPE:
+		type->as.type.boxed = read_type_object(r);
+		break;
+	case BT_TYPE_CATEGORY_ARRAY:
+		type->as.array.inner = read_type_object(r);
+		break;
+	case BT_TYPE_CATEGORY_TABLESHAPE: {
+		if (flags & TABLESHAPE_MAP) {
+			type->as.table_shape.key_type = read_type_object(r);
+			type->as.table_shape.value_type = read_type_object(r);
+		}
+
+		bt_Type* parent = read_type_object(r);
+		if (parent) {
+			type->as.table_shape.parent = parent;
+			bt_buffer_push(ctx, &r->parented, type);
+		}
+
+		uint32_t n_fields = read_count(r, 3);
+		for (uint32_t i = 0; i < n_fields && !r->failed; ++i) {
+			bt_Value key = read_value(r);
+			bt_Type* field_type = read_type_object(r);
+			bt_Type* key_type = read_type_object(r);
+			bt_tableshape_add_layout(ctx, type, key_type, key, field_type);
+		}
+
+		type->as.table_shape.field_annotations = read_table_pairs(r);
+		type->prototype_types = read_table_pairs(r);
+		type->prototype_values = read_table_pairs(r);
+
+		if (read_u8(r)) { bt_buffer_push(ctx, &r->templated, type); }
+	} break;
+	case BT_TYPE_CATEGORY_SIGNATURE: {
+		uint32_t n_args = read_count(r, 1);
+		for (uint32_t i = 0; i < n_args && !r->failed; ++i) {
+			bt_Type* arg = read_type_object(r);
+			bt_buffer_push(ctx, &type->as.fn.args, arg);
+		}
+
+		type->as.fn.return_type = read_type_object(r);
+		type->as.fn.varargs_type = read_type_object(r);
+		type->as.fn.is_vararg = flags != 0;
+	} break;
+	case BT_TYPE_CATEGORY_UNION: {
+		uint32_t n_variants = read_count(r, 1);
+		for (uint32_t i = 0; i < n_variants && !r->failed; ++i) {
+			bt_Type* variant = read_type_object(r);
+			bt_buffer_push(ctx, &type->as.selector.types, variant);
+		}
+	} break;
+	case BT_TYPE_CATEGORY_ENUM: {
+		type->as.enum_.name = (bt_String*)read_object(r);
+		bt_Table* options = read_table_pairs(r);
+		if (options) type->as.enum_.options = options;
+	} break;
+	}
+
+	return type;
+}
+
+static bt_Object* resolve_extern(Reader* r, uint8_t kind, bt_String* root, bt_String* key, bt_String* member)
+{
+	bt_Context* ctx = r->ctx;
+	bt_Value result = BT_VALUE_NULL;
+
+	if (!root) return NULL;
+
+	switch (kind) {
+	case EXTERN_REGISTERED_TYPE: {
+		bt_Type* type = bt_find_type(ctx, BT_VALUE_OBJECT(root));
+		if (type) result = BT_VALUE_OBJECT(type);
+	} break;
+	case EXTERN_PRELUDE: {
+		bt_Value entry = bt_table_get(ctx->prelude, BT_VALUE_OBJECT(root));
+		if (entry != BT_VALUE_NULL) result = ((bt_ModuleImport*)BT_AS_OBJECT(entry))->value;
+	} break;
+	default: {
+		bt_Module* mod = bt_find_module(ctx, BT_VALUE_OBJECT(root), BT_TRUE);
+		if (!mod) return NULL;
+
+		if (kind == EXTERN_MODULE_EXPORTS) result = BT_VALUE_OBJECT(mod->exports);
+		else if (kind == EXTERN_MODULE_TYPE) result = BT_VALUE_OBJECT(mod->type);
+		else if (!key) return NULL;
+		else if (kind == EXTERN_MODULE_EXPORT) result = bt_module_get_export(mod, BT_VALUE_OBJECT(key));
+		else if (kind == EXTERN_MODULE_EXPORT_TYPE) {
+			bt_Type* type = bt_module_get_export_type(mod, BT_VALUE_OBJECT(key));
+			if (type) result = BT_VALUE_OBJECT(type);
+		}
+	} break;
+	}
+
+	if (member && BT_IS_OBJECT(result)) {
+		bt_Object* obj = BT_AS_OBJECT(result);
+		bt_Table* proto = BT_OBJECT_GET_TYPE(obj) == BT_OBJECT_TYPE_TYPE ? ((bt_Type*)obj)->prototype_values : NULL;
+		result = proto ? bt_table_get(proto, BT_VALUE_OBJECT(member)) : BT_VALUE_NULL;
+	}
+
+	return BT_IS_OBJECT(result) ? BT_AS_OBJECT(result) : NULL;
+}
+
+static bt_Object* read_extern(Reader* r)
+{
+	uint8_t kind = read_u8(r);
+	bt_String* root = read_string_ref(r);
+	bt_String* key = read_string_ref(r);
+	bt_String* member = read_string_ref(r);
+	bt_bool has_layout = read_u8(r);
+	if (r->failed) return NULL;
+
+	bt_Object* result = resolve_extern(r, kind, root, key, member);
+	if (!result) {
+		read_error(r, "Failed to resolve reference to '%s' while loading serialized module", root ? BT_STRING_STR(root) : NULL);
+		return NULL;
+	}
+
+	if (has_layout) {
+		uint32_t expected_count = read_u32(r);
+		uint64_t expected_hash = read_u64(r);
+		bt_bool needs_template = read_u8(r);
+		if (r->failed) return NULL;
+
+		if (!is_tableshape(result)) {
+			read_error(r, "Reference to '%s' no longer resolves to a tableshape, recompile the module", BT_STRING_STR(root));
+			return NULL;
+		}
+
+		uint32_t count;
+		uint64_t hash;
+		layout_fingerprint((bt_Type*)result, &count, &hash);
+		if (count != expected_count || hash != expected_hash) {
+			read_error(r, "Layout of a type from '%s' changed since the module was serialized, recompile it", BT_STRING_STR(root));
+			return NULL;
+		}
+
+		if (needs_template) { bt_buffer_push(r->ctx, &r->templated, (bt_Type*)result); }
+	}
+
+	return result;
+}
+
+static bt_Object* read_object(Reader* r)
+{
+	bt_Context* ctx = r->ctx;
+	uint8_t tag = read_u8(r);
+	if (r->failed || tag == SV_NONE) return NULL;
+
+	if (tag == SV_REF) {
+		uint32_t idx = read_u32(r);
+		if (r->failed) return NULL;
+		if (idx >= r->memo.length || !r->memo.elements[idx]) {
+			read_error(r, "Serialized module has a dangling object reference%s", "");
+			return NULL;
+		}
+
+		return r->memo.elements[idx];
+	}
+
+	uint32_t slot = r->memo.length;
+	bt_buffer_push(ctx, &r->memo, NULL);
+
+	bt_Object* result = NULL;
+	switch (tag) {
+	case SV_EXTERN:
+		result = read_extern(r);
+		break;
+	case SV_STRING:
+		result = (bt_Object*)read_string_ref(r);
+		break;
+	case SV_TYPE:
+		result = (bt_Object*)read_type(r, slot);
+		break;
+	case SV_FN: {
+		bt_ValueBuffer no_constants;
+		bt_InstructionBuffer no_instructions;
+		bt_buffer_empty(&no_constants);
+		bt_buffer_empty(&no_instructions);
+
+		bt_Fn* fn = bt_make_fn(ctx, r->module, NULL, &no_constants, &no_instructions, 0);
+		r->memo.elements[slot] = (bt_Object*)fn;
+
+		fn->signature = read_type_object(r);
+		read_code(r, &fn->stack_size, &fn->constants, &fn->instructions, &fn->debug);
+		result = (bt_Object*)fn;
+	} break;
+	case SV_TABLE:
+		result = (bt_Object*)read_table_pairs(r);
+		break;
+	case SV_ARRAY: {
+		uint32_t length = read_count(r, 1);
+		bt_Array* arr = bt_make_array(ctx, length);
+		r->memo.elements[slot] = (bt_Object*)arr;
+
+		for (uint32_t i = 0; i < length && !r->failed; ++i) {
+			bt_array_push(ctx, arr, read_value(r));
+		}
+
+		result = (bt_Object*)arr;
+	} break;
+	case SV_ANNOTATION: {
+		bt_Annotation* anno = bt_make_annotation(ctx, NULL);
+		r->memo.elements[slot] = (bt_Object*)anno;
+
+		anno->name = (bt_String*)read_object(r);
+		anno->args = (bt_Array*)read_object(r);
+		anno->next = (bt_Annotation*)read_object(r);
+		result = (bt_Object*)anno;
+	} break;
+	default:
+		read_error(r, "Serialized module contains an unknown value tag%s", "");
+		return NULL;
+	}
+
+	if (!r->failed) r->memo.elements[slot] = result;
+	return result;
+}
+
+static bt_bool read_imports(Reader* r, bt_ImportBuffer* imports)
+{
+	bt_Context* ctx = r->ctx;
+
+	uint32_t count = read_count(r, 1);
+	for (uint32_t i = 0; i < count && !r->failed; ++i) {
+		uint8_t kind = read_u8(r);
+		bt_String* name = read_string_ref(r);
+		bt_String* mod_name = read_string_ref(r);
+		if (r->failed) break;
+
+		if (!name) {
+			read_error(r, "Serialized module has an unnamed import%s", "");
+			break;
+		}
+
+		if (kind == IMPORT_PRELUDE) {
+			bt_Value entry = bt_table_get(ctx->prelude, BT_VALUE_OBJECT(name));
+			if (entry == BT_VALUE_NULL) {
+				read_error(r, "Prelude entry '%s' imported by serialized module doesn't exist", BT_STRING_STR(name));
+				break;
+			}
+
+			bt_buffer_push(ctx, imports, (bt_ModuleImport*)BT_AS_OBJECT(entry));
+			continue;
+		}
+
+		// finding the module may compile and run it, keep our strings alive meanwhile
+		bt_push_root(ctx, (bt_Object*)name);
+		if (mod_name) bt_push_root(ctx, (bt_Object*)mod_name);
+		bt_Module* mod = mod_name ? bt_find_module(ctx, BT_VALUE_OBJECT(mod_name), BT_TRUE) : NULL;
+		if (!mod) {
+			read_error(r, "Failed to import module '%s'", mod_name ? BT_STRING_STR(mod_name) : NULL);
+			bt_pop_root(ctx);
+			if (mod_name) bt_pop_root(ctx);
+			break;
+		}
+
+		bt_ModuleImport* import = BT_ALLOCATE(ctx, IMPORT, bt_ModuleImport);
+		import->name = name;
+		bt_pop_root(ctx);
+		bt_pop_root(ctx);
+		bt_push_root(ctx, (bt_Object*)import);
+
+		if (kind == IMPORT_MODULE) {
+			import->type = mod->type;
+			import->value = BT_VALUE_OBJECT(mod->exports);
+		}
+		else {
+			import->type = bt_module_get_export_type(mod, BT_VALUE_OBJECT(name));
+			import->value = bt_module_get_export(mod, BT_VALUE_OBJECT(name));
+
+			if (!import->type || import->value == BT_VALUE_NULL) {
+				read_error(r, "Failed to import item '%s'", BT_STRING_STR(name));
+				bt_pop_root(ctx);
+				break;
+			}
+		}
+
+		bt_add_ref(ctx, (bt_Object*)import);
+		bt_pop_root(ctx);
+		bt_buffer_push(ctx, imports, import);
+	}
+
+	return !r->failed;
+}
+
+bt_bool bt_is_serialized_module(const void* data, size_t size)
+{
+	if (size < 3 * sizeof(uint32_t)) return BT_FALSE;
+
+	uint32_t header[3];
+	memcpy(header, data, sizeof(header));
+	return header[0] == SERIALIZE_MAGIC && header[1] == BT_SERIALIZE_VERSION && header[2] == SERIALIZE_ENDIAN_MARK;
+}
+
+bt_Module* bt_deserialize_module(bt_Context* ctx, const void* data, size_t size, const char* mod_name)
+{
+	Reader r;
+	memset(&r, 0, sizeof(r));
+	r.ctx = ctx;
+	r.mod_name = mod_name;
+	r.current = (const uint8_t*)data;
+	r.end = r.current + size;
+	bt_buffer_empty(&r.memo);
+	bt_buffer_empty(&r.parented);
+	bt_buffer_empty(&r.templated);
+
+	if (!bt_is_serialized_module(data, size)) {
+		read_error(&r, "Data is not a serialized module of version %s", BOLT_XSTR(BT_SERIALIZE_VERSION));
+		return NULL;
+	}
+
+	r.current += 3 * sizeof(uint32_t);
+
+	// Imports may load and run other modules, so resolve them before the collector is held off
+	bt_ImportBuffer imports;
+	bt_buffer_empty(&imports);
+	read_imports(&r, &imports);
+
+	bt_gc_pause(ctx);
+
+	bt_Module* result = bt_make_module_with_imports(ctx, &imports);
+	bt_buffer_destroy(ctx, &imports);
+	r.module = result;
+	if (mod_name) result->name = bt_make_string(ctx, mod_name);
+
+	bt_DebugLocBuffer* locs = NULL;
+	read_code(&r, &result->stack_size, &result->constants, &result->instructions, &locs);
+	result->debug_locs = locs;
+
+	uint32_t n_tokens = read_count(&r, 2 * sizeof(uint16_t));
+	if (!r.failed && r.max_loc > n_tokens) read_error(&r, "Serialized module has debug locations without tokens%s", "");
+
+	if (!r.failed && result->debug_locs) {
+		bt_buffer_reserve(&result->debug_tokens, ctx, n_tokens);
+		for (uint32_t i = 0; i < n_tokens; ++i) {
+			bt_Token* token = bt_gc_alloc(ctx, sizeof(bt_Token));
+			memset(token, 0, sizeof(bt_Token));
+			token->line = read_u16(&r);
+			token->col = read_u16(&r);
+			token->idx = (uint16_t)i;
+			bt_buffer_push(ctx, &result->debug_tokens, token);
+		}
+	}
+
+	if (!r.failed) {
+		for (uint32_t i = 0; i < r.parented.length; ++i) {
+			bt_Type* type = r.parented.elements[i];
+			bt_tableshape_set_parent(ctx, type, type->as.table_shape.parent);
+		}
+
+		for (uint32_t i = 0; i < r.templated.length; ++i) {
+			ensure_template(ctx, r.templated.elements[i]);
+		}
+	}
+
+	bt_buffer_destroy(ctx, &r.memo);
+	bt_buffer_destroy(ctx, &r.parented);
+	bt_buffer_destroy(ctx, &r.templated);
+
+	bt_gc_unpause(ctx);
+
+	return r.failed ? NULL : result;
+}
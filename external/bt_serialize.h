@@ -0,0 +1,41 @@
+#pragma once
+
+#if __cplusplus
+extern "C" {
+#endif
+
+#include "bt_prelude.h"
+#include "bt_object.h"
+
+/***
+ * Compiled modules can be written to a versioned binary blob and loaded back without tokenizing, parsing or compiling again.
+ * The blob stores the module's constants, instructions, nested functions and the types they reference,
+ * and optionally a compact set of debug locations (line and column only, no source text).
+ *
+ * Anything the module got from the outside world (imports, registered types, other modules' exports and their prototypes)
+ * is stored as a named reference and resolved against the loading context, so the same modules must be available there.
+ * Objects that can't be named this way, like userdata types that are never exported, make serialization fail.
+ *
+ * Instruction streams are not verified when loading, only load blobs produced by `bt_serialize_module`.
+ */
+
+/** Bump whenever the serialized layout or the instruction set changes */
+#define BT_SERIALIZE_VERSION 8
+
+/** Receives the serialized bytes, `userdata` is passed through unchanged */
+typedef void (*bt_SerializeWrite)(void* userdata, const void* data, size_t size);
+
+/**
+ * Serializes `module`, which must have been compiled but not necessarily executed, and passes the result to `write` in one call.
+ * Debug locations are only included if `include_debug` is set and the module was compiled with them.
+ * Returns BT_FALSE and reports through the context's error handler if the module can't be represented.
+ */
+BOLT_API bt_bool bt_serialize_module(bt_Context* ctx, bt_Module* module, bt_bool include_debug, bt_SerializeWrite write, void* userdata);
+/** Returns whether `data` starts with a serialized module header of the current version */
+BOLT_API bt_bool bt_is_serialized_module(const void* data, size_t size);
+/** Loads a module produced by `bt_serialize_module`, ready to be executed. Returns NULL on error. */
+BOLT_API bt_Module* bt_deserialize_module(bt_Context* ctx, const void* data, size_t size, const char* mod_name);
+
+#if __cplusplus
+}
+#endif
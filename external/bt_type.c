@@ -382,6 +382,25 @@ bt_Type* bt_make_userdata_type(bt_Context* context, const char* name)
 	bt_Type* result = bt_make_type(context, name, bt_type_satisfier_same, BT_TYPE_CATEGORY_USERDATA);
 	bt_buffer_empty(&result->as.userdata.fields);
 	result->as.userdata.finalizer = NULL;
+	result->as.userdata.tracer = NULL;
+	result->as.userdata.value_size = 0;
+	result->as.userdata.elements = BT_ELEMENTS_NONE;
+	return result;
+}
+
+bt_Type* bt_make_typed_array_type(bt_Context* context, const char* name, bt_ElementType elements)
+{
+	bt_Type* result = bt_make_userdata_type(context, name);
+	result->as.userdata.elements = elements;
+	return result;
+}
+
+bt_Type* bt_make_value_type(bt_Context* context, const char* name, uint32_t size)
+{
+	if (size == 0 || size > BT_VALUE_TYPE_MAX_SIZE) return NULL;
+
+	bt_Type* result = bt_make_userdata_type(context, name);
+	result->as.userdata.value_size = size;
 	return result;
 }
 
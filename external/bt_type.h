@@ -49,6 +49,10 @@ BOLT_API bt_Type* bt_make_alias_type(bt_Context* context, const char* name, bt_T
 BOLT_API bt_Type* bt_make_fundamental_type(bt_Context* context);
 /** Creates an opaque userdata type with name `name` */
 BOLT_API bt_Type* bt_make_userdata_type(bt_Context* context, const char* name);
+/** Creates a userdata type for fixed length arrays of packed `elements`, which can be subscripted with numbers like regular arrays, see `bt_make_typed_array` */
+BOLT_API bt_Type* bt_make_typed_array_type(bt_Context* context, const char* name, bt_ElementType elements);
+/** Creates a userdata type for small structs of `size` bytes (up to `BT_VALUE_TYPE_MAX_SIZE`) that can be held inline by other userdata, see `bt_userdata_type_field_value` */
+BOLT_API bt_Type* bt_make_value_type(bt_Context* context, const char* name, uint32_t size);
 /** Creates an array type of `[inner]` */
 BOLT_API bt_Type* bt_make_array_type(bt_Context* context, bt_Type* inner);
 
@@ -216,6 +220,9 @@ typedef struct bt_Type {
         struct {
             bt_FieldBuffer fields;
             bt_UserdataFinalizer finalizer;
+            bt_UserdataTracer tracer;
+            uint32_t value_size;
+            bt_ElementType elements;
         } userdata;
 
         struct {
@@ -23,6 +23,8 @@ static void push_userdata_field(bt_Context* ctx, bt_Type* type, const char* name
 	field.offset = offset;
 	field.getter = getter;
 	field.setter = setter;
+	field.load = NULL;
+	field.store = NULL;
 
 	bt_buffer_push(ctx, fields, field);
 }
@@ -120,7 +122,145 @@ void bt_userdata_type_field_bool(bt_Context* ctx, bt_Type* type, const char* nam
 	push_userdata_field(ctx, type, name, offset, ctx->types.boolean, userdata_get_bool, userdata_set_bool);
 }
 
+void bt_userdata_type_field_value(bt_Context* ctx, bt_Type* type, const char* name, uint32_t offset, bt_Type* value_type)
+{
+	// value fields without load/store are copied straight out of the userdata allocation
+	bt_userdata_type_push_value_field(ctx, type, name, offset, value_type, NULL, NULL);
+}
+
+void bt_userdata_type_push_value_field(bt_Context* ctx, bt_Type* type, const char* name, uint32_t offset, bt_Type* value_type,
+	bt_UserdataValueLoad load, bt_UserdataValueStore store)
+{
+#ifdef BT_DEBUG
+	assert(value_type->category == BT_TYPE_CATEGORY_USERDATA && value_type->as.userdata.value_size);
+#endif
+
+	push_userdata_field(ctx, type, name, offset, value_type, NULL, NULL);
+
+	bt_FieldBuffer* fields = &type->as.userdata.fields;
+	bt_UserdataField* field = fields->elements + fields->length - 1;
+	field->load = load;
+	field->store = store;
+}
+
 void bt_userdata_type_set_finalizer(bt_Type* type, bt_UserdataFinalizer finalizer)
 {
 	type->as.userdata.finalizer = finalizer;
 }
+
+void bt_userdata_type_set_tracer(bt_Type* type, bt_UserdataTracer tracer)
+{
+	type->as.userdata.tracer = tracer;
+}
+
+static void load_value(bt_UserdataField* field, bt_Context* ctx, uint8_t* userdata, void* out)
+{
+	if (field->load) field->load(ctx, userdata, field->offset, out);
+	else memcpy(out, userdata + field->offset, field->bolt_type->as.userdata.value_size);
+}
+
+static void store_value(bt_UserdataField* field, bt_Context* ctx, uint8_t* userdata, const void* in)
+{
+	if (field->store) field->store(ctx, userdata, field->offset, in);
+	else memcpy(userdata + field->offset, in, field->bolt_type->as.userdata.value_size);
+}
+
+bt_Value bt_userdata_get_field(bt_Context* ctx, bt_Userdata* userdata, bt_UserdataField* field)
+{
+	if (field->getter) return field->getter(ctx, bt_userdata_get(userdata), field->offset);
+
+	bt_Type* value_type = field->bolt_type;
+	uint8_t data[BT_VALUE_TYPE_MAX_SIZE];
+	load_value(field, ctx, bt_userdata_get(userdata), data);
+
+	return BT_VALUE_OBJECT(bt_make_userdata(ctx, value_type, data, value_type->as.userdata.value_size));
+}
+
+void bt_userdata_set_field(bt_Context* ctx, bt_Userdata* userdata, bt_UserdataField* field, bt_Value value)
+{
+	if (field->setter) {
+		field->setter(ctx, bt_userdata_get(userdata), field->offset, value);
+		return;
+	}
+
+	store_value(field, ctx, bt_userdata_get(userdata), bt_userdata_get((bt_Userdata*)BT_AS_OBJECT(value)));
+}
+
+bt_Value bt_userdata_load_value_member(bt_Context* ctx, bt_Userdata* userdata, uint32_t path)
+{
+	bt_UserdataField* field = userdata->type->as.userdata.fields.elements + (path >> 8);
+	bt_UserdataField* member = field->bolt_type->as.userdata.fields.elements + (path & 0xff);
+
+	uint8_t data[BT_VALUE_TYPE_MAX_SIZE];
+	load_value(field, ctx, bt_userdata_get(userdata), data);
+
+	return member->getter(ctx, data, member->offset);
+}
+
+void bt_userdata_store_value_member(bt_Context* ctx, bt_Userdata* userdata, uint32_t path, bt_Value value)
+{
+	bt_UserdataField* field = userdata->type->as.userdata.fields.elements + (path >> 8);
+	bt_UserdataField* member = field->bolt_type->as.userdata.fields.elements + (path & 0xff);
+
+	// read-modify-write, so fields backed by load/store (like an entity's transform) see the whole value change at once
+	uint8_t data[BT_VALUE_TYPE_MAX_SIZE];
+	load_value(field, ctx, bt_userdata_get(userdata), data);
+	member->setter(ctx, data, member->offset, value);
+	store_value(field, ctx, bt_userdata_get(userdata), data);
+}
+
+uint32_t bt_element_size(bt_ElementType elements)
+{
+	switch (elements) {
+	case BT_ELEMENTS_F32: return sizeof(float);
+	case BT_ELEMENTS_F64: return sizeof(double);
+	case BT_ELEMENTS_I32: return sizeof(int32_t);
+	default: return 0;
+	}
+}
+
+bt_Userdata* bt_make_typed_array(bt_Context* ctx, bt_Type* type, uint32_t length)
+{
+#ifdef BT_DEBUG
+	assert(type->category == BT_TYPE_CATEGORY_USERDATA && type->as.userdata.elements != BT_ELEMENTS_NONE);
+#endif
+
+	uint32_t size = sizeof(bt_TypedArray) + length * bt_element_size(type->as.userdata.elements);
+	bt_Userdata* result = BT_ALLOCATE_INLINE_STORAGE(ctx, USERDATA, bt_Userdata, size);
+	result->type = type;
+	result->size = size;
+	result->finalizer = type->as.userdata.finalizer;
+
+	BT_TYPED_ARRAY(result)->length = length;
+	BT_TYPED_ARRAY(result)->reserved = 0;
+	memset(BT_TYPED_ARRAY_DATA(result), 0, size - sizeof(bt_TypedArray));
+
+	return result;
+}
+
+bt_Value bt_typed_array_get(bt_Context* ctx, bt_Userdata* arr, uint64_t index)
+{
+	if (index >= BT_TYPED_ARRAY(arr)->length) bt_runtime_error(ctx->current_thread, "Array index out of bounds!", NULL);
+
+	void* data = BT_TYPED_ARRAY_DATA(arr);
+	switch (arr->type->as.userdata.elements) {
+	case BT_ELEMENTS_F32: return bt_make_number(((float*)data)[index]);
+	case BT_ELEMENTS_F64: return bt_make_number(((double*)data)[index]);
+	case BT_ELEMENTS_I32: return bt_make_number(((int32_t*)data)[index]);
+	default: return BT_VALUE_NULL;
+	}
+}
+
+void bt_typed_array_set(bt_Context* ctx, bt_Userdata* arr, uint64_t index, bt_Value value)
+{
+	if (index >= BT_TYPED_ARRAY(arr)->length) bt_runtime_error(ctx->current_thread, "Array index out of bounds!", NULL);
+
+	void* data = BT_TYPED_ARRAY_DATA(arr);
+	bt_number as_num = BT_AS_NUMBER(value);
+	switch (arr->type->as.userdata.elements) {
+	case BT_ELEMENTS_F32: ((float*)data)[index] = (float)as_num; break;
+	case BT_ELEMENTS_F64: ((double*)data)[index] = as_num; break;
+	case BT_ELEMENTS_I32: ((int32_t*)data)[index] = bt_number_to_int32(as_num); break;
+	default: break;
+	}
+}
@@ -10,6 +10,7 @@ extern "C" {
 struct bt_Type;
 struct bt_String;
 struct bt_NativeFn;
+struct bt_Userdata;
 
 /** Function pointer type for retrieving fields from a userdata object, where `offset` is the supplied byte offset into `userdata` when defining the field */
 typedef bt_Value (*bt_UserdataFieldGetter)(bt_Context* ctx, uint8_t* userdata, uint32_t offset);
@@ -19,12 +20,48 @@ typedef bt_Value (*bt_UserdataFieldGetter)(bt_Context* ctx, uint8_t* userdata, u
  */
 typedef void (*bt_UserdataFieldSetter)(bt_Context* ctx, uint8_t* userdata, uint32_t offset, bt_Value value);
 
+/** Function pointer type for copying an inline value field out of `userdata` into `out`, which is as large as the field's value type */
+typedef void (*bt_UserdataValueLoad)(bt_Context* ctx, uint8_t* userdata, uint32_t offset, void* out);
+
+/** Function pointer type for copying `in`, an instance of the field's value type, into an inline value field of `userdata` */
+typedef void (*bt_UserdataValueStore)(bt_Context* ctx, uint8_t* userdata, uint32_t offset, const void* in);
+
+/** Element storage of typed arrays, see `bt_make_typed_array_type` */
+typedef enum {
+	BT_ELEMENTS_NONE,
+	BT_ELEMENTS_F32,
+	BT_ELEMENTS_F64,
+	BT_ELEMENTS_I32,
+} bt_ElementType;
+
+/** Payload of typed array userdata, immediately followed by `length` packed elements */
+typedef struct bt_TypedArray {
+	uint32_t length;
+	uint32_t reserved;
+} bt_TypedArray;
+
+/** Get the typed array header of `ud`, which must be userdata of a typed array type */
+#define BT_TYPED_ARRAY(ud) ((bt_TypedArray*)BT_USERDATA_VALUE(ud))
+/** Get a pointer to the first element of the typed array `ud` */
+#define BT_TYPED_ARRAY_DATA(ud) ((void*)(BT_TYPED_ARRAY(ud) + 1))
+
+/** Converts `value` to an int32 element, saturating out of range values and storing NaN as 0 */
+static inline int32_t bt_number_to_int32(bt_number value)
+{
+	if (value != value) return 0;
+	if (value <= (bt_number)INT32_MIN) return INT32_MIN;
+	if (value >= (bt_number)INT32_MAX) return INT32_MAX;
+	return (int32_t)value;
+}
+
 /** Internal representation of a user-accessible field in a userdata type */
 typedef struct bt_UserdataField {
 	bt_Type* bolt_type;
 	bt_String* name;
 	bt_UserdataFieldGetter getter;
 	bt_UserdataFieldSetter setter;
+	bt_UserdataValueLoad load;
+	bt_UserdataValueStore store;
 	uint32_t offset;
 } bt_UserdataField;
 
@@ -62,15 +99,45 @@ BOLT_API void bt_userdata_type_field_uint32(bt_Context* ctx, bt_Type* type, cons
 /** Pushes a new field at `offset` with appropriate callbacks for a (8-byte) unsigned integer */
 BOLT_API void bt_userdata_type_field_uint64(bt_Context* ctx, bt_Type* type, const char* name, uint32_t offset);
 
+/** Pushes an inline field of `value_type`, created with `bt_make_value_type`, stored by value at `offset`
+ * Reading the whole field produces a copy, while accessing its members directly (`obj.field.x`) goes straight to the userdata without allocating
+ */
+BOLT_API void bt_userdata_type_field_value(bt_Context* ctx, bt_Type* type, const char* name, uint32_t offset, bt_Type* value_type);
+/** Pushes an inline field of `value_type` that isn't laid out in the userdata allocation, `load` and `store` copy it in and out */
+BOLT_API void bt_userdata_type_push_value_field(bt_Context* ctx, bt_Type* type, const char* name, uint32_t offset, bt_Type* value_type,
+	bt_UserdataValueLoad load, bt_UserdataValueStore store);
+
+/** Reads `field` of `userdata` through its getter, inline value fields are copied into a new userdata of their value type */
+BOLT_API bt_Value bt_userdata_get_field(bt_Context* ctx, struct bt_Userdata* userdata, bt_UserdataField* field);
+/** Writes `field` of `userdata` through its setter, inline value fields copy the contents of the value type userdata `value` */
+BOLT_API void bt_userdata_set_field(bt_Context* ctx, struct bt_Userdata* userdata, bt_UserdataField* field, bt_Value value);
+
+/** Returns the member of an inline value field, `path` packs the field index in its upper 8 bits and the member index in its lower 8 */
+BOLT_API bt_Value bt_userdata_load_value_member(bt_Context* ctx, struct bt_Userdata* userdata, uint32_t path);
+/** Writes the member of an inline value field back through the field's store, `path` is packed like in `bt_userdata_load_value_member` */
+BOLT_API void bt_userdata_store_value_member(bt_Context* ctx, struct bt_Userdata* userdata, uint32_t path, bt_Value value);
+
 /** Offset for this is expected to point to a char*, immediately followed by a u32 for length */
 BOLT_API void bt_userdata_type_field_string(bt_Context* ctx, bt_Type* type, const char* name, uint32_t offset);
 
 /** Expects the bool at `offset` to be of type `bt_bool` */
 BOLT_API void bt_userdata_type_field_bool(bt_Context* ctx, bt_Type* type, const char* naem, uint32_t offset);
 
+/** Returns the size in bytes of a single element of type `elements` */
+BOLT_API uint32_t bt_element_size(bt_ElementType elements);
+/** Allocates a typed array of `type`, created with `bt_make_typed_array_type`, holding `length` zeroed elements */
+BOLT_API struct bt_Userdata* bt_make_typed_array(bt_Context* ctx, bt_Type* type, uint32_t length);
+/** Reads element `index` of the typed array `arr` as a number, raising a runtime error if it's out of bounds */
+BOLT_API bt_Value bt_typed_array_get(bt_Context* ctx, struct bt_Userdata* arr, uint64_t index);
+/** Converts the number `value` to the element type of `arr` and stores it at `index`, raising a runtime error if it's out of bounds */
+BOLT_API void bt_typed_array_set(bt_Context* ctx, struct bt_Userdata* arr, uint64_t index, bt_Value value);
+
 /** The finalizer is run whenever the userdata object is being garbage collected, as a means to let the user free any unmanaged resources */
 BOLT_API void bt_userdata_type_set_finalizer(bt_Type* type, bt_UserdataFinalizer finalizer);
 
+/** The tracer is run whenever the gc traverses a userdata object, letting user objects that hold on to bolt values keep them alive */
+BOLT_API void bt_userdata_type_set_tracer(bt_Type* type, bt_UserdataTracer tracer);
+
 #if __cplusplus
 }
 #endif
\ No newline at end of file
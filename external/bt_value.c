@@ -42,6 +42,33 @@ bt_bool bt_value_is_equal(bt_Value a, bt_Value b)
 	return BT_FALSE;
 }
 
+uint64_t bt_value_hash(bt_Value value)
+{
+	uint64_t h;
+	if (BT_IS_NUMBER(value)) {
+		// Make sure -0 and 0 land in the same slot
+		if (BT_AS_NUMBER(value) == 0) return 0;
+		h = value;
+	}
+	else if (BT_IS_OBJECT(value)) {
+		bt_Object* obj = BT_AS_OBJECT(value);
+		switch (BT_OBJECT_GET_TYPE(obj)) {
+		case BT_OBJECT_TYPE_STRING: return bt_hash_string((bt_String*)obj)->hash;
+		// Types compare structurally, so they can only share one chain
+		case BT_OBJECT_TYPE_TYPE: return BT_OBJECT_TYPE_TYPE;
+		default: h = (uint64_t)obj; break;
+		}
+	}
+	else {
+		h = value;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	return h;
+}
+
 bt_Value bt_default_value(bt_Context* ctx, bt_Type* type) {
 	if (type == ctx->types.any) return BT_VALUE_NULL;
 	if (type == ctx->types.null) return BT_VALUE_NULL;
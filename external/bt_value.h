@@ -53,6 +53,8 @@ typedef struct bt_Type bt_Type;
 
 /** Compare two bt_Value's, returning whether they're equal */
 BOLT_API bt_bool bt_value_is_equal(bt_Value a, bt_Value b);
+/** Hashes `value` such that any two values considered equal by `bt_value_is_equal` hash the same */
+BOLT_API uint64_t bt_value_hash(bt_Value value);
 
 /** Generates a default value fo the supplied `type`, preferring the simplest types in case of unions */
 BOLT_API bt_Value bt_default_value(bt_Context* ctx, bt_Type* type);
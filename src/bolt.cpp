@@ -1,47 +1,362 @@
+#include "core/array.h"
+#include "core/hash_map.h"
+#include "core/job_system.h"
 #include "core/log.h"
+#include "core/math.h"
+#include "core/os.h"
+#include "core/profiler.h"
 #include "core/path.h"
 #include "core/stream.h"
 #include "core/tag_allocator.h"
 #include "engine/engine.h"
 #include "engine/file_system.h"
 #include "engine/plugin.h"
+#include "engine/reflection.h"
+#include "engine/resource_manager.h"
 #include "engine/world.h"
 #include "imgui/imgui.h"
 #include "bolt.h"
+#include "bt_channel.h"
+#include "bt_coroutine.h"
+#include "bt_image.h"
+#include "bt_profiler.h"
+#include "bt_serialize.h"
 #include "boltstd/boltstd.h"
+#include "bolt_api.h"
+#include "bolt_script.h"
+#include <stddef.h>
 
 
 using namespace Lumix;
 
 namespace BoltAPI {
 
-static bt_Type* s_dvec3_type;
-static bt_Type* s_world_type;
-static bt_Type* s_entity_type;
-
 struct Entity {
 	World* world;
 	EntityRef entity;
 };
 
-static bt_Value entityGetPosition(bt_Context* ctx, uint8_t* userdata, uint32_t offset) {
+// position is an inline value field, scripts touching `entity.position.x` go through these without allocating a DVec3
+static void entityLoadPosition(bt_Context* ctx, uint8_t* userdata, uint32_t offset, void* out) {
 	Entity* e = (Entity*)userdata;
-	DVec3 p = e->world->getPosition(e->entity);
-	bt_Userdata* ud = bt_make_userdata(ctx, s_dvec3_type, &p, sizeof(p));
-	return BT_VALUE_OBJECT(ud);
+	*(DVec3*)out = e->world->getPosition(e->entity);
 }
 
-static void entitySetPosition(bt_Context* ctx, uint8_t* userdata, uint32_t offset, bt_Value value) {
+static void entityStorePosition(bt_Context* ctx, uint8_t* userdata, uint32_t offset, const void* in) {
 	Entity* e = (Entity*)userdata;
-	bt_Userdata* ud = (bt_Userdata*)BT_AS_OBJECT(value);
-	DVec3* p = (DVec3*)BT_USERDATA_VALUE(ud);
-	e->world->setPosition(e->entity, *p);
+	e->world->setPosition(e->entity, *(const DVec3*)in);
+}
+
+// every context registers its own `lumix` module, natives find that context's types in the storage of the module they belong to
+static bt_Type* getType(bt_Context* ctx, bt_Thread* thread, const char* name) {
+	return (bt_Type*)BT_AS_OBJECT(bt_module_get_storage(bt_get_module(thread), BT_VALUE_CSTRING(ctx, name)));
+}
+
+static void makeDVec3(bt_Context* ctx, bt_Thread* thread) {
+	DVec3 v(BT_AS_NUMBER(bt_arg(thread, 0)), BT_AS_NUMBER(bt_arg(thread, 1)), BT_AS_NUMBER(bt_arg(thread, 2)));
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_userdata(ctx, getType(ctx, thread, "DVec3"), &v, sizeof(v))));
+}
+
+// payload of the `World` userdata
+struct WorldRef {
+	World* world;
+	CoroutineScheduler* scheduler;
+};
+
+// Batch transform access. Entities are passed around as plain entity indices in number arrays, transforms as flat
+// arrays of 3 (position) or 4 (rotation) numbers per entity, so a whole set is read or written in a single native call
+
+static WorldRef* getWorldRef(bt_Thread* thread, u8 arg) {
+	return (WorldRef*)bt_userdata_get((bt_Userdata*)BT_AS_OBJECT(bt_arg(thread, arg)));
+}
+
+// the asset compiler's `lumix.world` has no world behind it, scripts calling into it there get an error instead of a crash
+static World* getWorld(bt_Thread* thread, u8 arg) {
+	World* world = getWorldRef(thread, arg)->world;
+	if (!world) bt_runtime_error(thread, "World is not available outside of a running game", NULL);
+	return world;
+}
+
+static bt_Array* getArray(bt_Thread* thread, u8 arg) {
+	return (bt_Array*)BT_AS_OBJECT(bt_arg(thread, arg));
+}
+
+static void resizeArray(bt_Context* ctx, bt_Array* arr, u32 length) {
+	while (arr->length < length) bt_array_push(ctx, arr, BT_VALUE_NUMBER(0));
+	arr->length = length;
+}
+
+// entity indices come from scripts, anything that isn't the index of an entity alive in `world` is an error
+static EntityRef toEntity(bt_Thread* thread, World* world, bt_Value value) {
+	if (!BT_IS_NUMBER(value)) bt_runtime_error(thread, "Expected an entity index", NULL);
+
+	// range is checked first, converting NaN or out of range numbers is undefined
+	const double index = BT_AS_NUMBER(value);
+	if (!(index >= 0 && index <= INT32_MAX) || (double)(i32)index != index) {
+		bt_runtime_error(thread, "Entity index must be a non-negative integer", NULL);
+	}
+
+	const EntityRef entity{ (i32)index };
+	if (!world->hasEntity(entity)) bt_runtime_error(thread, "No entity with this index exists", NULL);
+	return entity;
+}
+
+// query(world, component): [number], every entity in `world` that has `component`
+static void query(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	bt_String* name = (bt_String*)BT_AS_OBJECT(bt_arg(thread, 1));
+	ComponentType type = reflection::getComponentType(StringView(BT_STRING_STR(name), name->len));
+	// unknown names still get a type index, only registered components have a reflection entry
+	if (type == INVALID_COMPONENT_TYPE || !reflection::getComponent(type)) {
+		bt_runtime_error(thread, "No component with this name is registered", NULL);
+	}
+
+	bt_Array* result = bt_make_array(ctx, 0);
+	bt_return(thread, BT_VALUE_OBJECT(result));
+
+	for (EntityPtr e = world->getFirstEntity(); e.isValid(); e = world->getNextEntity((EntityRef)e)) {
+		if (world->hasComponent((EntityRef)e, type)) bt_array_push(ctx, result, BT_VALUE_NUMBER(e.index));
+	}
+}
+
+// get_positions(world, entities, out), resizes `out` to 3 numbers per entity
+static void getPositions(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	bt_Array* entities = getArray(thread, 1);
+	bt_Array* out = getArray(thread, 2);
+
+	resizeArray(ctx, out, entities->length * 3);
+	bt_Value* dst = out->items;
+	for (u32 i = 0; i < entities->length; ++i) {
+		const DVec3& p = world->getPosition(toEntity(thread, world, entities->items[i]));
+		*dst++ = BT_VALUE_NUMBER(p.x);
+		*dst++ = BT_VALUE_NUMBER(p.y);
+		*dst++ = BT_VALUE_NUMBER(p.z);
+	}
+}
+
+// set_positions(world, entities, positions), `positions` holds 3 numbers per entity
+static void setPositions(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	bt_Array* entities = getArray(thread, 1);
+	bt_Array* positions = getArray(thread, 2);
+	if (positions->length < entities->length * 3) bt_runtime_error(thread, "Expected 3 numbers per entity in positions", NULL);
+
+	const bt_Value* src = positions->items;
+	for (u32 i = 0; i < entities->length; ++i, src += 3) {
+		DVec3 p(BT_AS_NUMBER(src[0]), BT_AS_NUMBER(src[1]), BT_AS_NUMBER(src[2]));
+		world->setPosition(toEntity(thread, world, entities->items[i]), p);
+	}
+}
+
+// get_rotations(world, entities, out), resizes `out` to 4 numbers (quaternion xyzw) per entity
+static void getRotations(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	bt_Array* entities = getArray(thread, 1);
+	bt_Array* out = getArray(thread, 2);
+
+	resizeArray(ctx, out, entities->length * 4);
+	bt_Value* dst = out->items;
+	for (u32 i = 0; i < entities->length; ++i) {
+		Quat q = world->getRotation(toEntity(thread, world, entities->items[i]));
+		*dst++ = BT_VALUE_NUMBER(q.x);
+		*dst++ = BT_VALUE_NUMBER(q.y);
+		*dst++ = BT_VALUE_NUMBER(q.z);
+		*dst++ = BT_VALUE_NUMBER(q.w);
+	}
+}
+
+// set_rotations(world, entities, rotations), `rotations` holds 4 numbers per entity
+static void setRotations(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	bt_Array* entities = getArray(thread, 1);
+	bt_Array* rotations = getArray(thread, 2);
+	if (rotations->length < entities->length * 4) bt_runtime_error(thread, "Expected 4 numbers per entity in rotations", NULL);
+
+	const bt_Value* src = rotations->items;
+	for (u32 i = 0; i < entities->length; ++i, src += 4) {
+		Quat q((float)BT_AS_NUMBER(src[0]), (float)BT_AS_NUMBER(src[1]), (float)BT_AS_NUMBER(src[2]), (float)BT_AS_NUMBER(src[3]));
+		world->setRotation(toEntity(thread, world, entities->items[i]), q);
+	}
+}
+
+// translate(world, entities, offsets), moves every entity by its 3 numbers in `offsets`
+static void translate(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	bt_Array* entities = getArray(thread, 1);
+	bt_Array* offsets = getArray(thread, 2);
+	if (offsets->length < entities->length * 3) bt_runtime_error(thread, "Expected 3 numbers per entity in offsets", NULL);
+
+	const bt_Value* src = offsets->items;
+	for (u32 i = 0; i < entities->length; ++i, src += 3) {
+		EntityRef e = toEntity(thread, world, entities->items[i]);
+		DVec3 p = world->getPosition(e);
+		p.x += BT_AS_NUMBER(src[0]);
+		p.y += BT_AS_NUMBER(src[1]);
+		p.z += BT_AS_NUMBER(src[2]);
+		world->setPosition(e, p);
+	}
+}
+
+// entity(world, index): Entity, for scripts that work with a single entity's fields
+static void makeEntity(bt_Context* ctx, bt_Thread* thread) {
+	World* world = getWorld(thread, 0);
+	Entity e = { world, toEntity(thread, world, bt_arg(thread, 1)) };
+	bt_return(thread, BT_VALUE_OBJECT(bt_make_userdata(ctx, getType(ctx, thread, "Entity"), &e, sizeof(e))));
+}
+
+// Script coroutines started with `lumix.start`, resumed once per frame. They sleep in a heap ordered by wake time, so a frame
+// only touches the coroutines that are due no matter how many are suspended
+struct CoroutineScheduler {
+	struct Entry {
+		double wake_time;
+		bt_Userdata* coroutine;
+	};
+
+	CoroutineScheduler(IAllocator& allocator)
+		: m_heap(allocator)
+		, m_due(allocator)
+	{}
+
+	void start(bt_Context* ctx, bt_Userdata* coroutine) {
+		bt_add_ref(ctx, (bt_Object*)coroutine);
+		push({ m_time, coroutine });
+	}
+
+	void update(bt_Context* ctx, float time_delta) {
+		m_time += time_delta;
+		// collected first, anything rescheduled while resuming waits for the next frame
+		while (!m_heap.empty() && m_heap[0].wake_time <= m_time) m_due.push(pop());
+
+		for (const Entry& entry : m_due) {
+			bt_Value result;
+			if (bt_resume(ctx, entry.coroutine, BT_VALUE_NUMBER(time_delta), &result) && bt_coroutine_status(entry.coroutine) == BT_COROUTINE_SUSPENDED) {
+				// `wait(seconds)` yields the time to sleep, any other yield resumes next frame
+				const double delay = BT_IS_NUMBER(result) ? BT_AS_NUMBER(result) : 0;
+				push({ m_time + delay, entry.coroutine });
+			}
+			else {
+				bt_remove_ref(ctx, (bt_Object*)entry.coroutine);
+			}
+		}
+		m_due.clear();
+	}
+
+	void clear(bt_Context* ctx) {
+		for (const Entry& entry : m_heap) bt_remove_ref(ctx, (bt_Object*)entry.coroutine);
+		m_heap.clear();
+		m_time = 0;
+	}
+
+	void push(const Entry& entry) {
+		m_heap.push(entry);
+		u32 i = m_heap.size() - 1;
+		while (i > 0) {
+			const u32 parent = (i - 1) / 2;
+			if (m_heap[parent].wake_time <= m_heap[i].wake_time) break;
+			swap(i, parent);
+			i = parent;
+		}
+	}
+
+	Entry pop() {
+		const Entry result = m_heap[0];
+		m_heap[0] = m_heap.back();
+		m_heap.pop();
+		u32 i = 0;
+		for (;;) {
+			const u32 left = i * 2 + 1;
+			const u32 right = left + 1;
+			u32 smallest = i;
+			if (left < m_heap.size() && m_heap[left].wake_time < m_heap[smallest].wake_time) smallest = left;
+			if (right < m_heap.size() && m_heap[right].wake_time < m_heap[smallest].wake_time) smallest = right;
+			if (smallest == i) break;
+			swap(i, smallest);
+			i = smallest;
+		}
+		return result;
+	}
+
+	void swap(u32 a, u32 b) {
+		const Entry tmp = m_heap[a];
+		m_heap[a] = m_heap[b];
+		m_heap[b] = tmp;
+	}
+
+	Array<Entry> m_heap;
+	Array<Entry> m_due;
+	double m_time = 0;
+};
+
+// start(world, fn), runs `fn` as a coroutine that can `wait(seconds)` between frames
+static void startCoroutine(bt_Context* ctx, bt_Thread* thread) {
+	CoroutineScheduler* scheduler = getWorldRef(thread, 0)->scheduler;
+	if (!scheduler) bt_runtime_error(thread, "Coroutines can only be started in a running game", nullptr);
+	bt_Object* fn = BT_AS_OBJECT(bt_arg(thread, 1));
+	if (BT_OBJECT_GET_TYPE(fn) == BT_OBJECT_TYPE_NATIVE_FN) {
+		bt_runtime_error(thread, "lumix.start expects a bolt function", nullptr);
+	}
+
+	bt_Userdata* coroutine = bt_make_coroutine(ctx, (bt_Callable*)fn);
+	scheduler->start(ctx, coroutine);
+	bt_return(thread, BT_VALUE_OBJECT(coroutine));
+}
+
+void registerLumixModule(bt_Context* ctx, Types& types, World* world, CoroutineScheduler* scheduler) {
+	bt_Module* module = bt_make_module(ctx);
+	types.world = bt_make_userdata_type(ctx, "World");
+
+	bt_Type* number_type = bt_type_number(ctx);
+	bt_Type* string_type = bt_type_string(ctx);
+	bt_Type* number_array = bt_make_array_type(ctx, number_type);
+
+	types.dvec3 = bt_make_value_type(ctx, "DVec3", sizeof(DVec3));
+	bt_userdata_type_field_double(ctx, types.dvec3, "x", offsetof(DVec3, x));
+	bt_userdata_type_field_double(ctx, types.dvec3, "y", offsetof(DVec3, y));
+	bt_userdata_type_field_double(ctx, types.dvec3, "z", offsetof(DVec3, z));
+
+	bt_module_export(ctx, module, bt_make_alias_type(ctx, "DVec3", types.dvec3), BT_VALUE_CSTRING(ctx, "DVec3"), bt_value((bt_Object*)types.dvec3));
+	bt_module_set_storage(module, BT_VALUE_CSTRING(ctx, "DVec3"), bt_value((bt_Object*)types.dvec3));
+
+	bt_Type* dvec3_args[] = { number_type, number_type, number_type };
+	bt_module_export_native(ctx, module, "dvec3", makeDVec3, types.dvec3, dvec3_args, 3);
+
+	types.entity = bt_make_userdata_type(ctx, "Entity");
+	bt_userdata_type_push_value_field(ctx, types.entity, "position", 0, types.dvec3, entityLoadPosition, entityStorePosition);
+
+	bt_module_export(ctx, module, bt_make_alias_type(ctx, "World", types.world), BT_VALUE_CSTRING(ctx, "World"), bt_value((bt_Object*)types.world));
+	bt_module_export(ctx, module, bt_make_alias_type(ctx, "Entity", types.entity), BT_VALUE_CSTRING(ctx, "Entity"), bt_value((bt_Object*)types.entity));
+	bt_module_set_storage(module, BT_VALUE_CSTRING(ctx, "Entity"), bt_value((bt_Object*)types.entity));
+	// the asset compiler and the worker contexts register the module without a world, only the export's type matters there
+	WorldRef world_ref = { world, scheduler };
+	bt_module_export(ctx, module, types.world, BT_VALUE_CSTRING(ctx, "world"), BT_VALUE_OBJECT(bt_make_userdata(ctx, types.world, &world_ref, sizeof(world_ref))));
+
+	bt_Type* entity_args[] = { types.world, number_type };
+	bt_module_export_native(ctx, module, "entity", makeEntity, types.entity, entity_args, 2);
+
+	bt_Type* query_args[] = { types.world, string_type };
+	bt_module_export_native(ctx, module, "query", query, number_array, query_args, 2);
+
+	bt_Type* batch_args[] = { types.world, number_array, number_array };
+	bt_module_export_native(ctx, module, "get_positions", getPositions, nullptr, batch_args, 3);
+	bt_module_export_native(ctx, module, "set_positions", setPositions, nullptr, batch_args, 3);
+	bt_module_export_native(ctx, module, "get_rotations", getRotations, nullptr, batch_args, 3);
+	bt_module_export_native(ctx, module, "set_rotations", setRotations, nullptr, batch_args, 3);
+	bt_module_export_native(ctx, module, "translate", translate, nullptr, batch_args, 3);
+
+	bt_Type* start_args[] = { types.world, bt_make_signature_type(ctx, nullptr, nullptr, 0) };
+	bt_module_export_native(ctx, module, "start", startCoroutine, ctx->types.coroutine, start_args, 2);
+
+	bt_register_module(ctx, BT_VALUE_CSTRING(ctx, "lumix"), module);
 }
 
 }
 
-struct BoltSystem : ISystem {
-	BoltSystem(Engine& engine) : m_engine(engine) {}
+// bt_Handlers are plain function pointers, so the page handlers reach the allocator through this
+static IAllocator* s_page_allocator = nullptr;
+
+struct BoltSystem : BoltAPI::System {
+	BoltSystem(Engine& engine);
 
 	const char* getName() const override { return "bolt"; }
 	
@@ -51,8 +366,10 @@ struct BoltSystem : ISystem {
 	}
 
 	void createModules(World& world) override;
+	bt_Context* getContext() override { return m_context; }
 
-	void initBegin() override {
+	// the main context and the worker contexts share this setup, the handlers are safe to call from any thread
+	bt_Context* openContext() {
 		bt_Handlers handlers = bt_default_handlers();
 		handlers.write = [](bt_Context* ctx, const char* msg) {
 			logInfo(msg);
@@ -60,99 +377,560 @@ struct BoltSystem : ISystem {
 		handlers.on_error = [](bt_ErrorType type, const char* module, const char* message, uint16_t line, uint16_t col){
 			logError(module, "(", line, ",", col, "): ", message);
 		};
-		bt_open(&m_context, &handlers);
-		boltstd_open_all(m_context);
-		bt_append_module_path(m_context, "%s");
+		// small script objects live in pages taken from the engine allocator, so they are tracked under the bolt tag
+		handlers.alloc_page = [](size_t size) { return s_page_allocator->allocate(size, size); };
+		handlers.free_page = [](void* page, size_t size) { s_page_allocator->deallocate(page); };
+		bt_Context* ctx;
+		bt_open(&ctx, &handlers);
+		boltstd_open_all(ctx);
+		bt_append_module_path(ctx, "%s");
+		return ctx;
+	}
+
+	void initBegin() override {
+		s_page_allocator = &m_allocator;
+		m_context = openContext();
+
+		// instrumented script calls show up as scopes in the engine profiler
+		bt_profiler_set_scope_callback(m_context, [](void* userdata, const char* name){
+			if (name) profiler::beginBlock(name);
+			else profiler::endBlock();
+		}, nullptr);
 	}
 	
 	void shutdownStarted() override {
 		bt_close(m_context);
 		m_context = nullptr;
+		s_page_allocator = nullptr;
 	}
 
 	Engine& m_engine;
+	TagAllocator m_allocator;
 	bt_Context* m_context = nullptr;
 };
 
 
-struct BoltModule : IModule {
+static const ComponentType BOLT_SCRIPT_TYPE = reflection::getComponentType("bolt_script");
+
+// Entities with a `bolt_script` component are updated in batches. Components sharing a script and a tick interval form a
+// tick group, and each frame a group calls the script's exported `update(entities: [number], time_delta: number)` once,
+// with the indices of every entity due that frame. Entities are spread over the interval's phases by entity index, so
+// a script ticking every 4 frames runs a quarter of its entities each frame, with the time elapsed since their last tick.
+//
+// Scripts exporting `update_parallel(entities: [number], time_delta: number, results: Channel)` also have it called on worker
+// contexts, one per job system worker, each with a slice of the entities. Workers load the module from an image shared by all of
+// them. Their `lumix` module has no world, so scripts importing it load there but can't touch the world from another thread, they
+// hand their results to the main context's `apply(results: Channel)` export instead.
+struct BoltModule : BoltAPI::Module {
+	static constexpr u32 MAX_TICK_INTERVAL = 32;
+
+	struct TickGroup {
+		u32 interval;
+		u32 count;
+		// entity indices per phase, these are passed to the script as they are
+		bt_Array* phases[MAX_TICK_INTERVAL];
+		float deltas[MAX_TICK_INTERVAL];
+	};
+
+	// one per script resource, all of its components share the module
+	struct ScriptType {
+		ScriptType(BoltScript* resource, IAllocator& allocator)
+			: resource(resource)
+			, groups(allocator)
+		{}
+
+		BoltScript* resource;
+		bt_Value update_func = BT_VALUE_NULL;
+		bt_Value apply_func = BT_VALUE_NULL;
+		// only set for scripts with `update_parallel`
+		bt_Image* image = nullptr;
+		bt_Value results = BT_VALUE_NULL;
+		bool instantiated = false;
+		u32 instances = 0;
+		Array<TickGroup> groups;
+	};
+
+	struct Worker {
+		bt_Context* context;
+		bt_Thread* thread;
+		BoltAPI::Types types;
+	};
+
+	struct ParallelBatch {
+		ScriptType* type;
+		bt_Array* entities;
+		float time_delta;
+	};
+
+	struct ScriptComponent {
+		ScriptType* type = nullptr;
+		u32 tick_interval = 1;
+		// index into the entity's phase array
+		u32 slot = 0;
+	};
+
 	BoltModule(Engine& engine, BoltSystem& system, World& world, IAllocator& allocator)
 		: m_engine(engine)
 		, m_system(system)
 		, m_world(world)
 		, m_allocator(allocator, "bolt")
+		, m_scheduler(m_allocator)
+		, m_components(m_allocator)
+		, m_script_types(m_allocator)
+		, m_workers(m_allocator)
+		, m_parallel_batches(m_allocator)
 	{}
 
-	void registerLumixModule() {
+	~BoltModule() {
+		for (auto iter = m_components.begin(), end = m_components.end(); iter != end; ++iter) {
+			detach(iter.key(), iter.value());
+		}
+	}
+
+	static void reflect() {
+		LUMIX_MODULE(BoltModule, "bolt")
+			.LUMIX_CMP(Script, "bolt_script", "Bolt / Script")
+				.LUMIX_PROP(ScriptPath, "Path").resourceAttribute(BoltScript::TYPE)
+				.LUMIX_PROP(ScriptTickInterval, "Tick interval").minAttribute(1);
+	}
+
+	void createScript(EntityRef entity) {
+		m_components.insert(entity, ScriptComponent());
+		m_world.onComponentCreated(entity, BOLT_SCRIPT_TYPE, this);
+	}
+
+	void destroyScript(EntityRef entity) {
+		detach(entity, m_components[entity]);
+		m_components.erase(entity);
+		m_world.onComponentDestroyed(entity, BOLT_SCRIPT_TYPE, this);
+	}
+
+	Path getScriptPath(EntityRef entity) {
+		const ScriptComponent& cmp = m_components[entity];
+		return cmp.type ? cmp.type->resource->getPath() : Path();
+	}
+
+	void setScriptPath(EntityRef entity, const Path& path) {
+		ScriptComponent& cmp = m_components[entity];
+		detach(entity, cmp);
+		if (!path.isEmpty()) attach(entity, cmp, getScriptType(path));
+	}
+
+	u32 getScriptTickInterval(EntityRef entity) {
+		return m_components[entity].tick_interval;
+	}
+
+	void setScriptTickInterval(EntityRef entity, u32 interval) {
+		ScriptComponent& cmp = m_components[entity];
+		// the entity only moves between tick groups, going through detach would release a type this entity is the last instance of
+		if (cmp.type) removeFromGroup(entity, cmp);
+		cmp.tick_interval = clamp(interval, 1u, MAX_TICK_INTERVAL);
+		if (cmp.type) addToGroup(entity, cmp);
+	}
+
+	ScriptType* getScriptType(const Path& path) {
+		for (UniquePtr<ScriptType>& type : m_script_types) {
+			if (type->resource->getPath() == path) return type.get();
+		}
+
+		BoltScript* resource = m_engine.getResourceManager().load<BoltScript>(path);
+		m_script_types.push(UniquePtr<ScriptType>::create(m_allocator, resource, m_allocator));
+		return m_script_types.back().get();
+	}
+
+	TickGroup& getTickGroup(ScriptType& type, u32 interval) {
+		for (TickGroup& group : type.groups) {
+			if (group.interval == interval) return group;
+		}
+
 		bt_Context* ctx = m_system.m_context;
-		bt_Module* module = bt_make_module(ctx);
-		BoltAPI::s_world_type = bt_make_userdata_type(ctx, "World");
+		TickGroup& group = type.groups.emplace();
+		group.interval = interval;
+		group.count = 0;
+		for (u32 i = 0; i < interval; ++i) {
+			group.phases[i] = bt_make_array(ctx, 0);
+			bt_add_ref(ctx, (bt_Object*)group.phases[i]);
+			group.deltas[i] = 0;
+		}
+		return group;
+	}
 
-		bt_Type* number_type = bt_type_number(ctx);
-		bt_Type* string_type = bt_type_string(ctx);
+	void addToGroup(EntityRef entity, ScriptComponent& cmp) {
+		TickGroup& group = getTickGroup(*cmp.type, cmp.tick_interval);
+		bt_Array* phase = group.phases[entity.index % group.interval];
+		cmp.slot = phase->length;
+		bt_array_push(m_system.m_context, phase, BT_VALUE_NUMBER(entity.index));
+		++group.count;
+	}
 
-		BoltAPI::s_dvec3_type = bt_make_tableshape_type(ctx, "DVec3", BT_TRUE);
-		bt_tableshape_add_layout(ctx, BoltAPI::s_dvec3_type, string_type, BT_VALUE_CSTRING(ctx, "x"), number_type);
+	void removeFromGroup(EntityRef entity, ScriptComponent& cmp) {
+		ScriptType* type = cmp.type;
+		bt_Context* ctx = m_system.m_context;
+		for (u32 i = 0; i < (u32)type->groups.size(); ++i) {
+			TickGroup& group = type->groups[i];
+			if (group.interval != cmp.tick_interval) continue;
+
+			// swap the last entity of the phase into the freed slot
+			bt_Array* phase = group.phases[entity.index % group.interval];
+			const bt_Value last = phase->items[phase->length - 1];
+			phase->items[cmp.slot] = last;
+			--phase->length;
+			if (cmp.slot < phase->length) m_components[EntityRef{ (i32)BT_AS_NUMBER(last) }].slot = cmp.slot;
+
+			if (--group.count == 0) {
+				for (u32 j = 0; j < group.interval; ++j) bt_remove_ref(ctx, (bt_Object*)group.phases[j]);
+				type->groups.swapAndPop(i);
+			}
+			break;
+		}
+	}
 
-		bt_module_export(ctx, module, bt_make_alias_type(ctx, "DVec3", BoltAPI::s_dvec3_type), BT_VALUE_CSTRING(ctx, "DVec3"), bt_value((bt_Object*)BoltAPI::s_dvec3_type));
-		bt_module_set_storage(module, BT_VALUE_CSTRING(ctx, "DVec3"), bt_value((bt_Object*)BoltAPI::s_dvec3_type));
+	void attach(EntityRef entity, ScriptComponent& cmp, ScriptType* type) {
+		cmp.type = type;
+		addToGroup(entity, cmp);
+		++type->instances;
+	}
 
-		bt_Type* entity_type = bt_make_userdata_type(ctx, "Entity");
-		bt_userdata_type_push_field(ctx, entity_type, "position", 0, BoltAPI::s_dvec3_type, BoltAPI::entityGetPosition, BoltAPI::entitySetPosition);
-	
-		bt_register_module(ctx, BT_VALUE_CSTRING(ctx, "lumix"), module);
+	void detach(EntityRef entity, ScriptComponent& cmp) {
+		ScriptType* type = cmp.type;
+		if (!type) return;
+		removeFromGroup(entity, cmp);
+		cmp.type = nullptr;
+
+		if (--type->instances == 0) {
+			releaseScriptType(*type);
+			type->resource->decRefCount();
+			for (u32 i = 0; i < (u32)m_script_types.size(); ++i) {
+				if (m_script_types[i].get() == type) {
+					m_script_types.swapAndPop(i);
+					break;
+				}
+			}
+		}
 	}
 
 	void startGame() override {
 		bt_Context* ctx = m_system.m_context;
-		registerLumixModule();
+		BoltAPI::registerLumixModule(ctx, m_types, &m_world, &m_scheduler);
 
 		m_main_thread = bt_make_thread(ctx);
-		FileSystem& fs = m_engine.getFileSystem();
-		OutputMemoryStream main_content(m_allocator);
-		if (fs.getContentSync(Path("scripts/main.bolt"), main_content)) {
-			main_content.write(0);
-			bt_Module* module = bt_compile_module(ctx, (const char*)main_content.data(), "scripts/main");
-			if (module && bt_execute(ctx, (bt_Callable*)module)) {
-				m_update_func = bt_module_get_export(module, BT_VALUE_CSTRING(ctx, "update"));
-			}
+		// compiled by the asset compiler, instantiated in update once it's loaded
+		m_main_script = m_engine.getResourceManager().load<BoltScript>(Path("scripts/main.bolt"));
+		m_is_game_running = true;
+
+		const u32 workers_count = maximum(1u, (u32)jobs::getWorkersCount());
+		for (u32 i = 0; i < workers_count; ++i) {
+			Worker& worker = m_workers.emplace();
+			worker.context = m_system.openContext();
+			BoltAPI::registerLumixModule(worker.context, worker.types);
+			worker.thread = bt_make_thread(worker.context);
+		}
+	}
+
+	bt_Module* loadModule(BoltScript& script) {
+		bt_Context* ctx = m_system.m_context;
+		bt_Module* module = nullptr;
+		if (script.isCompiled()) {
+			Span<const u8> bytecode = script.getBytecode();
+			module = bt_deserialize_module(ctx, bytecode.begin(), bytecode.length(), script.getPath().c_str());
+		}
+		else {
+			// source fallback, used when the script could not be serialized
+			OutputMemoryStream source(m_allocator);
+			source.write(script.getSourceCode().begin, script.getSourceCode().size());
+			source.write(0);
+			module = bt_compile_module(ctx, (const char*)source.data(), script.getPath().c_str());
+		}
+
+		if (module && bt_execute(ctx, (bt_Callable*)module)) return module;
+		return nullptr;
+	}
+
+	// returns the module's export called `name`, kept alive explicitly as the gc runs every frame
+	bt_Value getExport(bt_Module* module, const char* name) {
+		if (!module) return BT_VALUE_NULL;
+		bt_Context* ctx = m_system.m_context;
+		bt_Value value = bt_module_get_export(module, BT_VALUE_CSTRING(ctx, name));
+		if (BT_IS_OBJECT(value)) bt_add_ref(ctx, BT_AS_OBJECT(value));
+		return value;
+	}
+
+	static void release(bt_Context* ctx, bt_Value& value) {
+		if (BT_IS_OBJECT(value)) bt_remove_ref(ctx, BT_AS_OBJECT(value));
+		value = BT_VALUE_NULL;
+	}
+
+	void instantiate(ScriptType& type) {
+		bt_Context* ctx = m_system.m_context;
+		bt_Module* module = loadModule(*type.resource);
+		type.update_func = getExport(module, "update");
+		type.apply_func = getExport(module, "apply");
+		type.instantiated = true;
+		if (!module || BT_IS_NULL(bt_module_get_export(module, BT_VALUE_CSTRING(ctx, "update_parallel")))) return;
+
+		// workers import the module by its path, each runs its own instance of it
+		const char* name = type.resource->getPath().c_str();
+		type.image = bt_make_image(ctx);
+		const bool added = type.resource->isCompiled()
+			? bt_image_add_serialized(type.image, name, type.resource->getBytecode().begin(), type.resource->getBytecode().length())
+			: bt_image_add_module(ctx, type.image, name, module);
+		if (!added) logError("Failed to share ", name, " with the worker contexts");
+		bt_image_freeze(type.image);
+		for (Worker& worker : m_workers) bt_attach_image(worker.context, type.image);
+
+		// load it on the workers now, while none of them runs, a script they can't load would otherwise drop its batches every frame
+		for (Worker& worker : m_workers) {
+			if (bt_find_module(worker.context, BT_VALUE_CSTRING(worker.context, name), BT_FALSE)) continue;
+
+			logError("Worker contexts failed to load ", name, ", its update_parallel won't run");
+			for (Worker& attached : m_workers) bt_detach_image(attached.context, type.image);
+			bt_destroy_image(type.image);
+			type.image = nullptr;
+			return;
+		}
+
+		bt_Channel* results = bt_make_channel(ctx);
+		type.results = BT_VALUE_OBJECT(bt_channel_wrap(ctx, results));
+		bt_add_ref(ctx, BT_AS_OBJECT(type.results));
+		bt_channel_release(results);
+	}
+
+	void releaseScriptType(ScriptType& type) {
+		bt_Context* ctx = m_system.m_context;
+		release(ctx, type.update_func);
+		release(ctx, type.apply_func);
+		release(ctx, type.results);
+		if (type.image) {
+			for (Worker& worker : m_workers) bt_detach_image(worker.context, type.image);
+			bt_destroy_image(type.image);
+			type.image = nullptr;
 		}
+		type.instantiated = false;
 	}
 
 	void stopGame() override {
-		bt_destroy_thread(m_system.m_context, m_main_thread);
+		bt_Context* ctx = m_system.m_context;
+		if (BT_IS_OBJECT(m_update_func)) bt_remove_ref(ctx, BT_AS_OBJECT(m_update_func));
+		m_update_func = BT_VALUE_NULL;
+		// module state doesn't outlive the game, the next one executes the scripts again
+		for (Worker& worker : m_workers) {
+			bt_destroy_thread(worker.context, worker.thread);
+			bt_close(worker.context);
+		}
+		m_workers.clear();
+		for (UniquePtr<ScriptType>& type : m_script_types) releaseScriptType(*type);
+		m_scheduler.clear(ctx);
+		bt_destroy_thread(ctx, m_main_thread);
+		if (m_main_script) {
+			m_main_script->decRefCount();
+			m_main_script = nullptr;
+		}
+		m_main_script_instantiated = false;
+		m_is_game_running = false;
 	}
 
 	const char* getName() const override { return "bolt"; }
+	i32 getVersion() const override { return (i32)Version::LATEST - 1; }
 
 	void serialize(struct OutputMemoryStream& serializer) override {
+		serializer.write((u32)m_components.size());
+		for (auto iter = m_components.begin(), end = m_components.end(); iter != end; ++iter) {
+			const ScriptComponent& cmp = iter.value();
+			serializer.write(iter.key());
+			serializer.writeString(cmp.type ? cmp.type->resource->getPath().c_str() : "");
+			serializer.write(cmp.tick_interval);
+		}
 	}
 
 	void deserialize(struct InputMemoryStream& serializer, const struct EntityMap& entity_map, i32 version) override {
-
+		// worlds saved before script components have no data
+		if (version < (i32)Version::SCRIPT_COMPONENTS) return;
+
+		const u32 count = serializer.read<u32>();
+		for (u32 i = 0; i < count; ++i) {
+			EntityRef entity = serializer.read<EntityRef>();
+			entity = entity_map.get(entity);
+			const char* path = serializer.readString();
+			ScriptComponent& cmp = m_components.insert(entity, ScriptComponent());
+			cmp.tick_interval = clamp(serializer.read<u32>(), 1u, MAX_TICK_INTERVAL);
+			if (path[0]) attach(entity, cmp, getScriptType(Path(path)));
+			m_world.onComponentCreated(entity, BOLT_SCRIPT_TYPE, this);
+		}
 	}
+
 	ISystem& getSystem() const override { return m_system; }
 	World& getWorld() override { return m_world; }
+	float getScriptTime() const override { return m_script_time; }
+	u32 getScriptCalls() const override { return m_script_calls; }
+
+	// runs `func` on `thread`, returns false if it raised an error
+	static bool execute(bt_Context* ctx, bt_Thread*& thread, bt_Value func, bt_Value* args, u8 argc) {
+		// execute through the context so the gc sees this thread's stack
+		if (bt_execute_with_args(ctx, thread, (bt_Callable*)BT_AS_OBJECT(func), args, argc)) {
+			bt_pop(thread);
+			return true;
+		}
+
+		// a runtime error unwinds without restoring the thread, start over with a fresh one
+		bt_destroy_thread(ctx, thread);
+		thread = bt_make_thread(ctx);
+		return false;
+	}
+
+	bool execute(bt_Value func, bt_Value* args, u8 argc) {
+		return execute(m_system.m_context, m_main_thread, func, args, argc);
+	}
+
+	// runs on a job system worker, nothing but `worker` is touched apart from reading the batches
+	void updateWorker(Worker& worker, u32 index) {
+		PROFILE_FUNCTION();
+		bt_Context* ctx = worker.context;
+		const u32 workers_count = m_workers.size();
+		for (const ParallelBatch& batch : m_parallel_batches) {
+			// every worker takes its own slice of the entities
+			const u32 count = batch.entities->length;
+			const u32 slice = (count + workers_count - 1) / workers_count;
+			const u32 from = index * slice;
+			const u32 to = minimum(count, from + slice);
+			if (from >= to) continue;
+
+			bt_Module* module = bt_find_module(ctx, BT_VALUE_CSTRING(ctx, batch.type->resource->getPath().c_str()), BT_TRUE);
+			if (!module) continue;
+			bt_Value func = bt_module_get_export(module, BT_VALUE_CSTRING(ctx, "update_parallel"));
+			if (!BT_IS_OBJECT(func)) continue;
+
+			bt_Channel* channel = bt_channel_unwrap((bt_Userdata*)BT_AS_OBJECT(batch.type->results));
+			bt_Userdata* results = bt_channel_wrap(ctx, channel);
+			bt_push_root(ctx, (bt_Object*)results);
+			bt_Array* entities = bt_make_array(ctx, to - from);
+			bt_push_root(ctx, (bt_Object*)entities);
+			for (u32 i = from; i < to; ++i) bt_array_push(ctx, entities, batch.entities->items[i]);
+
+			bt_Value args[] = { BT_VALUE_OBJECT(entities), BT_VALUE_NUMBER(batch.time_delta), BT_VALUE_OBJECT(results) };
+			execute(ctx, worker.thread, func, args, lengthOf(args));
+			bt_pop_root(ctx);
+			bt_pop_root(ctx);
+		}
+
+		bt_gc_step(ctx, GC_BUDGET_US);
+	}
+
+	void updateParallel() {
+		PROFILE_FUNCTION();
+		jobs::forEach((i32)m_workers.size(), 1, [&](i32 from, i32 to){
+			for (i32 i = from; i < to; ++i) updateWorker(m_workers[i], i);
+		});
+		m_script_calls += m_parallel_batches.size();
+
+		for (UniquePtr<ScriptType>& type : m_script_types) {
+			if (!type->image || !BT_IS_OBJECT(type->apply_func)) continue;
+			if (bt_channel_count(bt_channel_unwrap((bt_Userdata*)BT_AS_OBJECT(type->results))) == 0) continue;
+
+			execute(type->apply_func, &type->results, 1);
+			++m_script_calls;
+		}
+	}
+
+	void updateScripts(float time_delta) {
+		PROFILE_FUNCTION();
+		os::Timer timer;
+		m_script_calls = 0;
+		for (UniquePtr<ScriptType>& type : m_script_types) {
+			if (!type->instantiated) {
+				if (type->resource->isReady()) {
+					instantiate(*type);
+				}
+				else if (type->resource->isFailure()) {
+					logError("Failed to load ", type->resource->getPath());
+					type->instantiated = true;
+				}
+				else continue;
+			}
+			if (!BT_IS_OBJECT(type->update_func) && !type->image) continue;
+
+			for (TickGroup& group : type->groups) {
+				const u32 phase = m_frame % group.interval;
+				group.deltas[phase] = time_delta;
+				bt_Array* entities = group.phases[phase];
+				if (entities->length == 0) continue;
+
+				// the phase last ticked `interval` frames ago
+				float elapsed = 0;
+				for (u32 i = 0; i < group.interval; ++i) elapsed += group.deltas[i];
+
+				if (type->image) m_parallel_batches.push({ type.get(), entities, elapsed });
+				if (!BT_IS_OBJECT(type->update_func)) continue;
+
+				bt_Value args[] = { BT_VALUE_OBJECT(entities), BT_VALUE_NUMBER(elapsed) };
+				execute(type->update_func, args, lengthOf(args));
+				++m_script_calls;
+			}
+		}
+		if (!m_parallel_batches.empty()) updateParallel();
+		m_parallel_batches.clear();
+		++m_frame;
+		m_script_time = timer.getTimeSinceStart();
+	}
 	
 	void update(float time_delta) {
-		if (BT_IS_NULL(m_update_func)) return;
-
+		PROFILE_FUNCTION();
 		bt_Context* ctx = m_system.m_context;
-		bt_Thread* thread = m_main_thread;
-		bt_push(thread, m_update_func);
-		bt_push(thread, BT_VALUE_NUMBER(time_delta));
-		bt_call(thread, 1);
-		bt_pop(thread);
+		if (m_main_script && !m_main_script_instantiated) {
+			if (m_main_script->isReady()) {
+				m_update_func = getExport(loadModule(*m_main_script), "update");
+				m_main_script_instantiated = true;
+			}
+			else if (m_main_script->isFailure()) {
+				logError("Failed to load ", m_main_script->getPath());
+				m_main_script_instantiated = true;
+			}
+		}
+
+		if (BT_IS_OBJECT(m_update_func)) {
+			bt_Value arg = BT_VALUE_NUMBER(time_delta);
+			execute(m_update_func, &arg, 1);
+		}
+
+		if (m_is_game_running) updateScripts(time_delta);
+		m_scheduler.update(ctx, time_delta);
+
+		bt_gc_step(ctx, GC_BUDGET_US);
 	}
 
+	enum class Version : i32 {
+		SCRIPT_COMPONENTS,
+
+		LATEST
+	};
+
 	Engine& m_engine;
 	BoltSystem& m_system;
 	World& m_world;
 	TagAllocator m_allocator;
+	BoltAPI::CoroutineScheduler m_scheduler;
+	BoltAPI::Types m_types;
+	HashMap<EntityRef, ScriptComponent> m_components;
+	Array<UniquePtr<ScriptType>> m_script_types;
+	Array<Worker> m_workers;
+	Array<ParallelBatch> m_parallel_batches;
 	bt_Thread* m_main_thread = nullptr;
 	bt_Value m_update_func = BT_VALUE_NULL;
+	BoltScript* m_main_script = nullptr;
+	bool m_main_script_instantiated = false;
+	bool m_is_game_running = false;
+	u32 m_frame = 0;
+	float m_script_time = 0;
+	u32 m_script_calls = 0;
+	static constexpr u32 GC_BUDGET_US = 500;
 };
 
+BoltSystem::BoltSystem(Engine& engine)
+	: m_engine(engine)
+	, m_allocator(engine.getAllocator(), "bolt")
+{
+	BoltModule::reflect();
+}
+
 void BoltSystem::createModules(World& world) {
 	IAllocator& allocator = m_engine.getAllocator();
 	UniquePtr<BoltModule> module = UniquePtr<BoltModule>::create(allocator, m_engine, *this, world, allocator);
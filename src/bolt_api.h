@@ -0,0 +1,37 @@
+#pragma once
+
+#include "engine/plugin.h"
+
+typedef struct bt_Context bt_Context;
+typedef struct bt_Type bt_Type;
+
+namespace BoltAPI {
+
+// the engine side `bolt` system, lets editor plugins reach the runtime context, e.g. to drive the profiler
+struct System : Lumix::ISystem {
+	virtual bt_Context* getContext() = 0;
+};
+
+// the per-world `bolt` module, runs the `bolt_script` components
+struct Module : Lumix::IModule {
+	// time spent in the last frame's batched script updates, in seconds
+	virtual float getScriptTime() const = 0;
+	// number of `update` calls the batches made in the last frame
+	virtual Lumix::u32 getScriptCalls() const = 0;
+};
+
+struct CoroutineScheduler;
+
+struct Types {
+	bt_Type* dvec3 = nullptr;
+	bt_Type* world = nullptr;
+	bt_Type* entity = nullptr;
+};
+
+// registers the `lumix` module in `ctx`, the asset compiler needs it too so scripts importing it can be compiled offline
+// `world` is exported as `lumix.world`, the asset compiler passes null as scripts don't run there, and so do worker contexts
+// as they must not touch the world. `types` is filled with the types created in `ctx`, every context needs its own
+// coroutines passed to `lumix.start` are handed to `scheduler`
+void registerLumixModule(bt_Context* ctx, Types& types, Lumix::World* world = nullptr, CoroutineScheduler* scheduler = nullptr);
+
+}
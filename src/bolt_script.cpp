@@ -1,5 +1,6 @@
 #include "bolt_script.h"
 #include "core/stream.h"
+#include "bt_serialize.h"
 
 namespace Lumix {
 
@@ -8,6 +9,7 @@ BoltScript::BoltScript(const Path& path, ResourceManager& resource_manager, IAll
 	: Resource(path, resource_manager, allocator)
 	, m_allocator(allocator, m_path.c_str())
 	, m_source_code(m_allocator)
+	, m_bytecode(m_allocator)
 {
 }
 
@@ -15,9 +17,15 @@ BoltScript::~BoltScript() = default;
 
 void BoltScript::unload() {
 	m_source_code = "";
+	m_bytecode.clear();
 }
 
 bool BoltScript::load(Span<const u8> mem) {
+	if (bt_is_serialized_module(mem.begin(), mem.length())) {
+		m_bytecode.write(mem.begin(), mem.length());
+		return true;
+	}
+
 	InputMemoryStream blob(mem.begin(), mem.length());
 	m_source_code = StringView((const char*)blob.skip(0), (u32)blob.remaining());
 	return true;
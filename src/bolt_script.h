@@ -1,6 +1,7 @@
 #pragma once
 
 #include "engine/resource.h"
+#include "core/stream.h"
 #include "core/string.h"
 #include "core/tag_allocator.h"
 
@@ -15,12 +16,16 @@ struct BoltScript final : Resource {
 	void unload() override;
 	bool load(Span<const u8> mem) override;
 	StringView getSourceCode() const { return m_source_code; }
+	// compiled by the asset compiler, see bt_serialize.h; empty if the script was stored as source
+	bool isCompiled() const { return !m_bytecode.empty(); }
+	Span<const u8> getBytecode() const { return m_bytecode; }
 
 	static inline const ResourceType TYPE = ResourceType("bolt_script");
 
 private:
 	TagAllocator m_allocator;
 	String m_source_code;
+	OutputMemoryStream m_bytecode;
 };
 
 
@@ -1,6 +1,10 @@
 #include "core/allocator.h"
+#include "core/array.h"
+#include "core/log.h"
 #include "core/profiler.h"
+#include "core/stream.h"
 #include "engine/engine.h"
+#include "engine/world.h"
 #include "editor/action.h"
 #include "editor/asset_compiler.h"
 #include "editor/asset_browser.h"
@@ -9,7 +13,13 @@
 #include "editor/utils.h"
 #include "editor/world_editor.h"
 #include "imgui/imgui.h"
+#include "../bolt_api.h"
 #include "../bolt_script.h"
+#include "bolt.h"
+#include "bt_profiler.h"
+#include "bt_serialize.h"
+#include "boltstd/boltstd.h"
+#include <stdlib.h>
 
 namespace Lumix {
 
@@ -291,8 +301,40 @@ struct BoltAssetPlugin : AssetBrowser::IPlugin, AssetCompiler::IPlugin {
 		m_app.getAssetBrowser().addWindow(win.move());
 	}
 
+	// scripts are compiled here and stored as serialized modules, so the runtime skips tokenizing, parsing and compiling
 	bool compile(const Path& src) override {
-		return m_app.getAssetCompiler().copyCompile(src);
+		FileSystem& fs = m_app.getEngine().getFileSystem();
+		OutputMemoryStream source(m_app.getAllocator());
+		if (!fs.getContentSync(src, source)) {
+			logError("Could not read ", src);
+			return false;
+		}
+		source.write(0);
+
+		bt_Handlers handlers = bt_default_handlers();
+		handlers.on_error = [](bt_ErrorType type, const char* module, const char* message, uint16_t line, uint16_t col){
+			logError(module, "(", line, ",", col, "): ", message);
+		};
+
+		// private context, compile can run on any thread
+		bt_Context* ctx;
+		bt_open(&ctx, &handlers);
+		boltstd_open_all(ctx);
+		bt_append_module_path(ctx, "%s");
+		BoltAPI::Types types;
+		BoltAPI::registerLumixModule(ctx, types);
+
+		OutputMemoryStream compiled(m_app.getAllocator());
+		bt_Module* module = bt_compile_module(ctx, (const char*)source.data(), src.c_str());
+		bool serialized = module && bt_serialize_module(ctx, module, BT_TRUE, [](void* userdata, const void* data, size_t size){
+			((OutputMemoryStream*)userdata)->write(data, size);
+		}, &compiled);
+		bt_close(ctx);
+
+		if (!module) return false;
+		// modules referencing native objects that can't be named are kept as source and compiled at runtime
+		if (!serialized) return m_app.getAssetCompiler().copyCompile(src);
+		return m_app.getAssetCompiler().writeCompiledResource(src, compiled);
 	}
 
 	const char* getIcon() const override { return ICON_FA_FILE_CODE; }
@@ -311,19 +353,94 @@ struct BoltEditorPlugin : StudioApp::GUIPlugin {
 	BoltEditorPlugin(StudioApp& app)
 		: m_app(app)
 		, m_asset_plugin(app)
+		, m_profile_sorted(app.getAllocator())
 	{
 		const char* extensions[] = { "bolt" };
 		m_app.getAssetCompiler().addPlugin(m_asset_plugin, Span(extensions));
 		m_app.getAssetBrowser().addPlugin(m_asset_plugin, Span(extensions));
 	}
 
-	void onGUI() override {}
+	void onGUI() override {
+		ISystem* system = m_app.getEngine().getSystemManager().getSystem("bolt");
+		if (!system) return;
+		bt_Context* ctx = static_cast<BoltAPI::System*>(system)->getContext();
+		if (!ctx) return;
+
+		if (ImGui::Begin("Bolt profiler")) profilerGUI(ctx);
+		ImGui::End();
+
+		if (m_profile_per_frame) bt_profiler_reset(ctx);
+	}
+
+	void profilerGUI(bt_Context* ctx) {
+		const char* modes[] = { "Off", "Instrumented", "Sampling" };
+		int mode = bt_profiler_is_running(ctx) ? m_profile_mode : 0;
+		if (ImGui::Combo("Mode", &mode, modes, lengthOf(modes))) {
+			if (mode == 0) bt_profiler_stop(ctx);
+			else bt_profiler_start(ctx, mode == 1 ? BT_PROFILE_INSTRUMENT : BT_PROFILE_SAMPLE, 0);
+			m_profile_mode = mode;
+		}
+		ImGui::Checkbox("Per frame", &m_profile_per_frame);
+		ImGui::SameLine();
+		if (ImGui::Button("Save flamegraph")) {
+			// folded stacks, feed them to flamegraph.pl or speedscope
+			bt_String* folded = bt_profiler_dump_folded(ctx);
+			FileSystem& fs = m_app.getEngine().getFileSystem();
+			if (!fs.saveContentSync(Path("bolt_profile.folded"), Span((const u8*)BT_STRING_STR(folded), folded->len))) {
+				logError("Failed to save bolt_profile.folded");
+			}
+		}
+
+		World* world = m_app.getWorldEditor().getWorld();
+		if (auto* module = world ? static_cast<BoltAPI::Module*>(world->getModule("bolt")) : nullptr) {
+			ImGui::Text("Script components: %.3f ms in %u update calls", module->getScriptTime() * 1000, module->getScriptCalls());
+		}
+
+		u32 count;
+		const bt_ProfileFunction* functions = bt_profiler_get_functions(ctx, &count);
+		m_profile_sorted.clear();
+		for (u32 i = 0; i < count; ++i) {
+			if (functions[i].calls || functions[i].samples) m_profile_sorted.push(&functions[i]);
+		}
+		qsort(m_profile_sorted.begin(), m_profile_sorted.size(), sizeof(m_profile_sorted[0]), [](const void* a, const void* b){
+			const bt_ProfileFunction* fa = *(const bt_ProfileFunction**)a;
+			const bt_ProfileFunction* fb = *(const bt_ProfileFunction**)b;
+			u64 cost_a = fa->exclusive_ns + fa->self_samples;
+			u64 cost_b = fb->exclusive_ns + fb->self_samples;
+			return cost_a < cost_b ? 1 : (cost_a > cost_b ? -1 : 0);
+		});
+
+		if (!ImGui::BeginTable("functions", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable | ImGuiTableFlags_ScrollY)) return;
+		ImGui::TableSetupColumn("Function");
+		ImGui::TableSetupColumn("Calls");
+		ImGui::TableSetupColumn("Self (ms)");
+		ImGui::TableSetupColumn("Total (ms)");
+		ImGui::TableSetupColumn("Samples (self / total)");
+		ImGui::TableHeadersRow();
+		for (const bt_ProfileFunction* f : m_profile_sorted) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(f->name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)f->calls);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", f->exclusive_ns / 1e6);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", f->inclusive_ns / 1e6);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu / %llu", (unsigned long long)f->self_samples, (unsigned long long)f->samples);
+		}
+		ImGui::EndTable();
+	}
 	
 	const char* getName() const override { return "bolt"; }
 
 	StudioApp& m_app;
 	BoltAssetPlugin m_asset_plugin;
 	float m_some_value = 0;
+	int m_profile_mode = 0;
+	bool m_profile_per_frame = true;
+	Array<const bt_ProfileFunction*> m_profile_sorted;
 };
 
 
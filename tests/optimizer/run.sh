@@ -0,0 +1,50 @@
+#!/bin/sh
+# Differential tests for the optimizing compiler pass (bt_CompilerOptions.optimize_bytecode).
+# Every script with a matching .expected file is run with the pass on and off, and what both print has to match it.
+# Scripts without one (lib.bolt) are only imported by the others.
+#
+#   ./run.sh            build the runner and check every script
+#   ./run.sh --update   rewrite the .expected files from the unoptimized output, review the diff before committing it
+#
+# To add a script, create an empty .expected file next to it and run with --update.
+# CC and CFLAGS are honoured, e.g. CFLAGS="-O1 -g -fsanitize=address,undefined" ./run.sh
+
+set -u
+
+here=$(cd "$(dirname "$0")" && pwd)
+external="$here/../../external"
+build="${TMPDIR:-/tmp}/bolt-optimizer-tests"
+runner="$build/runner"
+update=0
+[ "${1:-}" = "--update" ] && update=1
+
+mkdir -p "$build"
+${CC:-cc} ${CFLAGS:--O2} -w -I"$external" "$here/runner.c" "$external"/*.c "$external"/boltstd/*.c \
+	"$external"/boltstd/picomatch/*.c -lm -o "$runner" || exit 1
+
+# imports are resolved relative to the working directory
+cd "$here" || exit 1
+
+failed=0
+for expected in *.expected; do
+	name=${expected%.expected}
+
+	"$runner" "$name.bolt" --no-opt > "$build/$name.off"
+	"$runner" "$name.bolt" > "$build/$name.on"
+
+	[ $update = 1 ] && cp "$build/$name.off" "$expected"
+
+	result="ok  "
+	for mode in off on; do
+		if ! cmp -s "$expected" "$build/$name.$mode"; then
+			echo "--- $name, optimizer $mode:"
+			diff "$expected" "$build/$name.$mode" | head -20
+			result="FAIL"
+			failed=1
+		fi
+	done
+
+	echo "$result $name"
+done
+
+exit $failed
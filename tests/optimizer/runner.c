@@ -0,0 +1,53 @@
+// Compiles and runs a single script, with the optimizing pass either on or off (--no-opt), printing whatever it prints
+#include "bolt.h"
+#include "bt_context.h"
+#include "boltstd/boltstd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* read_source(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	char* source = malloc(length + 1);
+	source[fread(source, 1, length, file)] = 0;
+	fclose(file);
+
+	return source;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <script.bolt> [--no-opt]\n", argv[0]);
+		return 2;
+	}
+
+	char* source = read_source(argv[1]);
+	if (!source) {
+		fprintf(stderr, "failed to read '%s'\n", argv[1]);
+		return 2;
+	}
+
+	bt_Context* context;
+	bt_Handlers handlers = bt_default_handlers();
+	bt_open(&context, &handlers);
+	boltstd_open_all(context);
+
+	context->compiler_options.optimize_bytecode = !(argc > 2 && strcmp(argv[2], "--no-opt") == 0);
+
+	bt_Module* module = bt_compile_module(context, source, "main");
+	bt_bool ok = module && bt_execute(context, (bt_Callable*)module);
+
+	bt_close(context);
+	free(source);
+
+	return ok ? 0 : 1;
+}